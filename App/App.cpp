@@ -1,170 +1,294 @@
-﻿// App.cpp : Defines the entry point for the application.
-//
-
-#include "stdafx.h"
-#include "App.h"
-#include "resource.h"
-#include <debug.h>
-#include <file.h>
-#include <array>
-
-// global
-config::ConfigFile g_config(L"config.txt", {
-	{ "graphics.skip", "0" },
-	{ "graphics.cursor", "true" },
-	{ "graphics.fullscreen", "false" },
-	{ "script.debug", "true" },
-	{ "perf.output", "false" },
-});
-
-MyApp::MyApp(const framework::AppParam &appParam,
-	const graphics::GraphicsParam &graphParam)
-	: Application(appParam, graphParam, ResSetId::Count)
-{}
-
-framework::scene::SceneBase *MyApp::getScene(SceneId id)
-{
-	return m_scenes[static_cast<uint32_t>(id)].get();
-}
-
-void MyApp::setNextScene(SceneId id)
-{
-	m_pNextScene = getScene(id);
-}
-
-void MyApp::init()
-{
-	// load common resource
-	{
-		framework::UnsealResource autoSeal(*this);
-		addFontResource(ResSetId::Common, "e", L"ＭＳ 明朝", 0x00, 0xff, 16, 32);
-		addFontResource(ResSetId::Common, "j", L"メイリオ", L'あ', L'ん', 128, 128);
-		addSeResource(ResSetId::Common, "testse", L"/C:/Windows/Media/chord.wav");
-	}
-	loadResourceSet(ResSetId::Common, std::atomic_bool());
-
-	m_scenes[static_cast<uint32_t>(SceneId::Main)] =
-		std::make_unique<MainScene>(this, g_config.getBool("script.debug"));
-	m_scenes[static_cast<uint32_t>(SceneId::Sub)] = 
-		std::make_unique<SubScene>(this);
-
-	// set initial scene
-	auto mainScene = getSceneAs<MainScene>(SceneId::Main);
-	mainScene->setup();
-	setNextScene(SceneId::Main);
-}
-
-void MyApp::update()
-{
-	// go to next scene returned by previous update()
-	if (m_pNextScene != nullptr) {
-		m_pCurrentScene = m_pNextScene;
-		m_pNextScene = nullptr;
-	}
-
-	m_pCurrentScene->update();
-	// m_pNextScene may be set
-}
-
-void MyApp::render()
-{
-	// render by current scene even if next scene was returned
-	m_pCurrentScene->render();
-}
-
-
-int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
-                     _In_opt_ HINSTANCE hPrevInstance,
-                     _In_ LPWSTR    lpCmdLine,
-                     _In_ int       nCmdShow)
-{
-	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
-
-	// debug test
-	{
-		debug::enableDebugOutput();
-		debug::enableConsoleOutput();
-		debug::enableFileOutput(L"log.txt");
-
-		debug::writeLine(L"Start application");
-		debug::writeLine(L"にほんご");
-		debug::writef(L"%d 0x%08x %f %.8f", 123, 0x1234abcd, 3.14, 3.14);
-
-		const wchar_t *digit = L"0123456789abcdef";
-		wchar_t large[1024 + 32] = { 0 };
-		for (int i = 0; i < 1024; i++) {
-			large[i] = digit[i & 0xf];
-		}
-		debug::writef(large);
-
-		wchar_t dir[MAX_PATH];
-		::GetCurrentDirectory(MAX_PATH, dir);
-		debug::writef(L"Current dir: %s", dir);
-	}
-	// trace test
-	// fixed length string key test
-	{
-		trace::initialize(1 * 1024 * 1024);
-		for (int i = 0; i < 1024 * 1024; i++) {
-			trace::write("test");
-		}
-		trace::write("test start");
-
-		using util::IdString;
-		IdString key1, key2, key3;
-		util::createFixedString(&key1, "alice");
-		util::createFixedString(&key2, "sinki");
-		util::createFixedString(&key3, "takenoko");
-		std::unordered_map<IdString, int> hash;
-		hash.emplace(key1, 1);
-		hash.emplace(key2, 2);
-		hash.emplace(key3, 3);
-		hash.insert({key1, 4});
-		for (auto entry : hash) {
-			debug::writef("%s=%d", entry.first.data(), entry.second);
-		}
-
-		trace::write("test end");
-		// open with notepad
-		// trace::output();
-	}
-	// error test
-	{
-		debug::writeLine(error::createStackTraceMsg("error test").c_str());
-	}
-
-	int result = 0;
-	try {
-		g_config.load();
-
-		file::initWithFileSystem(L".");
-
-		framework::AppParam appParam;
-		graphics::GraphicsParam graphParam;
-		appParam.hInstance = hInstance;
-		appParam.wndClsName = L"TestAppClass";
-		appParam.title = L"Test App (0-9: Change speed, F5: Reload script, F12: Lua Debugger)";
-		appParam.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_APP));
-		appParam.hIconSm = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_SMALL));
-		appParam.nCmdShow = nCmdShow;
-		appParam.frameSkip = g_config.getInt("graphics.skip");
-		appParam.showCursor = g_config.getBool("graphics.cursor");
-		graphParam.w = 1024;
-		graphParam.h = 768;
-		graphParam.fullScreen = g_config.getBool("graphics.fullscreen");
-
-		auto app = std::make_unique<MyApp>(appParam, graphParam);
-		result = app->run();
-
-		if (g_config.getBool("perf.output")) {
-			trace::output();
-		}
-		// destruct app
-	}
-	catch (const std::exception &ex) {
-		debug::writef(L"Error: %s", util::utf82wc(ex.what()).get());
-	}
-
-	debug::shutdownDebugOutput();
-	return result;
-}
+﻿// App.cpp : Defines the entry point for the application.
+//
+
+#include "stdafx.h"
+#include "App.h"
+#include "resource.h"
+#include <debug.h>
+#include <file.h>
+#include <array>
+
+// global
+config::ConfigFile g_config(L"config.txt", {
+	{ "graphics.skip", "0" },
+	{ "graphics.adaptiveskip", "true" },
+	{ "graphics.wait", "adaptive" },
+	{ "graphics.waitslack", "2000" },
+	{ "graphics.cursor", "true" },
+	{ "graphics.fullscreen", "false" },
+	{ "script.debug", "true" },
+	{ "jobs.workers", "0" },
+	{ "sound.bgmlatency", "300" },
+	{ "cache.texture", "0" },
+	{ "cache.font", "0" },
+	{ "cache.se", "0" },
+	{ "cache.bgm", "0" },
+	{ "perf.output", "false" },
+	{ "file.archive", "" },
+	{ "file.trace", "" },
+	{ "file.mount", "" },
+	{ "resource.manifest", "" },
+	{ "resource.record", "false" },
+});
+
+MyApp::MyApp(const framework::AppParam &appParam,
+	const graphics::GraphicsParam &graphParam)
+	: Application(appParam, graphParam, ResSetId::Count)
+{}
+
+framework::scene::SceneBase *MyApp::getScene(SceneId id)
+{
+	return m_scenes[static_cast<uint32_t>(id)].get();
+}
+
+void MyApp::setNextScene(SceneId id)
+{
+	m_pNextScene = getScene(id);
+}
+
+void MyApp::init()
+{
+	// resource cache budget [KiB] (0: unlimited)
+	setResourceCacheBudget(framework::ResourceType::Texture,
+		g_config.getInt("cache.texture") * 1024u);
+	setResourceCacheBudget(framework::ResourceType::Font,
+		g_config.getInt("cache.font") * 1024u);
+	setResourceCacheBudget(framework::ResourceType::SoundEffect,
+		g_config.getInt("cache.se") * 1024u);
+	setResourceCacheBudget(framework::ResourceType::Bgm,
+		g_config.getInt("cache.bgm") * 1024u);
+
+	// register resources listed in manifest (Lua load() later gets the same)
+	// or record registrations of this run
+	const std::string &manifest = g_config.getString("resource.manifest");
+	if (g_config.getBool("resource.record")) {
+		startManifestRecording();
+	}
+	else if (!manifest.empty()) {
+		try {
+			loadManifest(util::utf82wc(manifest.c_str()).get());
+		}
+		catch (const std::exception &ex) {
+			// registered by script as usual
+			debug::writeLine(L"Manifest load failed");
+			debug::writeLine(ex.what());
+		}
+	}
+
+	// load common resource
+	{
+		framework::UnsealResource autoSeal(*this);
+		addFontResource(ResSetId::Common, "e", L"ＭＳ 明朝", 0x00, 0xff, 16, 32);
+		addFontResource(ResSetId::Common, "j", L"メイリオ", L'あ', L'ん', 128, 128);
+		addSeResource(ResSetId::Common, "testse", L"/C:/Windows/Media/chord.wav");
+	}
+	loadResourceSet(ResSetId::Common, std::atomic_bool());
+
+	m_scenes[static_cast<uint32_t>(SceneId::Main)] =
+		std::make_unique<MainScene>(this, g_config.getBool("script.debug"));
+	m_scenes[static_cast<uint32_t>(SceneId::Sub)] = 
+		std::make_unique<SubScene>(this);
+
+	// set initial scene
+	auto mainScene = getSceneAs<MainScene>(SceneId::Main);
+	mainScene->setup();
+	setNextScene(SceneId::Main);
+}
+
+void MyApp::update()
+{
+	// go to next scene returned by previous update()
+	if (m_pNextScene != nullptr) {
+		m_pCurrentScene = m_pNextScene;
+		m_pNextScene = nullptr;
+	}
+
+	m_pCurrentScene->update();
+	// m_pNextScene may be set
+}
+
+void MyApp::render()
+{
+	// render by current scene even if next scene was returned
+	m_pCurrentScene->render();
+}
+
+
+int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
+                     _In_opt_ HINSTANCE hPrevInstance,
+                     _In_ LPWSTR    lpCmdLine,
+                     _In_ int       nCmdShow)
+{
+	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
+
+	// debug test
+	{
+		debug::enableDebugOutput();
+		debug::enableConsoleOutput();
+		debug::enableFileOutput(L"log.txt");
+
+		debug::writeLine(L"Start application");
+		debug::writeLine(L"にほんご");
+		debug::writef(L"%d 0x%08x %f %.8f", 123, 0x1234abcd, 3.14, 3.14);
+
+		const wchar_t *digit = L"0123456789abcdef";
+		wchar_t large[1024 + 32] = { 0 };
+		for (int i = 0; i < 1024; i++) {
+			large[i] = digit[i & 0xf];
+		}
+		debug::writef(large);
+
+		wchar_t dir[MAX_PATH];
+		::GetCurrentDirectory(MAX_PATH, dir);
+		debug::writef(L"Current dir: %s", dir);
+	}
+	// trace test
+	// fixed length string key test
+	{
+		trace::initialize(1 * 1024 * 1024);
+		for (int i = 0; i < 1024 * 1024; i++) {
+			trace::write("test");
+		}
+		trace::write("test start");
+
+		using util::IdString;
+		IdString key1, key2, key3;
+		util::createFixedString(&key1, "alice");
+		util::createFixedString(&key2, "sinki");
+		util::createFixedString(&key3, "takenoko");
+		std::unordered_map<IdString, int> hash;
+		hash.emplace(key1, 1);
+		hash.emplace(key2, 2);
+		hash.emplace(key3, 3);
+		hash.insert({key1, 4});
+		for (auto entry : hash) {
+			debug::writef("%s=%d", entry.first.data(), entry.second);
+		}
+
+		trace::write("test end");
+		// open with notepad
+		// trace::output();
+	}
+	// error test
+	{
+		debug::writeLine(error::createStackTraceMsg("error test").c_str());
+	}
+
+	int result = 0;
+	try {
+		// pack tool mode:
+		// App.exe --pack <src dir> <archive file> [--store] [--trace <trace file>]
+		// verify tool mode: (exit code 1 if broken)
+		// App.exe --verify <archive file>
+		const std::vector<std::wstring> argv = framework::parseCommandLine();
+		if (argv.size() >= 4 && argv[1] == L"--pack") {
+			bool compress = true;
+			const wchar_t *traceFile = nullptr;
+			for (size_t i = 4; i < argv.size(); i++) {
+				if (argv[i] == L"--store") {
+					compress = false;
+				}
+				else if (argv[i] == L"--trace" && i + 1 < argv.size()) {
+					traceFile = argv[++i].c_str();
+				}
+			}
+			file::createArchive(argv[3].c_str(), argv[2].c_str(), compress, traceFile);
+			debug::shutdownDebugOutput();
+			return 0;
+		}
+		if (argv.size() >= 3 && argv[1] == L"--verify") {
+			const auto result = file::verifyArchive(argv[2].c_str());
+			debug::shutdownDebugOutput();
+			return result.badFiles.empty() ? 0 : 1;
+		}
+
+		g_config.load();
+
+		const std::string &archive = g_config.getString("file.archive");
+		// ';' separated patch directories or archives on top of the base
+		const std::string &mounts = g_config.getString("file.mount");
+		if (!mounts.empty()) {
+			file::initWithMountTable();
+			file::mount(archive.empty() ? L"." : util::utf82wc(archive.c_str()).get());
+			size_t pos = 0;
+			while (pos <= mounts.size()) {
+				size_t end = mounts.find(';', pos);
+				if (end == std::string::npos) {
+					end = mounts.size();
+				}
+				if (end > pos) {
+					file::mount(util::utf82wc(mounts.substr(pos, end - pos).c_str()).get());
+				}
+				pos = end + 1;
+			}
+		}
+		else if (archive.empty()) {
+			file::initWithFileSystem(L".");
+		}
+		else {
+			file::initWithArchiveFile(util::utf82wc(archive.c_str()).get());
+		}
+		// record load order for --pack --trace
+		const std::string &trace = g_config.getString("file.trace");
+		if (!trace.empty()) {
+			file::startAccessTrace();
+		}
+
+		framework::AppParam appParam;
+		graphics::GraphicsParam graphParam;
+		appParam.hInstance = hInstance;
+		appParam.wndClsName = L"TestAppClass";
+		appParam.title = L"Test App (0-9: Change speed, F5: Reload script, F12: Lua Debugger)";
+		appParam.hIcon = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_APP));
+		appParam.hIconSm = LoadIcon(hInstance, MAKEINTRESOURCE(IDI_SMALL));
+		appParam.nCmdShow = nCmdShow;
+		appParam.frameSkip = g_config.getInt("graphics.skip");
+		appParam.adaptiveSkip = g_config.getBool("graphics.adaptiveskip");
+		{
+			// fixed | adaptive | spin | sleep
+			const std::string &wait = g_config.getString("graphics.wait");
+			if (wait == "fixed") {
+				appParam.frameWait.policy = timer::SlackPolicy::Fixed;
+			}
+			else if (wait == "spin") {
+				appParam.frameWait.policy = timer::SlackPolicy::SpinOnly;
+			}
+			else if (wait == "sleep") {
+				appParam.frameWait.policy = timer::SlackPolicy::SleepOnly;
+			}
+			else {
+				appParam.frameWait.policy = timer::SlackPolicy::Adaptive;
+			}
+			appParam.frameWait.slackUs = g_config.getInt("graphics.waitslack");
+		}
+		appParam.traceFrameTime = g_config.getBool("perf.output");
+		appParam.jobWorkers = g_config.getInt("jobs.workers");
+		appParam.bgmLatencyMs = g_config.getInt("sound.bgmlatency");
+		appParam.showCursor = g_config.getBool("graphics.cursor");
+		graphParam.w = 1024;
+		graphParam.h = 768;
+		graphParam.fullScreen = g_config.getBool("graphics.fullscreen");
+
+		auto app = std::make_unique<MyApp>(appParam, graphParam);
+		result = app->run();
+
+		const std::string &manifest = g_config.getString("resource.manifest");
+		if (g_config.getBool("resource.record") && !manifest.empty()) {
+			app->saveManifest(util::utf82wc(manifest.c_str()).get());
+		}
+		if (!trace.empty()) {
+			file::saveAccessTrace(util::utf82wc(trace.c_str()).get());
+		}
+
+		if (g_config.getBool("perf.output")) {
+			trace::output();
+		}
+		// destruct app
+	}
+	catch (const std::exception &ex) {
+		debug::writef(L"Error: %s", util::utf82wc(ex.what()).get());
+	}
+
+	debug::shutdownDebugOutput();
+	return result;
+}
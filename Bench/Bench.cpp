@@ -0,0 +1,165 @@
+﻿// Bench.cpp : Console benchmark of the platform independent core.
+//
+// Bench [<data dir>]
+// Runs LZ, CRC-32C, job system, FrozenIdMap and mount table benchmarks.
+// If data dir is given, also packs it to a temporary archive and
+// measures archive verification, archive and asynchronous reads of the files.
+
+#include <crc.h>
+#include <debug.h>
+#include <file.h>
+#include <idmap.h>
+#include <jobs.h>
+#include <lz.h>
+#include <platform.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <string>
+#include <vector>
+
+using namespace yappy;
+
+namespace {
+
+// text-like data (compressible but not trivial)
+std::vector<uint8_t> createSampleData(size_t size)
+{
+	static const char *const Words[] = {
+		"sprite", "texture", "font", "sound", "script", "frame", "scene", "load",
+		"draw", "update", "=", "(", ")", "{", "}", ";", "\n", "\t", "0", "1",
+	};
+	const size_t wordCount = sizeof(Words) / sizeof(Words[0]);
+	std::vector<uint8_t> data;
+	data.reserve(size + 16);
+	uint32_t x = 2463534242u;
+	while (data.size() < size) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		const char *word = Words[x % wordCount];
+		data.insert(data.end(), word, word + std::char_traits<char>::length(word));
+		data.push_back(' ');
+	}
+	data.resize(size);
+	return data;
+}
+
+// compress 64 KiB blocks on 1..hardware concurrency workers
+void benchParallelFor(const std::vector<uint8_t> &sample)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	const size_t blockSize = file::ArchiveBlockSize;
+	const size_t blockCount = sample.size() / blockSize;
+	const size_t bound = lz::compressBound(blockSize);
+	std::vector<uint8_t> out(bound * blockCount);
+	auto compressBlock = [&](size_t i) {
+		lz::compress(&sample[i * blockSize], blockSize, &out[i * bound], bound);
+	};
+	// best of rounds
+	auto measure = [](const std::function<void()> &func) {
+		double best = 0.0;
+		for (int round = 0; round < 3; round++) {
+			auto start = Clock::now();
+			func();
+			double ms = duration<double, std::milli>(Clock::now() - start).count();
+			best = (round == 0) ? ms : std::min(best, ms);
+		}
+		return best;
+	};
+
+	double serialMs = measure([&]() {
+		for (size_t i = 0; i < blockCount; i++) {
+			compressBlock(i);
+		}
+	});
+	debug::writef(L"parallelFor: %zu blocks, serial %.2f ms", blockCount, serialMs);
+
+	// (the calling thread also runs jobs while waiting)
+	uint32_t hw = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t workers = 1; workers <= hw; workers++) {
+		jobs::JobSystem jobs(workers);
+		double ms = measure([&]() {
+			jobs.parallelFor(0, blockCount, 1, compressBlock);
+		});
+		debug::writef(L"parallelFor: %u workers %.2f ms (x%.2f)",
+			workers, ms, serialMs / ms);
+	}
+}
+
+// recursive, names are relative to root
+void listFiles(const std::wstring &root, const std::wstring &prefix,
+	std::vector<std::wstring> *out)
+{
+	const std::wstring dir = prefix.empty() ? root : root + L'/' + prefix;
+	platform::listDirectory(dir.c_str(), [&](const wchar_t *name, bool isDirectory) {
+		std::wstring path = prefix.empty() ? name : prefix + L'/' + name;
+		if (isDirectory) {
+			listFiles(root, path, out);
+		}
+		else {
+			out->emplace_back(std::move(path));
+		}
+	});
+}
+
+void benchDataDir(const std::wstring &dataDir)
+{
+	std::vector<std::wstring> names;
+	listFiles(dataDir, L"", &names);
+	debug::writef(L"Data dir: %s (%zu files)", dataDir.c_str(), names.size());
+	if (names.empty()) {
+		return;
+	}
+
+	std::wstring archive = platform::createTempFile(L"pak");
+	file::createArchive(archive.c_str(), dataDir.c_str());
+	file::verifyArchive(archive.c_str());
+	file::benchmarkArchive(archive.c_str(), dataDir.c_str(), 3);
+
+	file::initWithFileSystem(dataDir.c_str());
+	// Auto: io_uring on Linux if available
+	for (auto backend : { file::AsyncReader::Backend::ThreadPool, file::AsyncReader::Backend::Auto }) {
+		for (uint32_t depth : { 1u, 4u, 16u }) {
+			file::benchmarkAsyncRead(names, depth, backend);
+		}
+	}
+	std::remove(util::wc2utf8(archive.c_str()).get());
+}
+
+}	// namespace
+
+int main(int argc, char *argv[])
+{
+	debug::enableConsoleOutput();
+
+	int result = 0;
+	try {
+		std::vector<uint8_t> sample = createSampleData(16 * 1024 * 1024);
+		lz::benchmark(sample.data(), sample.size(), file::ArchiveBlockSize, 3);
+		benchParallelFor(sample);
+
+		// in cache and from memory
+		crc::benchmark(256 * 1024, 1000);
+		crc::benchmark(64 * 1024 * 1024, 5);
+
+		util::benchmarkIdMap(100000, 1000000);
+
+		file::benchmarkMountLookup(100000, 1000000);
+
+		if (argc >= 2) {
+			benchDataDir(util::utf82wc(argv[1]).get());
+		}
+	}
+	catch (const std::exception &ex) {
+		debug::writeLine(L"Error");
+		debug::writeLine(ex.what());
+		result = 1;
+	}
+	debug::shutdownDebugOutput();
+	return result;
+}
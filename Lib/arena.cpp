@@ -0,0 +1,285 @@
+﻿#include "stdafx.h"
+#include "include/arena.h"
+#include "include/debug.h"
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#if !defined(YAPPY_HEAP_COUNTER) && defined(_WIN32) && defined(_DEBUG)
+#include <crtdbg.h>
+#endif
+
+namespace yappy {
+namespace arena {
+
+///////////////////////////////////////////////////////////////////////////////
+// class LinearArena impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region LinearArena
+
+namespace {
+
+inline size_t alignUp(size_t value, size_t align)
+{
+	return (value + align - 1) & ~(align - 1);
+}
+
+}	// namespace
+
+LinearArena::LinearArena(size_t chunkSize) :
+	m_chunkSize(chunkSize)
+{}
+
+void *LinearArena::allocate(size_t size, size_t align)
+{
+	ASSERT(align != 0 && (align & (align - 1)) == 0);
+	if (size == 0) {
+		size = 1;
+	}
+	// try the current chunk, then the following chunks
+	while (m_current < m_chunks.size()) {
+		Chunk &chunk = m_chunks[m_current];
+		uintptr_t base = reinterpret_cast<uintptr_t>(chunk.buf.get());
+		size_t offset = alignUp(base + m_offset, align) - base;
+		if (offset <= chunk.size && size <= chunk.size - offset) {
+			m_offset = offset + size;
+			m_peak = std::max(m_peak, getUsed());
+			return chunk.buf.get() + offset;
+		}
+		// the rest of this chunk is wasted until rewind
+		m_usedPrev += chunk.size;
+		m_offset = 0;
+		m_current++;
+		// a reused chunk may be too small for this request
+		if (m_current < m_chunks.size() && m_chunks[m_current].size < size + align) {
+			break;
+		}
+	}
+	// new chunk at m_current
+	// (insert before the too small chunk, it will be reused later)
+	Chunk chunk;
+	chunk.size = std::max(m_chunkSize, size + align);
+	chunk.buf.reset(new char[chunk.size]);
+	m_chunkAllocCount++;
+	m_chunks.insert(m_chunks.begin() + m_current, std::move(chunk));
+
+	Chunk &cur = m_chunks[m_current];
+	uintptr_t base = reinterpret_cast<uintptr_t>(cur.buf.get());
+	size_t offset = alignUp(base, align) - base;
+	m_offset = offset + size;
+	m_peak = std::max(m_peak, getUsed());
+	return cur.buf.get() + offset;
+}
+
+char *LinearArena::copyString(const char *str)
+{
+	size_t size = std::strlen(str) + 1;
+	char *p = static_cast<char *>(allocate(size, 1));
+	std::memcpy(p, str, size);
+	return p;
+}
+
+LinearArena::Marker LinearArena::getMarker() const
+{
+	return Marker{ m_current, m_offset };
+}
+
+void LinearArena::rewind(const Marker &marker)
+{
+	// already released by reset()
+	if (marker.chunk > m_current ||
+		(marker.chunk == m_current && marker.offset > m_offset)) {
+		return;
+	}
+	for (size_t i = marker.chunk; i < m_current; i++) {
+		m_usedPrev -= m_chunks[i].size;
+	}
+	m_current = marker.chunk;
+	m_offset = marker.offset;
+}
+
+void LinearArena::reset()
+{
+	m_current = 0;
+	m_offset = 0;
+	m_usedPrev = 0;
+}
+
+size_t LinearArena::getReserved() const
+{
+	size_t total = 0;
+	for (const auto &chunk : m_chunks) {
+		total += chunk.size;
+	}
+	return total;
+}
+
+#pragma endregion
+
+LinearArena &threadArena()
+{
+	thread_local LinearArena s_arena;
+	return s_arena;
+}
+
+char *wc2utf8(const wchar_t *in, LinearArena &arena)
+{
+	size_t len = platform::wcToUtf8(in, nullptr, 0);
+	char *pBuf = static_cast<char *>(arena.allocate(len, alignof(char)));
+	platform::wcToUtf8(in, pBuf, len);
+	return pBuf;
+}
+
+wchar_t *utf82wc(const char *in, LinearArena &arena)
+{
+	size_t len = platform::utf8ToWc(in, nullptr, 0);
+	wchar_t *pBuf = static_cast<wchar_t *>(
+		arena.allocate(sizeof(wchar_t) * len, alignof(wchar_t)));
+	platform::utf8ToWc(in, pBuf, len);
+	return pBuf;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// Heap allocation counter
+///////////////////////////////////////////////////////////////////////////////
+#pragma region HeapCounter
+
+namespace {
+
+std::atomic<uint64_t> s_heapAllocCount(0);
+
+#if defined(YAPPY_HEAP_COUNTER)
+// replaced global operator new (below) counts while this is set
+std::atomic<bool> s_counting{ false };
+
+// malloc with the operator new retry loop
+void *countedAlloc(size_t size)
+{
+	if (size == 0) {
+		size = 1;
+	}
+	for (;;) {
+		void *p = std::malloc(size);
+		if (p != nullptr) {
+			if (s_counting.load(std::memory_order_relaxed)) {
+				s_heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return p;
+		}
+		std::new_handler handler = std::get_new_handler();
+		if (handler == nullptr) {
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+#elif defined(_WIN32) && defined(_DEBUG)
+_CRT_ALLOC_HOOK s_prevHook = nullptr;
+
+int __cdecl allocHook(int allocType, void *userData, size_t size,
+	int blockType, long requestNumber,
+	const unsigned char *filename, int lineNumber)
+{
+	// ignore CRT internal blocks
+	if (blockType != _CRT_BLOCK &&
+		(allocType == _HOOK_ALLOC || allocType == _HOOK_REALLOC)) {
+		s_heapAllocCount.fetch_add(1, std::memory_order_relaxed);
+	}
+	if (s_prevHook != nullptr) {
+		return s_prevHook(allocType, userData, size,
+			blockType, requestNumber, filename, lineNumber);
+	}
+	return TRUE;
+}
+#endif
+
+}	// namespace
+
+void enableHeapCounter()
+{
+#if defined(YAPPY_HEAP_COUNTER)
+	s_counting.store(true, std::memory_order_relaxed);
+#elif defined(_WIN32) && defined(_DEBUG)
+	static bool s_enabled = false;
+	if (!s_enabled) {
+		s_prevHook = _CrtSetAllocHook(allocHook);
+		s_enabled = true;
+	}
+#endif
+}
+
+bool isHeapCounterAvailable()
+{
+#if defined(YAPPY_HEAP_COUNTER) || (defined(_WIN32) && defined(_DEBUG))
+	return true;
+#else
+	return false;
+#endif
+}
+
+uint64_t getHeapAllocCount()
+{
+	return s_heapAllocCount.load(std::memory_order_relaxed);
+}
+
+#pragma endregion
+
+}	// namespace arena
+}	// namespace yappy
+
+#if defined(YAPPY_HEAP_COUNTER)
+// Replaceable global allocation functions. (C++14: no align_val_t overloads)
+void *operator new(size_t size)
+{
+	return yappy::arena::countedAlloc(size);
+}
+
+void *operator new[](size_t size)
+{
+	return yappy::arena::countedAlloc(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	try {
+		return yappy::arena::countedAlloc(size);
+	}
+	catch (const std::bad_alloc &) {
+		return nullptr;
+	}
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+	std::free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+	std::free(p);
+}
+#endif
@@ -0,0 +1,290 @@
+﻿#include "stdafx.h"
+#include "include/crc.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define CRC_X86
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__ARM_FEATURE_CRC32) || defined(_M_ARM64)
+#define CRC_ARM
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <arm_acle.h>
+#endif
+#endif
+
+// GCC and clang need the target to use intrinsics without -msse4.2
+#if defined(CRC_X86) && !defined(_MSC_VER)
+#define CRC_TARGET __attribute__((target("sse4.2")))
+#else
+#define CRC_TARGET
+#endif
+
+namespace yappy {
+namespace crc {
+
+namespace {
+
+const uint32_t Polynomial = 0x82f63b78;
+
+using Table = std::array<std::array<uint32_t, 256>, 8>;
+
+// slicing-by-8 (computed once)
+const Table &getTable()
+{
+	static const Table table = []() {
+		Table t;
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++) {
+				c = (c >> 1) ^ ((c & 1) ? Polynomial : 0);
+			}
+			t[0][i] = c;
+		}
+		for (uint32_t i = 0; i < 256; i++) {
+			for (size_t k = 1; k < 8; k++) {
+				t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+			}
+		}
+		return t;
+	}();
+	return table;
+}
+
+// crc is not inverted
+uint32_t updateTable(uint32_t crc, const uint8_t *p, size_t size)
+{
+	const Table &t = getTable();
+	for (; size >= 8; size -= 8, p += 8) {
+		uint32_t lo, hi;
+		std::memcpy(&lo, p, sizeof(lo));
+		std::memcpy(&hi, p + 4, sizeof(hi));
+		// little endian
+		lo ^= crc;
+		crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^
+			t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24] ^
+			t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^
+			t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+	}
+	for (; size > 0; size--, p++) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+	}
+	return crc;
+}
+
+// a * b mod P (bit-reflected, x^0 at bit 31)
+uint32_t multModP(uint32_t a, uint32_t b)
+{
+	uint32_t p = 0;
+	for (uint32_t m = 1u << 31; m != 0; m >>= 1) {
+		if (a & m) {
+			p ^= b;
+		}
+		b = (b & 1) ? (b >> 1) ^ Polynomial : b >> 1;
+	}
+	return p;
+}
+
+// lane size of interleaved hardware CRC
+const size_t LaneSize = 1024;
+
+// crc register -> register after LaneSize zero bytes (linear, by byte)
+using ShiftTable = std::array<std::array<uint32_t, 256>, 4>;
+
+const ShiftTable &getShiftTable()
+{
+	static const ShiftTable table = []() {
+		// x^(8 * LaneSize) mod P
+		uint32_t xn = 1u << 31;
+		uint32_t x8 = 1u << 23;
+		for (size_t i = 0; i < LaneSize; i++) {
+			xn = multModP(xn, x8);
+		}
+		ShiftTable t;
+		for (uint32_t k = 0; k < 4; k++) {
+			for (uint32_t i = 0; i < 256; i++) {
+				t[k][i] = multModP(xn, i << (8 * k));
+			}
+		}
+		return t;
+	}();
+	return table;
+}
+
+inline uint32_t shiftLane(const ShiftTable &t, uint32_t crc)
+{
+	return t[0][crc & 0xff] ^ t[1][(crc >> 8) & 0xff] ^
+		t[2][(crc >> 16) & 0xff] ^ t[3][crc >> 24];
+}
+
+#if defined(CRC_X86)
+
+bool detectHardware()
+{
+	// CPUID.1:ECX.SSE4_2[bit 20]
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 20)) != 0;
+#else
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+		return false;
+	}
+	return (ecx & (1u << 20)) != 0;
+#endif
+}
+
+CRC_TARGET
+uint32_t updateHardware(uint32_t crc, const uint8_t *p, size_t size)
+{
+#if defined(_M_X64) || defined(__x86_64__)
+	// 3 independent lanes hide the latency (3 cycles) of the instruction
+	if (size >= LaneSize * 3) {
+		const ShiftTable &t = getShiftTable();
+		for (; size >= LaneSize * 3; size -= LaneSize * 3, p += LaneSize * 3) {
+			uint64_t c0 = crc, c1 = 0, c2 = 0;
+			for (size_t i = 0; i < LaneSize; i += 8) {
+				uint64_t v0, v1, v2;
+				std::memcpy(&v0, p + i, sizeof(v0));
+				std::memcpy(&v1, p + LaneSize + i, sizeof(v1));
+				std::memcpy(&v2, p + LaneSize * 2 + i, sizeof(v2));
+				c0 = _mm_crc32_u64(c0, v0);
+				c1 = _mm_crc32_u64(c1, v1);
+				c2 = _mm_crc32_u64(c2, v2);
+			}
+			crc = shiftLane(t, static_cast<uint32_t>(c0)) ^ static_cast<uint32_t>(c1);
+			crc = shiftLane(t, crc) ^ static_cast<uint32_t>(c2);
+		}
+	}
+	uint64_t c = crc;
+	for (; size >= 8; size -= 8, p += 8) {
+		uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+	crc = static_cast<uint32_t>(c);
+#endif
+	for (; size >= 4; size -= 4, p += 4) {
+		uint32_t v;
+		std::memcpy(&v, p, sizeof(v));
+		crc = _mm_crc32_u32(crc, v);
+	}
+	for (; size > 0; size--, p++) {
+		crc = _mm_crc32_u8(crc, *p);
+	}
+	return crc;
+}
+
+#elif defined(CRC_ARM)
+
+bool detectHardware()
+{
+	return true;
+}
+
+uint32_t updateHardware(uint32_t crc, const uint8_t *p, size_t size)
+{
+	for (; size >= 8; size -= 8, p += 8) {
+		uint64_t v;
+		std::memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+	for (; size > 0; size--, p++) {
+		crc = __crc32cb(crc, *p);
+	}
+	return crc;
+}
+
+#else
+
+bool detectHardware()
+{
+	return false;
+}
+
+uint32_t updateHardware(uint32_t crc, const uint8_t *p, size_t size)
+{
+	return updateTable(crc, p, size);
+}
+
+#endif
+
+}	// namespace
+
+bool hasHardwareCrc()
+{
+	static const bool hardware = detectHardware();
+	return hardware;
+}
+
+uint32_t crc32c(const void *data, size_t size, uint32_t crc)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(data);
+	if (hasHardwareCrc()) {
+		return ~updateHardware(~crc, p, size);
+	}
+	return ~updateTable(~crc, p, size);
+}
+
+uint32_t crc32cTable(const void *data, size_t size, uint32_t crc)
+{
+	return ~updateTable(~crc, static_cast<const uint8_t *>(data), size);
+}
+
+BenchResult benchmark(size_t size, uint32_t rounds)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	rounds = std::max(rounds, 1u);
+	std::vector<uint8_t> data(size);
+	uint32_t x = 2463534242u;
+	for (auto &b : data) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		b = static_cast<uint8_t>(x);
+	}
+
+	BenchResult result;
+	result.bytes = size;
+	result.hardware = hasHardwareCrc();
+	uint32_t crc = 0, tableCrc = 0;
+	auto start = Clock::now();
+	for (uint32_t r = 0; r < rounds; r++) {
+		crc = crc32c(data.data(), data.size());
+	}
+	auto mid = Clock::now();
+	for (uint32_t r = 0; r < rounds; r++) {
+		tableCrc = crc32cTable(data.data(), data.size());
+	}
+	auto end = Clock::now();
+	if (crc != tableCrc) {
+		error::throwTrace<error::FrameworkError>("CRC-32C mismatch between implementations");
+	}
+	duration<double> crcTime = mid - start;
+	duration<double> tableTime = end - mid;
+	const double gb = static_cast<double>(size) * rounds / 1e9;
+	result.crcGBps = (crcTime.count() > 0.0) ? gb / crcTime.count() : 0.0;
+	result.tableGBps = (tableTime.count() > 0.0) ? gb / tableTime.count() : 0.0;
+	debug::writef(L"CRC-32C bench: %llu bytes, %s %.2f GB/s, table %.2f GB/s",
+		static_cast<unsigned long long>(result.bytes),
+		result.hardware ? L"hardware" : L"table", result.crcGBps, result.tableGBps);
+	return result;
+}
+
+}	// namespace crc
+}	// namespace yappy
@@ -1,112 +1,2402 @@
-﻿#include "stdafx.h"
-#include "include/file.h"
-#include "include/exceptions.h"
-#include <windows.h>
-#include <memory>
-#include <array>
-#include <string>
-
-namespace yappy {
-namespace file {
-
-using error::throwTrace;
-using error::checkWin32Result;
-
-namespace {
-
-class FileLoader : private util::noncopyable {
-public:
-	FileLoader() = default;
-	virtual ~FileLoader() = default;
-	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) = 0;
-};
-
-class FsFileLoader : public FileLoader {
-public:
-	FsFileLoader(const wchar_t *rootDir) : m_rootDir(rootDir) {}
-	virtual ~FsFileLoader() override {}
-	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) override;
-private:
-	std::wstring m_rootDir;
-};
-
-class ArchiveFileLoader : public FileLoader {
-	// TODO: impl
-};
-
-// impls
-Bytes FsFileLoader::loadFile(const wchar_t *fileName)
-{
-	std::wstring path;
-	if (fileName[0] == L'/') {
-		// Debug only, abs path
-		path = &fileName[1];
-	}
-	else if (fileName[0] == L'@') {
-		// Debug only, relative to executable
-		std::array<wchar_t, MAX_PATH> dir;
-		DWORD ret = ::GetModuleFileName(nullptr, dir.data(), static_cast<DWORD>(dir.size()));
-		checkWin32Result(ret != 0, "GetModuleFileName() failed");
-		*(::wcsrchr(dir.data(), L'\\') + 1) = L'\0';
-		path = dir.data();
-		path += &fileName[1];
-	}
-	else {
-		path += m_rootDir;
-		path += L'/';
-		path += fileName;
-	}
-
-	// open
-	HANDLE tmphFile = ::CreateFile(
-		path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
-		FILE_ATTRIBUTE_NORMAL, nullptr);
-	checkWin32Result(tmphFile != INVALID_HANDLE_VALUE, "CreateFile() failed");
-	util::HandlePtr hFile(tmphFile);
-
-	BOOL b = FALSE;
-	// get size to avoid realloc
-	LARGE_INTEGER fileSize = { 0 };
-	b = ::GetFileSizeEx(hFile.get(), &fileSize);
-	checkWin32Result(b != 0, "GetFileSizeEx() failed");
-	// 2GiB check
-	checkWin32Result(fileSize.HighPart == 0, "File size is too large");
-	checkWin32Result(fileSize.LowPart < 0x80000000, "File size is too large");
-	// read
-	Bytes bin(fileSize.LowPart);
-	DWORD readSize = 0;
-	b = ::ReadFile(hFile.get(), bin.data(), fileSize.LowPart, &readSize, nullptr);
-	error::checkWin32Result(b != 0, "ReadFile() failed");
-	error::checkWin32Result(fileSize.LowPart == readSize, "Read size is strange");
-
-	// move return
-	return bin;
-}
-
-// variables
-std::unique_ptr<FileLoader> s_fileLoader(nullptr);
-
-}	// namespace
-
-
-void initWithFileSystem(const wchar_t *rootDir)
-{
-	s_fileLoader.reset(new FsFileLoader(rootDir));
-}
-
-void initWithArchiveFile(const wchar_t *archiveFile)
-{
-	// TODO
-	throwTrace<std::logic_error>("Not implemented");
-}
-
-std::vector<uint8_t> loadFile(const wchar_t *fileName)
-{
-	if (s_fileLoader == nullptr) {
-		throwTrace<std::logic_error>("FileLoader is not initialized.");
-	}
-	return s_fileLoader->loadFile(fileName);
-}
-
-}	// namespace file
-}	// namespace yappy
+﻿#include "stdafx.h"
+#include "include/file.h"
+#include "include/exceptions.h"
+#include "include/debug.h"
+#include "include/jobs.h"
+#include "include/lz.h"
+#include "include/crc.h"
+#include "include/platform.h"
+#include <memory>
+#include <array>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <unordered_set>
+#include <limits>
+#include <cwchar>
+#ifdef YAPPY_HAVE_LIBURING
+#include <liburing.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+namespace yappy {
+namespace file {
+
+using error::throwTrace;
+using error::checkWin32Result;
+using error::FrameworkError;
+
+FileView::FileView(Bytes &&bin)
+{
+	auto owner = std::make_shared<Bytes>(std::move(bin));
+	m_data = owner->data();
+	m_size = owner->size();
+	m_owner = std::move(owner);
+}
+
+FileView::FileView(std::shared_ptr<const void> owner, const uint8_t *data, size_t size) :
+	m_owner(std::move(owner)), m_data(data), m_size(size)
+{}
+
+FileView FileView::subView(size_t offset, size_t size) const
+{
+	offset = std::min(offset, m_size);
+	size = std::min(size, m_size - offset);
+	return FileView(m_owner, m_data + offset, size);
+}
+
+namespace {
+
+class FileLoader : private util::noncopyable {
+public:
+	FileLoader() = default;
+	virtual ~FileLoader() = default;
+	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) = 0;
+	virtual uint64_t getFileSize(const wchar_t *fileName) = 0;
+	// size is already clipped at the end of file
+	virtual std::vector<uint8_t> loadFileRange(const wchar_t *fileName,
+		uint64_t offset, size_t size) = 0;
+	virtual FileView loadFileView(const wchar_t *fileName) = 0;
+	// path in the real file system (false if not a real file)
+	virtual bool getRealPath(const wchar_t *fileName, std::wstring *path) = 0;
+};
+
+// read-only mapped view of a whole file
+struct MappedFile : private util::noncopyable {
+	const uint8_t *base = nullptr;
+	uint64_t size = 0;
+
+	MappedFile() = default;
+	~MappedFile()
+	{
+		platform::unmapFile(base, size);
+	}
+};
+
+std::shared_ptr<MappedFile> mapFile(const wchar_t *path, platform::AccessHint hint)
+{
+	auto map = std::make_shared<MappedFile>();
+	// nullptr if empty
+	map->base = platform::mapFile(path, hint, &map->size);
+	return map;
+}
+
+class FsFileLoader : public FileLoader {
+public:
+	FsFileLoader(const wchar_t *rootDir) : m_rootDir(rootDir) {}
+	virtual ~FsFileLoader() override {}
+	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) override;
+	virtual uint64_t getFileSize(const wchar_t *fileName) override;
+	virtual std::vector<uint8_t> loadFileRange(const wchar_t *fileName,
+		uint64_t offset, size_t size) override;
+	virtual FileView loadFileView(const wchar_t *fileName) override;
+	virtual bool getRealPath(const wchar_t *fileName, std::wstring *path) override
+	{
+		*path = getPath(fileName);
+		return true;
+	}
+
+	// by path in the real file system
+	static Bytes loadPath(const wchar_t *path);
+	static uint64_t getPathSize(const wchar_t *path);
+	static Bytes loadPathRange(const wchar_t *path, uint64_t offset, size_t size);
+	static FileView loadPathView(const wchar_t *path);
+
+private:
+	// smaller files are read (mapping costs more than copy)
+	static const uint64_t MapThreshold = 64 * 1024;
+
+	std::wstring m_rootDir;
+
+	std::wstring getPath(const wchar_t *fileName);
+};
+
+// variables
+std::atomic<jobs::JobSystem *> s_jobs(nullptr);
+
+// archive format
+const char ArchiveMagic[4] = { 'Y', 'P', 'A', 'K' };
+const uint32_t ArchiveVersion = 3;
+// ArchiveEntry::flags
+const uint16_t EntryCompressed = 0x0001;
+// ArchiveHeader::flags
+// data is in access trace order
+const uint32_t ArchiveTraceOrdered = 0x0001;
+
+struct ArchiveHeader {
+	char magic[4];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t entryCount;
+	uint64_t indexOffset;
+	uint64_t nameOffset;
+	uint64_t crcOffset;
+	uint32_t crcCount;
+	uint32_t reserved;
+};
+static_assert(sizeof(ArchiveHeader) == 48, "ArchiveHeader size");
+
+// compressed: uint32 compressed block sizes, then blocks
+// (a block of the raw size is stored as is)
+// CRC table: CRC-32C of the stored bytes of each block
+// (blocks of an uncompressed entry are raw data split by ArchiveBlockSize)
+struct ArchiveEntry {
+	uint64_t hash;
+	uint64_t offset;
+	uint32_t size;
+	uint32_t storedSize;
+	uint32_t nameOffset;
+	uint16_t nameSize;
+	uint16_t flags;
+	// first index in CRC table (getBlockCount(size) CRCs)
+	uint32_t crcIndex;
+	uint32_t reserved;
+};
+static_assert(sizeof(ArchiveEntry) == 40, "ArchiveEntry size");
+
+// UTF-8, '/' separated, ASCII lower case
+std::string normalizeName(const wchar_t *fileName)
+{
+	std::string name = util::wc2utf8(fileName).get();
+	for (char &c : name) {
+		if (c == '\\') {
+			c = '/';
+		}
+		else if (c >= 'A' && c <= 'Z') {
+			c = c - 'A' + 'a';
+		}
+	}
+	return name;
+}
+
+inline uint64_t hashName(const std::string &name)
+{
+	return util::fnv1a64(name.data(), name.size());
+}
+
+// normalizeName() for lookups, in a stack buffer
+// (allocates only for non-ASCII or long names)
+class LookupName : private util::noncopyable {
+public:
+	explicit LookupName(const wchar_t *fileName)
+	{
+		size_t len = 0;
+		for (const wchar_t *p = fileName; *p != L'\0'; p++) {
+			const uint32_t c = static_cast<uint32_t>(*p);
+			if (c >= 0x80 || len >= sizeof(m_buf)) {
+				m_long = normalizeName(fileName);
+				m_data = m_long.data();
+				m_size = m_long.size();
+				return;
+			}
+			if (c == '\\') {
+				m_buf[len++] = '/';
+			}
+			else if (c >= 'A' && c <= 'Z') {
+				m_buf[len++] = static_cast<char>(c - 'A' + 'a');
+			}
+			else {
+				m_buf[len++] = static_cast<char>(c);
+			}
+		}
+		m_data = m_buf;
+		m_size = len;
+	}
+
+	const char *data() const { return m_data; }
+	size_t size() const { return m_size; }
+	uint64_t hash() const { return util::fnv1a64(m_data, m_size); }
+	std::string str() const { return std::string(m_data, m_size); }
+
+private:
+	char m_buf[256];
+	std::string m_long;
+	const char *m_data;
+	size_t m_size;
+};
+
+class ArchiveFileLoader : public FileLoader {
+public:
+	explicit ArchiveFileLoader(const wchar_t *archiveFile);
+	virtual ~ArchiveFileLoader() override {}
+	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) override;
+	virtual uint64_t getFileSize(const wchar_t *fileName) override;
+	virtual std::vector<uint8_t> loadFileRange(const wchar_t *fileName,
+		uint64_t offset, size_t size) override;
+	virtual FileView loadFileView(const wchar_t *fileName) override;
+	virtual bool getRealPath(const wchar_t *fileName, std::wstring *path) override
+	{
+		if (fileName[0] == L'/' || fileName[0] == L'@') {
+			return m_fsLoader.getRealPath(fileName, path);
+		}
+		return false;
+	}
+
+	// normalized names of all entries
+	std::vector<std::string> getNames() const;
+	uint64_t getArchiveSize() const { return m_size; }
+
+	// by index entry (for mount table)
+	uint32_t getEntryCount() const { return m_count; }
+	const ArchiveEntry &getEntry(uint32_t index) const { return m_index[index]; }
+	std::string getEntryName(const ArchiveEntry &entry) const
+	{
+		return std::string(m_names + entry.nameOffset, entry.nameSize);
+	}
+	bool isEntryName(const ArchiveEntry &entry, const char *name, size_t size) const
+	{
+		return entry.nameSize == size &&
+			std::memcmp(m_names + entry.nameOffset, name, size) == 0;
+	}
+	Bytes loadEntry(const ArchiveEntry &entry);
+	FileView loadEntryView(const ArchiveEntry &entry);
+	Bytes loadEntryRange(const ArchiveEntry &entry, uint64_t offset, size_t size);
+	// check CRCs of all blocks in parallel (does not throw on mismatch)
+	void verifyAll(VerifyResult *result);
+
+private:
+	// shared with FileView objects
+	std::shared_ptr<MappedFile> m_map;
+	const uint8_t *m_base = nullptr;
+	uint64_t m_size = 0;
+	const ArchiveEntry *m_index = nullptr;
+	uint32_t m_count = 0;
+	const char *m_names = nullptr;
+	const uint32_t *m_crcs = nullptr;
+	uint32_t m_crcCount = 0;
+	// a bit per block, set after CRC check (each block is checked once)
+	std::unique_ptr<std::atomic<uint32_t>[]> m_verified;
+	// for debug only paths
+	FsFileLoader m_fsLoader;
+	// trace ordered
+	bool m_readAhead = false;
+	// end of read-ahead requested so far
+	std::atomic<uint64_t> m_readAheadEnd;
+
+	void validate(uint64_t nameSize);
+	// start of stored blocks [0, blockCount] from entry.offset
+	std::vector<uint64_t> getBlockPositions(const ArchiveEntry &entry) const;
+	bool checkBlock(const ArchiveEntry &entry, uint32_t block,
+		const uint8_t *stored, size_t storedSize) const;
+	// throws if CRC does not match
+	void verifyBlock(const ArchiveEntry &entry, uint32_t block,
+		const uint8_t *stored, size_t storedSize) const;
+	// uncompressed entry, blocks [first, last)
+	void verifyRaw(const ArchiveEntry &entry, uint32_t first, uint32_t last) const;
+	const ArchiveEntry *find(const LookupName &name) const;
+	const ArchiveEntry &get(const wchar_t *fileName) const;
+	// decompress blocks [first, last) to dst
+	void decodeBlocks(const ArchiveEntry &entry,
+		uint32_t first, uint32_t last, uint8_t *dst) const;
+	// read the data after entry in the background
+	void readAhead(const ArchiveEntry &entry);
+};
+
+// directories and archives, later mounts override earlier ones
+// (one flat hash index of all visible files, built at mount time)
+class MountFileLoader : public FileLoader {
+public:
+	// directory if archive is nullptr
+	struct Mount {
+		std::unique_ptr<ArchiveFileLoader> archive;
+		// directory: normalized names and real paths
+		std::vector<std::string> names;
+		std::vector<std::wstring> paths;
+	};
+
+	MountFileLoader() : m_fsLoader(L".") {}
+	virtual ~MountFileLoader() override {}
+	virtual std::vector<uint8_t> loadFile(const wchar_t *fileName) override;
+	virtual uint64_t getFileSize(const wchar_t *fileName) override;
+	virtual std::vector<uint8_t> loadFileRange(const wchar_t *fileName,
+		uint64_t offset, size_t size) override;
+	virtual FileView loadFileView(const wchar_t *fileName) override;
+	virtual bool getRealPath(const wchar_t *fileName, std::wstring *path) override;
+
+	// directory or archive file
+	void mount(const wchar_t *path);
+	void addMount(std::unique_ptr<Mount> &&mount);
+	// visible file count
+	uint32_t getFileCount() const { return m_fileCount; }
+	bool contains(const wchar_t *fileName) const;
+
+private:
+	// hash index slot
+	struct Slot {
+		uint64_t hash;
+		uint32_t mount;
+		// archive entry or directory file index
+		uint32_t entry;
+	};
+	static const uint32_t EmptySlot = std::numeric_limits<uint32_t>::max();
+
+	std::vector<std::unique_ptr<Mount>> m_mounts;
+	// open addressing (linear probing), power of 2, at most half full
+	std::vector<Slot> m_table;
+	uint32_t m_fileCount = 0;
+	// for debug only paths
+	FsFileLoader m_fsLoader;
+
+	bool isSlotName(const Slot &slot, const char *name, size_t size) const;
+	void insert(const Slot &slot, const std::string &name);
+	void grow();
+	const Slot *find(const char *name, size_t size, uint64_t hash) const;
+	const Slot &get(const wchar_t *fileName) const;
+};
+
+inline uint32_t getBlockCount(uint32_t size)
+{
+	return static_cast<uint32_t>((static_cast<uint64_t>(size) + ArchiveBlockSize - 1) / ArchiveBlockSize);
+}
+
+// start reading pages of the mapping without blocking
+void prefetchMapping(const std::shared_ptr<MappedFile> &map, uint64_t offset, uint64_t size)
+{
+	if (platform::prefetchMemory(map->base + offset, static_cast<size_t>(size))) {
+		return;
+	}
+	// Windows 7: touch pages on a worker thread
+	jobs::JobSystem *jobs = s_jobs.load();
+	if (jobs == nullptr) {
+		return;
+	}
+	jobs->run([map, offset, size]() {
+		const size_t PageSize = platform::getPageSize();
+		const volatile uint8_t *p = map->base + offset;
+		uint8_t sum = 0;
+		for (uint64_t i = 0; i < size; i += PageSize) {
+			sum += p[i];
+		}
+		(void)sum;
+	});
+}
+
+// impls
+std::wstring FsFileLoader::getPath(const wchar_t *fileName)
+{
+	std::wstring path;
+	if (fileName[0] == L'/') {
+		// Debug only, abs path
+		path = &fileName[1];
+	}
+	else if (fileName[0] == L'@') {
+		// Debug only, relative to executable
+		path = platform::getExecutableDir();
+		path += &fileName[1];
+	}
+	else {
+		path += m_rootDir;
+		path += L'/';
+		path += fileName;
+	}
+	return path;
+}
+
+Bytes FsFileLoader::loadFile(const wchar_t *fileName)
+{
+	return loadPath(getPath(fileName).c_str());
+}
+
+uint64_t FsFileLoader::getFileSize(const wchar_t *fileName)
+{
+	return getPathSize(getPath(fileName).c_str());
+}
+
+FileView FsFileLoader::loadFileView(const wchar_t *fileName)
+{
+	return loadPathView(getPath(fileName).c_str());
+}
+
+Bytes FsFileLoader::loadFileRange(const wchar_t *fileName, uint64_t offset, size_t size)
+{
+	return loadPathRange(getPath(fileName).c_str(), offset, size);
+}
+
+Bytes FsFileLoader::loadPath(const wchar_t *path)
+{
+	// open
+	platform::FileHandle file = platform::FileHandle::openRead(path);
+
+	// get size to avoid realloc
+	uint64_t fileSize = file.getSize();
+	// 2GiB check
+	if (fileSize > FileSizeMax) {
+		throwTrace<FrameworkError>("File size is too large");
+	}
+	// read
+	Bytes bin(static_cast<size_t>(fileSize));
+	size_t readSize = file.read(bin.data(), bin.size());
+	if (readSize != bin.size()) {
+		throwTrace<FrameworkError>("Read size is strange");
+	}
+
+	// move return
+	return bin;
+}
+
+uint64_t FsFileLoader::getPathSize(const wchar_t *path)
+{
+	platform::FileInfo info;
+	checkWin32Result(platform::getFileInfo(path, &info), "getFileInfo() failed");
+	return info.size;
+}
+
+FileView FsFileLoader::loadPathView(const wchar_t *path)
+{
+	if (getPathSize(path) < MapThreshold) {
+		return FileView(loadPath(path));
+	}
+	std::shared_ptr<MappedFile> map = mapFile(path, platform::AccessHint::Sequential);
+	if (map->size > FileSizeMax) {
+		throwTrace<FrameworkError>("File size is too large");
+	}
+	const uint8_t *base = map->base;
+	const size_t size = static_cast<size_t>(map->size);
+	return FileView(std::move(map), base, size);
+}
+
+Bytes FsFileLoader::loadPathRange(const wchar_t *path, uint64_t offset, size_t size)
+{
+	platform::FileHandle file = platform::FileHandle::openRead(path);
+	if (size > FileSizeMax) {
+		throwTrace<FrameworkError>("Read size is too large");
+	}
+	Bytes bin(size);
+	bin.resize(file.readAt(bin.data(), size, offset));
+	return bin;
+}
+
+ArchiveFileLoader::ArchiveFileLoader(const wchar_t *archiveFile) :
+	m_fsLoader(L"."), m_readAheadEnd(0)
+{
+	m_map = mapFile(archiveFile, platform::AccessHint::Random);
+	m_base = m_map->base;
+	m_size = m_map->size;
+	if (m_size < sizeof(ArchiveHeader)) {
+		throwTrace<FrameworkError>("Broken archive: header");
+	}
+
+	ArchiveHeader header;
+	std::memcpy(&header, m_base, sizeof(header));
+	if (std::memcmp(header.magic, ArchiveMagic, sizeof(ArchiveMagic)) != 0) {
+		throwTrace<FrameworkError>("Not an archive file");
+	}
+	if (header.version != ArchiveVersion) {
+		throwTrace<FrameworkError>("Unsupported archive version");
+	}
+	uint64_t indexSize = static_cast<uint64_t>(sizeof(ArchiveEntry)) * header.entryCount;
+	if (header.indexOffset % alignof(ArchiveEntry) != 0 ||
+		header.indexOffset > m_size || indexSize > m_size - header.indexOffset ||
+		header.nameOffset > m_size) {
+		throwTrace<FrameworkError>("Broken archive: index");
+	}
+	uint64_t crcSize = static_cast<uint64_t>(sizeof(uint32_t)) * header.crcCount;
+	if (header.crcOffset % alignof(uint32_t) != 0 ||
+		header.crcOffset > m_size || crcSize > m_size - header.crcOffset) {
+		throwTrace<FrameworkError>("Broken archive: CRC table");
+	}
+	m_count = header.entryCount;
+	m_index = reinterpret_cast<const ArchiveEntry *>(m_base + header.indexOffset);
+	m_names = reinterpret_cast<const char *>(m_base + header.nameOffset);
+	m_crcs = reinterpret_cast<const uint32_t *>(m_base + header.crcOffset);
+	m_crcCount = header.crcCount;
+	m_verified.reset(new std::atomic<uint32_t>[(m_crcCount + 31) / 32]());
+	validate(m_size - header.nameOffset);
+	m_readAhead = (header.flags & ArchiveTraceOrdered) != 0;
+	debug::writef(L"Archive: %s (%u files%s)", archiveFile, m_count,
+		m_readAhead ? L", trace ordered" : L"");
+}
+
+void ArchiveFileLoader::validate(uint64_t nameSize)
+{
+	// check once here, then loadFile() trusts the index
+	for (uint32_t i = 0; i < m_count; i++) {
+		const ArchiveEntry &entry = m_index[i];
+		if (entry.offset > m_size || entry.storedSize > m_size - entry.offset) {
+			throwTrace<FrameworkError>("Broken archive: data range");
+		}
+		if (entry.nameOffset > nameSize || entry.nameSize > nameSize - entry.nameOffset) {
+			throwTrace<FrameworkError>("Broken archive: name range");
+		}
+		if (i > 0 && m_index[i - 1].hash > entry.hash) {
+			throwTrace<FrameworkError>("Broken archive: index order");
+		}
+		if (entry.crcIndex > m_crcCount || getBlockCount(entry.size) > m_crcCount - entry.crcIndex) {
+			throwTrace<FrameworkError>("Broken archive: CRC range");
+		}
+		if ((entry.flags & EntryCompressed) == 0) {
+			if (entry.storedSize != entry.size) {
+				throwTrace<FrameworkError>("Broken archive: stored size");
+			}
+			continue;
+		}
+		// block table
+		const uint32_t blockCount = getBlockCount(entry.size);
+		const uint64_t tableSize = sizeof(uint32_t) * static_cast<uint64_t>(blockCount);
+		if (tableSize > entry.storedSize) {
+			throwTrace<FrameworkError>("Broken archive: block table");
+		}
+		uint64_t total = tableSize;
+		for (uint32_t k = 0; k < blockCount; k++) {
+			uint32_t blockSize;
+			std::memcpy(&blockSize, m_base + entry.offset + sizeof(uint32_t) * k, sizeof(blockSize));
+			uint32_t raw = std::min(ArchiveBlockSize, entry.size - k * ArchiveBlockSize);
+			if (blockSize == 0 || blockSize > raw) {
+				throwTrace<FrameworkError>("Broken archive: block size");
+			}
+			total += blockSize;
+		}
+		if (total != entry.storedSize) {
+			throwTrace<FrameworkError>("Broken archive: block table");
+		}
+	}
+}
+
+const ArchiveEntry *ArchiveFileLoader::find(const LookupName &name) const
+{
+	const uint64_t hash = name.hash();
+	const ArchiveEntry *end = m_index + m_count;
+	const ArchiveEntry *it = std::lower_bound(m_index, end, hash,
+		[](const ArchiveEntry &entry, uint64_t value) {
+			return entry.hash < value;
+		});
+	// compare names in case of hash collision
+	for (; it != end && it->hash == hash; ++it) {
+		if (isEntryName(*it, name.data(), name.size())) {
+			return it;
+		}
+	}
+	return nullptr;
+}
+
+const ArchiveEntry &ArchiveFileLoader::get(const wchar_t *fileName) const
+{
+	const ArchiveEntry *entry = find(LookupName(fileName));
+	if (entry == nullptr) {
+		throwTrace<FrameworkError>(std::string("File not found in archive: ") +
+			util::wc2utf8(fileName).get());
+	}
+	return *entry;
+}
+
+std::vector<uint64_t> ArchiveFileLoader::getBlockPositions(const ArchiveEntry &entry) const
+{
+	const uint32_t blockCount = getBlockCount(entry.size);
+	std::vector<uint64_t> pos(blockCount + 1);
+	if ((entry.flags & EntryCompressed) == 0) {
+		for (uint32_t k = 0; k < blockCount; k++) {
+			pos[k] = static_cast<uint64_t>(k) * ArchiveBlockSize;
+		}
+		pos[blockCount] = entry.size;
+		return pos;
+	}
+	const uint8_t *table = m_base + entry.offset;
+	uint64_t offset = sizeof(uint32_t) * static_cast<uint64_t>(blockCount);
+	for (uint32_t k = 0; k < blockCount; k++) {
+		pos[k] = offset;
+		uint32_t blockSize;
+		std::memcpy(&blockSize, table + sizeof(uint32_t) * k, sizeof(blockSize));
+		offset += blockSize;
+	}
+	pos[blockCount] = offset;
+	return pos;
+}
+
+bool ArchiveFileLoader::checkBlock(const ArchiveEntry &entry, uint32_t block,
+	const uint8_t *stored, size_t storedSize) const
+{
+	return crc::crc32c(stored, storedSize) == m_crcs[entry.crcIndex + block];
+}
+
+void ArchiveFileLoader::verifyBlock(const ArchiveEntry &entry, uint32_t block,
+	const uint8_t *stored, size_t storedSize) const
+{
+	const uint32_t index = entry.crcIndex + block;
+	std::atomic<uint32_t> &bits = m_verified[index / 32];
+	const uint32_t mask = 1u << (index % 32);
+	if (bits.load(std::memory_order_relaxed) & mask) {
+		return;
+	}
+	if (!checkBlock(entry, block, stored, storedSize)) {
+		throwTrace<FrameworkError>("Archive CRC mismatch: " + getEntryName(entry) +
+			" (block " + std::to_string(block) + ")");
+	}
+	bits.fetch_or(mask, std::memory_order_relaxed);
+}
+
+void ArchiveFileLoader::verifyRaw(const ArchiveEntry &entry, uint32_t first, uint32_t last) const
+{
+	auto verify = [this, &entry](size_t k) {
+		const uint32_t block = static_cast<uint32_t>(k);
+		const uint32_t raw = std::min(ArchiveBlockSize, entry.size - block * ArchiveBlockSize);
+		verifyBlock(entry, block,
+			m_base + entry.offset + static_cast<uint64_t>(block) * ArchiveBlockSize, raw);
+	};
+	jobs::JobSystem *jobs = s_jobs.load();
+	if (jobs != nullptr && last - first > 1) {
+		jobs->parallelFor(first, last, 1, verify);
+	}
+	else {
+		for (uint32_t k = first; k < last; k++) {
+			verify(k);
+		}
+	}
+}
+
+void ArchiveFileLoader::decodeBlocks(const ArchiveEntry &entry,
+	uint32_t first, uint32_t last, uint8_t *dst) const
+{
+	const uint8_t *table = m_base + entry.offset;
+	const uint32_t blockCount = getBlockCount(entry.size);
+	// start position of blocks [first, last]
+	std::vector<uint64_t> pos(last - first + 1);
+	uint64_t offset = sizeof(uint32_t) * static_cast<uint64_t>(blockCount);
+	for (uint32_t k = 0; k <= last; k++) {
+		if (k >= first) {
+			pos[k - first] = offset;
+		}
+		if (k < last) {
+			uint32_t blockSize;
+			std::memcpy(&blockSize, table + sizeof(uint32_t) * k, sizeof(blockSize));
+			offset += blockSize;
+		}
+	}
+	auto decode = [this, &entry, &pos, table, first, dst](size_t k) {
+		const uint32_t block = static_cast<uint32_t>(k);
+		const uint32_t raw = std::min(ArchiveBlockSize, entry.size - block * ArchiveBlockSize);
+		const uint64_t stored = pos[block - first + 1] - pos[block - first];
+		uint8_t *out = dst + static_cast<size_t>(block - first) * ArchiveBlockSize;
+		// before the decoder sees broken data
+		verifyBlock(entry, block, table + pos[block - first], static_cast<size_t>(stored));
+		if (stored == raw) {
+			std::memcpy(out, table + pos[block - first], raw);
+		}
+		else {
+			lz::decompress(table + pos[block - first], static_cast<size_t>(stored), out, raw);
+		}
+	};
+	// blocks are independent
+	jobs::JobSystem *jobs = s_jobs.load();
+	if (jobs != nullptr && last - first > 1) {
+		jobs->parallelFor(first, last, 1, decode);
+	}
+	else {
+		for (uint32_t k = first; k < last; k++) {
+			decode(k);
+		}
+	}
+}
+
+void ArchiveFileLoader::readAhead(const ArchiveEntry &entry)
+{
+	if (!m_readAhead) {
+		return;
+	}
+	const uint64_t end = entry.offset + entry.storedSize;
+	const uint64_t target = std::min<uint64_t>(end + ArchiveReadAheadSize, m_size);
+	uint64_t done = m_readAheadEnd.load();
+	// still more than half a window ahead (or jumped back)
+	if (done > end && done - end >= ArchiveReadAheadSize / 2) {
+		return;
+	}
+	const uint64_t start = std::max(done, end);
+	if (start >= target) {
+		return;
+	}
+	// another thread may have requested it
+	if (!m_readAheadEnd.compare_exchange_strong(done, target)) {
+		return;
+	}
+	prefetchMapping(m_map, start, target - start);
+}
+
+Bytes ArchiveFileLoader::loadFile(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		// Debug only, real file system
+		return m_fsLoader.loadFile(fileName);
+	}
+	return loadEntry(get(fileName));
+}
+
+Bytes ArchiveFileLoader::loadEntry(const ArchiveEntry &entry)
+{
+	readAhead(entry);
+	if ((entry.flags & EntryCompressed) == 0) {
+		verifyRaw(entry, 0, getBlockCount(entry.size));
+		const uint8_t *data = m_base + entry.offset;
+		return Bytes(data, data + entry.size);
+	}
+	Bytes bin(entry.size);
+	decodeBlocks(entry, 0, getBlockCount(entry.size), bin.data());
+	return bin;
+}
+
+FileView ArchiveFileLoader::loadFileView(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.loadFileView(fileName);
+	}
+	return loadEntryView(get(fileName));
+}
+
+FileView ArchiveFileLoader::loadEntryView(const ArchiveEntry &entry)
+{
+	readAhead(entry);
+	if ((entry.flags & EntryCompressed) == 0) {
+		verifyRaw(entry, 0, getBlockCount(entry.size));
+		// points into the archive mapping
+		return FileView(m_map, m_base + entry.offset, entry.size);
+	}
+	Bytes bin(entry.size);
+	decodeBlocks(entry, 0, getBlockCount(entry.size), bin.data());
+	return FileView(std::move(bin));
+}
+
+uint64_t ArchiveFileLoader::getFileSize(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.getFileSize(fileName);
+	}
+	return get(fileName).size;
+}
+
+Bytes ArchiveFileLoader::loadFileRange(const wchar_t *fileName, uint64_t offset, size_t size)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.loadFileRange(fileName, offset, size);
+	}
+	return loadEntryRange(get(fileName), offset, size);
+}
+
+Bytes ArchiveFileLoader::loadEntryRange(const ArchiveEntry &entry, uint64_t offset, size_t size)
+{
+	if (offset >= entry.size) {
+		return Bytes();
+	}
+	readAhead(entry);
+	size = static_cast<size_t>(std::min<uint64_t>(size, entry.size - offset));
+	// only the blocks in range
+	const uint32_t first = static_cast<uint32_t>(offset / ArchiveBlockSize);
+	const uint32_t last = static_cast<uint32_t>((offset + size + ArchiveBlockSize - 1) / ArchiveBlockSize);
+	if ((entry.flags & EntryCompressed) == 0) {
+		verifyRaw(entry, first, last);
+		const uint8_t *data = m_base + entry.offset + offset;
+		return Bytes(data, data + size);
+	}
+	const size_t skip = static_cast<size_t>(offset - static_cast<uint64_t>(first) * ArchiveBlockSize);
+	const size_t rawSize = std::min<size_t>(
+		static_cast<size_t>(last - first) * ArchiveBlockSize,
+		entry.size - static_cast<size_t>(first) * ArchiveBlockSize);
+	if (skip == 0 && rawSize == size) {
+		Bytes bin(size);
+		decodeBlocks(entry, first, last, bin.data());
+		return bin;
+	}
+	Bytes tmp(rawSize);
+	decodeBlocks(entry, first, last, tmp.data());
+	return Bytes(tmp.data() + skip, tmp.data() + skip + size);
+}
+
+void ArchiveFileLoader::verifyAll(VerifyResult *result)
+{
+	struct Block {
+		uint32_t entry;
+		uint32_t block;
+		uint64_t offset;
+		uint32_t size;
+	};
+	std::vector<Block> blocks;
+	blocks.reserve(m_crcCount);
+	for (uint32_t i = 0; i < m_count; i++) {
+		const ArchiveEntry &entry = m_index[i];
+		const std::vector<uint64_t> pos = getBlockPositions(entry);
+		for (uint32_t k = 0; k + 1 < pos.size(); k++) {
+			blocks.push_back(Block{ i, k, entry.offset + pos[k],
+				static_cast<uint32_t>(pos[k + 1] - pos[k]) });
+			result->bytes += pos[k + 1] - pos[k];
+		}
+	}
+	// 1 if broken (no lock in the loop)
+	std::vector<uint8_t> bad(blocks.size(), 0);
+	auto check = [this, &blocks, &bad](size_t k) {
+		const Block &b = blocks[k];
+		if (!checkBlock(m_index[b.entry], b.block, m_base + b.offset, b.size)) {
+			bad[k] = 1;
+		}
+	};
+	// 1 MiB per job
+	const size_t grain = 1024 * 1024 / ArchiveBlockSize;
+	jobs::JobSystem *jobs = s_jobs.load();
+	if (jobs != nullptr) {
+		jobs->parallelFor(0, blocks.size(), grain, check);
+	}
+	else {
+		jobs::JobSystem tmpJobs(0);
+		tmpJobs.parallelFor(0, blocks.size(), grain, check);
+	}
+	result->files = m_count;
+	result->blocks = static_cast<uint32_t>(blocks.size());
+	for (size_t k = 0; k < blocks.size(); k++) {
+		if (bad[k] == 0) {
+			continue;
+		}
+		std::string name = getEntryName(m_index[blocks[k].entry]);
+		// blocks of an entry are adjacent
+		if (result->badFiles.empty() || result->badFiles.back() != name) {
+			result->badFiles.emplace_back(std::move(name));
+		}
+	}
+}
+
+std::vector<std::string> ArchiveFileLoader::getNames() const
+{
+	std::vector<std::string> names;
+	names.reserve(m_count);
+	for (uint32_t i = 0; i < m_count; i++) {
+		names.emplace_back(m_names + m_index[i].nameOffset, m_index[i].nameSize);
+	}
+	return names;
+}
+
+// recursive, names are relative to the first dir
+void listFiles(const std::wstring &dir, const std::wstring &prefix,
+	std::vector<std::wstring> *out)
+{
+	platform::listDirectory(dir.c_str(), [&](const wchar_t *name, bool isDirectory) {
+		if (isDirectory) {
+			listFiles(dir + L'/' + name, prefix + name + L'/', out);
+		}
+		else {
+			out->emplace_back(prefix + name);
+		}
+	});
+}
+
+inline uint64_t alignUp(uint64_t value, uint64_t align)
+{
+	return (value + align - 1) / align * align;
+}
+
+void MountFileLoader::mount(const wchar_t *path)
+{
+	platform::FileInfo info;
+	checkWin32Result(platform::getFileInfo(path, &info), "getFileInfo() failed");
+	auto mount = std::make_unique<Mount>();
+	if (info.isDirectory) {
+		std::vector<std::wstring> files;
+		listFiles(path, L"", &files);
+		mount->names.reserve(files.size());
+		mount->paths.reserve(files.size());
+		for (const auto &file : files) {
+			mount->names.emplace_back(normalizeName(file.c_str()));
+			mount->paths.emplace_back(std::wstring(path) + L'/' + file);
+		}
+	}
+	else {
+		mount->archive = std::make_unique<ArchiveFileLoader>(path);
+	}
+	addMount(std::move(mount));
+	debug::writef(L"Mount: %s (%u files visible)", path, m_fileCount);
+}
+
+void MountFileLoader::addMount(std::unique_ptr<Mount> &&mount)
+{
+	const uint32_t index = static_cast<uint32_t>(m_mounts.size());
+	m_mounts.emplace_back(std::move(mount));
+	const Mount &m = *m_mounts.back();
+	if (m.archive != nullptr) {
+		const uint32_t count = m.archive->getEntryCount();
+		for (uint32_t i = 0; i < count; i++) {
+			const ArchiveEntry &entry = m.archive->getEntry(i);
+			insert(Slot{ entry.hash, index, i }, m.archive->getEntryName(entry));
+		}
+	}
+	else {
+		for (uint32_t i = 0; i < m.names.size(); i++) {
+			insert(Slot{ hashName(m.names[i]), index, i }, m.names[i]);
+		}
+	}
+}
+
+bool MountFileLoader::isSlotName(const Slot &slot, const char *name, size_t size) const
+{
+	const Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return mount.archive->isEntryName(mount.archive->getEntry(slot.entry), name, size);
+	}
+	const std::string &slotName = mount.names[slot.entry];
+	return slotName.size() == size && std::memcmp(slotName.data(), name, size) == 0;
+}
+
+void MountFileLoader::insert(const Slot &slot, const std::string &name)
+{
+	if ((static_cast<size_t>(m_fileCount) + 1) * 2 > m_table.size()) {
+		grow();
+	}
+	const size_t mask = m_table.size() - 1;
+	for (size_t i = static_cast<size_t>(slot.hash) & mask; ; i = (i + 1) & mask) {
+		Slot &s = m_table[i];
+		if (s.mount == EmptySlot) {
+			s = slot;
+			m_fileCount++;
+			return;
+		}
+		if (s.hash == slot.hash && isSlotName(s, name.data(), name.size())) {
+			// override
+			s = slot;
+			return;
+		}
+	}
+}
+
+void MountFileLoader::grow()
+{
+	std::vector<Slot> old(std::max<size_t>(m_table.size() * 2, 64),
+		Slot{ 0, EmptySlot, 0 });
+	old.swap(m_table);
+	const size_t mask = m_table.size() - 1;
+	// names are all different
+	for (const Slot &slot : old) {
+		if (slot.mount == EmptySlot) {
+			continue;
+		}
+		size_t i = static_cast<size_t>(slot.hash) & mask;
+		while (m_table[i].mount != EmptySlot) {
+			i = (i + 1) & mask;
+		}
+		m_table[i] = slot;
+	}
+}
+
+const MountFileLoader::Slot *MountFileLoader::find(
+	const char *name, size_t size, uint64_t hash) const
+{
+	if (m_table.empty()) {
+		return nullptr;
+	}
+	const size_t mask = m_table.size() - 1;
+	for (size_t i = static_cast<size_t>(hash) & mask; ; i = (i + 1) & mask) {
+		const Slot &s = m_table[i];
+		if (s.mount == EmptySlot) {
+			return nullptr;
+		}
+		if (s.hash == hash && isSlotName(s, name, size)) {
+			return &s;
+		}
+	}
+}
+
+const MountFileLoader::Slot &MountFileLoader::get(const wchar_t *fileName) const
+{
+	// normalize and hash only once, without allocation
+	const LookupName name(fileName);
+	const Slot *slot = find(name.data(), name.size(), name.hash());
+	if (slot == nullptr) {
+		throwTrace<FrameworkError>("File not found in mount table: " + name.str());
+	}
+	return *slot;
+}
+
+bool MountFileLoader::contains(const wchar_t *fileName) const
+{
+	const LookupName name(fileName);
+	return find(name.data(), name.size(), name.hash()) != nullptr;
+}
+
+Bytes MountFileLoader::loadFile(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.loadFile(fileName);
+	}
+	const Slot &slot = get(fileName);
+	Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return mount.archive->loadEntry(mount.archive->getEntry(slot.entry));
+	}
+	return FsFileLoader::loadPath(mount.paths[slot.entry].c_str());
+}
+
+uint64_t MountFileLoader::getFileSize(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.getFileSize(fileName);
+	}
+	const Slot &slot = get(fileName);
+	Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return mount.archive->getEntry(slot.entry).size;
+	}
+	return FsFileLoader::getPathSize(mount.paths[slot.entry].c_str());
+}
+
+Bytes MountFileLoader::loadFileRange(const wchar_t *fileName, uint64_t offset, size_t size)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.loadFileRange(fileName, offset, size);
+	}
+	const Slot &slot = get(fileName);
+	Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return mount.archive->loadEntryRange(
+			mount.archive->getEntry(slot.entry), offset, size);
+	}
+	return FsFileLoader::loadPathRange(mount.paths[slot.entry].c_str(), offset, size);
+}
+
+FileView MountFileLoader::loadFileView(const wchar_t *fileName)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.loadFileView(fileName);
+	}
+	const Slot &slot = get(fileName);
+	Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return mount.archive->loadEntryView(mount.archive->getEntry(slot.entry));
+	}
+	return FsFileLoader::loadPathView(mount.paths[slot.entry].c_str());
+}
+
+bool MountFileLoader::getRealPath(const wchar_t *fileName, std::wstring *path)
+{
+	if (fileName[0] == L'/' || fileName[0] == L'@') {
+		return m_fsLoader.getRealPath(fileName, path);
+	}
+	const Slot &slot = get(fileName);
+	const Mount &mount = *m_mounts[slot.mount];
+	if (mount.archive != nullptr) {
+		return false;
+	}
+	*path = mount.paths[slot.entry];
+	return true;
+}
+
+// variables
+std::unique_ptr<FileLoader> s_fileLoader(nullptr);
+// s_fileLoader if initWithMountTable()
+MountFileLoader *s_mountTable = nullptr;
+
+// access trace
+std::atomic<bool> s_traceEnabled(false);
+std::mutex s_traceLock;
+std::unordered_set<std::string> s_traceSeen;
+std::vector<std::string> s_trace;
+
+void traceAccess(const wchar_t *fileName)
+{
+	if (!s_traceEnabled.load() || fileName[0] == L'/' || fileName[0] == L'@') {
+		return;
+	}
+	std::string name = normalizeName(fileName);
+	std::lock_guard<std::mutex> lock(s_traceLock);
+	if (s_traceSeen.insert(name).second) {
+		s_trace.emplace_back(std::move(name));
+	}
+}
+
+// names in first-access order (real file system)
+std::vector<std::string> loadAccessTrace(const wchar_t *path)
+{
+	FILE *tmpfp = platform::openFile(path, "rb");
+	if (tmpfp == nullptr) {
+		throwTrace<FrameworkError>("Open trace file failed");
+	}
+	util::FilePtr fp(tmpfp);
+	std::vector<std::string> names;
+	std::string line;
+	int c;
+	while ((c = ::fgetc(fp.get())) != EOF) {
+		if (c == '\n') {
+			names.emplace_back(std::move(line));
+			line.clear();
+		}
+		else if (c != '\r') {
+			line += static_cast<char>(c);
+		}
+	}
+	names.emplace_back(std::move(line));
+	names.erase(std::remove_if(names.begin(), names.end(),
+		[](const std::string &name) { return name.empty(); }), names.end());
+	return names;
+}
+
+}	// namespace
+
+
+void initWithFileSystem(const wchar_t *rootDir)
+{
+	s_mountTable = nullptr;
+	s_fileLoader.reset(new FsFileLoader(rootDir));
+}
+
+void initWithArchiveFile(const wchar_t *archiveFile)
+{
+	auto loader = std::make_unique<MountFileLoader>();
+	loader->mount(archiveFile);
+	s_mountTable = loader.get();
+	s_fileLoader = std::move(loader);
+}
+
+void initWithMountTable()
+{
+	auto loader = std::make_unique<MountFileLoader>();
+	s_mountTable = loader.get();
+	s_fileLoader = std::move(loader);
+}
+
+void mount(const wchar_t *path)
+{
+	if (s_mountTable == nullptr) {
+		throwTrace<std::logic_error>("Mount table is not initialized.");
+	}
+	s_mountTable->mount(path);
+}
+
+std::vector<uint8_t> loadFile(const wchar_t *fileName)
+{
+	if (s_fileLoader == nullptr) {
+		throwTrace<std::logic_error>("FileLoader is not initialized.");
+	}
+	traceAccess(fileName);
+	return s_fileLoader->loadFile(fileName);
+}
+
+FileView loadFileView(const wchar_t *fileName)
+{
+	if (s_fileLoader == nullptr) {
+		throwTrace<std::logic_error>("FileLoader is not initialized.");
+	}
+	traceAccess(fileName);
+	return s_fileLoader->loadFileView(fileName);
+}
+
+void setJobSystem(jobs::JobSystem *jobs)
+{
+	s_jobs.store(jobs);
+}
+
+uint64_t getFileSize(const wchar_t *fileName)
+{
+	if (s_fileLoader == nullptr) {
+		throwTrace<std::logic_error>("FileLoader is not initialized.");
+	}
+	return s_fileLoader->getFileSize(fileName);
+}
+
+bool isRealFile(const wchar_t *fileName)
+{
+	if (s_fileLoader == nullptr) {
+		throwTrace<std::logic_error>("FileLoader is not initialized.");
+	}
+	std::wstring path;
+	return s_fileLoader->getRealPath(fileName, &path);
+}
+
+Bytes loadFileRange(const wchar_t *fileName, uint64_t offset, size_t size)
+{
+	if (s_fileLoader == nullptr) {
+		throwTrace<std::logic_error>("FileLoader is not initialized.");
+	}
+	traceAccess(fileName);
+	return s_fileLoader->loadFileRange(fileName, offset, size);
+}
+
+void startAccessTrace()
+{
+	std::lock_guard<std::mutex> lock(s_traceLock);
+	s_traceSeen.clear();
+	s_trace.clear();
+	s_traceEnabled.store(true);
+}
+
+void saveAccessTrace(const wchar_t *path)
+{
+	std::string text;
+	{
+		std::lock_guard<std::mutex> lock(s_traceLock);
+		for (const auto &name : s_trace) {
+			text += name;
+			text += '\n';
+		}
+		debug::writef(L"Save access trace: %s (%zu files)", path, s_trace.size());
+	}
+	FILE *tmpfp = platform::openFile(path, "wb");
+	if (tmpfp == nullptr) {
+		throwTrace<FrameworkError>("Save trace file failed");
+	}
+	util::FilePtr fp(tmpfp);
+	if (::fwrite(text.data(), 1, text.size(), fp.get()) != text.size()) {
+		throwTrace<FrameworkError>("Write trace file failed");
+	}
+}
+
+namespace {
+
+// block table and blocks
+// empty if compression does not save enough
+Bytes compressEntry(const Bytes &bin)
+{
+	const uint32_t size = static_cast<uint32_t>(bin.size());
+	const uint32_t blockCount = getBlockCount(size);
+	Bytes out(sizeof(uint32_t) * blockCount);
+	Bytes buf(lz::compressBound(ArchiveBlockSize));
+	for (uint32_t k = 0; k < blockCount; k++) {
+		const uint8_t *raw = bin.data() + static_cast<size_t>(k) * ArchiveBlockSize;
+		const uint32_t rawSize = std::min(ArchiveBlockSize, size - k * ArchiveBlockSize);
+		size_t compSize = lz::compress(raw, rawSize, buf.data(), buf.size());
+		uint32_t blockSize = rawSize;
+		if (compSize != 0) {
+			blockSize = static_cast<uint32_t>(compSize);
+			out.insert(out.end(), buf.data(), buf.data() + compSize);
+		}
+		else {
+			// incompressible, store as is
+			out.insert(out.end(), raw, raw + rawSize);
+		}
+		std::memcpy(out.data() + sizeof(uint32_t) * k, &blockSize, sizeof(blockSize));
+	}
+	// at least 1/8 smaller, or not worth decompression
+	if (out.size() > bin.size() - bin.size() / 8) {
+		return Bytes();
+	}
+	return out;
+}
+
+// CRCs of the stored blocks
+void appendBlockCrcs(const Bytes &stored, uint32_t size, bool compressed,
+	std::vector<uint32_t> *crcs)
+{
+	const uint32_t blockCount = getBlockCount(size);
+	size_t offset = compressed ? sizeof(uint32_t) * blockCount : 0;
+	for (uint32_t k = 0; k < blockCount; k++) {
+		uint32_t blockSize = std::min(ArchiveBlockSize, size - k * ArchiveBlockSize);
+		if (compressed) {
+			std::memcpy(&blockSize, stored.data() + sizeof(uint32_t) * k, sizeof(blockSize));
+		}
+		crcs->push_back(crc::crc32c(stored.data() + offset, blockSize));
+		offset += blockSize;
+	}
+}
+
+}	// namespace
+
+uint32_t createArchive(const wchar_t *archivePath, const wchar_t *srcDir, bool compress,
+	const wchar_t *traceFile)
+{
+	struct Item {
+		std::wstring path;
+		std::string name;
+		ArchiveEntry entry;
+	};
+
+	std::vector<std::wstring> paths;
+	listFiles(srcDir, L"", &paths);
+	if (paths.size() > std::numeric_limits<uint32_t>::max()) {
+		throwTrace<FrameworkError>("Too many files");
+	}
+	std::vector<Item> items(paths.size());
+	for (size_t i = 0; i < paths.size(); i++) {
+		items[i].path = std::move(paths[i]);
+		items[i].name = normalizeName(items[i].path.c_str());
+		items[i].entry.hash = hashName(items[i].name);
+		if (items[i].name.size() > std::numeric_limits<uint16_t>::max()) {
+			throwTrace<FrameworkError>("File name is too long: " + items[i].name);
+		}
+	}
+	std::sort(items.begin(), items.end(), [](const Item &a, const Item &b) {
+		return a.name < b.name;
+	});
+	for (size_t i = 1; i < items.size(); i++) {
+		if (items[i - 1].name == items[i].name) {
+			throwTrace<FrameworkError>("Duplicate file name: " + items[i].name);
+		}
+	}
+	// data layout: traced files in first-access order, then the rest in name order
+	std::vector<uint32_t> layout(items.size());
+	for (uint32_t i = 0; i < layout.size(); i++) {
+		layout[i] = i;
+	}
+	uint32_t tracedCount = 0;
+	if (traceFile != nullptr) {
+		std::vector<uint32_t> rank(items.size(), std::numeric_limits<uint32_t>::max());
+		for (const auto &name : loadAccessTrace(traceFile)) {
+			auto it = std::lower_bound(items.begin(), items.end(), name,
+				[](const Item &item, const std::string &value) {
+					return item.name < value;
+				});
+			if (it == items.end() || it->name != name) {
+				// deleted after the trace
+				continue;
+			}
+			uint32_t &r = rank[it - items.begin()];
+			if (r == std::numeric_limits<uint32_t>::max()) {
+				r = tracedCount++;
+			}
+		}
+		std::stable_sort(layout.begin(), layout.end(), [&rank](uint32_t a, uint32_t b) {
+			return rank[a] < rank[b];
+		});
+	}
+
+	const uint32_t count = static_cast<uint32_t>(items.size());
+	const uint64_t indexOffset = sizeof(ArchiveHeader);
+	const uint64_t nameOffset = indexOffset + sizeof(ArchiveEntry) * count;
+	std::string names;
+	for (auto &item : items) {
+		item.entry.nameOffset = static_cast<uint32_t>(names.size());
+		item.entry.nameSize = static_cast<uint16_t>(item.name.size());
+		names += item.name;
+	}
+
+	FILE *tmpfp = platform::openFile(archivePath, "wb");
+	if (tmpfp == nullptr) {
+		throwTrace<FrameworkError>("Open archive file failed");
+	}
+	util::FilePtr fp(tmpfp);
+	uint64_t written = 0;
+	auto write = [&fp, &written](const void *data, size_t size) {
+		if (::fwrite(data, 1, size, fp.get()) != size) {
+			throwTrace<FrameworkError>("Write archive file failed");
+		}
+		written += size;
+	};
+	const uint8_t zero[ArchiveAlign] = { 0 };
+
+	// header and index are written at last
+	std::vector<uint8_t> placeholder(static_cast<size_t>(nameOffset), 0);
+	write(placeholder.data(), placeholder.size());
+	write(names.data(), names.size());
+	// data
+	FsFileLoader fsLoader(srcDir);
+	uint64_t rawTotal = 0;
+	uint32_t compCount = 0;
+	std::vector<uint32_t> crcs;
+	for (uint32_t i : layout) {
+		Item &item = items[i];
+		write(zero, static_cast<size_t>(alignUp(written, ArchiveAlign) - written));
+		Bytes bin = fsLoader.loadFile(item.path.c_str());
+		Bytes comp;
+		if (compress && !bin.empty()) {
+			comp = compressEntry(bin);
+		}
+		const Bytes &stored = comp.empty() ? bin : comp;
+		item.entry.offset = written;
+		item.entry.size = static_cast<uint32_t>(bin.size());
+		item.entry.storedSize = static_cast<uint32_t>(stored.size());
+		item.entry.flags = comp.empty() ? 0 : EntryCompressed;
+		item.entry.crcIndex = static_cast<uint32_t>(crcs.size());
+		appendBlockCrcs(stored, item.entry.size, !comp.empty(), &crcs);
+		write(stored.data(), stored.size());
+		rawTotal += bin.size();
+		compCount += comp.empty() ? 0 : 1;
+	}
+	// CRC table
+	write(zero, static_cast<size_t>(alignUp(written, ArchiveAlign) - written));
+	const uint64_t crcOffset = written;
+	write(crcs.data(), sizeof(uint32_t) * crcs.size());
+
+	// index in hash order
+	std::vector<ArchiveEntry> index(count);
+	for (uint32_t i = 0; i < count; i++) {
+		index[i] = items[i].entry;
+	}
+	std::sort(index.begin(), index.end(), [](const ArchiveEntry &a, const ArchiveEntry &b) {
+		return a.hash < b.hash;
+	});
+
+	ArchiveHeader header;
+	std::memcpy(header.magic, ArchiveMagic, sizeof(ArchiveMagic));
+	header.version = ArchiveVersion;
+	header.flags = (traceFile != nullptr) ? ArchiveTraceOrdered : 0;
+	header.entryCount = count;
+	header.indexOffset = indexOffset;
+	header.nameOffset = nameOffset;
+	header.crcOffset = crcOffset;
+	header.crcCount = static_cast<uint32_t>(crcs.size());
+	header.reserved = 0;
+	if (platform::seekFile(fp.get(), 0, SEEK_SET) != 0) {
+		throwTrace<FrameworkError>("Seek archive file failed");
+	}
+	const uint64_t fileSize = written;
+	write(&header, sizeof(header));
+	write(index.data(), sizeof(ArchiveEntry) * index.size());
+
+	debug::writef(L"Create archive: %s (%u files, %u compressed, %u traced, %llu -> %llu bytes)",
+		archivePath, count, compCount, tracedCount, static_cast<unsigned long long>(rawTotal),
+		static_cast<unsigned long long>(fileSize));
+	return count;
+}
+
+ArchiveBenchResult benchmarkArchive(const wchar_t *archiveFile,
+	const wchar_t *rootDir, uint32_t rounds)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	ArchiveFileLoader archive(archiveFile);
+	FsFileLoader fs(rootDir);
+	std::vector<std::wstring> names;
+	for (const auto &name : archive.getNames()) {
+		names.emplace_back(util::utf82wc(name.c_str()).get());
+	}
+
+	ArchiveBenchResult result;
+	result.files = static_cast<uint32_t>(names.size());
+	result.archiveBytes = archive.getArchiveSize();
+	rounds = std::max(rounds, 1u);
+	// warm up both (OS file cache), so that only the access cost is compared
+	for (const auto &name : names) {
+		result.bytes += fs.loadFile(name.c_str()).size();
+		archive.loadFile(name.c_str());
+	}
+	duration<double, std::milli> fsTime(0), archiveTime(0);
+	for (uint32_t r = 0; r < rounds; r++) {
+		auto start = Clock::now();
+		for (const auto &name : names) {
+			fs.loadFile(name.c_str());
+		}
+		auto mid = Clock::now();
+		for (const auto &name : names) {
+			archive.loadFile(name.c_str());
+		}
+		auto end = Clock::now();
+		fsTime += mid - start;
+		archiveTime += end - mid;
+	}
+	result.fsMs = fsTime.count() / rounds;
+	result.archiveMs = archiveTime.count() / rounds;
+	debug::writef(L"Archive bench: %u files, %llu bytes (archive %llu), fs %.3f ms, archive %.3f ms",
+		result.files, static_cast<unsigned long long>(result.bytes),
+		static_cast<unsigned long long>(result.archiveBytes),
+		result.fsMs, result.archiveMs);
+	return result;
+}
+
+VerifyResult verifyArchive(const wchar_t *archiveFile)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	ArchiveFileLoader archive(archiveFile);
+	VerifyResult result;
+	auto start = Clock::now();
+	archive.verifyAll(&result);
+	duration<double, std::milli> time = Clock::now() - start;
+	result.ms = time.count();
+	result.gbps = (result.ms > 0.0) ? result.bytes / 1e6 / result.ms : 0.0;
+	debug::writef(L"Verify archive: %s (%u files, %u blocks, %llu bytes, %.3f ms, %.2f GB/s, %zu broken)",
+		archiveFile, result.files, result.blocks,
+		static_cast<unsigned long long>(result.bytes),
+		result.ms, result.gbps, result.badFiles.size());
+	for (const auto &name : result.badFiles) {
+		debug::writef(L"Broken: %s", util::utf82wc(name.c_str()).get());
+	}
+	return result;
+}
+
+MountBenchResult benchmarkMountLookup(uint32_t entries, uint32_t lookups)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	entries = std::max(entries, 1u);
+	// typical asset paths (not in the real file system)
+	std::vector<std::wstring> names(entries);
+	auto mount = std::make_unique<MountFileLoader::Mount>();
+	mount->names.reserve(entries);
+	mount->paths.resize(entries);
+	for (uint32_t i = 0; i < entries; i++) {
+		wchar_t buf[64];
+		std::swprintf(buf, sizeof(buf) / sizeof(buf[0]), L"data/Dir%03u/File%06u.png", i % 1000, i);
+		names[i] = buf;
+		mount->names.emplace_back(normalizeName(buf));
+	}
+
+	MountBenchResult result;
+	result.entries = entries;
+	result.lookups = lookups;
+	MountFileLoader loader;
+	auto start = Clock::now();
+	loader.addMount(std::move(mount));
+	auto mid = Clock::now();
+	uint32_t x = 2463534242u;
+	uint32_t found = 0;
+	for (uint32_t i = 0; i < lookups; i++) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		found += loader.contains(names[x % entries].c_str()) ? 1 : 0;
+	}
+	auto end = Clock::now();
+	if (found != lookups) {
+		throwTrace<FrameworkError>("Mount table lookup failed");
+	}
+	duration<double, std::milli> buildTime = mid - start;
+	duration<double, std::milli> lookupTime = end - mid;
+	result.buildMs = buildTime.count();
+	result.lookupMs = lookupTime.count();
+	result.lookupsPerSec = (result.lookupMs > 0.0) ? lookups / result.lookupMs * 1e3 : 0.0;
+	debug::writef(L"Mount lookup bench: %u entries, build %.3f ms, %u lookups %.3f ms (%.0f /s)",
+		entries, result.buildMs, lookups, result.lookupMs, result.lookupsPerSec);
+	return result;
+}
+
+namespace {
+
+struct ReplayRun {
+	uint32_t files = 0;
+	uint64_t bytes = 0;
+	double ms = 0.0;
+	bool cold = false;
+};
+
+ReplayRun replayTrace(const wchar_t *archiveFile, const std::vector<std::string> &trace)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	ReplayRun run;
+	run.cold = platform::evictFileCache(archiveFile);
+	auto start = Clock::now();
+	{
+		// includes open and index validation, as in startup
+		ArchiveFileLoader archive(archiveFile);
+		const std::vector<std::string> entries = archive.getNames();
+		const std::unordered_set<std::string> exists(entries.begin(), entries.end());
+		for (const auto &name : trace) {
+			if (exists.count(name) == 0) {
+				continue;
+			}
+			Bytes bin = archive.loadFile(util::utf82wc(name.c_str()).get());
+			run.files++;
+			run.bytes += bin.size();
+		}
+	}
+	duration<double, std::milli> elapsed = Clock::now() - start;
+	run.ms = elapsed.count();
+	return run;
+}
+
+}	// namespace
+
+TraceReplayResult benchmarkTraceReplay(const wchar_t *nameOrderArchive,
+	const wchar_t *traceOrderArchive, const wchar_t *traceFile)
+{
+	const std::vector<std::string> trace = loadAccessTrace(traceFile);
+
+	const ReplayRun nameRun = replayTrace(nameOrderArchive, trace);
+	const ReplayRun traceRun = replayTrace(traceOrderArchive, trace);
+	if (nameRun.files != traceRun.files || nameRun.bytes != traceRun.bytes) {
+		throwTrace<FrameworkError>("Trace replay: archives have different files");
+	}
+
+	TraceReplayResult result;
+	result.files = traceRun.files;
+	result.bytes = traceRun.bytes;
+	result.nameOrderMs = nameRun.ms;
+	result.traceOrderMs = traceRun.ms;
+	result.cold = nameRun.cold && traceRun.cold;
+	debug::writef(L"Trace replay: %u files, %llu bytes, name order %.3f ms, trace order %.3f ms%s",
+		result.files, static_cast<unsigned long long>(result.bytes),
+		result.nameOrderMs, result.traceOrderMs,
+		result.cold ? L"" : L" (OS file cache not dropped)");
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class AsyncReader impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region AsyncReader
+
+namespace {
+
+struct AsyncRequest {
+	std::wstring fileName;
+	AsyncReader::Callback callback;
+};
+
+// overlapped read in flight
+#ifdef _WIN32
+struct AsyncOp {
+	// completion gives this address (CONTAINING_RECORD)
+	OVERLAPPED ov;
+	util::HandlePtr hFile;
+	Bytes buf;
+	AsyncReader::Callback callback;
+};
+
+// completion key to wake up the I/O thread
+const ULONG_PTR WakeKey = 1;
+#endif
+
+#ifdef YAPPY_HAVE_LIBURING
+// read in flight on the ring
+struct UringOp {
+	platform::FileHandle file;
+	Bytes buf;
+	// read size so far (a short read is continued)
+	size_t done = 0;
+	AsyncReader::Callback callback;
+};
+#endif
+
+const wchar_t *getBackendName(AsyncReader::Backend backend)
+{
+	switch (backend) {
+	case AsyncReader::Backend::Iocp:
+		return L"iocp";
+	case AsyncReader::Backend::ThreadPool:
+		return L"thread pool";
+#ifdef __linux__
+	case AsyncReader::Backend::IoUring:
+		return L"io_uring";
+#endif
+	default:
+		return L"auto";
+	}
+}
+
+}	// namespace
+
+struct AsyncReader::Impl {
+	uint32_t depth;
+	Backend backend;
+
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<AsyncRequest> queue;
+	uint32_t inFlight = 0;
+	bool stop = false;
+
+#ifdef _WIN32
+	// Iocp
+	util::HandlePtr hPort;
+#endif
+#ifdef YAPPY_HAVE_LIBURING
+	// IoUring
+	io_uring ring;
+	// eventfd written by wake(), read of wakeBuf is always pending on the ring
+	int wakeFd = -1;
+	uint64_t wakeBuf = 0;
+#endif
+	// Iocp, IoUring: the I/O thread, ThreadPool: workers
+	std::vector<std::thread> threads;
+
+	std::atomic<uint64_t> completed{ 0 };
+	std::atomic<uint64_t> bytes{ 0 };
+	std::atomic<uint32_t> maxInFlight{ 0 };
+
+	void complete(const AsyncReader::Callback &callback, Bytes &&bin,
+		std::exception_ptr error);
+	void countInFlight();
+	void poolMain();
+#ifdef _WIN32
+	void iocpMain();
+	// false if completed immediately
+	bool startRead(AsyncRequest &&req);
+#endif
+#ifdef YAPPY_HAVE_LIBURING
+	// false if io_uring is not available
+	bool initUring();
+	void uringMain();
+	// false if completed immediately
+	bool startUring(AsyncRequest &&req);
+	// read the rest of op->buf
+	void submitUring(UringOp *op);
+	void armWake();
+#endif
+	void wake(bool all);
+};
+
+void AsyncReader::Impl::complete(const AsyncReader::Callback &callback, Bytes &&bin,
+	std::exception_ptr error)
+{
+	bytes.fetch_add(bin.size());
+	completed.fetch_add(1);
+	try {
+		callback(std::move(bin), error);
+	}
+	catch (const std::exception &ex) {
+		debug::writeLine(L"Unhandled exception in AsyncReader callback");
+		debug::writeLine(ex.what());
+	}
+}
+
+// call with lock
+void AsyncReader::Impl::countInFlight()
+{
+	inFlight++;
+	if (inFlight > maxInFlight.load()) {
+		maxInFlight.store(inFlight);
+	}
+}
+
+void AsyncReader::Impl::poolMain()
+{
+	platform::setThreadName(L"Async reader");
+	while (true) {
+		AsyncRequest req;
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			cond.wait(lk, [this]() { return stop || !queue.empty(); });
+			if (queue.empty()) {
+				// stop
+				return;
+			}
+			req = std::move(queue.front());
+			queue.pop_front();
+			countInFlight();
+		}
+		Bytes bin;
+		std::exception_ptr error;
+		try {
+			bin = loadFile(req.fileName.c_str());
+		}
+		catch (...) {
+			error = std::current_exception();
+		}
+		complete(req.callback, std::move(bin), error);
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			inFlight--;
+		}
+	}
+}
+
+#ifdef _WIN32
+bool AsyncReader::Impl::startRead(AsyncRequest &&req)
+{
+	std::unique_ptr<AsyncOp> op;
+	try {
+		std::wstring path;
+		if (s_fileLoader == nullptr || !s_fileLoader->getRealPath(req.fileName.c_str(), &path)) {
+			// archive entry etc. (blocking)
+			Bytes bin = loadFile(req.fileName.c_str());
+			complete(req.callback, std::move(bin), nullptr);
+			return false;
+		}
+		op = std::make_unique<AsyncOp>();
+		::ZeroMemory(&op->ov, sizeof(op->ov));
+		op->callback = std::move(req.callback);
+		HANDLE tmphFile = ::CreateFile(
+			path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		checkWin32Result(tmphFile != INVALID_HANDLE_VALUE, "CreateFile() failed");
+		op->hFile.reset(tmphFile);
+
+		LARGE_INTEGER fileSize = { 0 };
+		BOOL b = ::GetFileSizeEx(op->hFile.get(), &fileSize);
+		checkWin32Result(b != 0, "GetFileSizeEx() failed");
+		checkWin32Result(fileSize.HighPart == 0, "File size is too large");
+		checkWin32Result(fileSize.LowPart < 0x80000000, "File size is too large");
+		if (fileSize.LowPart == 0) {
+			complete(op->callback, Bytes(), nullptr);
+			return false;
+		}
+		op->buf.resize(fileSize.LowPart);
+
+		HANDLE port = ::CreateIoCompletionPort(op->hFile.get(), hPort.get(), 0, 0);
+		checkWin32Result(port != nullptr, "CreateIoCompletionPort() failed");
+		// completion is queued to the port even if it finishes synchronously
+		b = ::ReadFile(op->hFile.get(), op->buf.data(), fileSize.LowPart, nullptr, &op->ov);
+		checkWin32Result(b != 0 || ::GetLastError() == ERROR_IO_PENDING, "ReadFile() failed");
+		// owned by the port until completion
+		op.release();
+		return true;
+	}
+	catch (...) {
+		complete((op != nullptr) ? op->callback : req.callback,
+			Bytes(), std::current_exception());
+		return false;
+	}
+}
+
+void AsyncReader::Impl::iocpMain()
+{
+	platform::setThreadName(L"Async reader I/O");
+	while (true) {
+		// issue reads up to depth
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			while (inFlight < depth && !queue.empty()) {
+				AsyncRequest req = std::move(queue.front());
+				queue.pop_front();
+				countInFlight();
+				lk.unlock();
+				bool pending = startRead(std::move(req));
+				lk.lock();
+				if (!pending) {
+					inFlight--;
+				}
+			}
+			if (stop && queue.empty() && inFlight == 0) {
+				return;
+			}
+		}
+		// wait for a completion or WakeKey
+		DWORD size = 0;
+		ULONG_PTR key = 0;
+		OVERLAPPED *ov = nullptr;
+		BOOL b = ::GetQueuedCompletionStatus(hPort.get(), &size, &key, &ov, INFINITE);
+		if (ov == nullptr) {
+			// WakeKey (or port error)
+			continue;
+		}
+		std::unique_ptr<AsyncOp> op(CONTAINING_RECORD(ov, AsyncOp, ov));
+		std::exception_ptr error;
+		try {
+			checkWin32Result(b != 0, "ReadFile() failed");
+			// shorter if truncated after GetFileSizeEx()
+			op->buf.resize(size);
+		}
+		catch (...) {
+			error = std::current_exception();
+			op->buf.clear();
+		}
+		op->hFile.reset();
+		complete(op->callback, std::move(op->buf), error);
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			inFlight--;
+		}
+	}
+}
+#endif
+
+#ifdef YAPPY_HAVE_LIBURING
+bool AsyncReader::Impl::initUring()
+{
+	// reads and the wake read
+	int ret = ::io_uring_queue_init(depth + 1, &ring, 0);
+	if (ret < 0) {
+		// e.g. disabled by the kernel or seccomp
+		debug::writef(L"io_uring_queue_init() failed: %d", -ret);
+		return false;
+	}
+	wakeFd = ::eventfd(0, EFD_CLOEXEC);
+	if (wakeFd < 0) {
+		::io_uring_queue_exit(&ring);
+		debug::writeLine(L"eventfd() failed");
+		return false;
+	}
+	return true;
+}
+
+void AsyncReader::Impl::submitUring(UringOp *op)
+{
+	io_uring_sqe *sqe = ::io_uring_get_sqe(&ring);
+	if (sqe == nullptr) {
+		throwTrace<FrameworkError>("io_uring_get_sqe() failed");
+	}
+	::io_uring_prep_read(sqe, static_cast<int>(op->file.getNative()),
+		op->buf.data() + op->done, static_cast<unsigned>(op->buf.size() - op->done),
+		op->done);
+	::io_uring_sqe_set_data(sqe, op);
+	int ret = ::io_uring_submit(&ring);
+	if (ret < 0) {
+		throwTrace<error::Win32Error>("io_uring_submit() failed", static_cast<uint32_t>(-ret));
+	}
+}
+
+void AsyncReader::Impl::armWake()
+{
+	// depth + 1 entries: always available
+	io_uring_sqe *sqe = ::io_uring_get_sqe(&ring);
+	ASSERT(sqe != nullptr);
+	::io_uring_prep_read(sqe, wakeFd, &wakeBuf, sizeof(wakeBuf), 0);
+	::io_uring_sqe_set_data(sqe, nullptr);
+	::io_uring_submit(&ring);
+}
+
+bool AsyncReader::Impl::startUring(AsyncRequest &&req)
+{
+	std::unique_ptr<UringOp> op;
+	try {
+		std::wstring path;
+		if (s_fileLoader == nullptr || !s_fileLoader->getRealPath(req.fileName.c_str(), &path)) {
+			// archive entry etc. (blocking)
+			Bytes bin = loadFile(req.fileName.c_str());
+			complete(req.callback, std::move(bin), nullptr);
+			return false;
+		}
+		op = std::make_unique<UringOp>();
+		op->callback = std::move(req.callback);
+		op->file = platform::FileHandle::openRead(path.c_str(), platform::AccessHint::Sequential);
+		uint64_t fileSize = op->file.getSize();
+		if (fileSize > FileSizeMax) {
+			throwTrace<FrameworkError>("File size is too large");
+		}
+		if (fileSize == 0) {
+			complete(op->callback, Bytes(), nullptr);
+			return false;
+		}
+		op->buf.resize(static_cast<size_t>(fileSize));
+		submitUring(op.get());
+		// owned by the ring until completion
+		op.release();
+		return true;
+	}
+	catch (...) {
+		complete((op != nullptr) ? op->callback : req.callback,
+			Bytes(), std::current_exception());
+		return false;
+	}
+}
+
+void AsyncReader::Impl::uringMain()
+{
+	platform::setThreadName(L"Async reader I/O");
+	armWake();
+	while (true) {
+		// issue reads up to depth
+		{
+			std::unique_lock<std::mutex> lk(lock);
+			while (inFlight < depth && !queue.empty()) {
+				AsyncRequest req = std::move(queue.front());
+				queue.pop_front();
+				countInFlight();
+				lk.unlock();
+				bool pending = startUring(std::move(req));
+				lk.lock();
+				if (!pending) {
+					inFlight--;
+				}
+			}
+			if (stop && queue.empty() && inFlight == 0) {
+				return;
+			}
+		}
+		// wait for a completion or wake()
+		io_uring_cqe *cqe = nullptr;
+		if (::io_uring_wait_cqe(&ring, &cqe) < 0) {
+			// EINTR
+			continue;
+		}
+		auto *op = static_cast<UringOp *>(::io_uring_cqe_get_data(cqe));
+		int res = cqe->res;
+		::io_uring_cqe_seen(&ring, cqe);
+		if (op == nullptr) {
+			armWake();
+			continue;
+		}
+		std::exception_ptr error;
+		try {
+			if (res < 0) {
+				throwTrace<error::Win32Error>("io_uring read failed", static_cast<uint32_t>(-res));
+			}
+			op->done += static_cast<size_t>(res);
+			if (res > 0 && op->done < op->buf.size()) {
+				submitUring(op);
+				continue;
+			}
+			// shorter if truncated after getSize()
+			op->buf.resize(op->done);
+		}
+		catch (...) {
+			error = std::current_exception();
+			op->buf.clear();
+		}
+		std::unique_ptr<UringOp> owner(op);
+		owner->file.close();
+		complete(owner->callback, std::move(owner->buf), error);
+		{
+			std::lock_guard<std::mutex> lk(lock);
+			inFlight--;
+		}
+	}
+}
+#endif
+
+void AsyncReader::Impl::wake(bool all)
+{
+#ifdef _WIN32
+	if (backend == Backend::Iocp) {
+		::PostQueuedCompletionStatus(hPort.get(), 0, WakeKey, nullptr);
+		return;
+	}
+#endif
+#ifdef YAPPY_HAVE_LIBURING
+	if (backend == Backend::IoUring) {
+		uint64_t one = 1;
+		ssize_t ret = ::write(wakeFd, &one, sizeof(one));
+		(void)ret;
+		return;
+	}
+#endif
+	if (all) {
+		cond.notify_all();
+	}
+	else {
+		cond.notify_one();
+	}
+}
+
+AsyncReader::AsyncReader(uint32_t queueDepth, Backend backend) :
+	m_impl(std::make_unique<Impl>())
+{
+	m_impl->depth = std::max(queueDepth, 1u);
+#ifdef _WIN32
+	m_impl->backend = (backend == Backend::Auto) ? Backend::Iocp : backend;
+#else
+	// no IOCP
+	if (backend == Backend::Iocp) {
+		throwTrace<FrameworkError>("AsyncReader: IOCP backend is Windows only");
+	}
+	m_impl->backend = Backend::ThreadPool;
+#ifdef YAPPY_HAVE_LIBURING
+	if ((backend == Backend::Auto || backend == Backend::IoUring) && m_impl->initUring()) {
+		m_impl->backend = Backend::IoUring;
+	}
+#endif
+#endif
+	Impl *impl = m_impl.get();
+#ifdef _WIN32
+	if (impl->backend == Backend::Iocp) {
+		HANDLE tmphPort = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+		checkWin32Result(tmphPort != nullptr, "CreateIoCompletionPort() failed");
+		impl->hPort.reset(tmphPort);
+		impl->threads.emplace_back([impl]() { impl->iocpMain(); });
+		return;
+	}
+#endif
+#ifdef YAPPY_HAVE_LIBURING
+	if (impl->backend == Backend::IoUring) {
+		try {
+			impl->threads.emplace_back([impl]() { impl->uringMain(); });
+		}
+		catch (...) {
+			::io_uring_queue_exit(&impl->ring);
+			::close(impl->wakeFd);
+			throw;
+		}
+		return;
+	}
+#endif
+	for (uint32_t i = 0; i < impl->depth; i++) {
+		impl->threads.emplace_back([impl]() { impl->poolMain(); });
+	}
+}
+
+AsyncReader::~AsyncReader()
+{
+	{
+		std::lock_guard<std::mutex> lk(m_impl->lock);
+		m_impl->stop = true;
+	}
+	m_impl->wake(true);
+	for (auto &th : m_impl->threads) {
+		th.join();
+	}
+#ifdef YAPPY_HAVE_LIBURING
+	if (m_impl->backend == Backend::IoUring) {
+		// cancels the wake read
+		::io_uring_queue_exit(&m_impl->ring);
+		::close(m_impl->wakeFd);
+	}
+#endif
+}
+
+void AsyncReader::read(const wchar_t *fileName, Callback callback)
+{
+	// in submission order
+	traceAccess(fileName);
+	{
+		std::lock_guard<std::mutex> lk(m_impl->lock);
+		m_impl->queue.emplace_back(AsyncRequest{ fileName, std::move(callback) });
+	}
+	m_impl->wake(false);
+}
+
+std::future<Bytes> AsyncReader::read(const wchar_t *fileName)
+{
+	auto promise = std::make_shared<std::promise<Bytes>>();
+	std::future<Bytes> future = promise->get_future();
+	read(fileName, [promise](Bytes &&bin, std::exception_ptr error) {
+		if (error) {
+			promise->set_exception(error);
+		}
+		else {
+			promise->set_value(std::move(bin));
+		}
+	});
+	return future;
+}
+
+std::vector<std::future<Bytes>> AsyncReader::readBatch(const std::vector<std::wstring> &fileNames)
+{
+	std::vector<std::future<Bytes>> futures;
+	futures.reserve(fileNames.size());
+	for (const auto &name : fileNames) {
+		futures.emplace_back(read(name.c_str()));
+	}
+	return futures;
+}
+
+AsyncReadStats AsyncReader::getStats() const
+{
+	AsyncReadStats stats;
+	stats.completed = m_impl->completed.load();
+	stats.bytes = m_impl->bytes.load();
+	stats.maxInFlight = m_impl->maxInFlight.load();
+	return stats;
+}
+
+AsyncReader::Backend AsyncReader::getBackend() const
+{
+	return m_impl->backend;
+}
+
+AsyncBenchResult benchmarkAsyncRead(const std::vector<std::wstring> &fileNames,
+	uint32_t queueDepth, AsyncReader::Backend backend)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	AsyncBenchResult result;
+	auto start = Clock::now();
+	{
+		AsyncReader reader(queueDepth, backend);
+		for (auto &future : reader.readBatch(fileNames)) {
+			result.bytes += future.get().size();
+		}
+		result.maxInFlight = reader.getStats().maxInFlight;
+		backend = reader.getBackend();
+	}
+	duration<double, std::milli> elapsed = Clock::now() - start;
+	result.ms = elapsed.count();
+	result.mbps = (result.ms > 0.0) ? result.bytes / 1e3 / result.ms : 0.0;
+	debug::writef(L"Async read bench: %s, depth %u, %zu files, %llu bytes, %.3f ms, %.1f MB/s",
+		getBackendName(backend), queueDepth, fileNames.size(), static_cast<unsigned long long>(result.bytes),
+		result.ms, result.mbps);
+	return result;
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// class StreamReader impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region StreamReader
+
+namespace {
+
+const uint64_t NoChunk = std::numeric_limits<uint64_t>::max();
+
+}	// namespace
+
+struct StreamReader::Impl : public std::enable_shared_from_this<StreamReader::Impl> {
+	std::wstring fileName;
+	uint64_t fileSize = 0;
+	uint64_t totalChunks = 0;
+	uint32_t chunkSize = 0;
+	uint32_t chunkCount = 0;
+	// read position (the reading thread only)
+	uint64_t pos = 0;
+
+	std::mutex lock;
+	// wakes read()
+	std::condition_variable readyCond;
+	// chunk k is in slots[k % chunkCount] if slotChunk[k % chunkCount] == k
+	std::vector<Bytes> slots;
+	std::vector<uint64_t> slotChunk;
+	// read-ahead window [first, first + chunkCount)
+	// a slot in the window is not overwritten
+	uint64_t first = 0;
+	std::exception_ptr error;
+	bool stop = false;
+	// a read-ahead job is in flight
+	bool running = false;
+
+	std::atomic<uint64_t> chunks{ 0 };
+	std::atomic<uint64_t> stalls{ 0 };
+
+	// call with lock: the first chunk not read in the window
+	uint64_t findTarget() const;
+	// call with lock: read chunk target and store it if still in the window
+	void readChunk(std::unique_lock<std::mutex> &lk, uint64_t target);
+	// call with lock: start a read-ahead job if there is a chunk to read
+	void startReadAhead();
+	// job: read chunks until the window is full
+	void readAheadMain();
+	// move the window to chunk k and wait for it
+	const Bytes &waitChunk(uint64_t k);
+};
+
+uint64_t StreamReader::Impl::findTarget() const
+{
+	const uint64_t end = std::min(first + chunkCount, totalChunks);
+	for (uint64_t k = first; k < end; k++) {
+		if (slotChunk[k % chunkCount] != k) {
+			return k;
+		}
+	}
+	return NoChunk;
+}
+
+void StreamReader::Impl::readChunk(std::unique_lock<std::mutex> &lk, uint64_t target)
+{
+	lk.unlock();
+	Bytes bin;
+	std::exception_ptr err;
+	try {
+		bin = loadFileRange(fileName.c_str(), target * chunkSize, chunkSize);
+	}
+	catch (...) {
+		err = std::current_exception();
+	}
+	lk.lock();
+	if (err) {
+		error = err;
+	}
+	else if (target >= first && target < first + chunkCount &&
+		slotChunk[target % chunkCount] != target) {
+		// not if the window has moved away (seek)
+		slots[target % chunkCount] = std::move(bin);
+		slotChunk[target % chunkCount] = target;
+		chunks.fetch_add(1);
+	}
+	readyCond.notify_all();
+}
+
+void StreamReader::Impl::startReadAhead()
+{
+	jobs::JobSystem *jobs = s_jobs.load();
+	if (running || stop || error || jobs == nullptr || findTarget() == NoChunk) {
+		return;
+	}
+	// the job waits for the lock
+	running = true;
+	try {
+		std::shared_ptr<Impl> self = shared_from_this();
+		jobs->run([self]() { self->readAheadMain(); });
+	}
+	catch (...) {
+		running = false;
+		throw;
+	}
+}
+
+void StreamReader::Impl::readAheadMain()
+{
+	std::unique_lock<std::mutex> lk(lock);
+	while (!stop && !error) {
+		uint64_t target = findTarget();
+		if (target == NoChunk) {
+			break;
+		}
+		readChunk(lk, target);
+	}
+	// no thread while the window is full
+	running = false;
+	readyCond.notify_all();
+}
+
+const Bytes &StreamReader::Impl::waitChunk(uint64_t k)
+{
+	std::unique_lock<std::mutex> lk(lock);
+	first = k;
+	const size_t slot = static_cast<size_t>(k % chunkCount);
+	if (slotChunk[slot] != k) {
+		stalls.fetch_add(1);
+	}
+	while (slotChunk[slot] != k) {
+		if (error) {
+			std::rethrow_exception(error);
+		}
+		startReadAhead();
+		if (running) {
+			// k is the first target of the job
+			readyCond.wait(lk);
+		}
+		else {
+			// no job system
+			readChunk(lk, k);
+		}
+	}
+	// read ahead the rest of the window
+	startReadAhead();
+	// the read-ahead job does not write this slot while first == k
+	return slots[slot];
+}
+
+StreamReader::StreamReader(const wchar_t *fileName, uint32_t chunkSize, uint32_t chunkCount) :
+	m_impl(std::make_shared<Impl>())
+{
+	Impl *impl = m_impl.get();
+	impl->fileName = fileName;
+	impl->fileSize = getFileSize(fileName);
+	impl->chunkSize = std::max(chunkSize, 1u);
+	impl->chunkCount = std::max(chunkCount, 2u);
+	impl->totalChunks = (impl->fileSize + impl->chunkSize - 1) / impl->chunkSize;
+	impl->slots.resize(impl->chunkCount);
+	impl->slotChunk.resize(impl->chunkCount, NoChunk);
+	// read-ahead starts at the first read()
+}
+
+StreamReader::~StreamReader()
+{
+	// the job in flight stops after the current chunk and releases Impl
+	std::lock_guard<std::mutex> lk(m_impl->lock);
+	m_impl->stop = true;
+}
+
+uint64_t StreamReader::size() const
+{
+	return m_impl->fileSize;
+}
+
+uint64_t StreamReader::tell() const
+{
+	return m_impl->pos;
+}
+
+void StreamReader::seek(uint64_t pos)
+{
+	m_impl->pos = std::min(pos, m_impl->fileSize);
+}
+
+size_t StreamReader::read(void *buf, size_t size)
+{
+	Impl *impl = m_impl.get();
+	uint8_t *out = static_cast<uint8_t *>(buf);
+	size_t done = 0;
+	while (done < size && impl->pos < impl->fileSize) {
+		const uint64_t k = impl->pos / impl->chunkSize;
+		const Bytes &chunk = impl->waitChunk(k);
+		const size_t offset = static_cast<size_t>(impl->pos - k * impl->chunkSize);
+		if (offset >= chunk.size()) {
+			// file is shorter than getFileSize()
+			break;
+		}
+		const size_t count = std::min(size - done, chunk.size() - offset);
+		std::memcpy(out + done, chunk.data() + offset, count);
+		done += count;
+		impl->pos += count;
+	}
+	return done;
+}
+
+size_t StreamReader::getMemorySize() const
+{
+	return static_cast<size_t>(m_impl->chunkSize) * m_impl->chunkCount;
+}
+
+StreamReadStats StreamReader::getStats() const
+{
+	StreamReadStats stats;
+	stats.chunks = m_impl->chunks.load();
+	stats.stalls = m_impl->stalls.load();
+	return stats;
+}
+
+#pragma endregion
+
+}	// namespace file
+}	// namespace yappy
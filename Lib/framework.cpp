@@ -1,626 +1,1031 @@
-﻿#include "stdafx.h"
-#include "include/framework.h"
-#include "include/debug.h"
-#include "include/exceptions.h"
-#include <random>
-
-namespace yappy {
-namespace framework {
-
-using error::checkWin32Result;
-
-namespace random {
-
-namespace {
-std::random_device s_randomDevice;
-std::mt19937 s_mt;
-}	// namespace
-
-unsigned int generateRandomSeed()
-{
-	return s_randomDevice();
-}
-
-void setSeed(unsigned int seed)
-{
-	s_mt.seed(seed);
-}
-
-unsigned int nextRawUInt32()
-{
-	return s_mt();
-}
-
-int nextInt(int a, int b)
-{
-	std::uniform_int_distribution<int> dist(a, b);
-	return dist(s_mt);
-}
-
-double nextDouble(double a, double b)
-{
-	std::uniform_real_distribution<double> dist(a, b);
-	return dist(s_mt);
-}
-
-}	// namespace random
-
-namespace scene {
-
-///////////////////////////////////////////////////////////////////////////////
-// class AsyncLoadScene impl
-///////////////////////////////////////////////////////////////////////////////
-#pragma region AsyncLoadScene
-
-AsyncLoadScene::~AsyncLoadScene()
-{
-	// set cancel flag
-	m_cancel.store(true);
-	// m_future destructor will wait for sub thread
-}
-
-void AsyncLoadScene::update()
-{
-	updateLoadStatus();
-	updateOnMainThread();
-}
-
-void AsyncLoadScene::startLoadThread()
-{
-	if (m_future.valid()) {
-		throwTrace<std::logic_error>("Async task is already running");
-	}
-	// move assign
-	m_future = std::async(std::launch::async, [this]() {
-		// can throw an exception
-		loadOnSubThread(m_cancel);
-	});
-}
-
-void AsyncLoadScene::updateLoadStatus()
-{
-	if (m_future.valid()) {
-		auto status = m_future.wait_for(std::chrono::seconds(0));
-		switch (status) {
-		case std::future_status::ready:
-			// complete or exception
-			// make m_future invalid
-			// if an exception is thrown in sub thread, throw it
-			m_future.get();
-			break;
-		case std::future_status::timeout:
-			// not yet
-			break;
-		default:
-			ASSERT(false);
-		}
-	}
-}
-
-bool AsyncLoadScene::isLoading() const
-{
-	return m_future.valid();
-}
-
-}	// namespace scene
-
-#pragma endregion
-
-std::vector<std::wstring> parseCommandLine()
-{
-	// get as const pointer
-	const WCHAR *cmdline = ::GetCommandLineW();
-
-	// covert to argc, argv
-	// "quoted string including spaces" will be resolved
-	int argc = -1;
-	WCHAR **tmpArgv = ::CommandLineToArgvW(cmdline, &argc);
-	checkWin32Result(tmpArgv != nullptr, "CommandLineToArgvW() failed");
-	// use unique_ptr<T[]> for operator []
-	// LocalFree() instead of delete[]
-	auto del = [](WCHAR **ptr) {
-		::LocalFree(ptr);
-	};
-	std::unique_ptr<WCHAR *[], decltype(del)> argv(tmpArgv, del);
-
-	std::vector<std::wstring> result(&argv[0], &argv[argc]);
-	return result;
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// class ResourceManager impl
-///////////////////////////////////////////////////////////////////////////////
-#pragma region ResourceManager
-
-ResourceManager::ResourceManager(size_t resSetCount) :
-	m_texMapVec(resSetCount),
-	m_fontMapVec(resSetCount),
-	m_seMapVec(resSetCount),
-	m_bgmMapVec(resSetCount)
-{}
-
-namespace {
-
-template <class T, class U>
-void addResource(ResourceManager::ResMapVec<T> *targetMapVec, bool locked,
-	size_t setId, const char * resId, std::function<U> loadFunc)
-{
-	if (locked) {
-		throwTrace<std::logic_error>("Resource is not allowed to be added now");
-	}
-
-	IdString fixedResId;
-	util::createFixedString(&fixedResId, resId);
-	std::unordered_map<IdString, Resource<T>> &map =
-		targetMapVec->at(setId);
-	if (map.count(fixedResId) != 0) {
-		throwTrace<std::invalid_argument>(std::string("Resource ID already exists: ") + resId);
-	}
-	// key = IdString(fixedResId)
-	// value = Resource<T>(loadfunc)
-	map.emplace(std::piecewise_construct,
-		std::forward_as_tuple(fixedResId),
-		std::forward_as_tuple(loadFunc));
-}
-
-}	// namespace
-
-void ResourceManager::addTexture(size_t setId, const char * resId,
-	std::function<graphics::DGraphics::TextureResourcePtr()> loadFunc)
-{
-	addResource(&m_texMapVec, m_sealed, setId, resId, loadFunc);
-}
-
-void ResourceManager::addFont(size_t setId, const char *resId,
-	std::function<graphics::DGraphics::FontResourcePtr()> loadFunc)
-{
-	addResource(&m_fontMapVec, m_sealed, setId, resId, loadFunc);
-}
-
-void ResourceManager::addSoundEffect(size_t setId, const char *resId,
-	std::function<sound::XAudio2::SeResourcePtr()> loadFunc)
-{
-	addResource(&m_seMapVec, m_sealed, setId, resId, loadFunc);
-}
-
-void ResourceManager::addBgm(size_t setId, const char *resId,
-	std::function<sound::XAudio2::BgmResourcePtr()> loadFunc)
-{
-	addResource(&m_bgmMapVec, m_sealed, setId, resId, loadFunc);
-}
-
-void ResourceManager::setSealed(bool seal)
-{
-	m_sealed = seal;
-}
-
-bool ResourceManager::isSealed()
-{
-	return m_sealed;
-}
-
-namespace {
-
-template <class T>
-void loadAll(ResourceManager::ResMapVec<T> *targetMapVec, size_t setId, std::atomic_bool &cancel)
-{
-	for (auto &elem : targetMapVec->at(setId)) {
-		if (cancel.load()) {
-			break;
-		}
-		elem.second.load();
-	}
-}
-
-template <class T>
-void unloadAll(ResourceManager::ResMapVec<T> *targetMapVec, size_t setId)
-{
-	for (auto &elem : targetMapVec->at(setId)) {
-		elem.second.unload();
-	}
-}
-
-}	// namespace
-
-void ResourceManager::loadResourceSet(size_t setId, std::atomic_bool &cancel)
-{
-	loadAll(&m_texMapVec, setId, cancel);
-	loadAll(&m_fontMapVec, setId, cancel);
-	loadAll(&m_seMapVec, setId, cancel);
-	loadAll(&m_bgmMapVec, setId, cancel);
-}
-
-void ResourceManager::unloadResourceSet(size_t setId)
-{
-	unloadAll(&m_texMapVec, setId);
-	unloadAll(&m_fontMapVec, setId);
-	unloadAll(&m_seMapVec, setId);
-	unloadAll(&m_bgmMapVec, setId);
-}
-
-namespace {
-
-template <class T>
-const typename Resource<T>::PtrType getResource(
-	const std::vector<std::unordered_map<IdString, Resource<T>>> &mapVec,
-	size_t setId, const char *resId)
-{
-	IdString fixedResId;
-	util::createFixedString(&fixedResId, resId);
-	auto &map = mapVec.at(setId);
-	if (map.count(fixedResId) == 0) {
-		throwTrace<std::invalid_argument>(std::string("Resource ID not found: ") + resId);
-	}
-	return map.at(fixedResId).getPtr();
-}
-
-}
-
-const graphics::DGraphics::TextureResourcePtr ResourceManager::getTexture(
-	size_t setId, const char *resId) const
-{
-	return getResource(m_texMapVec, setId, resId);
-}
-
-const graphics::DGraphics::FontResourcePtr ResourceManager::getFont(
-	size_t setId, const char *resId) const
-{
-	return getResource(m_fontMapVec, setId, resId);
-}
-
-const sound::XAudio2::SeResourcePtr ResourceManager::getSoundEffect(
-	size_t setId, const char *resId) const
-{
-	return getResource(m_seMapVec, setId, resId);
-}
-
-const sound::XAudio2::BgmResourcePtr ResourceManager::getBgm(
-	size_t setId, const char *resId) const
-{
-	return getResource(m_bgmMapVec, setId, resId);
-}
-
-#pragma endregion
-
-///////////////////////////////////////////////////////////////////////////////
-// class FrameControl impl
-///////////////////////////////////////////////////////////////////////////////
-#pragma region FrameControl
-
-namespace {
-
-inline int64_t getTimeCounter()
-{
-	LARGE_INTEGER cur;
-	BOOL b = ::QueryPerformanceCounter(&cur);
-	checkWin32Result(b != 0, "QueryPerformanceCounter() failed");
-	return cur.QuadPart;
-}
-
-}	// namespace
-
-FrameControl::FrameControl(uint32_t fps, uint32_t skipCount) :
-	m_skipCount(skipCount),
-	m_fpsPeriod(fps)
-{
-	// counter/sec
-	LARGE_INTEGER freq;
-	BOOL b = ::QueryPerformanceFrequency(&freq);
-	checkWin32Result(b != FALSE, "QueryPerformanceFrequency() failed");
-	m_freq = freq.QuadPart;
-
-	// counter/frame = (counter/sec) / (frame/sec)
-	//               = m_freq / fps
-	m_counterPerFrame = m_freq / fps;
-}
-
-bool FrameControl::shouldSkipFrame() const
-{
-	return m_frameCount != 0;
-}
-
-void FrameControl::endFrame()
-{
-	// for fps calc
-	if (!shouldSkipFrame()) {
-		m_fpsFrameAcc++;
-	}
-
-	int64_t target = m_base + m_counterPerFrame;
-	int64_t cur = getTimeCounter();
-	if (m_base == 0) {
-		// force OK
-		m_base = cur;
-	}
-	else if (cur < target) {
-		// OK, wait for next frame
-		while (cur < target) {
-			::Sleep(1);
-			cur = getTimeCounter();
-		}
-		// may overrun a little bit, add it to next frame
-		m_base = target;
-	}
-	else {
-		// too late, probably immediately right after vsync
-		m_base = cur;
-	}
-
-	// m_frameCount++;
-	// m_frameCount %= (#draw(=1) + #skip)
-	m_frameCount = (m_frameCount + 1) % (1 + m_skipCount);
-
-	// for fps calc
-	m_fpsCount++;
-	if (m_fpsCount >= m_fpsPeriod) {
-		double sec = static_cast<double>(cur - m_fpsBase) / m_freq;
-		m_fps = m_fpsFrameAcc / sec;
-
-		m_fpsCount = 0;
-		m_fpsFrameAcc = 0;
-		m_fpsBase = cur;
-	}
-}
-
-double FrameControl::getFramePerSec() const
-{
-	return m_fps;
-}
-
-#pragma endregion
-
-///////////////////////////////////////////////////////////////////////////////
-// class Application impl
-///////////////////////////////////////////////////////////////////////////////
-#pragma region Application
-
-Application::Application(const AppParam &appParam,
-	const graphics::GraphicsParam &graphParam,
-	size_t resSetCount) :
-	m_hWnd(nullptr),
-	m_resMgr(resSetCount),
-	m_param(appParam),
-	m_graphParam(graphParam),
-	m_frameCtrl(graphParam.refreshRate, appParam.frameSkip)
-{
-	// window
-	initializeWindow();
-	m_graphParam.hWnd = m_hWnd;
-
-	// DirectGraphics
-	auto *tmpDg = new graphics::DGraphics(m_graphParam);
-	m_dg.reset(tmpDg);
-	// XAudio2
-	auto *tmpXa2 = new sound::XAudio2();
-	m_ds.reset(tmpXa2);
-	// DirectInput
-	auto *tmpDi = new input::DInput(m_param.hInstance, m_hWnd);
-	m_di.reset(tmpDi);
-}
-
-void Application::initializeWindow()
-{
-	debug::writeLine(L"Initializing window...");
-
-	// Register class
-	WNDCLASSEX cls = { 0 };
-	cls.cbSize = sizeof(WNDCLASSEX);
-	cls.style = 0;
-	cls.lpfnWndProc = wndProc;
-	cls.cbClsExtra = 0;
-	cls.cbWndExtra = 0;
-	cls.hInstance = m_param.hInstance;
-	cls.hIcon = m_param.hIcon;
-	cls.hCursor = LoadCursor(NULL, IDC_ARROW);
-	cls.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_BTNFACE + 1);
-	cls.lpszMenuName = nullptr;
-	cls.lpszClassName = m_param.wndClsName;
-	cls.hIconSm = m_param.hIconSm;
-	checkWin32Result(::RegisterClassEx(&cls) != 0, "RegisterClassEx() failed");
-
-	const DWORD wndStyle = WS_OVERLAPPEDWINDOW & ~WS_SIZEBOX & ~WS_MAXIMIZEBOX;
-
-	RECT rc = { 0, 0, m_graphParam.w, m_graphParam.h };
-	checkWin32Result(::AdjustWindowRect(&rc, wndStyle, FALSE) != FALSE,
-		"AdjustWindowRect() failed");
-
-	m_hWnd = ::CreateWindow(m_param.wndClsName, m_param.title, wndStyle,
-		CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top,
-		nullptr, nullptr, m_param.hInstance, this);
-	checkWin32Result(m_hWnd != nullptr, "CreateWindow() failed");
-
-	// for frame processing while window drugging etc.
-	::SetTimer(m_hWnd, TimerEventId, 1, nullptr);
-
-	// Show cursor
-	if (m_param.showCursor) {
-		while (::ShowCursor(TRUE) < 0);
-	}
-	else {
-		while (::ShowCursor(FALSE) >= 0);
-	}
-
-	debug::writeLine(L"Initializing window OK");
-}
-
-Application::~Application()
-{
-	debug::writeLine(L"Finalize Application Window");
-	if (m_hWnd != nullptr) {
-		::DestroyWindow(m_hWnd);
-		m_hWnd = nullptr;
-	}
-}
-
-LRESULT CALLBACK Application::wndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
-{
-	if (msg == WM_CREATE) {
-		// Associate this ptr with hWnd
-		void *userData = reinterpret_cast<LPCREATESTRUCT>(lParam)->lpCreateParams;
-		::SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(userData));
-	}
-
-	LONG_PTR user = ::GetWindowLongPtr(hWnd, GWLP_USERDATA);
-	Application *self = reinterpret_cast<Application *>(user);
-
-	switch (msg) {
-	case WM_TIMER:
-		self->onIdle();
-		return 0;
-	case WM_SIZE:
-		return self->onSize(hWnd, msg, wParam, lParam);
-	case WM_DESTROY:
-		self->m_hWnd = nullptr;
-		PostQuitMessage(0);
-		return 0;
-	}
-	return ::DefWindowProc(hWnd, msg, wParam, lParam);
-}
-
-LRESULT Application::onSize(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
-{
-	return m_dg->onSize(hWnd, msg, wParam, lParam);
-}
-
-// main work
-// update(), then draw() if FrameControl allowed
-void Application::onIdle()
-{
-	updateInternal();
-	if (!m_frameCtrl.shouldSkipFrame()) {
-		renderInternal();
-	}
-	m_frameCtrl.endFrame();
-
-	// fps
-	wchar_t buf[256] = { 0 };
-	swprintf_s(buf, L"%s fps=%.2f (%d)", m_param.title,
-		m_frameCtrl.getFramePerSec(), m_param.frameSkip);
-	::SetWindowText(m_hWnd, buf);
-}
-
-void Application::updateInternal()
-{
-	m_ds->processFrame();
-	m_di->processFrame();
-	// Call user code
-	update();
-}
-
-void Application::renderInternal()
-{
-	// TEST: frame skip
-	/*
-	uint32_t skip = 3;
-	::Sleep(17 * skip);
-	//*/
-
-	// Call user code
-	render();
-
-	m_dg->render();
-}
-
-int Application::run()
-{
-	// Call user code
-	init();
-
-	::ShowWindow(m_hWnd, m_param.nCmdShow);
-	::UpdateWindow(m_hWnd);
-
-	MSG msg = { 0 };
-	while (msg.message != WM_QUIT) {
-		if (::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-			::TranslateMessage(&msg);
-			::DispatchMessage(&msg);
-		}
-		else {
-			// main work
-			onIdle();
-		}
-	}
-	return static_cast<int>(msg.wParam);
-}
-
-
-void Application::addTextureResource(size_t setId, const char *resId, const wchar_t *path)
-{
-	std::wstring pathCopy(path);
-	m_resMgr.addTexture(setId, resId, [this, pathCopy]() {
-		yappy::debug::writef(L"LoadTexture: %s", pathCopy.c_str());
-		return m_dg->loadTexture(pathCopy.c_str());
-	});
-}
-
-void Application::addFontResource(size_t setId, const char *resId,
-	const wchar_t *fontName, uint32_t startChar, uint32_t endChar,
-	uint32_t w, uint32_t h)
-{
-	std::wstring fontNameCopy(fontName);
-	m_resMgr.addFont(setId, resId, [this, fontNameCopy, startChar, endChar, w, h]() {
-		yappy::debug::writef(L"CreateFont: %s", fontNameCopy.c_str());
-		return m_dg->loadFont(fontNameCopy.c_str(), startChar, endChar, w, h);
-	});
-}
-
-void Application::addSeResource(size_t setId, const char *resId, const wchar_t *path)
-{
-	std::wstring pathCopy(path);
-	m_resMgr.addSoundEffect(setId, resId, [this, pathCopy]() {
-		yappy::debug::writef(L"LoadSoundEffect: %s", pathCopy.c_str());
-		return m_ds->loadSoundEffect(pathCopy.c_str());
-	});
-}
-
-void Application::addBgmResource(size_t setId, const char *resId, const wchar_t *path)
-{
-	std::wstring pathCopy(path);
-	m_resMgr.addBgm(setId, resId, [this, pathCopy]() {
-		yappy::debug::writef(L"LoadBgm: %s", pathCopy.c_str());
-		return m_ds->loadBgm(pathCopy.c_str());
-	});
-}
-
-void Application::sealResource(bool seal)
-{
-	m_resMgr.setSealed(seal);
-}
-
-void Application::loadResourceSet(size_t setId, std::atomic_bool &cancel)
-{
-	m_resMgr.loadResourceSet(setId, cancel);
-}
-void Application::unloadResourceSet(size_t setId)
-{
-	m_resMgr.unloadResourceSet(setId);
-}
-
-const graphics::DGraphics::TextureResourcePtr Application::getTexture(
-	size_t setId, const char *resId) const
-{
-	return m_resMgr.getTexture(setId, resId);
-}
-
-const graphics::DGraphics::FontResourcePtr Application::getFont(
-	size_t setId, const char *resId) const
-{
-	return m_resMgr.getFont(setId, resId);
-}
-
-const sound::XAudio2::SeResourcePtr Application::getSoundEffect(
-	size_t setId, const char *resId) const
-{
-	return m_resMgr.getSoundEffect(setId, resId);
-}
-
-const sound::XAudio2::BgmResourcePtr Application::getBgm(
-	size_t setId, const char *resId) const
-{
-	return m_resMgr.getBgm(setId, resId);
-}
-
-#pragma endregion
-
-}	// namespace framework
-}	// namespace yappy
+﻿#include "stdafx.h"
+#include "include/framework.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <random>
+#include <chrono>
+#include <thread>
+
+namespace yappy {
+namespace framework {
+
+using error::checkWin32Result;
+
+namespace random {
+
+namespace {
+std::random_device s_randomDevice;
+std::mt19937 s_mt;
+}	// namespace
+
+unsigned int generateRandomSeed()
+{
+	return s_randomDevice();
+}
+
+void setSeed(unsigned int seed)
+{
+	s_mt.seed(seed);
+}
+
+unsigned int nextRawUInt32()
+{
+	return s_mt();
+}
+
+int nextInt(int a, int b)
+{
+	std::uniform_int_distribution<int> dist(a, b);
+	return dist(s_mt);
+}
+
+double nextDouble(double a, double b)
+{
+	std::uniform_real_distribution<double> dist(a, b);
+	return dist(s_mt);
+}
+
+}	// namespace random
+
+namespace scene {
+
+///////////////////////////////////////////////////////////////////////////////
+// class AsyncLoadScene impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region AsyncLoadScene
+
+AsyncLoadScene::~AsyncLoadScene()
+{
+	cancelAndWait();
+}
+
+void AsyncLoadScene::cancelAndWait()
+{
+	// set cancel flag
+	m_cancel.store(true);
+	// wait for the task
+	if (m_loading) {
+		m_loading = false;
+		try {
+			m_jobs.wait(m_loadCounter);
+		}
+		catch (const std::exception &ex) {
+			debug::writeLine(ex.what());
+		}
+	}
+}
+
+void AsyncLoadScene::update()
+{
+	updateLoadStatus();
+	updateOnMainThread();
+}
+
+void AsyncLoadScene::startLoadThread()
+{
+	if (m_loading) {
+		throwTrace<std::logic_error>("Async task is already running");
+	}
+	m_loading = true;
+	m_jobs.run([this]() {
+		// can throw an exception
+		loadOnSubThread(m_cancel);
+	}, &m_loadCounter);
+}
+
+void AsyncLoadScene::updateLoadStatus()
+{
+	if (m_loading && m_loadCounter.isDone()) {
+		// complete or exception
+		m_loading = false;
+		// if an exception is thrown in sub thread, throw it
+		m_jobs.wait(m_loadCounter);
+	}
+}
+
+bool AsyncLoadScene::isLoading() const
+{
+	return m_loading;
+}
+
+}	// namespace scene
+
+#pragma endregion
+
+std::vector<std::wstring> parseCommandLine()
+{
+	// get as const pointer
+	const WCHAR *cmdline = ::GetCommandLineW();
+
+	// covert to argc, argv
+	// "quoted string including spaces" will be resolved
+	int argc = -1;
+	WCHAR **tmpArgv = ::CommandLineToArgvW(cmdline, &argc);
+	checkWin32Result(tmpArgv != nullptr, "CommandLineToArgvW() failed");
+	// use unique_ptr<T[]> for operator []
+	// LocalFree() instead of delete[]
+	auto del = [](WCHAR **ptr) {
+		::LocalFree(ptr);
+	};
+	std::unique_ptr<WCHAR *[], decltype(del)> argv(tmpArgv, del);
+
+	std::vector<std::wstring> result(&argv[0], &argv[argc]);
+	return result;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class IdleScheduler impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region IdleScheduler
+
+namespace {
+
+// learned cost: decay weight when a step is faster than the estimate
+const double IdleCostDecay = 1.0 / 16.0;
+
+}	// namespace
+
+IdleScheduler::IdleScheduler(int64_t freq) :
+	m_freq(freq)
+{}
+
+IdleScheduler::TaskId IdleScheduler::addTask(const char *name,
+	IdlePriority priority, uint32_t costUs, StepFunc step)
+{
+	TaskId id = m_nextId++;
+	Task task;
+	task.id = id;
+	task.name = name;
+	task.priority = priority;
+	task.cost = static_cast<double>(costUs) * m_freq / 1000000;
+	task.step = std::move(step);
+
+	// keep sorted by priority (stable)
+	auto it = std::upper_bound(m_tasks.begin(), m_tasks.end(), priority,
+		[](IdlePriority prio, const Task &t) { return prio < t.priority; });
+	m_tasks.emplace(it, std::move(task));
+	return id;
+}
+
+void IdleScheduler::removeTask(TaskId id)
+{
+	auto it = std::find_if(m_tasks.begin(), m_tasks.end(),
+		[id](const Task &t) { return t.id == id; });
+	if (it != m_tasks.end()) {
+		m_tasks.erase(it);
+	}
+}
+
+void IdleScheduler::post(IdlePriority priority, uint32_t costUs,
+	std::function<void()> func)
+{
+	Posted posted;
+	posted.cost = static_cast<int64_t>(costUs) * m_freq / 1000000;
+	posted.func = std::move(func);
+
+	std::lock_guard<std::mutex> lock(m_postLock);
+	m_posted.at(static_cast<size_t>(priority)).emplace_back(std::move(posted));
+}
+
+size_t IdleScheduler::getPostedCount() const
+{
+	std::lock_guard<std::mutex> lock(m_postLock);
+	size_t count = 0;
+	for (const auto &queue : m_posted) {
+		count += queue.size();
+	}
+	return count;
+}
+
+void IdleScheduler::run(timer::Clock &clock, int64_t deadline)
+{
+	const double toMs = 1000.0 / m_freq;
+	int64_t start = clock.getCounter();
+	m_stats.slackMs = std::max<int64_t>(deadline - start, 0) * toMs;
+	m_stats.executed = 0;
+	m_stats.deferred = 0;
+
+	for (size_t i = 0; i < PriorityCount; i++) {
+		auto priority = static_cast<IdlePriority>(i);
+		runTasks(clock, deadline, priority);
+		runPosted(clock, deadline, priority);
+	}
+
+	double spent = (clock.getCounter() - start) * toMs;
+	m_stats.spentMs = spent;
+	m_stats.spentTotalMs += spent;
+}
+
+void IdleScheduler::runTasks(timer::Clock &clock, int64_t deadline,
+	IdlePriority priority)
+{
+	for (auto &task : m_tasks) {
+		if (task.priority != priority) {
+			continue;
+		}
+		for (uint32_t n = 0; n < MaxStepsPerFrame; n++) {
+			int64_t before = clock.getCounter();
+			if (before + static_cast<int64_t>(task.cost) > deadline) {
+				m_stats.deferred++;
+				break;
+			}
+			bool more = task.step();
+			int64_t after = clock.getCounter();
+
+			// grow immediately, shrink slowly
+			double cost = static_cast<double>(after - before);
+			if (cost > task.cost) {
+				task.cost = cost;
+			}
+			else {
+				task.cost += IdleCostDecay * (cost - task.cost);
+			}
+			m_stats.executed++;
+			if (after > deadline) {
+				m_stats.overrunTotal++;
+			}
+			if (!more) {
+				break;
+			}
+		}
+	}
+}
+
+void IdleScheduler::runPosted(timer::Clock &clock, int64_t deadline,
+	IdlePriority priority)
+{
+	auto &queue = m_posted.at(static_cast<size_t>(priority));
+	while (true) {
+		Posted posted;
+		{
+			std::lock_guard<std::mutex> lock(m_postLock);
+			if (queue.empty()) {
+				break;
+			}
+			if (clock.getCounter() + queue.front().cost > deadline) {
+				m_stats.deferred += static_cast<uint32_t>(queue.size());
+				break;
+			}
+			posted = std::move(queue.front());
+			queue.pop_front();
+		}
+		// func may post another job
+		posted.func();
+		m_stats.executed++;
+		if (clock.getCounter() > deadline) {
+			m_stats.overrunTotal++;
+		}
+	}
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// class FrameControl impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region FrameControl
+
+namespace {
+
+// adaptive skip: enter skipping mode if estimated load > EnterLoad
+const double SkipEnterLoad = 1.0;
+// adaptive skip: leave skipping mode if estimated load < LeaveLoad
+const double SkipLeaveLoad = 0.85;
+// rolling average weight of the newest sample
+const double CostAlpha = 1.0 / 8.0;
+
+}	// namespace
+
+FrameControl::FrameControl(uint32_t fps, uint32_t skipCount, bool adaptiveSkip,
+	const timer::WaitParam &waitParam, std::unique_ptr<timer::Clock> pClock) :
+	m_clock(pClock != nullptr ? std::move(pClock) : std::make_unique<timer::SystemClock>()),
+	m_waiter(*m_clock, waitParam),
+	m_skipCount(skipCount),
+	m_fpsPeriod(fps),
+	m_timeRing(m_clock->getFrequency()),
+	m_idle(m_clock->getFrequency()),
+	m_adaptiveSkip(adaptiveSkip)
+{
+	// counter/sec
+	m_freq = m_clock->getFrequency();
+
+	// counter/frame = (counter/sec) / (frame/sec)
+	//               = m_freq / fps
+	m_counterPerFrame = m_freq / fps;
+
+	// 0 would never skip in adaptive mode
+	if (m_adaptiveSkip && m_skipCount == 0) {
+		m_skipCount = AdaptiveSkipCountDefault;
+	}
+
+	m_recent.reserve(m_fpsPeriod);
+	m_frameTimes.reserve(m_fpsPeriod);
+	m_skipStats.adaptive = m_adaptiveSkip;
+}
+
+bool FrameControl::shouldSkipFrame() const
+{
+	return m_skipThisFrame;
+}
+
+void FrameControl::endPhase(FramePhase phase)
+{
+	int64_t now = m_clock->getCounter();
+	if (m_phaseBase == 0) {
+		// the first frame
+		m_phaseBase = now;
+		return;
+	}
+	int64_t elapsed = now - m_phaseBase;
+	double cost = static_cast<double>(elapsed);
+	m_phaseBase = now;
+
+	switch (phase) {
+	case FramePhase::Update:
+		m_sample.update += elapsed;
+		m_updateCost += CostAlpha * (cost - m_updateCost);
+		if (m_adaptiveSkip) {
+			decideSkip(now);
+		}
+		break;
+	case FramePhase::Render:
+		m_sample.render += elapsed;
+		m_renderCost += CostAlpha * (cost - m_renderCost);
+		break;
+	case FramePhase::Present:
+		// includes vsync wait, not a cost
+		m_sample.present += elapsed;
+		break;
+	default:
+		ASSERT(false);
+	}
+	m_skipStats.updateCostMs = m_updateCost * 1000.0 / m_freq;
+	m_skipStats.renderCostMs = m_renderCost * 1000.0 / m_freq;
+}
+
+void FrameControl::decideSkip(int64_t now)
+{
+	if (m_base == 0) {
+		return;
+	}
+	// elapsed time from the scheduled frame start
+	// (includes overrun carried from the previous frame)
+	// + expected render cost
+	double load = (now - m_base + m_renderCost) / m_counterPerFrame;
+	m_skipStats.load = load;
+
+	// hysteresis: avoid flip-flopping around the budget
+	if (m_skipping) {
+		m_skipping = (load >= SkipLeaveLoad);
+	}
+	else {
+		m_skipping = (load > SkipEnterLoad);
+	}
+	// render at least once per (1 + skipCount) frames
+	m_skipThisFrame = m_skipping && (m_skipRun < m_skipCount);
+}
+
+void FrameControl::endFrame()
+{
+	// for fps calc
+	if (!shouldSkipFrame()) {
+		m_fpsFrameAcc++;
+	}
+	// for skip stats
+	m_skipStats.history = (m_skipStats.history << 1) | (shouldSkipFrame() ? 1 : 0);
+	if (shouldSkipFrame()) {
+		m_skipAcc++;
+		m_skipRun++;
+	}
+	else {
+		m_skipRun = 0;
+	}
+
+	int64_t target = m_base + m_counterPerFrame;
+	if (m_base != 0) {
+		// deferrable work in the slack
+		// (the spin window of the waiter is left untouched)
+		int64_t idleStart = m_clock->getCounter();
+		m_idle.run(*m_clock, target - m_waiter.getSlack());
+		m_sample.idle = m_clock->getCounter() - idleStart;
+	}
+	int64_t cur = m_clock->getCounter();
+	if (m_base == 0) {
+		// force OK
+		m_base = cur;
+	}
+	else if (cur < target) {
+		// OK, wait for next frame
+		// sleep and then spin (cur >= target)
+		int64_t waitStart = cur;
+		cur = m_waiter.waitUntil(target);
+		m_sample.wait = cur - waitStart;
+		// may overrun a little bit, add it to next frame
+		m_base = target;
+	}
+	else {
+		// too late, probably immediately right after vsync
+		m_base = cur;
+	}
+
+	// m_frameCount++;
+	// m_frameCount %= (#draw(=1) + #skip)
+	m_frameCount = (m_frameCount + 1) % (1 + m_skipCount);
+	// adaptive mode decides at the end of update phase
+	m_skipThisFrame = m_adaptiveSkip ? false : (m_frameCount != 0);
+	// the next frame starts now
+	m_phaseBase = cur;
+
+	// frame time breakdown
+	if (m_prevEnd != 0) {
+		m_sample.total = cur - m_prevEnd;
+		m_timeRing.push(m_sample);
+		if (m_trace) {
+			const double toMs = 1000.0 / m_freq;
+			char buf[128];
+			sprintf_s(buf, "frame t=%.3f u=%.3f r=%.3f p=%.3f i=%.3f w=%.3f",
+				m_sample.total * toMs, m_sample.update * toMs, m_sample.render * toMs,
+				m_sample.present * toMs, m_sample.idle * toMs, m_sample.wait * toMs);
+			trace::write(buf);
+		}
+	}
+	m_sample = timer::FrameTimeSample();
+	m_prevEnd = cur;
+
+	// for fps calc
+	m_fpsCount++;
+	if (m_fpsCount >= m_fpsPeriod) {
+		double sec = static_cast<double>(cur - m_fpsBase) / m_freq;
+		m_fps = m_fpsFrameAcc / sec;
+
+		m_fpsCount = 0;
+		m_fpsFrameAcc = 0;
+		m_fpsBase = cur;
+
+		m_timeRing.copyLatest(&m_recent, m_fpsPeriod);
+		m_frameTimes.clear();
+		for (const auto &sample : m_recent) {
+			m_frameTimes.push_back(sample.total);
+		}
+		timer::calcFrameJitter(&m_jitter, m_frameTimes, m_freq);
+
+		m_skipStats.skipRatio = static_cast<double>(m_skipAcc) / m_fpsPeriod;
+		m_skipAcc = 0;
+	}
+}
+
+double FrameControl::getFramePerSec() const
+{
+	return m_fps;
+}
+
+const timer::FrameJitter &FrameControl::getFrameJitter() const
+{
+	return m_jitter;
+}
+
+const FrameSkipStats &FrameControl::getSkipStats() const
+{
+	return m_skipStats;
+}
+
+void FrameControl::getFrameTimeStats(timer::FrameTimeStats *out, uint32_t window) const
+{
+	m_timeRing.getStats(out, window);
+}
+
+void FrameControl::dumpFrameTime(uint32_t window, double binMs, uint32_t binCount) const
+{
+	char buf[256];
+	auto output = [this, &buf]() {
+		debug::writeLine(buf);
+		if (m_trace) {
+			trace::write(buf);
+		}
+	};
+
+	timer::FrameTimeStats stats;
+	m_timeRing.getStats(&stats, window);
+	sprintf_s(buf, "Frame time (%u frames) [ms]: p50 p95 p99 max", stats.frames);
+	output();
+	auto line = [&buf, &output](const char *name, const timer::Percentiles &p) {
+		sprintf_s(buf, "%-8s %8.3f %8.3f %8.3f %8.3f", name,
+			p.p50Ms, p.p95Ms, p.p99Ms, p.maxMs);
+		output();
+	};
+	line("update", stats.update);
+	line("render", stats.render);
+	line("present", stats.present);
+	line("idle", stats.idle);
+	line("wait", stats.wait);
+	line("total", stats.total);
+
+	std::vector<uint32_t> hist;
+	m_timeRing.getHistogram(&hist, binMs, binCount, window);
+	for (uint32_t i = 0; i < hist.size(); i++) {
+		// skip empty bins
+		if (hist[i] == 0) {
+			continue;
+		}
+		if (i == hist.size() - 1) {
+			sprintf_s(buf, "%7.2f-        %6u", binMs * i, hist[i]);
+		}
+		else {
+			sprintf_s(buf, "%7.2f-%7.2f %6u", binMs * i, binMs * (i + 1), hist[i]);
+		}
+		output();
+	}
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// class Application impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region Application
+
+Application::Application(const AppParam &appParam,
+	const graphics::GraphicsParam &graphParam,
+	size_t resSetCount) :
+	m_hWnd(nullptr),
+	m_resMgr(resSetCount),
+	m_param(appParam),
+	m_graphParam(graphParam),
+	m_frameCtrl(graphParam.refreshRate, appParam.frameSkip, appParam.adaptiveSkip,
+		appParam.frameWait)
+{
+	m_frameCtrl.setTrace(m_param.traceFrameTime);
+	arena::enableHeapCounter();
+	m_heapAllocBase = arena::getHeapAllocCount();
+
+	// window
+	initializeWindow();
+	m_graphParam.hWnd = m_hWnd;
+
+	// DirectGraphics
+	auto *tmpDg = new graphics::DGraphics(m_graphParam);
+	m_dg.reset(tmpDg);
+	// XAudio2
+	auto *tmpXa2 = new sound::XAudio2(m_param.bgmLatencyMs);
+	m_ds.reset(tmpXa2);
+	// DirectInput
+	auto *tmpDi = new input::DInput(m_param.hInstance, m_hWnd);
+	m_di.reset(tmpDi);
+	// Job system
+	m_jobs = std::make_unique<jobs::JobSystem>(m_param.jobWorkers);
+	m_resMgr.setJobSystem(m_jobs.get());
+	file::setJobSystem(m_jobs.get());
+	// Async file reader
+	if (m_param.readQueueDepth != 0) {
+		m_reader = std::make_unique<file::AsyncReader>(m_param.readQueueDepth);
+		m_resMgr.setAsyncReader(m_reader.get());
+	}
+
+	// Idle tasks
+	debug::setFileBuffering(true);
+	idle().addTask("log flush", IdlePriority::Low, 200, []() {
+		debug::flushFileOutput();
+		return false;
+	});
+}
+
+void Application::initializeWindow()
+{
+	debug::writeLine(L"Initializing window...");
+
+	// Register class
+	WNDCLASSEX cls = { 0 };
+	cls.cbSize = sizeof(WNDCLASSEX);
+	cls.style = 0;
+	cls.lpfnWndProc = wndProc;
+	cls.cbClsExtra = 0;
+	cls.cbWndExtra = 0;
+	cls.hInstance = m_param.hInstance;
+	cls.hIcon = m_param.hIcon;
+	cls.hCursor = LoadCursor(NULL, IDC_ARROW);
+	cls.hbrBackground = reinterpret_cast<HBRUSH>(COLOR_BTNFACE + 1);
+	cls.lpszMenuName = nullptr;
+	cls.lpszClassName = m_param.wndClsName;
+	cls.hIconSm = m_param.hIconSm;
+	checkWin32Result(::RegisterClassEx(&cls) != 0, "RegisterClassEx() failed");
+
+	const DWORD wndStyle = WS_OVERLAPPEDWINDOW & ~WS_SIZEBOX & ~WS_MAXIMIZEBOX;
+
+	RECT rc = { 0, 0, m_graphParam.w, m_graphParam.h };
+	checkWin32Result(::AdjustWindowRect(&rc, wndStyle, FALSE) != FALSE,
+		"AdjustWindowRect() failed");
+
+	m_hWnd = ::CreateWindow(m_param.wndClsName, m_param.title, wndStyle,
+		CW_USEDEFAULT, CW_USEDEFAULT, rc.right - rc.left, rc.bottom - rc.top,
+		nullptr, nullptr, m_param.hInstance, this);
+	checkWin32Result(m_hWnd != nullptr, "CreateWindow() failed");
+
+	// for frame processing while window drugging etc.
+	::SetTimer(m_hWnd, TimerEventId, 1, nullptr);
+
+	// Show cursor
+	if (m_param.showCursor) {
+		while (::ShowCursor(TRUE) < 0);
+	}
+	else {
+		while (::ShowCursor(FALSE) >= 0);
+	}
+
+	debug::writeLine(L"Initializing window OK");
+}
+
+Application::~Application()
+{
+	// prefetch jobs refer to m_resMgr and m_jobs is destructed first
+	m_resMgr.cancelAllPrefetch();
+	file::setJobSystem(nullptr);
+
+	debug::setFileBuffering(false);
+	debug::writeLine(L"Finalize Application Window");
+	if (m_hWnd != nullptr) {
+		::DestroyWindow(m_hWnd);
+		m_hWnd = nullptr;
+	}
+}
+
+LRESULT CALLBACK Application::wndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	if (msg == WM_CREATE) {
+		// Associate this ptr with hWnd
+		void *userData = reinterpret_cast<LPCREATESTRUCT>(lParam)->lpCreateParams;
+		::SetWindowLongPtr(hWnd, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(userData));
+	}
+
+	LONG_PTR user = ::GetWindowLongPtr(hWnd, GWLP_USERDATA);
+	Application *self = reinterpret_cast<Application *>(user);
+
+	switch (msg) {
+	case WM_TIMER:
+		self->onIdle();
+		return 0;
+	case WM_SIZE:
+		return self->onSize(hWnd, msg, wParam, lParam);
+	case WM_DESTROY:
+		self->m_hWnd = nullptr;
+		PostQuitMessage(0);
+		return 0;
+	}
+	return ::DefWindowProc(hWnd, msg, wParam, lParam);
+}
+
+LRESULT Application::onSize(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
+{
+	return m_dg->onSize(hWnd, msg, wParam, lParam);
+}
+
+// main work
+// update(), then draw() if FrameControl allowed
+void Application::onIdle()
+{
+	updateInternal();
+	m_frameCtrl.endPhase(FramePhase::Update);
+	if (!m_frameCtrl.shouldSkipFrame()) {
+		renderInternal();
+		m_frameCtrl.endPhase(FramePhase::Render);
+		m_dg->present();
+		m_frameCtrl.endPhase(FramePhase::Present);
+	}
+	m_frameCtrl.endFrame();
+
+	// release per-frame memory
+	arena::threadArena().reset();
+	uint64_t allocCount = arena::getHeapAllocCount();
+	m_heapAllocPerFrame = allocCount - m_heapAllocBase;
+	m_heapAllocBase = allocCount;
+
+	// fps
+	const timer::FrameJitter &jitter = m_frameCtrl.getFrameJitter();
+	const FrameSkipStats &skip = m_frameCtrl.getSkipStats();
+	wchar_t buf[256] = { 0 };
+	int len = swprintf_s(buf, L"%s fps=%.2f (%s%d skip=%.0f%%) sd=%.2fms p99=%.2fms",
+		m_param.title,
+		m_frameCtrl.getFramePerSec(), skip.adaptive ? L"auto:" : L"", m_frameCtrl.getSkipCount(),
+		skip.skipRatio * 100.0, jitter.stddevMs, jitter.p99Ms);
+	// not shown where it cannot be counted
+	if (len > 0 && arena::isHeapCounterAvailable()) {
+		swprintf_s(buf + len, _countof(buf) - len, L" alloc=%llu", m_heapAllocPerFrame);
+	}
+	::SetWindowText(m_hWnd, buf);
+}
+
+void Application::updateInternal()
+{
+	m_resMgr.beginFrame();
+	m_ds->processFrame();
+	m_di->processFrame();
+	// Call user code
+	update();
+}
+
+void Application::renderInternal()
+{
+	// TEST: frame skip
+	/*
+	uint32_t skip = 3;
+	::Sleep(17 * skip);
+	//*/
+
+	// Call user code
+	render();
+
+	m_dg->render();
+}
+
+int Application::run()
+{
+	// Call user code
+	init();
+
+	::ShowWindow(m_hWnd, m_param.nCmdShow);
+	::UpdateWindow(m_hWnd);
+
+	MSG msg = { 0 };
+	while (msg.message != WM_QUIT) {
+		if (::PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+			::TranslateMessage(&msg);
+			::DispatchMessage(&msg);
+		}
+		else {
+			// main work
+			onIdle();
+		}
+	}
+	return static_cast<int>(msg.wParam);
+}
+
+namespace {
+
+void recordManifest(manifest::Recorder &rec, manifest::EntryType type,
+	size_t setId, const char *resId, const wchar_t *path,
+	uint32_t startChar = 0, uint32_t endChar = 0, uint32_t w = 0, uint32_t h = 0)
+{
+	if (!rec.isEnabled()) {
+		return;
+	}
+	manifest::Entry entry;
+	entry.type = type;
+	entry.setId = static_cast<uint32_t>(setId);
+	entry.resId = resId;
+	entry.path = path;
+	entry.startChar = startChar;
+	entry.endChar = endChar;
+	entry.w = w;
+	entry.h = h;
+	rec.record(entry);
+}
+
+}	// namespace
+
+ResourceHandle Application::addTextureResource(size_t setId, const char *resId, const wchar_t *path)
+{
+	std::wstring pathCopy(path);
+	Resource<graphics::DGraphics::TextureResource>::Loader loader;
+	loader.key = pathCopy;
+	loader.fileName = pathCopy;
+	loader.decode = [this, pathCopy](file::FileView &&bin) {
+		yappy::debug::writef(L"LoadTexture: %s", pathCopy.c_str());
+		auto image = std::make_shared<graphics::TextureImage>();
+		graphics::DGraphics::decodeTexture(image.get(), std::move(bin));
+		return [this, image]() {
+			return m_dg->uploadTexture(*image);
+		};
+	};
+	ResourceHandle handle = m_resMgr.add<graphics::DGraphics::TextureResource>(
+		ResourceType::Texture, setId, resId, std::move(loader));
+	recordManifest(m_manifestRec, manifest::EntryType::Texture,
+		setId, resId, path);
+	return handle;
+}
+
+ResourceHandle Application::addFontResource(size_t setId, const char *resId,
+	const wchar_t *fontName, uint32_t startChar, uint32_t endChar,
+	uint32_t w, uint32_t h)
+{
+	std::wstring fontNameCopy(fontName);
+	Resource<graphics::DGraphics::FontResource>::Loader loader;
+	// same glyph images if all parameters are the same
+	loader.key = fontNameCopy + L'/' + std::to_wstring(startChar) + L'-' +
+		std::to_wstring(endChar) + L'/' + std::to_wstring(w) + L'x' + std::to_wstring(h);
+	// no file
+	loader.decode = [this, fontNameCopy, startChar, endChar, w, h](file::FileView &&) {
+		yappy::debug::writef(L"CreateFont: %s", fontNameCopy.c_str());
+		auto image = std::make_shared<graphics::FontImage>();
+		graphics::DGraphics::decodeFont(image.get(),
+			fontNameCopy.c_str(), startChar, endChar, w, h);
+		return [this, image]() {
+			return m_dg->uploadFont(*image);
+		};
+	};
+	ResourceHandle handle = m_resMgr.add<graphics::DGraphics::FontResource>(
+		ResourceType::Font, setId, resId, std::move(loader));
+	recordManifest(m_manifestRec, manifest::EntryType::Font,
+		setId, resId, fontName, startChar, endChar, w, h);
+	return handle;
+}
+
+ResourceHandle Application::addSeResource(size_t setId, const char *resId, const wchar_t *path)
+{
+	std::wstring pathCopy(path);
+	Resource<sound::XAudio2::SeResource>::Loader loader;
+	loader.key = pathCopy;
+	loader.fileName = pathCopy;
+	loader.decode = [pathCopy](file::FileView &&bin) {
+		yappy::debug::writef(L"LoadSoundEffect: %s", pathCopy.c_str());
+		auto res = sound::XAudio2::createSoundEffect(std::move(bin));
+		return [res]() { return res; };
+	};
+	ResourceHandle handle = m_resMgr.add<sound::XAudio2::SeResource>(
+		ResourceType::SoundEffect, setId, resId, std::move(loader));
+	recordManifest(m_manifestRec, manifest::EntryType::SoundEffect,
+		setId, resId, path);
+	return handle;
+}
+
+ResourceHandle Application::addBgmResource(size_t setId, const char *resId, const wchar_t *path)
+{
+	std::wstring pathCopy(path);
+	Resource<sound::XAudio2::BgmResource>::Loader loader;
+	loader.key = pathCopy;
+	// no read stage (streamed while playing)
+	loader.decode = [pathCopy](file::FileView &&) {
+		yappy::debug::writef(L"LoadBgm: %s", pathCopy.c_str());
+		auto res = sound::XAudio2::createBgm(pathCopy.c_str());
+		return [res]() { return res; };
+	};
+	ResourceHandle handle = m_resMgr.add<sound::XAudio2::BgmResource>(
+		ResourceType::Bgm, setId, resId, std::move(loader));
+	recordManifest(m_manifestRec, manifest::EntryType::Bgm,
+		setId, resId, path);
+	return handle;
+}
+
+void Application::sealResource(bool seal)
+{
+	m_resMgr.setSealed(seal);
+}
+
+size_t Application::loadManifest(const wchar_t *fileName)
+{
+	std::vector<manifest::Entry> entries = manifest::load(fileName);
+
+	static_assert(static_cast<size_t>(manifest::EntryType::Count) ==
+		static_cast<size_t>(ResourceType::Count), "EntryType and ResourceType");
+	size_t counts[static_cast<size_t>(ResourceType::Count)] = { 0 };
+	for (const auto &entry : entries) {
+		counts[static_cast<size_t>(entry.type)]++;
+	}
+	for (size_t i = 0; i < static_cast<size_t>(ResourceType::Count); i++) {
+		m_resMgr.reserve(static_cast<ResourceType>(i), counts[i]);
+	}
+
+	UnsealResource autoSeal(*this);
+	for (const auto &entry : entries) {
+		switch (entry.type) {
+		case manifest::EntryType::Texture:
+			addTextureResource(entry.setId, entry.resId.c_str(), entry.path.c_str());
+			break;
+		case manifest::EntryType::Font:
+			addFontResource(entry.setId, entry.resId.c_str(), entry.path.c_str(),
+				entry.startChar, entry.endChar, entry.w, entry.h);
+			break;
+		case manifest::EntryType::SoundEffect:
+			addSeResource(entry.setId, entry.resId.c_str(), entry.path.c_str());
+			break;
+		case manifest::EntryType::Bgm:
+			addBgmResource(entry.setId, entry.resId.c_str(), entry.path.c_str());
+			break;
+		default:
+			ASSERT(false);
+		}
+	}
+	debug::writef(L"Load manifest: %s (%zu entries)", fileName, entries.size());
+	return entries.size();
+}
+
+void Application::startManifestRecording()
+{
+	m_manifestRec.setEnabled(true);
+}
+
+void Application::saveManifest(const wchar_t *path)
+{
+	manifest::save(path, m_manifestRec.getEntries());
+}
+
+void Application::loadResourceSet(size_t setId, std::atomic_bool &cancel,
+	LoadProgress *progress)
+{
+	m_resMgr.loadResourceSet(setId, cancel, progress);
+}
+void Application::unloadResourceSet(size_t setId)
+{
+	m_resMgr.unloadResourceSet(setId);
+}
+
+SetSwitchStats Application::switchResourceSet(size_t fromSet, size_t toSet,
+	std::atomic_bool &cancel, LoadProgress *progress)
+{
+	return m_resMgr.switchResourceSet(fromSet, toSet, cancel, progress);
+}
+
+void Application::prefetchResourceSet(size_t setId, const PrefetchParam &param,
+	LoadProgress *progress)
+{
+	m_resMgr.prefetchResourceSet(setId, param, progress);
+}
+
+void Application::cancelPrefetch(size_t setId)
+{
+	m_resMgr.cancelPrefetch(setId);
+}
+
+bool Application::isPrefetching(size_t setId) const
+{
+	return m_resMgr.isPrefetching(setId);
+}
+
+void Application::setResourceCacheBudget(ResourceType type, size_t bytes)
+{
+	m_resMgr.setCacheBudget(type, bytes);
+}
+
+CacheStats Application::getResourceCacheStats(ResourceType type) const
+{
+	return m_resMgr.getCacheStats(type);
+}
+
+const graphics::DGraphics::TextureResourcePtr Application::getTexture(
+	size_t setId, const char *resId)
+{
+	return m_resMgr.get<graphics::DGraphics::TextureResource>(ResourceType::Texture, setId, resId);
+}
+
+const graphics::DGraphics::FontResourcePtr Application::getFont(
+	size_t setId, const char *resId)
+{
+	return m_resMgr.get<graphics::DGraphics::FontResource>(ResourceType::Font, setId, resId);
+}
+
+const sound::XAudio2::SeResourcePtr Application::getSoundEffect(
+	size_t setId, const char *resId)
+{
+	return m_resMgr.get<sound::XAudio2::SeResource>(ResourceType::SoundEffect, setId, resId);
+}
+
+const sound::XAudio2::BgmResourcePtr Application::getBgm(
+	size_t setId, const char *resId)
+{
+	return m_resMgr.get<sound::XAudio2::BgmResource>(ResourceType::Bgm, setId, resId);
+}
+
+ResourceHandle Application::getResourceHandle(ResourceType type,
+	size_t setId, const char *resId) const
+{
+	return m_resMgr.getHandle(type, setId, resId);
+}
+
+const graphics::DGraphics::TextureResourcePtr Application::getTexture(
+	ResourceHandle handle)
+{
+	return m_resMgr.get<graphics::DGraphics::TextureResource>(ResourceType::Texture, handle);
+}
+
+const graphics::DGraphics::FontResourcePtr Application::getFont(
+	ResourceHandle handle)
+{
+	return m_resMgr.get<graphics::DGraphics::FontResource>(ResourceType::Font, handle);
+}
+
+const sound::XAudio2::SeResourcePtr Application::getSoundEffect(
+	ResourceHandle handle)
+{
+	return m_resMgr.get<sound::XAudio2::SeResource>(ResourceType::SoundEffect, handle);
+}
+
+const sound::XAudio2::BgmResourcePtr Application::getBgm(
+	ResourceHandle handle)
+{
+	return m_resMgr.get<sound::XAudio2::BgmResource>(ResourceType::Bgm, handle);
+}
+
+const graphics::DGraphics::TextureResource *Application::getTextureView(
+	ResourceHandle handle)
+{
+	return m_resMgr.getView<graphics::DGraphics::TextureResource>(ResourceType::Texture, handle);
+}
+
+const graphics::DGraphics::FontResource *Application::getFontView(
+	ResourceHandle handle)
+{
+	return m_resMgr.getView<graphics::DGraphics::FontResource>(ResourceType::Font, handle);
+}
+
+#pragma endregion
+
+}	// namespace framework
+}	// namespace yappy
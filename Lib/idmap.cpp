@@ -0,0 +1,210 @@
+﻿#include "stdafx.h"
+#include "include/idmap.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <algorithm>
+#include <unordered_map>
+#include <random>
+#include <chrono>
+#include <cstdio>
+
+namespace yappy {
+namespace util {
+
+using error::throwTrace;
+using error::FrameworkError;
+
+///////////////////////////////////////////////////////////////////////////////
+// class FrozenIdMap impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region FrozenIdMap
+
+namespace {
+
+// give up a seed search after this count and retry with a larger table
+const uint32_t SeedTryMax = 1u << 16;
+
+inline uint64_t roundUpPow2(uint64_t x)
+{
+	uint64_t result = 1;
+	while (result < x) {
+		result <<= 1;
+	}
+	return result;
+}
+
+}	// namespace
+
+void FrozenIdMap::build(const std::vector<std::pair<IdString, uint32_t>> &entries)
+{
+	clear();
+	if (entries.empty()) {
+		return;
+	}
+	const size_t count = entries.size();
+	std::vector<IdWords> keys;
+	std::vector<uint64_t> hashes;
+	keys.reserve(count);
+	hashes.reserve(count);
+	for (const auto &entry : entries) {
+		keys.emplace_back(entry.first);
+		hashes.emplace_back(hashKey(keys.back()));
+	}
+	// duplicate keys never fit in distinct slots (the seed search would not end)
+	{
+		std::vector<IdWords> sorted(keys);
+		auto less = [](const IdWords &a, const IdWords &b) {
+			return (a.w0 != b.w0) ? (a.w0 < b.w0) : (a.w1 < b.w1);
+		};
+		std::sort(sorted.begin(), sorted.end(), less);
+		if (std::adjacent_find(sorted.begin(), sorted.end()) != sorted.end()) {
+			throwTrace<FrameworkError>("FrozenIdMap: duplicate key");
+		}
+	}
+
+	// about 2 keys per bucket, load factor 0.4 - 0.8
+	uint64_t bucketCount = roundUpPow2((count + 1) / 2);
+	uint64_t slotCount = roundUpPow2(count + count / 4);
+	for (;;) {
+		m_bucketMask = bucketCount - 1;
+		m_slotMask = slotCount - 1;
+
+		// bucket -> key indices, the largest bucket first
+		std::vector<std::vector<uint32_t>> buckets(bucketCount);
+		for (uint32_t i = 0; i < count; i++) {
+			buckets[hashes[i] & m_bucketMask].push_back(i);
+		}
+		std::vector<uint32_t> order(bucketCount);
+		for (uint32_t b = 0; b < bucketCount; b++) {
+			order[b] = b;
+		}
+		std::stable_sort(order.begin(), order.end(), [&buckets](uint32_t a, uint32_t b) {
+			return buckets[a].size() > buckets[b].size();
+		});
+
+		m_seeds.assign(bucketCount, 0);
+		std::vector<bool> used(slotCount, false);
+		std::vector<uint64_t> pos;
+		bool ok = true;
+		for (uint32_t b : order) {
+			const auto &bucket = buckets[b];
+			if (bucket.empty()) {
+				break;
+			}
+			// find a seed which places all keys in this bucket on free slots
+			uint32_t seed = 1;
+			for (; seed <= SeedTryMax; seed++) {
+				pos.clear();
+				bool fit = true;
+				for (uint32_t i : bucket) {
+					uint64_t s = slotIndex(hashes[i], seed);
+					if (used[s] || std::find(pos.begin(), pos.end(), s) != pos.end()) {
+						fit = false;
+						break;
+					}
+					pos.push_back(s);
+				}
+				if (fit) {
+					break;
+				}
+			}
+			if (seed > SeedTryMax) {
+				ok = false;
+				break;
+			}
+			m_seeds[b] = seed;
+			for (uint64_t s : pos) {
+				used[s] = true;
+			}
+		}
+		if (ok) {
+			break;
+		}
+		// retry with a sparser table
+		slotCount *= 2;
+	}
+
+	// empty slot: key "" and NotFound, so that lookup of "" fails there
+	IdString empty = {};
+	m_slots.assign(slotCount, Slot{ IdWords(empty), NotFound });
+	for (uint32_t i = 0; i < count; i++) {
+		uint32_t seed = m_seeds[hashes[i] & m_bucketMask];
+		Slot &slot = m_slots[slotIndex(hashes[i], seed)];
+		slot.key = keys[i];
+		slot.value = entries[i].second;
+	}
+	m_count = count;
+}
+
+void FrozenIdMap::clear()
+{
+	m_count = 0;
+	m_bucketMask = 0;
+	m_slotMask = 0;
+	m_seeds.clear();
+	m_slots.clear();
+}
+
+#pragma endregion
+
+IdMapBenchResult benchmarkIdMap(uint32_t count, uint32_t lookups)
+{
+	using Clock = std::chrono::steady_clock;
+	auto elapsedNs = [](Clock::time_point start) {
+		return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			Clock::now() - start).count());
+	};
+
+	std::vector<std::pair<IdString, uint32_t>> entries;
+	entries.reserve(count);
+	for (uint32_t i = 0; i < count; i++) {
+		char name[16];
+		std::snprintf(name, sizeof(name), "res%05u", i);
+		IdString id;
+		createFixedString(&id, name);
+		entries.emplace_back(id, i);
+	}
+	std::unordered_map<IdString, uint32_t> unordered(entries.begin(), entries.end());
+
+	IdMapBenchResult result;
+	result.count = count;
+	result.lookups = lookups;
+
+	auto start = Clock::now();
+	FrozenIdMap frozen;
+	frozen.build(entries);
+	result.buildMs = elapsedNs(start) / 1e6;
+
+	// same random key sequence for both
+	std::vector<IdString> queries;
+	queries.reserve(lookups);
+	std::mt19937 mt(1);
+	std::uniform_int_distribution<uint32_t> dist(0, count - 1);
+	for (uint32_t i = 0; i < lookups; i++) {
+		queries.emplace_back(entries[dist(mt)].first);
+	}
+
+	// sum of values to keep the loops
+	uint64_t sumUnordered = 0;
+	start = Clock::now();
+	for (const auto &key : queries) {
+		auto it = unordered.find(key);
+		sumUnordered += (it != unordered.end()) ? it->second : 0;
+	}
+	result.unorderedNs = elapsedNs(start) / lookups;
+
+	uint64_t sumFrozen = 0;
+	start = Clock::now();
+	for (const auto &key : queries) {
+		sumFrozen += frozen.find(key);
+	}
+	result.frozenNs = elapsedNs(start) / lookups;
+
+	ASSERT(sumUnordered == sumFrozen);
+	debug::writef(L"IdMap bench: count=%u lookups=%u unordered=%.1fns frozen=%.1fns build=%.2fms",
+		count, lookups, result.unorderedNs, result.frozenNs, result.buildMs);
+	return result;
+}
+
+}	// namespace util
+}	// namespace yappy
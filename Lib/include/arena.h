@@ -0,0 +1,228 @@
+﻿/**@file
+ * @brief Linear (bump) allocator for short-lived objects.
+ * @details
+ * Allocation is a pointer increment and deallocation is a no-op.
+ * Memory is released all at once by reset() or by rewinding to a marker.
+ *
+ * Each thread has its own arena (@ref threadArena()).
+ * The arena of the main thread is reset at the end of every frame by
+ * framework::Application, so memory from it is valid until the frame ends.
+ * Other threads should use @ref ArenaScope to release memory.
+ */
+
+#pragma once
+
+#include "util.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <new>
+
+namespace yappy {
+/// Linear (bump) allocator.
+namespace arena {
+
+/**@brief Linear allocator made of chunks.
+ * @details
+ * If the current chunk is exhausted, the next chunk is used.
+ * Chunks are kept and reused after reset(), so that no heap allocation
+ * happens in steady state.
+ * Not thread-safe.
+ */
+class LinearArena : private util::noncopyable {
+public:
+	/// Default chunk size.
+	static const size_t DefaultChunkSize = 256 * 1024;
+
+	/// Allocation state saved by @ref getMarker().
+	struct Marker {
+		size_t chunk;
+		size_t offset;
+	};
+
+	/**@brief Constructor.
+	 * @details No memory is allocated until the first allocate().
+	 * @param[in]	chunkSize	Chunk size. (Larger requests get a dedicated chunk)
+	 */
+	explicit LinearArena(size_t chunkSize = DefaultChunkSize);
+	~LinearArena() = default;
+
+	/**@brief Allocate memory.
+	 * @param[in]	size	Size in bytes.
+	 * @param[in]	align	Alignment. (power of 2)
+	 * @return		Allocated memory. (never nullptr)
+	 */
+	void *allocate(size_t size, size_t align = alignof(std::max_align_t));
+	/**@brief Allocate and copy a string.
+	 * @param[in]	str	Null-terminated string.
+	 * @return		Copied string.
+	 */
+	char *copyString(const char *str);
+
+	/**@brief Get current allocation state.
+	 */
+	Marker getMarker() const;
+	/**@brief Release all memory allocated after marker.
+	 * @param[in]	marker	Return value of @ref getMarker().
+	 */
+	void rewind(const Marker &marker);
+	/**@brief Release all memory.
+	 * @details Chunks are not freed and will be reused.
+	 */
+	void reset();
+
+	/**@brief Get used size. (including alignment padding)
+	 */
+	size_t getUsed() const { return m_usedPrev + m_offset; }
+	/**@brief Get peak of used size since construction.
+	 */
+	size_t getPeak() const { return m_peak; }
+	/**@brief Get total size of chunks.
+	 */
+	size_t getReserved() const;
+	/**@brief Get count of chunk allocation. (heap allocations by this arena)
+	 */
+	uint64_t getChunkAllocCount() const { return m_chunkAllocCount; }
+
+private:
+	struct Chunk {
+		std::unique_ptr<char[]> buf;
+		size_t size;
+	};
+
+	size_t m_chunkSize;
+	std::vector<Chunk> m_chunks;
+	// current chunk index and offset
+	size_t m_current = 0;
+	size_t m_offset = 0;
+	// total size of m_chunks[0, m_current)
+	size_t m_usedPrev = 0;
+	size_t m_peak = 0;
+	uint64_t m_chunkAllocCount = 0;
+};
+
+/**@brief Get the arena of the current thread.
+ * @details
+ * On the main thread (frame loop) it is reset at the end of every frame.
+ */
+LinearArena &threadArena();
+
+/**@brief Rewind an arena at the end of scope.
+ * @details
+ * @code
+ * {
+ *     ArenaScope scope;
+ *     wchar_t *wstr = arena::utf82wc(str);
+ *     ...
+ * }	// wstr is released here
+ * @endcode
+ */
+class ArenaScope : private util::noncopyable {
+public:
+	/**@brief Save current state.
+	 * @param[in]	arena	Target arena.
+	 */
+	explicit ArenaScope(LinearArena &arena = threadArena()) :
+		m_arena(arena), m_marker(arena.getMarker())
+	{}
+	/**@brief Rewind to the saved state.
+	 */
+	~ArenaScope()
+	{
+		m_arena.rewind(m_marker);
+	}
+
+private:
+	LinearArena &m_arena;
+	LinearArena::Marker m_marker;
+};
+
+/**@brief STL-compatible allocator using LinearArena.
+ * @details
+ * deallocate() does nothing. Memory is released when the arena is reset.
+ * Default constructed allocator uses @ref threadArena() of the constructing thread.
+ * @tparam	T	Value type.
+ */
+template <class T>
+class ArenaAllocator {
+public:
+	using value_type = T;
+
+	ArenaAllocator() noexcept : m_arena(&threadArena()) {}
+	explicit ArenaAllocator(LinearArena &arena) noexcept : m_arena(&arena) {}
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U> &other) noexcept :
+		m_arena(other.getArena())
+	{}
+
+	T *allocate(size_t n)
+	{
+		if (n > static_cast<size_t>(-1) / sizeof(T)) {
+			throw std::bad_alloc();
+		}
+		return static_cast<T *>(m_arena->allocate(sizeof(T) * n, alignof(T)));
+	}
+	void deallocate(T *, size_t) noexcept {}
+
+	LinearArena *getArena() const noexcept { return m_arena; }
+
+private:
+	LinearArena *m_arena;
+};
+
+template <class T, class U>
+inline bool operator==(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) noexcept
+{
+	return lhs.getArena() == rhs.getArena();
+}
+template <class T, class U>
+inline bool operator!=(const ArenaAllocator<T> &lhs, const ArenaAllocator<U> &rhs) noexcept
+{
+	return !(lhs == rhs);
+}
+
+/// std::vector on arena.
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+/// std::string on arena.
+using ArenaString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
+/// std::wstring on arena.
+using ArenaWString = std::basic_string<wchar_t, std::char_traits<wchar_t>, ArenaAllocator<wchar_t>>;
+
+/**@brief Wide char to UTF-8 on arena.
+ * @param[in]	in		Wide char string.
+ * @param[in]	arena	Arena to be used.
+ * @return				UTF-8 string.
+ * @sa @ref util::wc2utf8()
+ */
+char *wc2utf8(const wchar_t *in, LinearArena &arena = threadArena());
+
+/**@brief UTF-8 to wide char on arena.
+ * @param[in]	in		UTF-8 string.
+ * @param[in]	arena	Arena to be used.
+ * @return				Wide char string.
+ * @sa @ref util::utf82wc()
+ */
+wchar_t *utf82wc(const char *in, LinearArena &arena = threadArena());
+
+/**@brief Start counting heap allocations.
+ * @details
+ * - YAPPY_HEAP_COUNTER (CMake core build): the library replaces the global
+ *   operator new, so new and new[] of all threads are counted in any build
+ *   type. (not malloc)
+ * - Otherwise, Windows debug build: CRT allocation hook.
+ *   (malloc, new and realloc)
+ * - Otherwise nothing can be counted; the counter stays 0.
+ *   (see @ref isHeapCounterAvailable())
+ */
+void enableHeapCounter();
+/**@brief Whether heap allocations can be counted in this build.
+ */
+bool isHeapCounterAvailable();
+/**@brief Get heap allocation count of all threads after enableHeapCounter().
+ */
+uint64_t getHeapAllocCount();
+
+}	// namespace arena
+}	// namespace yappy
@@ -0,0 +1,62 @@
+﻿/**@file
+ * @brief CRC-32C (Castagnoli) checksum.
+ * @details
+ * Uses the CRC32 instruction if the CPU has it,
+ * otherwise a slicing-by-8 table.
+ * @li x86/x64: SSE4.2. (detected at run time)
+ * @li ARM: ARMv8 CRC extension. (enabled at compile time)
+ *
+ * Both give the same value. (reflected polynomial 0x82F63B78,
+ * initial and final XOR 0xFFFFFFFF, "123456789" -> 0xE3069283)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yappy {
+/// CRC-32C checksum.
+namespace crc {
+
+/**@brief Calculate CRC-32C.
+ * @details
+ * Can be continued: crc32c(b, crc32c(a)) is the CRC of a and b.
+ * @param[in]	data	Data.
+ * @param[in]	size	Size in bytes.
+ * @param[in]	crc		CRC of the previous data. (0 at first)
+ * @return		CRC value.
+ */
+uint32_t crc32c(const void *data, size_t size, uint32_t crc = 0);
+
+/**@brief Calculate CRC-32C by table. (for comparison)
+ * @copydetails crc32c()
+ */
+uint32_t crc32cTable(const void *data, size_t size, uint32_t crc = 0);
+
+/**@brief Returns true if crc32c() uses the CPU instruction.
+ */
+bool hasHardwareCrc();
+
+/// Result of @ref benchmark().
+struct BenchResult {
+	/// Data size per round.
+	uint64_t bytes = 0;
+	/// crc32c() uses the CPU instruction.
+	bool hardware = false;
+	/// crc32c() speed. [GB/s]
+	double crcGBps = 0.0;
+	/// crc32cTable() speed. [GB/s]
+	double tableGBps = 0.0;
+};
+
+/**@brief Measure speed of crc32c() and crc32cTable() on one thread.
+ * @details Result is also written to debug output.
+ * @param[in]	size	Data size. (in the CPU cache if small)
+ * @param[in]	rounds	Repeat count.
+ * @return		Result.
+ */
+BenchResult benchmark(size_t size, uint32_t rounds);
+
+}	// namespace crc
+}	// namespace yappy
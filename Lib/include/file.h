@@ -1,35 +1,511 @@
-﻿#pragma once
-
-#include "util.h"
-#include <vector>
-#include <limits>
-
-namespace yappy {
-/// File abstract layer.
-namespace file {
-
-/// 0x7fffffff = 2GiB
-const uint32_t FileSizeMax = std::numeric_limits<int32_t>::max();
-
-/**@brief Uses real file system.
- * @param[in]	rootDir  Root directory path.
- */
-void initWithFileSystem(const wchar_t *rootDir);
-/**@brief Uses archive file.
- * @param[in]	archiveFile Archive file path.
- * @warning Not implemented...
- */
-void initWithArchiveFile(const wchar_t *archiveFile);
-
-/// File byte sequence. Vector of uint8_t.
-using Bytes = std::vector<uint8_t>;
-
-/**@brief Load file from abstract file system.
- * @details Library uses this function.
- * initXXX() function must be called at first.
- * @param[in]	fileName	File name.
- */
-Bytes loadFile(const wchar_t *fileName);
-
-}
-}
+﻿#pragma once
+
+#include "util.h"
+#include <vector>
+#include <limits>
+#include <memory>
+#include <string>
+#include <functional>
+#include <future>
+#include <exception>
+
+namespace yappy {
+namespace jobs {
+class JobSystem;
+}
+}
+
+namespace yappy {
+/// File abstract layer.
+namespace file {
+
+/// 0x7fffffff = 2GiB
+const uint32_t FileSizeMax = std::numeric_limits<int32_t>::max();
+
+/**@brief Uses real file system.
+ * @param[in]	rootDir  Root directory path.
+ */
+void initWithFileSystem(const wchar_t *rootDir);
+/**@brief Uses archive file.
+ * @details
+ * The archive is memory-mapped and loadFile() becomes an index lookup
+ * and a copy. File names are case-insensitive (ASCII) and
+ * '\\' is the same as '/'.
+ * Debug only paths ('/' and '@') are still loaded from the real file system.
+ *
+ * If the archive was created with an access trace, data is in load order
+ * and each load reads ahead the following @ref ArchiveReadAheadSize bytes
+ * in the background, so that cold loads become sequential reads.
+ *
+ * Each block is checked with its CRC-32C when it is read for the first time.
+ * (FrameworkError if broken)
+ * @param[in]	archiveFile Archive file path. (real file system)
+ * @sa @ref createArchive()
+ */
+void initWithArchiveFile(const wchar_t *archiveFile);
+/**@brief Uses mount table. (empty at first)
+ * @details
+ * Mount directories and archives by mount().
+ * initWithArchiveFile() is a mount table with the archive.
+ */
+void initWithMountTable();
+/**@brief Add a directory or archive file on top of the mount table.
+ * @details
+ * Files in later mounts override the same names in earlier ones.
+ * (for patches and DLC)
+ * All visible files are put in one hash index at mount time,
+ * so a lookup is one name normalization, one hash and a probe.
+ * Files in a mounted directory are listed at mount time;
+ * files added later are not visible.
+ *
+ * Call while no file is being loaded. (not thread-safe)
+ * @param[in]	path	Directory or archive file path. (real file system)
+ * @pre initWithMountTable() or initWithArchiveFile() has been called.
+ */
+void mount(const wchar_t *path);
+
+/// File byte sequence. Vector of uint8_t.
+using Bytes = std::vector<uint8_t>;
+
+/**@brief Create an archive file from all files in a directory.
+ * @details
+ * Format (little endian):
+ * @li Header: magic "YPAK", version, flags, entry count,
+ * index offset, name table offset, CRC table offset, CRC count, reserved.
+ * (uint32 x 4, uint64 x 3, uint32 x 2)
+ * @li Index: entries sorted by name hash.
+ * (hash, data offset: uint64, size, stored size, name offset: uint32,
+ * name size, flags: uint16, CRC index, reserved: uint32)
+ * @li Name table: normalized UTF-8 names. (lower case, '/' separated)
+ * @li Data: file contents, each aligned to @ref ArchiveAlign.
+ * @li CRC table: CRC-32C of each stored block (uint32 each),
+ * entries from their CRC index.
+ *
+ * A compressed entry is split into @ref ArchiveBlockSize blocks, which are
+ * compressed independently by @ref lz::compress().
+ * Its data starts with compressed block sizes (uint32 each),
+ * followed by the blocks. A block is stored as is if it does not shrink.
+ * Entries which do not shrink by 1/8 (e.g. ogg, png) are not compressed.
+ *
+ * Blocks of an uncompressed entry are @ref ArchiveBlockSize slices.
+ *
+ * Data is in name order (files in the same directory are close).
+ * If traceFile is given, files in the trace come first in first-access
+ * order and the header has the trace ordered flag. (enables read-ahead)
+ *
+ * File names are relative to srcDir.
+ * @param[in]	archivePath	Output file path.
+ * @param[in]	srcDir		Source directory.
+ * @param[in]	compress	Compress entries.
+ * @param[in]	traceFile	Access trace file path. (real file system, can be nullptr)
+ * @return		Packed file count.
+ * @sa @ref saveAccessTrace()
+ */
+uint32_t createArchive(const wchar_t *archivePath, const wchar_t *srcDir,
+	bool compress = true, const wchar_t *traceFile = nullptr);
+
+/// Alignment of file data in archive.
+const uint32_t ArchiveAlign = 16;
+/// Uncompressed size of a compression block in archive.
+const uint32_t ArchiveBlockSize = 64 * 1024;
+/// Read-ahead window of trace ordered archive.
+const uint32_t ArchiveReadAheadSize = 4 * 1024 * 1024;
+
+/// Result of @ref benchmarkArchive().
+struct ArchiveBenchResult {
+	/// File count in archive.
+	uint32_t files = 0;
+	/// Total size of files.
+	uint64_t bytes = 0;
+	/// Archive file size.
+	uint64_t archiveBytes = 0;
+	/// Average time to load all files from the real file system. [ms]
+	double fsMs = 0.0;
+	/// Average time to load all files from the archive. [ms]
+	double archiveMs = 0.0;
+};
+
+/**@brief Load all files in an archive and the same files in a directory.
+ * @details Result is also written to debug output.
+ * @param[in]	archiveFile	Archive file path.
+ * @param[in]	rootDir		Directory which the archive was created from.
+ * @param[in]	rounds		Repeat count.
+ * @return		Result.
+ */
+ArchiveBenchResult benchmarkArchive(const wchar_t *archiveFile,
+	const wchar_t *rootDir, uint32_t rounds);
+
+/// Result of @ref verifyArchive().
+struct VerifyResult {
+	/// File count in archive.
+	uint32_t files = 0;
+	/// Checked block count.
+	uint32_t blocks = 0;
+	/// Checked size. (stored size)
+	uint64_t bytes = 0;
+	/// Names of broken files.
+	std::vector<std::string> badFiles;
+	/// Elapsed time. [ms]
+	double ms = 0.0;
+	/// Check speed. [GB/s]
+	double gbps = 0.0;
+};
+
+/**@brief Check CRC of all blocks in an archive. ("verify install")
+ * @details
+ * Blocks are checked in parallel on the job system given by
+ * setJobSystem(), or on temporary threads if not set.
+ * Broken files are reported in the result, not by exception.
+ * Result is also written to debug output.
+ * @param[in]	archiveFile	Archive file path. (real file system)
+ * @return		Result.
+ */
+VerifyResult verifyArchive(const wchar_t *archiveFile);
+
+/// Result of @ref benchmarkMountLookup().
+struct MountBenchResult {
+	/// Entry count.
+	uint32_t entries = 0;
+	/// Lookup count.
+	uint32_t lookups = 0;
+	/// Time to build the index. [ms]
+	double buildMs = 0.0;
+	/// Time of all lookups. [ms]
+	double lookupMs = 0.0;
+	/// Lookups per second.
+	double lookupsPerSec = 0.0;
+};
+
+/**@brief Measure mount table lookup with generated names.
+ * @details
+ * Names are looked up in random order, from a wide string
+ * (normalization included). No file is read.
+ * Result is also written to debug output.
+ * @param[in]	entries	Entry count. (e.g. 100000)
+ * @param[in]	lookups	Lookup count.
+ * @return		Result.
+ */
+MountBenchResult benchmarkMountLookup(uint32_t entries, uint32_t lookups);
+
+/**@brief Start recording file access order.
+ * @details
+ * The first access of each file by loadFile(), loadFileView(),
+ * loadFileRange() and @ref AsyncReader is recorded.
+ * Debug only paths ('/' and '@') are not recorded.
+ * Recorded names are cleared.
+ */
+void startAccessTrace();
+/**@brief Write recorded access order to real file system.
+ * @details
+ * Text file, a normalized name (UTF-8) per line. Recording continues.
+ * @param[in]	path	Output file path.
+ * @sa @ref createArchive()
+ */
+void saveAccessTrace(const wchar_t *path);
+
+/// Result of @ref benchmarkTraceReplay().
+struct TraceReplayResult {
+	/// Loaded file count per archive. (names in trace and archive)
+	uint32_t files = 0;
+	/// Total size of files per archive.
+	uint64_t bytes = 0;
+	/// Time to load all files from the name ordered archive. [ms]
+	double nameOrderMs = 0.0;
+	/// Time to load all files from the trace ordered archive. [ms]
+	double traceOrderMs = 0.0;
+	/// Both archives were dropped from OS file cache before their runs.
+	bool cold = false;
+};
+
+/**@brief Load files in access trace order from a name ordered archive
+ * and a trace ordered archive of the same files.
+ * @details
+ * Replays the load sequence of a run once for each archive.
+ * Each archive is dropped from OS file cache just before its run
+ * (@ref platform::evictFileCache()); if that fails (result.cold is false),
+ * the times are only meaningful after reboot.
+ * Result is also written to debug output.
+ * @param[in]	nameOrderArchive	Archive created without trace.
+ * @param[in]	traceOrderArchive	Archive created with traceFile.
+ * @param[in]	traceFile			Access trace file path.
+ * @return		Result.
+ * @exception	error::FrameworkError	The archives have different files.
+ * @sa @ref createArchive()
+ */
+TraceReplayResult benchmarkTraceReplay(const wchar_t *nameOrderArchive,
+	const wchar_t *traceOrderArchive, const wchar_t *traceFile);
+
+/**@brief Read-only view of file contents with shared ownership.
+ * @details
+ * Backed by a memory-mapped file, the archive mapping or an owned buffer.
+ * Copy is cheap (shared_ptr) and the contents are valid while any copy
+ * (or sub view) is alive.
+ */
+class FileView {
+public:
+	/// Empty view.
+	FileView() = default;
+	/**@brief Take ownership of a buffer.
+	 * @param[in]	bin	File contents.
+	 */
+	explicit FileView(Bytes &&bin);
+	/**@brief View of memory owned by owner.
+	 * @param[in]	owner	Keeps data alive.
+	 * @param[in]	data	Start address.
+	 * @param[in]	size	Size in bytes.
+	 */
+	FileView(std::shared_ptr<const void> owner, const uint8_t *data, size_t size);
+	~FileView() = default;
+
+	/// Start address. (nullptr if empty)
+	const uint8_t *data() const { return m_data; }
+	/// Size in bytes.
+	size_t size() const { return m_size; }
+	/// Returns true if size is 0.
+	bool empty() const { return m_size == 0; }
+	/// For range-based for.
+	const uint8_t *begin() const { return m_data; }
+	/// For range-based for.
+	const uint8_t *end() const { return m_data + m_size; }
+
+	/**@brief View of a part of this view. (sharing the owner)
+	 * @param[in]	offset	Start position. (clipped)
+	 * @param[in]	size	Size. (clipped)
+	 * @return		Sub view.
+	 */
+	FileView subView(size_t offset, size_t size) const;
+
+private:
+	std::shared_ptr<const void> m_owner;
+	const uint8_t *m_data = nullptr;
+	size_t m_size = 0;
+};
+
+/**@brief Load file from abstract file system.
+ * @details Library uses this function.
+ * initXXX() function must be called at first.
+ * @param[in]	fileName	File name.
+ */
+Bytes loadFile(const wchar_t *fileName);
+
+/**@brief Load file from abstract file system without copy.
+ * @details
+ * Large files in the real file system are memory-mapped, and
+ * uncompressed archive entries point into the archive mapping.
+ * Small files and compressed entries are read into an owned buffer.
+ * Mapped pages are read from disk on first access.
+ * @param[in]	fileName	File name.
+ * @return		Read-only view.
+ */
+FileView loadFileView(const wchar_t *fileName);
+
+/**@brief Get file size in abstract file system.
+ * @param[in]	fileName	File name.
+ * @return		File size. (uncompressed)
+ */
+uint64_t getFileSize(const wchar_t *fileName);
+
+/**@brief Returns true if a file is in the real file system.
+ * @details False for archive entries. (@ref AsyncReader reads them blocking)
+ * @param[in]	fileName	File name.
+ */
+bool isRealFile(const wchar_t *fileName);
+
+/**@brief Load a part of file from abstract file system.
+ * @details
+ * For streaming. A compressed archive entry decompresses only the blocks
+ * in range. (@ref ArchiveBlockSize)
+ * @param[in]	fileName	File name.
+ * @param[in]	offset		Start position.
+ * @param[in]	size		Size to read. (clipped at the end of file)
+ * @return		Read data.
+ */
+Bytes loadFileRange(const wchar_t *fileName, uint64_t offset, size_t size);
+
+/**@brief Use job system to decompress archive blocks in parallel.
+ * @details
+ * Application sets its job system. Must be reset to nullptr
+ * before the job system is destructed.
+ * @param[in]	jobs	Job system. (nullptr: decompress on the calling thread)
+ */
+void setJobSystem(jobs::JobSystem *jobs);
+
+/// Statistics of @ref AsyncReader.
+struct AsyncReadStats {
+	/// Completed request count. (including errors)
+	uint64_t completed = 0;
+	/// Total bytes read.
+	uint64_t bytes = 0;
+	/// Maximum count of requests in flight at the same time.
+	uint32_t maxInFlight = 0;
+};
+
+/**@brief Asynchronous file reader with bounded queue depth.
+ * @details
+ * Requests are queued and up to queueDepth of them are in flight at once,
+ * so that the device queue is kept full without opening all files at once.
+ * @li Iocp: Overlapped ReadFile() on an I/O completion port.
+ * One I/O thread issues reads and receives completions.
+ * Files not in the real file system (archive entries) are loaded
+ * on the I/O thread by loadFile().
+ * @li IoUring: Reads on an io_uring. (Linux with liburing)
+ * One I/O thread issues reads and receives completions, like Iocp.
+ * @li ThreadPool: queueDepth threads call blocking loadFile().
+ *
+ * Callbacks are called on an internal thread and must not block long.
+ * The destructor waits for all submitted requests.
+ */
+class AsyncReader : private util::noncopyable {
+public:
+	/// I/O backend.
+	enum class Backend {
+		/// Default of the platform. (Windows: Iocp, Linux: IoUring, POSIX: ThreadPool)
+		Auto,
+		/// I/O completion port. (Windows only, error on other platforms)
+		Iocp,
+		/// Blocking reads on threads.
+		ThreadPool,
+#ifdef __linux__
+		/// io_uring. (ThreadPool if liburing or the kernel does not support it)
+		IoUring,
+#endif
+	};
+	/**@brief Completion callback.
+	 * @details Called with file contents, or error if it failed.
+	 */
+	using Callback = std::function<void(Bytes &&bin, std::exception_ptr error)>;
+
+	/**@brief Start internal threads.
+	 * @param[in]	queueDepth	Maximum count of requests in flight. (at least 1)
+	 * @param[in]	backend		I/O backend.
+	 * FrameworkError if it is not available on the platform.
+	 */
+	explicit AsyncReader(uint32_t queueDepth = 8, Backend backend = Backend::Auto);
+	/**@brief Wait for all requests and stop internal threads.
+	 */
+	~AsyncReader();
+
+	/**@brief Read a whole file asynchronously.
+	 * @param[in]	fileName	File name. (same as loadFile())
+	 * @param[in]	callback	Called on completion.
+	 */
+	void read(const wchar_t *fileName, Callback callback);
+	/**@brief Read a whole file asynchronously.
+	 * @param[in]	fileName	File name. (same as loadFile())
+	 * @return		Future of file contents. get() rethrows the error.
+	 */
+	std::future<Bytes> read(const wchar_t *fileName);
+	/**@brief Read files asynchronously at once.
+	 * @param[in]	fileNames	File names.
+	 * @return		Futures in the same order.
+	 */
+	std::vector<std::future<Bytes>> readBatch(const std::vector<std::wstring> &fileNames);
+
+	/**@brief Get statistics.
+	 */
+	AsyncReadStats getStats() const;
+	/**@brief Get the backend in use. (Auto and fallback are resolved)
+	 */
+	Backend getBackend() const;
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+};
+
+/// Result of @ref benchmarkAsyncRead().
+struct AsyncBenchResult {
+	/// Total bytes read.
+	uint64_t bytes = 0;
+	/// Elapsed time. [ms]
+	double ms = 0.0;
+	/// Throughput. [MB/s]
+	double mbps = 0.0;
+	/// Maximum count of requests in flight.
+	uint32_t maxInFlight = 0;
+};
+
+/**@brief Read files in one batch and measure throughput.
+ * @details
+ * Run with various queue depths to find the best one for the device.
+ * Files must not be in the OS file cache to measure the device.
+ * Result is also written to debug output.
+ * @param[in]	fileNames	File names.
+ * @param[in]	queueDepth	Queue depth.
+ * @param[in]	backend		I/O backend.
+ * @return		Result.
+ */
+AsyncBenchResult benchmarkAsyncRead(const std::vector<std::wstring> &fileNames,
+	uint32_t queueDepth, AsyncReader::Backend backend);
+
+/// Default chunk size of @ref StreamReader.
+const uint32_t StreamChunkSize = 64 * 1024;
+/// Default chunk count of @ref StreamReader. (the current one and read-ahead)
+const uint32_t StreamChunkCount = 4;
+
+/// Statistics of @ref StreamReader.
+struct StreamReadStats {
+	/// Chunks read from the file. (including read-ahead)
+	uint64_t chunks = 0;
+	/// Times read() waited for a chunk. (the first read and seeks included)
+	uint64_t stalls = 0;
+};
+
+/**@brief Sequential file reader in bounded chunks with read-ahead.
+ * @details
+ * For long streams (BGM) which should not be loaded at once.
+ * The chunks after the read position are read by loadFileRange()
+ * (a compressed archive entry decompresses only those blocks),
+ * so memory usage is chunkSize * chunkCount regardless of the file size.
+ * Read-ahead runs as a job of setJobSystem() while the window has chunks
+ * not read yet, so an idle reader costs no thread.
+ * Without job system, read() reads each chunk on the calling thread.
+ * Seeking out of the read-ahead window waits for the new chunk.
+ *
+ * read(), seek() and tell() must be called from one thread at a time.
+ */
+class StreamReader : private util::noncopyable {
+public:
+	/**@brief Open a file. (read-ahead starts at the first read())
+	 * @param[in]	fileName	File name. (same as loadFile())
+	 * @param[in]	chunkSize	Read unit.
+	 * @param[in]	chunkCount	Chunk buffer count. (at least 2)
+	 */
+	explicit StreamReader(const wchar_t *fileName,
+		uint32_t chunkSize = StreamChunkSize, uint32_t chunkCount = StreamChunkCount);
+	/**@brief Stop read-ahead. (does not wait for the job in flight)
+	 */
+	~StreamReader();
+
+	/// File size.
+	uint64_t size() const;
+	/// Current read position.
+	uint64_t tell() const;
+	/**@brief Set read position.
+	 * @param[in]	pos	New position. (clipped at the end of file)
+	 */
+	void seek(uint64_t pos);
+	/**@brief Read from the current position.
+	 * @details
+	 * Waits if the chunk is not read yet.
+	 * A read error of read-ahead is rethrown here.
+	 * @param[out]	buf		Output buffer.
+	 * @param[in]	size	Size to read.
+	 * @return		Read size. (smaller at the end of file)
+	 */
+	size_t read(void *buf, size_t size);
+
+	/// Memory size of chunk buffers.
+	size_t getMemorySize() const;
+	/**@brief Get statistics.
+	 */
+	StreamReadStats getStats() const;
+
+private:
+	struct Impl;
+	// shared with the read-ahead job
+	std::shared_ptr<Impl> m_impl;
+};
+
+}
+}
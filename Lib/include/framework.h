@@ -1,467 +1,775 @@
-﻿/** @mainpage
- * @section はじめに
- * これは、QOL(生活の質)を高めるためのライブラリです。
- * @section つぎに
- * @ref framework.h の Application クラスとか。
- * @ref debug.h , @ref util.h もおすすめです。
- * Lua へエクスポートされている関数仕様は @ref yappy::lua::export にあります。
- * @section おわりに
- * ホワイト。
- */
-
-/** @file
- * @brief Game application main framework classes.
- */
-
-#pragma once
-
-#include "util.h"
-#include "debug.h"
-#include "graphics.h"
-#include "sound.h"
-#include "input.h"
-#include <atomic>
-#include <future>
-#include <functional>
-
-namespace yappy {
-/// Game application main framework.
-namespace framework {
-
-using error::throwTrace;
-using error::FrameworkError;
-
-/// Random number framework.
-namespace random {
-
-/**@brief Generate nondeterministic random number for seed.
- * @details
- * Uses std::random_device.
- * Probably uses win32 CryptGenRandom().
- * This function will be slow.
- * @return random number
- */
-unsigned int generateRandomSeed();
-
-/**@brief Set random seed.
- * @param[in]	seed	Random seed.
- * @sa @ref generateRandomSeed()
- */
-void setSeed(unsigned int seed);
-
-/**@brief Get next uint32 random number.
- * @return [0x00000000, 0xffffffff]
- */
-unsigned int nextRawUInt32();
-
-/**@brief Get next int random number.
- * @param[in]	a	min value (inclusive)
- * @param[in]	b	max value (inclusive)
- * @return [a, b]
- */
-int nextInt(int a = 0, int b = std::numeric_limits<int>::max());
-
-/**@brief Get next double random number.
- * @param[in]	a	min value (inclusive)
- * @param[in]	b	max value (exclusive)
- * @return [a, b)
- */
-double nextDouble(double a = 0.0, double max = 1.0);
-
-}	// namespace random
-
-/// Scene class.
-namespace scene {
-
-/**@brief Simple scene class base.
- * @details Noncopyable, and has common functions.
- */
-class SceneBase : private util::noncopyable {
-public:
-	/// Constructor (default).
-	SceneBase() = default;
-	/// Virtual Destructor (default).
-	virtual ~SceneBase() = default;
-
-	/// Frame update.
-	virtual void update() = 0;
-	/// Rendering.
-	virtual void render() = 0;
-};
-
-/**@brief Scene class with an async loading task.
-*/
-class AsyncLoadScene : public SceneBase {
-public:
-	/// Constructor (default).
-	AsyncLoadScene() = default;
-	/**@brief Destructor.
-	 * @details
-	 * If async task is being processed, sets cancel flag to true and
-	 * blocks until task function will return.
-	 */
-	virtual ~AsyncLoadScene() override;
-	/**@brief Check the state of sub thread and then call @ref updateOnMainThread().
-	 */
-	virtual void update() final override;
-
-protected:
-	/**@brief User-defined async task.
-	 * @details
-	 * This function will run on a separated thread and
-	 * can take a long time to complete.
-	 * If this class object is destructed while running,
-	 * cancel flag which is passed by parameter will set to be true.
-	 * @param[in]	cancel	Cancel signal.
-	 */
-	virtual void loadOnSubThread(std::atomic_bool &cancel) = 0;
-	/**@brief Called in @ref update()
-	 */
-	virtual void updateOnMainThread() = 0;
-
-	/**@brief Starts async load task on another thread.
-	 * @pre Async task is not running. (@ref isLoading() returns false.)
-	 */
-	void startLoadThread();
-	/**@brief Poll the state of the async task.
-	 * @ref updateLoadStatus() is needed.
-	 */
-	bool isLoading() const;
-
-private:
-	std::atomic_bool m_cancel = false;
-	std::future<void> m_future;
-
-	void updateLoadStatus();
-};
-
-}	// namespace scene
-
-
-/**@brief Command line utility.
- * @return Parsed result vector. (argc-argv compatible)
- */
-std::vector<std::wstring> parseCommandLine();
-
-/**@brief Get key state by GetAsyncKeyState().
- * @param[in]	vKey	VK_XXX
- * @return		true if the key is pressed.
- */
-inline bool keyPressedAsync(int vKey)
-{
-	short ret = ::GetAsyncKeyState(vKey);
-	return (ret & 0x8000) != 0;
-}
-
-
-/// %Resource ID is fixed-length string; char[16].
-using IdString = util::IdString;
-
-template <class T>
-class Resource : private util::noncopyable {
-public:
-	using PtrType = std::shared_ptr<T>;
-	using LoadFuncType = std::function<PtrType()>;
-
-	explicit Resource(LoadFuncType loadFunc_) : m_loadFunc(loadFunc_) {}
-	~Resource() = default;
-
-	const PtrType getPtr() const
-	{
-		std::lock_guard<std::mutex> lock(m_lock);
-		if (m_resPtr == nullptr) {
-			throwTrace<FrameworkError>("Resource not loaded");
-		}
-		return m_resPtr;
-	}
-	void load()
-	{
-		{
-			std::lock_guard<std::mutex> lock(m_lock);
-			if (m_resPtr != nullptr) {
-				return;
-			}
-			m_loading = true;
-		}
-		auto res = m_loadFunc();
-		{
-			std::lock_guard<std::mutex> lock(m_lock);
-			if (!m_loading) {
-				throwTrace<FrameworkError>("Multiple load async detected");
-			}
-			m_loading = false;
-			m_resPtr = res;
-		}
-	}
-	void unload() {
-		std::lock_guard<std::mutex> lock(m_lock);
-		if (!m_loading) {
-			throwTrace<FrameworkError>("Unload resource while loading");
-		}
-		m_resPtr.reset();
-	}
-
-private:
-	mutable std::mutex m_lock;
-	bool m_loading = false;
-	PtrType m_resPtr;
-	LoadFuncType m_loadFunc;
-};
-
-
-class ResourceManager : private util::noncopyable {
-public:
-	explicit ResourceManager(size_t resSetCount = 1);
-	~ResourceManager() = default;
-
-	void addTexture(size_t setId, const char *resId,
-		std::function<graphics::DGraphics::TextureResourcePtr()> loadFunc);
-	void addFont(size_t setId, const char *resId,
-		std::function<graphics::DGraphics::FontResourcePtr()> loadFunc);
-	void addSoundEffect(size_t setId, const char *resId,
-		std::function<sound::XAudio2::SeResourcePtr()> loadFunc);
-	void addBgm(size_t setId, const char *resId,
-		std::function<sound::XAudio2::BgmResourcePtr()> loadFunc);
-
-	void setSealed(bool sealed);
-	bool isSealed();
-
-	void loadResourceSet(size_t setId, std::atomic_bool &cancel);
-	void unloadResourceSet(size_t setId);
-
-	const graphics::DGraphics::TextureResourcePtr getTexture(
-		size_t setId, const char *resId) const;
-	const graphics::DGraphics::FontResourcePtr getFont(
-		size_t setId, const char *resId) const;
-	const sound::XAudio2::SeResourcePtr getSoundEffect(
-		size_t setId, const char *resId) const;
-	const sound::XAudio2::BgmResourcePtr getBgm(
-		size_t setId, const char *resId) const;
-
-private:
-	bool m_sealed = true;
-
-	// int setId -> char[16] resId -> Resource<T>
-	template <class T>
-	using ResMapVec = std::vector<std::unordered_map<IdString, Resource<T>>>;
-
-	ResMapVec<graphics::DGraphics::TextureResource>	m_texMapVec;
-	ResMapVec<graphics::DGraphics::FontResource>	m_fontMapVec;
-	ResMapVec<sound::XAudio2::SeResource>			m_seMapVec;
-	ResMapVec<sound::XAudio2::BgmResource>			m_bgmMapVec;
-};
-
-class FrameControl : private util::noncopyable {
-public:
-	FrameControl(uint32_t fps, uint32_t skipCount);
-	~FrameControl() = default;
-	bool shouldSkipFrame() const;
-	void endFrame();
-	double getFramePerSec() const;
-
-private:
-	int64_t m_freq;
-	int64_t m_counterPerFrame;
-	int64_t m_base = 0;
-	uint32_t m_skipCount;
-	uint32_t m_frameCount = 0;
-
-	double m_fps = 0.0;
-	uint32_t m_fpsPeriod;
-	uint32_t m_fpsCount = 0;
-	int64_t m_fpsBase = 0;
-	uint32_t m_fpsFrameAcc = 0;
-};
-
-/**@brief Application parameters.
- * @details Each field has a default value.
- */
-struct AppParam {
-	/// hInstance from WinMain.
-	HINSTANCE hInstance = nullptr;
-	/// nCmdShow from WinMain.
-	int nCmdShow = SW_SHOW;
-	/// Window class name.
-	const wchar_t *wndClsName = L"GameWndCls";
-	/// Window title string.
-	const wchar_t *title = L"GameApp";
-	/// hIcon for window class.
-	HICON hIcon = nullptr;
-	/// hIconSm for window class.
-	HICON hIconSm = nullptr;
-	/// Frame skip count.
-	uint32_t frameSkip = 0;
-	/// Whether shows cursor or not.
-	bool showCursor = false;
-};
-
-/**@brief User application base, which manages a window and DirectX objects.
- * @details Please inherit this class and override protected methods.
- */
-class Application : private util::noncopyable {
-public:
-	/**@brief Constructor.
-	 * @details This needs AppParam and graphics::GraphicsParam.
-	 * Valid resource serId is: 0 .. resSetCount-1.
-	 * @param[in]	appParam		%Application parameters.
-	 * @param[in]	graphParam	Graphics parameters.
-	 * @param[in]	resSetCount	Count of resource set.
-	 */
-	Application(const AppParam &appParam, const graphics::GraphicsParam &graphParam,
-		size_t resSetCount);
-	/**@brief Destructor.
-	 */
-	virtual ~Application();
-	/**@brief Start main loop.
-	 * @details Call init() .
-	 * @return msg.wParam, which should be returned from WinMain().
-	 */
-	int run();
-
-	/**@brief Get HWND of the window managed by this class.
-	 */
-	HWND getHWnd() { return m_hWnd; }
-	/**@brief Get graphics parameters.
-	 */
-	void getGraphicsParam(graphics::GraphicsParam *param) { *param = m_graphParam; }
-	/**@brief Get DirectGraphics manager.
-	 */
-	graphics::DGraphics &graph() { return *m_dg.get(); }
-	/**@brief Get XAudio2 manager.
-	 */
-	sound::XAudio2 &sound() { return *m_ds.get(); }
-	/**@brief Get DirectInput manager.
-	 */
-	input::DInput &input() { return *m_di.get(); }
-
-	/**@brief Register texture image resource.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 * @param[in]	path	File path.
-	 */
-	void addTextureResource(size_t setId, const char *resId, const wchar_t *path);
-	/**@brief Register font image resource.
-	 * @param[in]	setId		%Resource set ID.
-	 * @param[in]	resId		%Resource ID.
-	 * @param[in]	fontName	Font family name.
-	 * @param[in]	startChar	The first character.
-	 * @param[in]	endChar	The last character.
-	 * @param[in]	w			Font image width.
-	 * @param[in]	h			Font image height.
-	 */
-	void addFontResource(size_t setId, const char *resId,
-		const wchar_t *fontName, uint32_t startChar, uint32_t endChar,
-		uint32_t w, uint32_t h);
-	/**@brief Register sound effect resource.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 * @param[in]	path	File path.
-	 */
-	void addSeResource(size_t setId, const char *resId, const wchar_t *path);
-	/**@brief Register BGM resource.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 * @param[in]	path	File path.
-	 */
-	void addBgmResource(size_t setId, const char *resId, const wchar_t *path);
-
-	/**@brief Set the lock state of resources.
-	 * @details If resource manager is sealed, addXXXResource() will be failed.
-	 * @param[in]	seal	new state.
-	 * @sa @ref UnsealResource
-	 */
-	void sealResource(bool seal);
-
-	/**@brief Load resources by resource set ID.
-	 * @details This function blocks until all resource is loaded.
-	 * Processing can be cancelled by writing true to cancel from another thread.
-	 * @param[in]	setId		%Resource set ID.
-	 * @param[in]	cancel	async cancel atomic
-	 */
-	void loadResourceSet(size_t setId, std::atomic_bool &cancel);
-	/**@brief Unload resources by resource set ID.
-	 * @param[in]	setId	%Resource set ID.
-	 */
-	void unloadResourceSet(size_t setId);
-
-	/**@brief Get texture resource pointer.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 */
-	const graphics::DGraphics::TextureResourcePtr getTexture(
-		size_t setId, const char *resId) const;
-	/**@brief Get font resource pointer.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 */
-	const graphics::DGraphics::FontResourcePtr getFont(
-		size_t setId, const char *resId) const;
-	/**@brief Get sound effect resource pointer.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 */
-	const sound::XAudio2::SeResourcePtr getSoundEffect(
-		size_t setId, const char *resId) const;
-	/**@brief Get BGM resource pointer.
-	 * @param[in]	setId	%Resource set ID.
-	 * @param[in]	resId	%Resource ID.
-	 */
-	const sound::XAudio2::BgmResourcePtr getBgm(
-		size_t setId, const char *resId) const;
-
-protected:
-	/**@brief User initialization code.
-	 * @details Called at the beginning of @ref run().
-	 */
-	virtual void init() = 0;
-	/**@brief Process frame.
-	 * @details Called at the beginning of every frame.
-	 */
-	virtual void update() = 0;
-	/**@brief Process rendering.
-	 * @details Called after @ref update(), unless frame skipping.
-	 */
-	virtual void render() = 0;
-
-private:
-	const UINT_PTR TimerEventId = 0xffff0001;
-
-	HWND m_hWnd;
-	std::unique_ptr<graphics::DGraphics> m_dg;
-	std::unique_ptr<sound::XAudio2> m_ds;
-	std::unique_ptr<input::DInput> m_di;
-	ResourceManager m_resMgr;
-
-	AppParam m_param;
-	graphics::GraphicsParam m_graphParam;
-	FrameControl m_frameCtrl;
-
-	void initializeWindow();
-	static LRESULT CALLBACK wndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-	LRESULT onSize(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
-
-	void onIdle();
-	void updateInternal();
-	void renderInternal();
-};
-
-/**@brief Auto re-seal helper
- * @sa @ref Application::sealResource()
- */
-class UnsealResource : util::noncopyable {
-public:
-	explicit UnsealResource(Application &app) : m_app(app)
-	{
-		m_app.sealResource(false);
-	}
-	~UnsealResource()
-	{
-		m_app.sealResource(true);
-	}
-
-private:
-	Application &m_app;
-};
-
-}	// namespace framework
-}	// namespace yappy
+﻿/** @mainpage
+ * @section はじめに
+ * これは、QOL(生活の質)を高めるためのライブラリです。
+ * @section つぎに
+ * @ref framework.h の Application クラスとか。
+ * @ref debug.h , @ref util.h もおすすめです。
+ * Lua へエクスポートされている関数仕様は @ref yappy::lua::export にあります。
+ * @section おわりに
+ * ホワイト。
+ */
+
+/** @file
+ * @brief Game application main framework classes.
+ */
+
+#pragma once
+
+#include "util.h"
+#include "debug.h"
+#include "file.h"
+#include "graphics.h"
+#include "sound.h"
+#include "input.h"
+#include "timer.h"
+#include "arena.h"
+#include "jobs.h"
+#include "resource_manager.h"
+#include "manifest.h"
+#include <atomic>
+#include <future>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace yappy {
+/// Game application main framework.
+namespace framework {
+
+using error::throwTrace;
+using error::FrameworkError;
+
+/// Random number framework.
+namespace random {
+
+/**@brief Generate nondeterministic random number for seed.
+ * @details
+ * Uses std::random_device.
+ * Probably uses win32 CryptGenRandom().
+ * This function will be slow.
+ * @return random number
+ */
+unsigned int generateRandomSeed();
+
+/**@brief Set random seed.
+ * @param[in]	seed	Random seed.
+ * @sa @ref generateRandomSeed()
+ */
+void setSeed(unsigned int seed);
+
+/**@brief Get next uint32 random number.
+ * @return [0x00000000, 0xffffffff]
+ */
+unsigned int nextRawUInt32();
+
+/**@brief Get next int random number.
+ * @param[in]	a	min value (inclusive)
+ * @param[in]	b	max value (inclusive)
+ * @return [a, b]
+ */
+int nextInt(int a = 0, int b = std::numeric_limits<int>::max());
+
+/**@brief Get next double random number.
+ * @param[in]	a	min value (inclusive)
+ * @param[in]	b	max value (exclusive)
+ * @return [a, b)
+ */
+double nextDouble(double a = 0.0, double max = 1.0);
+
+}	// namespace random
+
+/// Scene class.
+namespace scene {
+
+/**@brief Simple scene class base.
+ * @details Noncopyable, and has common functions.
+ */
+class SceneBase : private util::noncopyable {
+public:
+	/// Constructor (default).
+	SceneBase() = default;
+	/// Virtual Destructor (default).
+	virtual ~SceneBase() = default;
+
+	/// Frame update.
+	virtual void update() = 0;
+	/// Rendering.
+	virtual void render() = 0;
+};
+
+/**@brief Scene class with an async loading task.
+*/
+class AsyncLoadScene : public SceneBase {
+public:
+	/**@brief Constructor.
+	 * @param[in]	jobs	Job system which runs the loading task. (must outlive this object)
+	 */
+	explicit AsyncLoadScene(jobs::JobSystem &jobs) : m_jobs(jobs) {}
+	/**@brief Destructor.
+	 * @details
+	 * Calls @ref cancelAndWait().
+	 * This is too late if the task uses members of the derived class,
+	 * which are already destructed here.
+	 */
+	virtual ~AsyncLoadScene() override;
+	/**@brief Check the state of sub thread and then call @ref updateOnMainThread().
+	 */
+	virtual void update() final override;
+
+protected:
+	/**@brief User-defined async task.
+	 * @details
+	 * This function will run on a job system worker thread and
+	 * can take a long time to complete.
+	 * If this class object is destructed while running,
+	 * cancel flag which is passed by parameter will set to be true.
+	 * @param[in]	cancel	Cancel signal.
+	 */
+	virtual void loadOnSubThread(std::atomic_bool &cancel) = 0;
+	/**@brief Called in @ref update()
+	 */
+	virtual void updateOnMainThread() = 0;
+
+	/**@brief Starts async load task on a job system worker.
+	 * @pre Async task is not running. (@ref isLoading() returns false.)
+	 */
+	void startLoadThread();
+	/**@brief Poll the state of the async task.
+	 * @ref updateLoadStatus() is needed.
+	 */
+	bool isLoading() const;
+	/**@brief Cancel the async task and wait for it.
+	 * @details
+	 * If async task is being processed, sets cancel flag to true and
+	 * blocks until task function will return.
+	 * An exception from the task is written to debug output.
+	 * Call it first in the destructor of a derived class whose task
+	 * uses its members.
+	 */
+	void cancelAndWait();
+
+private:
+	jobs::JobSystem &m_jobs;
+	std::atomic_bool m_cancel = false;
+	jobs::JobCounter m_loadCounter;
+	bool m_loading = false;
+
+	void updateLoadStatus();
+};
+
+}	// namespace scene
+
+
+/**@brief Command line utility.
+ * @return Parsed result vector. (argc-argv compatible)
+ */
+std::vector<std::wstring> parseCommandLine();
+
+/**@brief Get key state by GetAsyncKeyState().
+ * @param[in]	vKey	VK_XXX
+ * @return		true if the key is pressed.
+ */
+inline bool keyPressedAsync(int vKey)
+{
+	short ret = ::GetAsyncKeyState(vKey);
+	return (ret & 0x8000) != 0;
+}
+
+
+/// Idle task priority. (High runs first)
+enum class IdlePriority {
+	High,
+	Normal,
+	Low,
+};
+
+/// Idle scheduler statistics.
+struct IdleStats {
+	/// Slack given to idle tasks in the last frame. [ms]
+	double slackMs = 0.0;
+	/// Time spent for idle tasks in the last frame. [ms]
+	double spentMs = 0.0;
+	/// Steps executed in the last frame.
+	uint32_t executed = 0;
+	/// Steps deferred to later frames because they did not fit in the last frame.
+	uint32_t deferred = 0;
+	/// Total time spent. [ms]
+	double spentTotalMs = 0.0;
+	/// Total count of steps which ended after the deadline.
+	uint64_t overrunTotal = 0;
+};
+
+/**@brief Runs deferrable work in the slack before the next frame.
+ * @details
+ * Two kinds of work are supported:
+ * @li Task: registered once, called step by step every frame.
+ * A step does a bounded piece of work and returns whether more work remains.
+ * @li Posted job: one-shot function, can be posted from any thread.
+ *
+ * Work is started only if its cost estimate fits before the deadline.
+ * Task cost is learned from measured step time (quick to grow, slow to shrink),
+ * starting from the given estimate.
+ * Work which does not fit is deferred to later frames.
+ */
+class IdleScheduler : private util::noncopyable {
+public:
+	/// Task ID. (0 is invalid)
+	using TaskId = uint32_t;
+	/// Task step function. Returns true if more work remains.
+	using StepFunc = std::function<bool()>;
+
+	/**@brief Constructor.
+	 * @param[in]	freq	Clock counter frequency.
+	 */
+	explicit IdleScheduler(int64_t freq);
+	~IdleScheduler() = default;
+
+	/**@brief Register a task. (main thread only)
+	 * @param[in]	name		Task name. (for debug)
+	 * @param[in]	priority	Priority.
+	 * @param[in]	costUs		Initial estimate of a step. [us]
+	 * @param[in]	step		Step function. (must not add or remove tasks)
+	 * @return		Task ID.
+	 */
+	TaskId addTask(const char *name, IdlePriority priority, uint32_t costUs, StepFunc step);
+	/**@brief Unregister a task. (main thread only)
+	 * @param[in]	id	Return value of @ref addTask().
+	 */
+	void removeTask(TaskId id);
+	/**@brief Post a one-shot job. (any thread)
+	 * @details Executed on the main thread in a later frame slack.
+	 * @param[in]	priority	Priority.
+	 * @param[in]	costUs		Cost estimate. [us]
+	 * @param[in]	func		Job function.
+	 */
+	void post(IdlePriority priority, uint32_t costUs, std::function<void()> func);
+	/**@brief Get count of posted jobs not executed yet. (any thread)
+	 */
+	size_t getPostedCount() const;
+
+	/**@brief Run work until deadline. (called by FrameControl)
+	 * @param[in]	clock		Clock.
+	 * @param[in]	deadline	Deadline in counter unit.
+	 */
+	void run(timer::Clock &clock, int64_t deadline);
+	/**@brief Get statistics.
+	 */
+	const IdleStats &getStats() const { return m_stats; }
+
+private:
+	static const size_t PriorityCount = 3;
+	// safety limit of steps per task per frame
+	static const uint32_t MaxStepsPerFrame = 64;
+
+	struct Task {
+		TaskId id;
+		std::string name;
+		IdlePriority priority;
+		// learned step cost (counter unit)
+		double cost;
+		StepFunc step;
+	};
+	struct Posted {
+		int64_t cost;
+		std::function<void()> func;
+	};
+
+	int64_t m_freq;
+	TaskId m_nextId = 1;
+	// sorted by priority
+	std::vector<Task> m_tasks;
+
+	mutable std::mutex m_postLock;
+	std::array<std::deque<Posted>, PriorityCount> m_posted;
+
+	IdleStats m_stats;
+
+	void runTasks(timer::Clock &clock, int64_t deadline, IdlePriority priority);
+	void runPosted(timer::Clock &clock, int64_t deadline, IdlePriority priority);
+};
+
+/// Frame processing phases measured by FrameControl.
+enum class FramePhase {
+	/// Input, sound and user update.
+	Update,
+	/// User render and GPU command submission.
+	Render,
+	/// Flip (and vsync wait).
+	Present,
+};
+
+/// Frame skip statistics.
+struct FrameSkipStats {
+	/// Adaptive mode or not.
+	bool adaptive = false;
+	/// Skipped frames / all frames in the last fps period.
+	double skipRatio = 0.0;
+	/// Rolling average of update cost. [ms]
+	double updateCostMs = 0.0;
+	/// Rolling average of render cost. [ms]
+	double renderCostMs = 0.0;
+	/// Estimated (elapsed + render cost) / frame time at the last decision.
+	double load = 0.0;
+	/// Decision history. bit0 is the last frame, 1 means skipped.
+	uint64_t history = 0;
+};
+
+class FrameControl : private util::noncopyable {
+public:
+	/// Max consecutive skip count of adaptive skip if skipCount is 0.
+	static const uint32_t AdaptiveSkipCountDefault = 2;
+
+	/**@brief Constructor.
+	 * @details
+	 * If adaptiveSkip is false, renders once per (1 + skipCount) frames.
+	 * If adaptiveSkip is true, skips rendering only when it would not fit
+	 * in the frame time, and skipCount is the max consecutive skip count.
+	 * (@ref AdaptiveSkipCountDefault if 0, otherwise it would never skip)
+	 * @param[in]	fps				Target frame rate.
+	 * @param[in]	skipCount		Frame skip count.
+	 * @param[in]	adaptiveSkip	Adaptive frame skip mode.
+	 * @param[in]	waitParam		Wait parameters for frame pacing.
+	 * @param[in]	pClock			Clock. (timer::SystemClock if nullptr)
+	 */
+	FrameControl(uint32_t fps, uint32_t skipCount, bool adaptiveSkip = false,
+		const timer::WaitParam &waitParam = timer::WaitParam(),
+		std::unique_ptr<timer::Clock> pClock = nullptr);
+	~FrameControl() = default;
+	bool shouldSkipFrame() const;
+	/**@brief Notify the end of a frame phase.
+	 * @details
+	 * Cost of the phase is measured from the previous phase end
+	 * (or the frame start).
+	 * Adaptive skip decision is made at the end of FramePhase::Update.
+	 * @param[in]	phase	Phase which has just finished.
+	 */
+	void endPhase(FramePhase phase);
+	void endFrame();
+	double getFramePerSec() const;
+	/**@brief Get frame time jitter.
+	 * @details Updated at the same timing as @ref getFramePerSec().
+	 */
+	const timer::FrameJitter &getFrameJitter() const;
+	/**@brief Get frame skip statistics.
+	 * @details skipRatio is updated at the same timing as @ref getFramePerSec().
+	 */
+	const FrameSkipStats &getSkipStats() const;
+	/**@brief Get frame skip count in effect.
+	 * @details Max consecutive skip count if adaptive.
+	 */
+	uint32_t getSkipCount() const { return m_skipCount; }
+	/**@brief Get frame time percentiles of the latest frames.
+	 * @details Can be called from any thread.
+	 * @param[out]	out		Result.
+	 * @param[in]	window	Window size. (frames, <= timer::FrameTimeRing::Capacity)
+	 */
+	void getFrameTimeStats(timer::FrameTimeStats *out, uint32_t window) const;
+	/**@brief Get raw frame time ring buffer.
+	 */
+	const timer::FrameTimeRing &getFrameTimeRing() const { return m_timeRing; }
+	/**@brief Write frame time percentiles and histogram to debug output.
+	 * @details The same lines are also written to trace buffer if trace is enabled.
+	 * @param[in]	window		Window size. (frames)
+	 * @param[in]	binMs		Histogram bin width. [ms]
+	 * @param[in]	binCount	Histogram bin count.
+	 */
+	void dumpFrameTime(uint32_t window, double binMs = 1.0, uint32_t binCount = 50) const;
+	/**@brief Get idle scheduler which runs in the slack before the next frame.
+	 */
+	IdleScheduler &getIdleScheduler() { return m_idle; }
+	/**@brief Get idle scheduler. (const)
+	 */
+	const IdleScheduler &getIdleScheduler() const { return m_idle; }
+	/**@brief Enable per-frame trace output.
+	 * @details trace::initialize() must have been called.
+	 * @param[in]	enable	Write a line per frame to trace buffer.
+	 */
+	void setTrace(bool enable) { m_trace = enable; }
+
+private:
+	std::unique_ptr<timer::Clock> m_clock;
+	timer::PreciseWaiter m_waiter;
+
+	int64_t m_freq;
+	int64_t m_counterPerFrame;
+	int64_t m_base = 0;
+	uint32_t m_skipCount;
+	uint32_t m_frameCount = 0;
+
+	double m_fps = 0.0;
+	uint32_t m_fpsPeriod;
+	uint32_t m_fpsCount = 0;
+	int64_t m_fpsBase = 0;
+	uint32_t m_fpsFrameAcc = 0;
+
+	int64_t m_prevEnd = 0;
+	timer::FrameJitter m_jitter;
+	// current frame breakdown, pushed to ring at endFrame()
+	timer::FrameTimeSample m_sample;
+	timer::FrameTimeRing m_timeRing;
+	IdleScheduler m_idle;
+	bool m_trace = false;
+	// work buffers for jitter calc (reused)
+	std::vector<timer::FrameTimeSample> m_recent;
+	std::vector<int64_t> m_frameTimes;
+
+	bool m_adaptiveSkip;
+	bool m_skipThisFrame = false;
+	// hysteresis state
+	bool m_skipping = false;
+	uint32_t m_skipRun = 0;
+	int64_t m_phaseBase = 0;
+	// rolling average (counter unit)
+	double m_updateCost = 0.0;
+	double m_renderCost = 0.0;
+	uint32_t m_skipAcc = 0;
+	FrameSkipStats m_skipStats;
+
+	void decideSkip(int64_t now);
+};
+
+/**@brief Application parameters.
+ * @details Each field has a default value.
+ */
+struct AppParam {
+	/// hInstance from WinMain.
+	HINSTANCE hInstance = nullptr;
+	/// nCmdShow from WinMain.
+	int nCmdShow = SW_SHOW;
+	/// Window class name.
+	const wchar_t *wndClsName = L"GameWndCls";
+	/// Window title string.
+	const wchar_t *title = L"GameApp";
+	/// hIcon for window class.
+	HICON hIcon = nullptr;
+	/// hIconSm for window class.
+	HICON hIconSm = nullptr;
+	/// Frame skip count.
+	/// (Max consecutive skip count if adaptiveSkip, 0 means the default)
+	uint32_t frameSkip = 0;
+	/// Skip rendering only when it does not fit in the frame time.
+	bool adaptiveSkip = false;
+	/// Frame pacing (wait for the next frame) parameters.
+	timer::WaitParam frameWait;
+	/// Write per-frame time breakdown to trace buffer.
+	bool traceFrameTime = false;
+	/// Job system worker count. (0: hardware concurrency - 1)
+	uint32_t jobWorkers = 0;
+	/// Queue depth of resource file reads. (@ref file::AsyncReader, 0: read in jobs)
+	uint32_t readQueueDepth = 8;
+	/// BGM latency target. [ms] (@ref sound::XAudio2::XAudio2())
+	uint32_t bgmLatencyMs = sound::BgmLatencyDefault;
+	/// Whether shows cursor or not.
+	bool showCursor = false;
+};
+
+/**@brief User application base, which manages a window and DirectX objects.
+ * @details Please inherit this class and override protected methods.
+ */
+class Application : private util::noncopyable {
+public:
+	/**@brief Constructor.
+	 * @details This needs AppParam and graphics::GraphicsParam.
+	 * Valid resource serId is: 0 .. resSetCount-1.
+	 * @param[in]	appParam		%Application parameters.
+	 * @param[in]	graphParam	Graphics parameters.
+	 * @param[in]	resSetCount	Count of resource set.
+	 */
+	Application(const AppParam &appParam, const graphics::GraphicsParam &graphParam,
+		size_t resSetCount);
+	/**@brief Destructor.
+	 */
+	virtual ~Application();
+	/**@brief Start main loop.
+	 * @details Call init() .
+	 * @return msg.wParam, which should be returned from WinMain().
+	 */
+	int run();
+
+	/**@brief Get HWND of the window managed by this class.
+	 */
+	HWND getHWnd() { return m_hWnd; }
+	/**@brief Get graphics parameters.
+	 */
+	void getGraphicsParam(graphics::GraphicsParam *param) { *param = m_graphParam; }
+	/**@brief Get DirectGraphics manager.
+	 */
+	graphics::DGraphics &graph() { return *m_dg.get(); }
+	/**@brief Get XAudio2 manager.
+	 */
+	sound::XAudio2 &sound() { return *m_ds.get(); }
+	/**@brief Get DirectInput manager.
+	 */
+	input::DInput &input() { return *m_di.get(); }
+	/**@brief Get job system.
+	 * @details Can be used for resource loading, audio decoding and user update.
+	 */
+	jobs::JobSystem &jobs() { return *m_jobs.get(); }
+	/**@brief Get idle scheduler.
+	 * @details
+	 * Deferrable work registered here runs on the main thread
+	 * in the slack before the next frame.
+	 */
+	IdleScheduler &idle() { return m_frameCtrl.getIdleScheduler(); }
+	/**@brief Get frame rate controller. (fps, skip and frame time statistics)
+	 */
+	const FrameControl &frameControl() const { return m_frameCtrl; }
+	/**@brief Get heap allocation count in the last frame.
+	 * @details
+	 * Always 0 if @ref arena::isHeapCounterAvailable() is false.
+	 * (release build of Qol.sln)
+	 * @sa @ref arena::getHeapAllocCount()
+	 */
+	uint64_t getHeapAllocPerFrame() const { return m_heapAllocPerFrame; }
+
+	/**@brief Register texture image resource.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @param[in]	path	File path.
+	 * @return			%Resource handle.
+	 */
+	ResourceHandle addTextureResource(size_t setId, const char *resId, const wchar_t *path);
+	/**@brief Register font image resource.
+	 * @param[in]	setId		%Resource set ID.
+	 * @param[in]	resId		%Resource ID.
+	 * @param[in]	fontName	Font family name.
+	 * @param[in]	startChar	The first character.
+	 * @param[in]	endChar	The last character.
+	 * @param[in]	w			Font image width.
+	 * @param[in]	h			Font image height.
+	 * @return					%Resource handle.
+	 */
+	ResourceHandle addFontResource(size_t setId, const char *resId,
+		const wchar_t *fontName, uint32_t startChar, uint32_t endChar,
+		uint32_t w, uint32_t h);
+	/**@brief Register sound effect resource.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @param[in]	path	File path.
+	 * @return			%Resource handle.
+	 */
+	ResourceHandle addSeResource(size_t setId, const char *resId, const wchar_t *path);
+	/**@brief Register BGM resource.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @param[in]	path	File path.
+	 * @return			%Resource handle.
+	 */
+	ResourceHandle addBgmResource(size_t setId, const char *resId, const wchar_t *path);
+
+	/**@brief Set the lock state of resources.
+	 * @details If resource manager is sealed, addXXXResource() will be failed.
+	 * @param[in]	seal	new state.
+	 * @sa @ref UnsealResource
+	 */
+	void sealResource(bool seal);
+
+	/**@brief Register all resources listed in a manifest.
+	 * @details
+	 * Registering the same (set, ID) with the same path later
+	 * (e.g. by script) returns the same handle, so that the manifest can
+	 * be used as a head start of the normal registration code.
+	 * @param[in]	fileName	Manifest file name. (file::loadFile())
+	 * @return		Registered entry count.
+	 */
+	size_t loadManifest(const wchar_t *fileName);
+	/**@brief Start recording addXxxResource() calls for a manifest.
+	 */
+	void startManifestRecording();
+	/**@brief Write recorded registrations as a manifest.
+	 * @param[in]	path	File path. (real file system)
+	 */
+	void saveManifest(const wchar_t *path);
+
+	/**@brief Load resources by resource set ID.
+	 * @details This function blocks until all resource is loaded.
+	 * Resources are loaded in parallel by the job system.
+	 * Processing can be cancelled by writing true to cancel from another thread.
+	 * @param[in]	setId		%Resource set ID.
+	 * @param[in]	cancel		async cancel atomic
+	 * @param[out]	progress	Progress counters. (can be nullptr)
+	 */
+	void loadResourceSet(size_t setId, std::atomic_bool &cancel,
+		LoadProgress *progress = nullptr);
+	/**@brief Unload resources by resource set ID.
+	 * @param[in]	setId	%Resource set ID.
+	 */
+	void unloadResourceSet(size_t setId);
+	/**@brief Switch resource set on scene transition.
+	 * @details
+	 * Resources common to both sets (same file path or font parameters)
+	 * are kept and only the difference is loaded.
+	 * Bytes reused and reloaded are logged and returned.
+	 * @param[in]	fromSet		%Resource set ID of the old scene.
+	 * @param[in]	toSet		%Resource set ID of the new scene.
+	 * @param[in]	cancel		async cancel atomic
+	 * @param[out]	progress	Progress counters. (can be nullptr)
+	 * @sa @ref ResourceManager::switchResourceSet()
+	 */
+	SetSwitchStats switchResourceSet(size_t fromSet, size_t toSet,
+		std::atomic_bool &cancel, LoadProgress *progress = nullptr);
+	/**@brief Load resources in background while the current scene plays.
+	 * @details
+	 * Throttled by param not to disturb the frame rate.
+	 * loadResourceSet() of the same set later promotes it to full speed
+	 * and loads only the rest, so the loading screen gets shorter.
+	 * @param[in]	setId		%Resource set ID.
+	 * @param[in]	param		Throttle parameters.
+	 * @param[out]	progress	Progress counters. (can be nullptr, must outlive the prefetch)
+	 * @sa @ref ResourceManager::prefetchResourceSet()
+	 */
+	void prefetchResourceSet(size_t setId, const PrefetchParam &param = PrefetchParam(),
+		LoadProgress *progress = nullptr);
+	/**@brief Cancel background loading of a resource set.
+	 * @param[in]	setId	%Resource set ID.
+	 */
+	void cancelPrefetch(size_t setId);
+	/**@brief Returns true if background loading of a resource set is in progress.
+	 * @param[in]	setId	%Resource set ID.
+	 */
+	bool isPrefetching(size_t setId) const;
+
+	/**@brief Set memory budget of a resource type. (cache mode)
+	 * @details
+	 * Least recently used resources which are not referenced are unloaded
+	 * at the beginning of frames while over budget,
+	 * and reloaded transparently by the next getXxx() call.
+	 * @param[in]	type	%Resource type.
+	 * @param[in]	bytes	Memory budget. (0: unlimited, cache mode off)
+	 */
+	void setResourceCacheBudget(ResourceType type, size_t bytes);
+	/**@brief Get resource cache statistics. (hit, miss, eviction, size, sharing)
+	 * @param[in]	type	%Resource type.
+	 */
+	CacheStats getResourceCacheStats(ResourceType type) const;
+
+	/**@brief Get texture resource pointer.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @details In cache mode, it is loaded if it has been evicted.
+	 */
+	const graphics::DGraphics::TextureResourcePtr getTexture(
+		size_t setId, const char *resId);
+	/**@brief Get font resource pointer.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 */
+	const graphics::DGraphics::FontResourcePtr getFont(
+		size_t setId, const char *resId);
+	/**@brief Get sound effect resource pointer.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 */
+	const sound::XAudio2::SeResourcePtr getSoundEffect(
+		size_t setId, const char *resId);
+	/**@brief Get BGM resource pointer.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 */
+	const sound::XAudio2::BgmResourcePtr getBgm(
+		size_t setId, const char *resId);
+
+	/**@brief Get resource handle by name.
+	 * @details
+	 * Name lookup is done here only once.
+	 * Getting resource by handle is a plain array index.
+	 * @param[in]	type	%Resource type.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @return				%Resource handle.
+	 */
+	ResourceHandle getResourceHandle(ResourceType type, size_t setId, const char *resId) const;
+	/**@brief Get texture resource pointer by handle.
+	 * @param[in]	handle	Return value of addTextureResource() or getResourceHandle().
+	 */
+	const graphics::DGraphics::TextureResourcePtr getTexture(ResourceHandle handle);
+	/**@brief Get font resource pointer by handle.
+	 * @param[in]	handle	Return value of addFontResource() or getResourceHandle().
+	 */
+	const graphics::DGraphics::FontResourcePtr getFont(ResourceHandle handle);
+	/**@brief Get sound effect resource pointer by handle.
+	 * @param[in]	handle	Return value of addSeResource() or getResourceHandle().
+	 */
+	const sound::XAudio2::SeResourcePtr getSoundEffect(ResourceHandle handle);
+	/**@brief Get BGM resource pointer by handle.
+	 * @param[in]	handle	Return value of addBgmResource() or getResourceHandle().
+	 */
+	const sound::XAudio2::BgmResourcePtr getBgm(ResourceHandle handle);
+	/**@brief Get texture resource view by handle.
+	 * @details
+	 * Lock-free and no reference counting. Valid until the end of the frame.
+	 * Use this for drawing in frame loop.
+	 * @param[in]	handle	Return value of addTextureResource() or getResourceHandle().
+	 */
+	const graphics::DGraphics::TextureResource *getTextureView(ResourceHandle handle);
+	/**@brief Get font resource view by handle.
+	 * @details
+	 * Lock-free and no reference counting. Valid until the end of the frame.
+	 * @param[in]	handle	Return value of addFontResource() or getResourceHandle().
+	 */
+	const graphics::DGraphics::FontResource *getFontView(ResourceHandle handle);
+
+protected:
+	/**@brief User initialization code.
+	 * @details Called at the beginning of @ref run().
+	 */
+	virtual void init() = 0;
+	/**@brief Process frame.
+	 * @details Called at the beginning of every frame.
+	 */
+	virtual void update() = 0;
+	/**@brief Process rendering.
+	 * @details Called after @ref update(), unless frame skipping.
+	 */
+	virtual void render() = 0;
+
+private:
+	const UINT_PTR TimerEventId = 0xffff0001;
+
+	HWND m_hWnd;
+	std::unique_ptr<graphics::DGraphics> m_dg;
+	std::unique_ptr<sound::XAudio2> m_ds;
+	std::unique_ptr<input::DInput> m_di;
+	ResourceManager m_resMgr;
+	manifest::Recorder m_manifestRec;
+	// destructed first: jobs may use the objects above
+	std::unique_ptr<jobs::JobSystem> m_jobs;
+	// destructed before m_jobs: completions submit jobs
+	std::unique_ptr<file::AsyncReader> m_reader;
+
+	AppParam m_param;
+	graphics::GraphicsParam m_graphParam;
+	FrameControl m_frameCtrl;
+	uint64_t m_heapAllocBase = 0;
+	uint64_t m_heapAllocPerFrame = 0;
+
+	void initializeWindow();
+	static LRESULT CALLBACK wndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+	LRESULT onSize(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+
+	void onIdle();
+	void updateInternal();
+	void renderInternal();
+};
+
+/**@brief Auto re-seal helper
+ * @sa @ref Application::sealResource()
+ */
+class UnsealResource : util::noncopyable {
+public:
+	explicit UnsealResource(Application &app) : m_app(app)
+	{
+		m_app.sealResource(false);
+	}
+	~UnsealResource()
+	{
+		m_app.sealResource(true);
+	}
+
+private:
+	Application &m_app;
+};
+
+}	// namespace framework
+}	// namespace yappy
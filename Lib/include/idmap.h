@@ -0,0 +1,136 @@
+﻿/**@file
+ * @brief Read-only hash table of IdString keys.
+ */
+
+#pragma once
+
+#include "util.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <utility>
+
+namespace yappy {
+namespace util {
+
+/**@brief IdString as two 64-bit words.
+ * @details Compared by two integer compares instead of 16 char compares.
+ */
+struct IdWords {
+	uint64_t w0, w1;
+
+	explicit IdWords(const IdString &id)
+	{
+		static_assert(sizeof(IdString) == sizeof(uint64_t) * 2, "IdString size");
+		std::memcpy(&w0, id.data(), sizeof(w0));
+		std::memcpy(&w1, id.data() + sizeof(w0), sizeof(w1));
+	}
+	bool operator==(const IdWords &rhs) const
+	{
+		return ((w0 ^ rhs.w0) | (w1 ^ rhs.w1)) == 0;
+	}
+	bool operator!=(const IdWords &rhs) const
+	{
+		return !(*this == rhs);
+	}
+};
+
+/**@brief Frozen perfect hash map: IdString -> uint32_t.
+ * @details
+ * Built once from a fixed key set and never modified (hash and displace).
+ * A key is hashed to a bucket, and the seed stored in the bucket gives
+ * the slot, which is collision-free for all registered keys.
+ * Lookup is two array reads and one key compare, with no chaining.
+ *
+ * Slots are a flat array of {key, value} (24 bytes each).
+ */
+class FrozenIdMap {
+public:
+	/// Return value of find() if not found.
+	static const uint32_t NotFound = 0xffffffffu;
+
+	FrozenIdMap() = default;
+	~FrozenIdMap() = default;
+
+	/**@brief Build from (key, value) list.
+	 * @param[in]	entries	Key and value pairs. Keys must be unique.
+	 * @exception	error::FrameworkError	Duplicate keys.
+	 */
+	void build(const std::vector<std::pair<IdString, uint32_t>> &entries);
+	/**@brief Make empty.
+	 */
+	void clear();
+	/**@brief Registered key count.
+	 */
+	size_t size() const { return m_count; }
+
+	/**@brief Find value.
+	 * @param[in]	key	Key.
+	 * @return		Value, or @ref NotFound.
+	 */
+	uint32_t find(const IdString &key) const
+	{
+		if (m_count == 0) {
+			return NotFound;
+		}
+		IdWords words(key);
+		uint64_t h = hashKey(words);
+		uint32_t seed = m_seeds[h & m_bucketMask];
+		const Slot &slot = m_slots[slotIndex(h, seed)];
+		return (slot.key == words) ? slot.value : NotFound;
+	}
+
+private:
+	struct Slot {
+		IdWords key;
+		uint32_t value;
+	};
+
+	size_t m_count = 0;
+	uint64_t m_bucketMask = 0;
+	uint64_t m_slotMask = 0;
+	// bucket -> seed (0: empty bucket)
+	std::vector<uint32_t> m_seeds;
+	std::vector<Slot> m_slots;
+
+	static uint64_t mix(uint64_t x)
+	{
+		x ^= x >> 33;
+		x *= 0xff51afd7ed558ccdull;
+		x ^= x >> 33;
+		x *= 0xc4ceb9fe1a85ec53ull;
+		x ^= x >> 33;
+		return x;
+	}
+	static uint64_t hashKey(const IdWords &words)
+	{
+		return mix(words.w0 ^ mix(words.w1 + 0x9e3779b97f4a7c15ull));
+	}
+	uint64_t slotIndex(uint64_t h, uint32_t seed) const
+	{
+		return mix(h ^ (seed * 0x9e3779b97f4a7c15ull)) & m_slotMask;
+	}
+};
+
+/// Result of @ref benchmarkIdMap().
+struct IdMapBenchResult {
+	uint32_t count = 0;
+	uint32_t lookups = 0;
+	/// std::unordered_map<IdString, uint32_t> with std::hash<IdString>. [ns/lookup]
+	double unorderedNs = 0.0;
+	/// FrozenIdMap. [ns/lookup]
+	double frozenNs = 0.0;
+	/// FrozenIdMap build time. [ms]
+	double buildMs = 0.0;
+};
+
+/**@brief Microbenchmark of FrozenIdMap against std::unordered_map.
+ * @details Keys are "res00000", "res00001", ... (hit only, random order)
+ * @param[in]	count	Key count.
+ * @param[in]	lookups	Lookup count.
+ * @return		Result.
+ */
+IdMapBenchResult benchmarkIdMap(uint32_t count, uint32_t lookups);
+
+}	// namespace util
+}	// namespace yappy
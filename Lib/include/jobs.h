@@ -0,0 +1,194 @@
+﻿/**@file
+ * @brief Work-stealing job system.
+ */
+
+#pragma once
+
+#include "util.h"
+#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <functional>
+#include <exception>
+#include <algorithm>
+
+namespace yappy {
+/// Work-stealing job system.
+namespace jobs {
+
+/// Job function.
+using JobFunc = std::function<void()>;
+
+class JobSystem;
+
+/**@brief Counter of unfinished jobs.
+ * @details
+ * Incremented when a job is submitted with this counter and
+ * decremented when the job finishes.
+ * Jobs can be scheduled to run after a counter reaches 0.
+ * (@ref JobSystem::runAfter())
+ *
+ * The first exception thrown by the jobs is kept and
+ * rethrown by @ref JobSystem::wait().
+ * Must outlive all the jobs associated with it.
+ */
+class JobCounter : private util::noncopyable {
+public:
+	JobCounter() = default;
+	~JobCounter() = default;
+
+	/**@brief Returns true if all associated jobs have finished.
+	 */
+	bool isDone() const;
+
+private:
+	friend class JobSystem;
+
+	struct Job {
+		JobFunc func;
+		JobCounter *counter;
+	};
+
+	mutable std::mutex m_lock;
+	uint32_t m_count = 0;
+	std::vector<Job> m_continuations;
+	std::exception_ptr m_error;
+};
+
+/// Job system statistics.
+struct JobStats {
+	/// Worker thread count.
+	uint32_t workers = 0;
+	/// Executed job count. (including jobs executed by waiting threads)
+	uint64_t executed = 0;
+	/// Jobs taken from another worker's deque.
+	uint64_t stolen = 0;
+	/// Jobs taken from the global queue.
+	uint64_t injected = 0;
+};
+
+/**@brief Work-stealing thread pool.
+ * @details
+ * Each worker has its own deque. A worker pushes and pops at the back of
+ * its deque (LIFO, cache friendly), and steals from the front of other
+ * workers' deques (FIFO) when it runs out of jobs.
+ * Jobs submitted from non-worker threads go to the global queue.
+ *
+ * Threads waiting for a counter execute other jobs in the meantime,
+ * so wait() can be called from jobs without deadlock.
+ * When no job is left to take, they sleep until a job is queued or
+ * the counter reaches 0.
+ * Deques are guarded by small per-deque locks; contention is rare because
+ * only thieves touch other workers' deques.
+ */
+class JobSystem : private util::noncopyable {
+public:
+	/**@brief Start worker threads.
+	 * @param[in]	workerCount	Worker count.
+	 * (0: hardware concurrency - 1, at least 1)
+	 */
+	explicit JobSystem(uint32_t workerCount = 0);
+	/**@brief Stop and join worker threads.
+	 * @details Jobs remaining in queues are discarded.
+	 */
+	~JobSystem();
+
+	/**@brief Get worker thread count.
+	 */
+	uint32_t getWorkerCount() const;
+	/**@brief Get statistics.
+	 */
+	JobStats getStats() const;
+
+	/**@brief Submit a job.
+	 * @param[in]	func	Job function.
+	 * @param[in]	counter	Counter to be decremented at finish. (can be nullptr)
+	 */
+	void run(JobFunc func, JobCounter *counter = nullptr);
+	/**@brief Submit a job which runs after all jobs of dependency have finished.
+	 * @param[in]	dependency	Counter to wait for.
+	 * @param[in]	func		Job function.
+	 * @param[in]	counter		Counter to be decremented at finish. (can be nullptr)
+	 */
+	void runAfter(JobCounter &dependency, JobFunc func, JobCounter *counter = nullptr);
+	/**@brief Wait until counter reaches 0.
+	 * @details
+	 * The calling thread executes other jobs while waiting,
+	 * and sleeps if there is none.
+	 * If a job associated with counter has thrown an exception,
+	 * rethrows it (only once).
+	 * @param[in]	counter	Counter to wait for.
+	 */
+	void wait(JobCounter &counter);
+
+	/**@brief Parallel for loop.
+	 * @details
+	 * Calls func(i) for i in [begin, end), split into jobs of grain iterations.
+	 * Blocks until all iterations have finished.
+	 * @param[in]	begin	The first index.
+	 * @param[in]	end		The last index + 1.
+	 * @param[in]	grain	Iteration count per job.
+	 * @param[in]	func	Called as func(size_t i).
+	 */
+	template <class F>
+	void parallelFor(size_t begin, size_t end, size_t grain, F func)
+	{
+		if (begin >= end) {
+			return;
+		}
+		grain = std::max<size_t>(grain, 1);
+		JobCounter counter;
+		for (size_t i = begin; i < end; i += grain) {
+			size_t last = std::min(end - i, grain) + i;
+			run([i, last, &func]() {
+				for (size_t k = i; k < last; k++) {
+					func(k);
+				}
+			}, &counter);
+		}
+		wait(counter);
+	}
+
+private:
+	using Job = JobCounter::Job;
+
+	struct alignas(64) Worker {
+		std::mutex lock;
+		std::deque<Job> deque;
+		std::atomic<uint64_t> executed;
+		std::atomic<uint64_t> stolen;
+		std::atomic<uint64_t> injected;
+		uint32_t random;
+	};
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::vector<std::thread> m_threads;
+
+	std::mutex m_globalLock;
+	std::deque<Job> m_global;
+	// stats of non-worker threads
+	std::atomic<uint64_t> m_externalExecuted;
+
+	// queued job count (all deques + global)
+	std::atomic<uint32_t> m_queued;
+	std::mutex m_sleepLock;
+	std::condition_variable m_wake;
+	// threads sleeping in wait() (guarded by m_sleepLock)
+	uint32_t m_waiters;
+	std::condition_variable m_waitWake;
+	std::atomic<bool> m_stop;
+
+	void push(Job &&job);
+	bool tryPop(Job *job);
+	void execute(Job &job);
+	void finish(JobCounter *counter, std::exception_ptr error);
+	void workerMain(uint32_t index);
+	int getCurrentWorker() const;
+};
+
+}	// namespace jobs
+}	// namespace yappy
@@ -0,0 +1,85 @@
+﻿/**@file
+ * @brief Fast LZ77 block compression.
+ * @details
+ * Byte-oriented LZ77 without entropy coding (LZ4 class), so that
+ * decompression runs at memory copy speed.
+ * Data is compressed in independent blocks, the caller keeps block sizes.
+ *
+ * Sequence format:
+ * @li Token: literal length (high 4 bits), match length - 4 (low 4 bits).
+ * 15 means that bytes follow. (add until a byte is not 255)
+ * @li Literals.
+ * @li Match offset. (uint16, little endian, 1 or more)
+ * @li Extra match length bytes.
+ *
+ * The last sequence has only literals.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace yappy {
+/// Fast LZ77 block compression.
+namespace lz {
+
+/// Minimum match length.
+const size_t MinMatch = 4;
+/// Maximum match offset.
+const size_t MaxOffset = 65535;
+
+/**@brief Get worst case of compressed size.
+ * @param[in]	srcSize	Input size.
+ * @return		Buffer size enough for compress().
+ */
+inline size_t compressBound(size_t srcSize)
+{
+	return srcSize + srcSize / 255 + 16;
+}
+
+/**@brief Compress a block.
+ * @param[in]	src		Input data.
+ * @param[in]	srcSize	Input size.
+ * @param[out]	dst		Output buffer.
+ * @param[in]	dstSize	Output buffer size.
+ * @return		Compressed size.
+ * 0 if the result does not fit in dst or is not smaller than the input.
+ */
+size_t compress(const void *src, size_t srcSize, void *dst, size_t dstSize);
+
+/**@brief Decompress a block.
+ * @details
+ * Input is fully checked, broken data never causes out of bounds access.
+ * @param[in]	src		Compressed data.
+ * @param[in]	srcSize	Compressed size.
+ * @param[out]	dst		Output buffer.
+ * @param[in]	dstSize	Original size. (must be exact)
+ * @exception	error::FrameworkError	Broken data.
+ */
+void decompress(const void *src, size_t srcSize, void *dst, size_t dstSize);
+
+/// Result of @ref benchmark().
+struct BenchResult {
+	/// Input size.
+	uint64_t rawBytes = 0;
+	/// Total compressed size of blocks. (incompressible blocks are counted as raw)
+	uint64_t compressedBytes = 0;
+	/// Compression speed. [MB/s of input]
+	double compressMBps = 0.0;
+	/// Decompression speed on one thread. [MB/s of output]
+	double decompressMBps = 0.0;
+};
+
+/**@brief Measure ratio and speed of compression in blocks.
+ * @details Result is also written to debug output.
+ * @param[in]	data		Input data.
+ * @param[in]	size		Input size.
+ * @param[in]	blockSize	Block size.
+ * @param[in]	rounds		Repeat count.
+ * @return		Result.
+ */
+BenchResult benchmark(const void *data, size_t size, size_t blockSize, uint32_t rounds);
+
+}	// namespace lz
+}	// namespace yappy
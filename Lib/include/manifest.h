@@ -0,0 +1,100 @@
+﻿/**@file
+ * @brief Binary resource manifest.
+ * @details
+ * A manifest lists resource registrations (set, ID, type and path),
+ * so that all resources can be registered in one pass at process start
+ * without running the scripts which register them.
+ * It is generated by recording a normal run. (@ref Recorder)
+ *
+ * Format (little endian):
+ * @li Header: magic "YRMF", version, entry count, string table size. (uint32 x 4)
+ * @li Entries: type, setId, resId offset, path offset,
+ * startChar, endChar, w, h. (uint32 x 8 each)
+ * @li String table: UTF-8, null-terminated.
+ */
+
+#pragma once
+
+#include "util.h"
+#include "file.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+
+namespace yappy {
+/// Binary resource manifest.
+namespace manifest {
+
+/// %Resource type. (same order as framework::ResourceType)
+enum class EntryType : uint32_t {
+	Texture,
+	Font,
+	SoundEffect,
+	Bgm,
+	Count
+};
+
+/// A resource registration.
+struct Entry {
+	EntryType type = EntryType::Texture;
+	uint32_t setId = 0;
+	std::string resId;
+	/// File path. (font name for EntryType::Font)
+	std::wstring path;
+	/// @name Font parameters (EntryType::Font only)
+	//@{
+	uint32_t startChar = 0;
+	uint32_t endChar = 0;
+	uint32_t w = 0;
+	uint32_t h = 0;
+	//@}
+};
+
+/**@brief Convert entries to binary manifest.
+ * @param[in]	entries	Entries.
+ * @return		Binary manifest.
+ */
+file::Bytes serialize(const std::vector<Entry> &entries);
+/**@brief Parse binary manifest.
+ * @details Throws FrameworkError if broken.
+ * @param[in]	bin	Binary manifest.
+ * @return		Entries in the recorded order.
+ */
+std::vector<Entry> parse(const file::Bytes &bin);
+
+/**@brief Load and parse a manifest from abstract file system.
+ * @param[in]	fileName	File name. (file::loadFile())
+ */
+std::vector<Entry> load(const wchar_t *fileName);
+/**@brief Write a manifest to real file system.
+ * @param[in]	path	File path.
+ * @param[in]	entries	Entries.
+ */
+void save(const wchar_t *path, const std::vector<Entry> &entries);
+
+/**@brief Records resource registrations of a run.
+ * @details Thread-safe. The same (set, ID) is recorded only once.
+ */
+class Recorder : private util::noncopyable {
+public:
+	Recorder() = default;
+	~Recorder() = default;
+
+	void setEnabled(bool enabled);
+	bool isEnabled() const;
+	/**@brief Add an entry if enabled.
+	 */
+	void record(const Entry &entry);
+	/**@brief Get a copy of recorded entries.
+	 */
+	std::vector<Entry> getEntries() const;
+
+private:
+	mutable std::mutex m_lock;
+	bool m_enabled = false;
+	std::vector<Entry> m_entries;
+};
+
+}	// namespace manifest
+}	// namespace yappy
@@ -1,12 +1,12 @@
-﻿#pragma once
-
-#include "util.h"
-
-namespace yappy {
-namespace network {
-
-void initialize();
-void finalize() noexcept;
-
-}   // namespace network
-}   // namespace yappy
+﻿#pragma once
+
+#include "util.h"
+
+namespace yappy {
+namespace network {
+
+void initialize();
+void finalize() noexcept;
+
+}   // namespace network
+}   // namespace yappy
@@ -0,0 +1,284 @@
+﻿/**@file
+ * @brief Thin OS abstraction layer.
+ * @details
+ * Clocks, file handles, memory mapping, virtual memory, heaps,
+ * UTF conversion, threads and debug output.
+ * @li Windows: Win32 API.
+ * @li POSIX: POSIX API. (Linux for perf measurement and CI)
+ *
+ * wchar_t is UTF-16 on Windows and UTF-32 on POSIX.
+ * This header does not include OS headers.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <cstdarg>
+#include <string>
+#include <functional>
+
+namespace yappy {
+/// Thin OS abstraction layer.
+namespace platform {
+
+/**@brief Get the error code of the last failed OS call on this thread.
+ * @return	GetLastError() or errno.
+ */
+uint32_t getLastError();
+/**@brief Get a description of an OS error code.
+ * @param[in]	code	Error code from @ref getLastError().
+ * @return		Message string.
+ */
+std::string getErrorMessage(uint32_t code);
+/**@brief Break into the debugger.
+ */
+void debugBreak();
+
+/**@brief Get monotonic high-resolution counter.
+ * @return	Counter value.
+ */
+int64_t getCounter();
+/**@brief Get frequency of @ref getCounter().
+ * @return	counter/sec
+ */
+int64_t getCounterFrequency();
+
+/**@brief Wide char to UTF-8.
+ * @param[in]	in			Wide string. ('\\0' terminated)
+ * @param[out]	out			Output buffer. (nullptr: size only)
+ * @param[in]	outCount	Output buffer size in chars.
+ * @return		Required size in chars, including '\\0'.
+ */
+size_t wcToUtf8(const wchar_t *in, char *out, size_t outCount);
+/**@brief UTF-8 to wide char.
+ * @param[in]	in			UTF-8 string. ('\\0' terminated)
+ * @param[out]	out			Output buffer. (nullptr: size only)
+ * @param[in]	outCount	Output buffer size in wchar_t.
+ * @return		Required size in wchar_t, including '\\0'.
+ */
+size_t utf8ToWc(const char *in, wchar_t *out, size_t outCount);
+/**@brief vswprintf() with Windows format semantics.
+ * @details
+ * "%s" and "%c" mean wide string and wide char on every platform.
+ * The result is truncated to fit in buf.
+ * @param[out]	buf		Output buffer.
+ * @param[in]	count	Buffer size in wchar_t.
+ * @param[in]	fmt		Format string.
+ * @param[in]	args	Arguments.
+ */
+void formatWide(wchar_t *buf, size_t count, const wchar_t *fmt, va_list args);
+
+/**@brief Write to the debugger. (stderr on POSIX)
+ * @param[in]	str	String.
+ */
+void writeDebugOutput(const wchar_t *str);
+/**@brief Open a console window. (stdout on POSIX)
+ * @return	true if succeeded.
+ */
+bool openConsole();
+/**@brief Close the console window opened by @ref openConsole().
+ */
+void closeConsole();
+/**@brief Write to the console.
+ * @param[in]	str	String.
+ */
+void writeConsole(const wchar_t *str);
+/**@brief Read a line from the console. (stdin on POSIX)
+ * @param[out]	line	Line read. (without new line)
+ * @return	false if failed or end of input.
+ */
+bool readConsole(std::wstring *line);
+
+/// Access pattern hint for OS cache.
+enum class AccessHint {
+	/// Default.
+	Normal,
+	/// Read from the beginning to the end.
+	Sequential,
+	/// Random access.
+	Random,
+};
+
+/**@brief Move-only file handle.
+ * @details Error is reported by Win32Error (also on POSIX, with errno).
+ */
+class FileHandle {
+public:
+	FileHandle() = default;
+	FileHandle(FileHandle &&other) noexcept;
+	FileHandle &operator=(FileHandle &&other) noexcept;
+	FileHandle(const FileHandle &) = delete;
+	FileHandle &operator=(const FileHandle &) = delete;
+	~FileHandle();
+
+	/**@brief Open an existing file to read.
+	 * @param[in]	path	File path.
+	 * @param[in]	hint	Access pattern.
+	 * @return		File handle.
+	 */
+	static FileHandle openRead(const wchar_t *path, AccessHint hint = AccessHint::Normal);
+	/**@brief Create or truncate a file to write.
+	 * @param[in]	path	File path.
+	 * @return		File handle.
+	 */
+	static FileHandle createWrite(const wchar_t *path);
+
+	/// Returns true if a file is open.
+	bool isOpen() const { return m_handle != InvalidHandle; }
+	/// HANDLE or file descriptor. (for OS async I/O)
+	intptr_t getNative() const { return m_handle; }
+	/// Close the file. (no effect if not open)
+	void close() noexcept;
+	/// Get file size.
+	uint64_t getSize() const;
+	/**@brief Read from the current position.
+	 * @return	Read size. (smaller at the end of file)
+	 */
+	size_t read(void *buf, size_t size);
+	/**@brief Read from offset. (the current position is undefined after this)
+	 * @return	Read size. (smaller at the end of file)
+	 */
+	size_t readAt(void *buf, size_t size, uint64_t offset);
+	/**@brief Write all data at the current position.
+	 */
+	void write(const void *buf, size_t size);
+
+private:
+	// HANDLE or file descriptor
+	static const intptr_t InvalidHandle = -1;
+	intptr_t m_handle = InvalidHandle;
+
+	explicit FileHandle(intptr_t handle) : m_handle(handle) {}
+
+	friend const uint8_t *mapFile(const wchar_t *path, AccessHint hint, uint64_t *size);
+};
+
+/**@brief _wfopen() on every platform.
+ * @param[in]	path	File path.
+ * @param[in]	mode	fopen() mode string. ("rb", "wb", ...)
+ * @return		FILE pointer. (nullptr if failed)
+ */
+FILE *openFile(const wchar_t *path, const char *mode);
+/**@brief 64-bit fseek().
+ * @return	0 if succeeded.
+ */
+int seekFile(FILE *fp, int64_t offset, int origin);
+
+/// Result of @ref getFileInfo().
+struct FileInfo {
+	/// Directory.
+	bool isDirectory = false;
+	/// File size.
+	uint64_t size = 0;
+};
+/**@brief Get file or directory information.
+ * @param[in]	path	Path.
+ * @param[out]	info	Information.
+ * @return		false if not found.
+ */
+bool getFileInfo(const wchar_t *path, FileInfo *info);
+/**@brief Enumerate entries in a directory. ("." and ".." are skipped)
+ * @param[in]	dir			Directory path.
+ * @param[in]	callback	Called as callback(name, isDirectory).
+ */
+void listDirectory(const wchar_t *dir,
+	const std::function<void(const wchar_t *name, bool isDirectory)> &callback);
+/**@brief Get the directory of the executable. (computed once)
+ * @return	Path with the last separator.
+ */
+const std::wstring &getExecutableDir();
+/**@brief Create an empty temporary file.
+ * @param[in]	prefix	File name prefix.
+ * @return		File path.
+ */
+std::wstring createTempFile(const wchar_t *prefix);
+
+/**@brief Map a whole file read-only.
+ * @details The file can be closed after this. (the mapping keeps it)
+ * @param[in]	path	File path.
+ * @param[in]	hint	Access pattern.
+ * @param[out]	size	File size.
+ * @return		Start address. (nullptr if the file is empty)
+ */
+const uint8_t *mapFile(const wchar_t *path, AccessHint hint, uint64_t *size);
+/**@brief Unmap a file mapped by @ref mapFile().
+ */
+void unmapFile(const uint8_t *base, uint64_t size) noexcept;
+/**@brief Start reading pages of a mapped range without blocking.
+ * @details
+ * PrefetchVirtualMemory() (Windows 8 or later, no effect on older OS)
+ * or madvise(MADV_WILLNEED).
+ * @return	false if not supported.
+ */
+bool prefetchMemory(const void *p, size_t size);
+/**@brief Drop cached pages of a file from the OS file cache. (for cold read benchmarks)
+ * @details
+ * Opens the file with FILE_FLAG_NO_BUFFERING, which purges its cached data
+ * unless another cached handle is open,
+ * or fdatasync() and posix_fadvise(POSIX_FADV_DONTNEED).
+ * @param[in]	path	File path.
+ * @return	false if failed.
+ */
+bool evictFileCache(const wchar_t *path);
+
+/**@brief Get virtual memory page size.
+ */
+size_t getPageSize();
+/**@brief Allocate zero-filled pages. (reserve and commit)
+ * @param[in]	size	Size in bytes.
+ * @return		Start address.
+ */
+void *allocatePages(size_t size);
+/**@brief Free pages allocated by @ref allocatePages().
+ */
+void freePages(void *p, size_t size) noexcept;
+
+/**@brief Private heap with a size limit.
+ * @details
+ * HeapCreate() on Windows, malloc() with a byte counter on POSIX.
+ * Not thread-safe. (HEAP_NO_SERIALIZE)
+ * Old sizes must be given by the caller. (Lua allocator has them)
+ */
+class Heap {
+public:
+	/**@brief Create a heap.
+	 * @param[in]	initSize	Initial commit size. (Windows only)
+	 * @param[in]	maxSize		Max size. (0: growable without limit)
+	 */
+	Heap(size_t initSize, size_t maxSize);
+	Heap(const Heap &) = delete;
+	Heap &operator=(const Heap &) = delete;
+	~Heap();
+
+	/// malloc(). nullptr if failed or over the limit.
+	void *allocate(size_t size);
+	/// realloc(). nullptr if failed or over the limit. (p is still valid)
+	void *reallocate(void *p, size_t oldSize, size_t size);
+	/// free().
+	void free(void *p, size_t size) noexcept;
+
+private:
+	// HANDLE (Windows)
+	void *m_heap = nullptr;
+	size_t m_maxSize = 0;
+	size_t m_used = 0;
+};
+
+/**@brief Set the name of the current thread for debuggers and profilers.
+ * @details
+ * SetThreadDescription() (Windows 10 1607 or later, no effect on older OS)
+ * or pthread_setname_np(). (truncated to 15 chars)
+ * @param[in]	name	Thread name.
+ */
+void setThreadName(const wchar_t *name);
+/**@brief Get the OS thread ID of the current thread.
+ */
+uint32_t getCurrentThreadId();
+/**@brief Hint for spin-wait loops. (pause instruction)
+ */
+void yieldProcessor();
+
+}	// namespace platform
+}	// namespace yappy
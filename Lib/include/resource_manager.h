@@ -0,0 +1,919 @@
+﻿/**@file
+ * @brief Resource loading, memory cache and resource sets.
+ * @details
+ * Independent of graphics and sound: resource types are template parameters.
+ */
+
+#pragma once
+
+#include "util.h"
+#include "debug.h"
+#include "exceptions.h"
+#include "file.h"
+#include "jobs.h"
+#include "idmap.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace yappy {
+namespace framework {
+
+using error::throwTrace;
+using error::FrameworkError;
+
+/// %Resource ID is fixed-length string; char[16].
+using IdString = util::IdString;
+
+/// %Resource type.
+enum class ResourceType {
+	Texture,
+	Font,
+	SoundEffect,
+	Bgm,
+	/// Count of types.
+	Count,
+};
+
+/// %Resource cache statistics of a resource type.
+struct CacheStats {
+	/// Memory budget. (0: unlimited)
+	size_t budget = 0;
+	/// Total memory size of loaded resources.
+	size_t used = 0;
+	/// Get requests for a loaded resource.
+	uint64_t hit = 0;
+	/// Get requests which (re)loaded the resource.
+	uint64_t miss = 0;
+	/// Resources unloaded to fit in the budget.
+	uint64_t evict = 0;
+	/// Loads served by an already loaded resource with the same content.
+	uint64_t shared = 0;
+	/// Memory saved by sharing. (not included in used)
+	size_t saved = 0;
+};
+
+/**@brief Memory accounting of a resource type.
+ * @details Shared by all Resource objects of the type.
+ */
+struct ResourceCache {
+	/// Memory budget. (0: unlimited, cache mode off)
+	std::atomic<size_t> budget{ 0 };
+	std::atomic<size_t> used{ 0 };
+	std::atomic<uint64_t> hit{ 0 };
+	std::atomic<uint64_t> miss{ 0 };
+	std::atomic<uint64_t> evict{ 0 };
+	/// Loads served by an already loaded resource of the same key.
+	std::atomic<uint64_t> shared{ 0 };
+	/// Memory not allocated thanks to sharing. (current)
+	std::atomic<size_t> saved{ 0 };
+
+	/**@brief Register a loaded payload, or get the one already registered.
+	 * @details
+	 * Payloads are shared by content key (Resource::Loader::key).
+	 * used is increased only for a new payload.
+	 * @param[in]	hash	Hash of key.
+	 * @param[in]	key		Content key.
+	 * @param[in]	ptr		Loaded payload.
+	 * @param[in]	size	Memory size of payload.
+	 * @return		Payload to be held. (ptr, or the registered one)
+	 */
+	std::shared_ptr<const void> attach(uint64_t hash, const std::wstring &key,
+		std::shared_ptr<const void> ptr, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_shareLock);
+		auto it = m_shareMap.find(hash);
+		if (it != m_shareMap.end()) {
+			auto existing = it->second.ptr.lock();
+			if (existing != nullptr && it->second.key == key) {
+				it->second.refs++;
+				shared.fetch_add(1);
+				saved.fetch_add(it->second.size);
+				return existing;
+			}
+			if (existing != nullptr) {
+				// hash collision: not shared
+				used.fetch_add(size);
+				return ptr;
+			}
+			m_shareMap.erase(it);
+		}
+		m_shareMap.emplace(hash, ShareEntry{ key, ptr, size, 1 });
+		used.fetch_add(size);
+		return ptr;
+	}
+	/**@brief Get a registered payload and add a reference.
+	 * @param[in]	hash	Hash of key.
+	 * @param[in]	key		Content key.
+	 * @param[out]	size	Memory size of payload.
+	 * @return		Payload or nullptr.
+	 */
+	std::shared_ptr<const void> findShared(uint64_t hash, const std::wstring &key, size_t *size)
+	{
+		std::lock_guard<std::mutex> lock(m_shareLock);
+		auto it = m_shareMap.find(hash);
+		if (it == m_shareMap.end() || it->second.key != key) {
+			return nullptr;
+		}
+		auto existing = it->second.ptr.lock();
+		if (existing != nullptr) {
+			it->second.refs++;
+			shared.fetch_add(1);
+			saved.fetch_add(it->second.size);
+			*size = it->second.size;
+		}
+		return existing;
+	}
+	/**@brief Release a reference of a payload. (attach() or findShared())
+	 * @param[in]	hash	Hash of key.
+	 * @param[in]	ptr		Payload held.
+	 * @param[in]	size	Memory size of payload.
+	 */
+	void detach(uint64_t hash, const std::shared_ptr<const void> &ptr, size_t size)
+	{
+		std::lock_guard<std::mutex> lock(m_shareLock);
+		auto it = m_shareMap.find(hash);
+		if (it == m_shareMap.end() || it->second.ptr.lock() != ptr) {
+			// not registered (hash collision)
+			used.fetch_sub(size);
+			return;
+		}
+		if (--it->second.refs == 0) {
+			used.fetch_sub(size);
+			m_shareMap.erase(it);
+		}
+		else {
+			saved.fetch_sub(size);
+		}
+	}
+	/**@brief Get count of resources holding a payload.
+	 * @return	0 if not registered.
+	 */
+	uint32_t getShareCount(uint64_t hash, const std::shared_ptr<const void> &ptr) const
+	{
+		std::lock_guard<std::mutex> lock(m_shareLock);
+		auto it = m_shareMap.find(hash);
+		if (it == m_shareMap.end() || it->second.ptr.lock() != ptr) {
+			return 0;
+		}
+		return it->second.refs;
+	}
+
+	/**@brief Keep a released resource until the next frame.
+	 * @details Views (@ref Resource::getView()) of this frame may still point to it.
+	 */
+	void retire(std::shared_ptr<const void> &&ptr)
+	{
+		std::lock_guard<std::mutex> lock(m_retireLock);
+		m_retired.emplace_back(std::move(ptr));
+	}
+	/**@brief Free resources retired before this call.
+	 * @details Call at the beginning of a frame, when no view is alive.
+	 */
+	void collect()
+	{
+		std::vector<std::shared_ptr<const void>> garbage;
+		{
+			std::lock_guard<std::mutex> lock(m_retireLock);
+			garbage.swap(m_retired);
+		}
+		// destructed here, out of the lock
+	}
+
+private:
+	struct ShareEntry {
+		std::wstring key;
+		std::weak_ptr<const void> ptr;
+		size_t size;
+		// count of Resource objects holding ptr
+		uint32_t refs;
+	};
+
+	std::mutex m_retireLock;
+	std::vector<std::shared_ptr<const void>> m_retired;
+	mutable std::mutex m_shareLock;
+	// hash of content key -> loaded payload
+	std::unordered_map<uint64_t, ShareEntry> m_shareMap;
+};
+
+/**@brief Type independent part of Resource.
+ * @details
+ * ResourceManager runs load stages and cache control of all resource
+ * types through this interface. See @ref Resource for each function.
+ */
+class ResourceBase : private util::noncopyable {
+public:
+	/// Upload stage which also finishes loading. (see @ref prepare())
+	using FinishFunc = std::function<void()>;
+
+	ResourceBase() = default;
+	virtual ~ResourceBase() = default;
+
+	virtual bool beginLoad() = 0;
+	virtual bool tryBeginLoad() = 0;
+	virtual bool shareLoaded() = 0;
+	virtual file::FileView read() const = 0;
+	/**@brief Decode stage.
+	 * @details Returns the upload stage, which calls endLoad() with its result.
+	 */
+	virtual FinishFunc prepare(file::FileView &&bin) = 0;
+	virtual void abortLoad() = 0;
+	virtual void unload() = 0;
+	virtual bool tryEvict() = 0;
+	virtual bool isLoaded() const = 0;
+	virtual uint64_t getLastUse() const = 0;
+	virtual const std::wstring &getKey() const = 0;
+	virtual const std::wstring &getFileName() const = 0;
+	virtual size_t getMemorySize() const = 0;
+	/// src must be the same type.
+	virtual bool adoptFrom(ResourceBase &src) = 0;
+};
+
+/**@brief Loadable resource.
+ * @details
+ * Loading is split into stages so that it can be pipelined:
+ * @li read: File I/O. (returns empty Bytes if no file is needed)
+ * @li decode: CPU work. Returns the upload function.
+ * @li upload: Creates the resource. (GPU upload)
+ *
+ * All stages must be thread-safe.
+ * @ref load() runs all stages on the calling thread.
+ *
+ * Read path:
+ * @li getView(): Wait-free. Returns a raw pointer published by an atomic,
+ * valid until the end of the frame. Released resources are retired to
+ * ResourceCache and freed at the beginning of the next frame (epoch = frame).
+ * @li getPtr(), acquire(): Locked. Returns shared_ptr, valid while held.
+ *
+ * Resources with the same Loader::key share one payload (shared_ptr)
+ * through ResourceCache, so that duplicate registrations are loaded once.
+ *
+ * T must have getMemorySize() for cache accounting.
+ */
+template <class T>
+class Resource : public ResourceBase {
+public:
+	using PtrType = std::shared_ptr<T>;
+	using UploadFunc = std::function<PtrType()>;
+	using ReadFunc = std::function<file::FileView()>;
+	using DecodeFunc = std::function<UploadFunc(file::FileView &&)>;
+
+	/// Load stage functions.
+	struct Loader {
+		/**@brief File of the read stage.
+		 * @details
+		 * If not empty, read is not used and the file is read by
+		 * file::loadFileView(), or by file::AsyncReader in
+		 * ResourceManager::loadResourceSet().
+		 */
+		std::wstring fileName;
+		ReadFunc read;
+		DecodeFunc decode;
+		/**@brief Content key. (e.g. file path)
+		 * @details
+		 * Resources of the same type with the same key are interchangeable.
+		 * Empty means unique.
+		 */
+		std::wstring key;
+	};
+
+	/**@brief Constructor.
+	 * @param[in]	loader	Load stage functions.
+	 * @param[in]	cache	Memory accounting. (can be nullptr)
+	 */
+	explicit Resource(Loader loader, ResourceCache *cache = nullptr) :
+		m_loader(std::move(loader)), m_cache(cache)
+	{
+		// share payload by content key
+		if (m_cache != nullptr && !m_loader.key.empty()) {
+			m_hash = util::fnv1a64(m_loader.key.data(),
+				m_loader.key.size() * sizeof(wchar_t));
+		}
+	}
+	virtual ~Resource() override = default;
+
+	const PtrType getPtr() const
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_resPtr == nullptr) {
+			throwTrace<FrameworkError>("Resource not loaded");
+		}
+		return m_resPtr;
+	}
+	/**@brief Get the resource for use in a frame.
+	 * @details
+	 * Records the frame for LRU eviction and counts hit or miss.
+	 * If not loaded and cache mode is on, loads on the calling thread.
+	 * @param[in]	frame	Current frame number.
+	 */
+	const PtrType acquire(uint64_t frame)
+	{
+		m_lastUse.store(frame);
+		{
+			std::lock_guard<std::mutex> lock(m_lock);
+			if (m_resPtr != nullptr) {
+				if (m_cache != nullptr) {
+					m_cache->hit.fetch_add(1);
+				}
+				return m_resPtr;
+			}
+		}
+		if (m_cache == nullptr || m_cache->budget.load() == 0) {
+			throwTrace<FrameworkError>("Resource not loaded");
+		}
+		m_cache->miss.fetch_add(1);
+		load();
+		return getPtr();
+	}
+	/**@brief Get non-refcounted pointer for use in the current frame.
+	 * @details
+	 * Wait-free if loaded. (atomic load, no lock, no refcount)
+	 * Otherwise falls back to @ref acquire().
+	 * Do not keep the pointer after the frame.
+	 * Hit is counted once per frame, not per call.
+	 * @param[in]	frame	Current frame number.
+	 */
+	T *getView(uint64_t frame)
+	{
+		T *view = m_view.load(std::memory_order_acquire);
+		if (view != nullptr) {
+			// write shared lines only once per frame (avoid cache line ping-pong)
+			if (m_lastUse.load(std::memory_order_relaxed) != frame) {
+				m_lastUse.store(frame, std::memory_order_relaxed);
+				if (m_cache != nullptr) {
+					m_cache->hit.fetch_add(1, std::memory_order_relaxed);
+				}
+			}
+			return view;
+		}
+		// owned by m_resPtr until retired
+		return acquire(frame).get();
+	}
+	/**@brief Load on the calling thread.
+	 * @details
+	 * If a background load (e.g. prefetch) is in flight, waits for it,
+	 * and loads here if it has been cancelled or failed.
+	 */
+	void load()
+	{
+		while (!tryBeginLoad()) {
+			if (waitLoad()) {
+				return;
+			}
+		}
+		if (shareLoaded()) {
+			return;
+		}
+		try {
+			UploadFunc upload = decode(read());
+			endLoad(upload());
+		}
+		catch (...) {
+			abortLoad();
+			throw;
+		}
+	}
+	virtual void unload() override {
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_loading) {
+			throwTrace<FrameworkError>("Unload resource while loading");
+		}
+		releaseLocked();
+	}
+	/**@brief Unload if loaded and not referenced from anywhere else.
+	 * @return true if unloaded.
+	 */
+	virtual bool tryEvict() override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_loading || m_resPtr == nullptr) {
+			return false;
+		}
+		// held only by Resource objects sharing it
+		long owners = 1;
+		if (m_hash != 0) {
+			owners = std::max<long>(m_cache->getShareCount(m_hash, m_resPtr), 1);
+		}
+		if (m_resPtr.use_count() != owners) {
+			return false;
+		}
+		releaseLocked();
+		return true;
+	}
+	virtual bool isLoaded() const override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_resPtr != nullptr;
+	}
+	/// Frame number of the last @ref acquire().
+	virtual uint64_t getLastUse() const override { return m_lastUse.load(); }
+	/// Content key. (@ref Loader::key)
+	virtual const std::wstring &getKey() const override { return m_loader.key; }
+	virtual const std::wstring &getFileName() const override { return m_loader.fileName; }
+	/// Memory size of the resource. (0 if not loaded)
+	virtual size_t getMemorySize() const override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		return m_size;
+	}
+	/**@brief Take over the loaded resource of src without reloading.
+	 * @details
+	 * src becomes unloaded. Views of src stay valid because
+	 * the object itself does not move.
+	 * Both must share the same ResourceCache.
+	 * @param[in]	src	%Resource with the same content.
+	 * @return false if src is not loaded, this is loaded, or either is loading.
+	 */
+	bool adoptFrom(Resource &src)
+	{
+		if (&src == this) {
+			return false;
+		}
+		std::lock(m_lock, src.m_lock);
+		std::lock_guard<std::mutex> lock(m_lock, std::adopt_lock);
+		std::lock_guard<std::mutex> srcLock(src.m_lock, std::adopt_lock);
+		if (m_loading || src.m_loading || m_resPtr != nullptr || src.m_resPtr == nullptr) {
+			return false;
+		}
+		ASSERT(m_cache == src.m_cache);
+		src.m_view.store(nullptr, std::memory_order_release);
+		m_resPtr = std::move(src.m_resPtr);
+		src.m_resPtr.reset();
+		m_size = src.m_size;
+		src.m_size = 0;
+		m_lastUse.store(src.m_lastUse.load());
+		m_view.store(m_resPtr.get(), std::memory_order_release);
+		return true;
+	}
+	virtual bool adoptFrom(ResourceBase &src) override
+	{
+		return adoptFrom(static_cast<Resource &>(src));
+	}
+
+	/**@brief Mark as loading.
+	 * @details
+	 * Call read(), decode(), then endLoad() or abortLoad() after this.
+	 * @return false if already loaded. (nothing to do)
+	 */
+	virtual bool beginLoad() override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_resPtr != nullptr) {
+			return false;
+		}
+		if (m_loading) {
+			throwTrace<FrameworkError>("Multiple load async detected");
+		}
+		m_loading = true;
+		return true;
+	}
+	/**@brief Mark as loading if neither loaded nor loading.
+	 * @return false if already loaded or being loaded by someone else.
+	 */
+	virtual bool tryBeginLoad() override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		if (m_resPtr != nullptr || m_loading) {
+			return false;
+		}
+		m_loading = true;
+		return true;
+	}
+	/**@brief Finish loading with a loaded resource of the same content key.
+	 * @details Call after beginLoad(). No read, decode nor upload.
+	 * @return true if finished. (false: go on to read())
+	 */
+	virtual bool shareLoaded() override
+	{
+		if (m_hash == 0) {
+			return false;
+		}
+		size_t size = 0;
+		auto ptr = m_cache->findShared(m_hash, m_loader.key, &size);
+		if (ptr == nullptr) {
+			return false;
+		}
+		std::lock_guard<std::mutex> lock(m_lock);
+		ASSERT(m_loading);
+		m_loading = false;
+		m_resPtr = castPayload(ptr);
+		m_size = size;
+		m_view.store(m_resPtr.get(), std::memory_order_release);
+		m_loadDone.notify_all();
+		return true;
+	}
+	/// I/O stage.
+	virtual file::FileView read() const override
+	{
+		if (!m_loader.fileName.empty()) {
+			return file::loadFileView(m_loader.fileName.c_str());
+		}
+		return m_loader.read ? m_loader.read() : file::FileView();
+	}
+	/// CPU decode stage.
+	UploadFunc decode(file::FileView &&bin) const
+	{
+		return m_loader.decode(std::move(bin));
+	}
+	virtual FinishFunc prepare(file::FileView &&bin) override
+	{
+		UploadFunc upload = decode(std::move(bin));
+		return [this, upload]() { endLoad(upload()); };
+	}
+	/// Set the result of upload stage and finish loading.
+	void endLoad(PtrType res)
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		ASSERT(m_loading);
+		m_loading = false;
+		m_size = res->getMemorySize();
+		if (m_hash != 0) {
+			// the same content may have been loaded in the meantime
+			m_resPtr = castPayload(m_cache->attach(m_hash, m_loader.key, std::move(res), m_size));
+		}
+		else {
+			m_resPtr = std::move(res);
+			if (m_cache != nullptr) {
+				m_cache->used.fetch_add(m_size);
+			}
+		}
+		m_view.store(m_resPtr.get(), std::memory_order_release);
+		m_loadDone.notify_all();
+	}
+	/// Finish loading without result. (cancel or error)
+	virtual void abortLoad() override
+	{
+		std::lock_guard<std::mutex> lock(m_lock);
+		m_loading = false;
+		m_loadDone.notify_all();
+	}
+
+private:
+	mutable std::mutex m_lock;
+	bool m_loading = false;
+	// notified when m_loading becomes false
+	std::condition_variable m_loadDone;
+	PtrType m_resPtr;
+	Loader m_loader;
+	ResourceCache *m_cache;
+	size_t m_size = 0;
+	std::atomic<uint64_t> m_lastUse{ 0 };
+	// == m_resPtr.get(), for lock-free read
+	std::atomic<T *> m_view{ nullptr };
+	// hash of content key (0: not shared)
+	uint64_t m_hash = 0;
+
+	static PtrType castPayload(const std::shared_ptr<const void> &ptr)
+	{
+		// ResourceCache is per type
+		return std::const_pointer_cast<T>(std::static_pointer_cast<const T>(ptr));
+	}
+
+	// wait for the load in flight, returns true if loaded
+	bool waitLoad()
+	{
+		std::unique_lock<std::mutex> lock(m_lock);
+		m_loadDone.wait(lock, [this]() { return !m_loading; });
+		return m_resPtr != nullptr;
+	}
+
+	void releaseLocked()
+	{
+		m_view.store(nullptr, std::memory_order_release);
+		if (m_resPtr != nullptr && m_cache != nullptr) {
+			if (m_hash != 0) {
+				m_cache->detach(m_hash, m_resPtr, m_size);
+			}
+			else {
+				m_cache->used.fetch_sub(m_size);
+			}
+			// views of this frame may still point to it
+			m_cache->retire(std::move(m_resPtr));
+		}
+		m_resPtr.reset();
+		m_size = 0;
+	}
+};
+
+/**@brief Progress of @ref ResourceManager::loadResourceSet().
+ * @details Updated by worker threads. Can be read from any thread.
+ */
+struct LoadProgress {
+	/// Count of resources to be loaded. (already loaded ones are not included)
+	std::atomic<uint32_t> itemsTotal{ 0 };
+	/// Count of resources loaded.
+	std::atomic<uint32_t> itemsDone{ 0 };
+	/// File size read.
+	std::atomic<uint64_t> bytesRead{ 0 };
+
+	/// Reset all counters to 0.
+	void reset()
+	{
+		itemsTotal.store(0);
+		itemsDone.store(0);
+		bytesRead.store(0);
+	}
+	/// Returns itemsDone / itemsTotal. (1.0 if nothing to load)
+	double getRatio() const
+	{
+		uint32_t total = itemsTotal.load();
+		return (total == 0) ? 1.0 : static_cast<double>(itemsDone.load()) / total;
+	}
+};
+
+/**@brief Result of @ref ResourceManager::switchResourceSet().
+ * @details Memory sizes are by getMemorySize() of the resources.
+ */
+struct SetSwitchStats {
+	/// Resources moved from the old set. (no reload)
+	uint32_t itemsReused = 0;
+	/// Memory size of reused resources.
+	uint64_t bytesReused = 0;
+	/// Resources of the old set unloaded.
+	uint32_t itemsUnloaded = 0;
+	/// Memory size of unloaded resources.
+	uint64_t bytesUnloaded = 0;
+	/// Resources of the new set loaded.
+	uint32_t itemsLoaded = 0;
+	/// Memory size of loaded resources.
+	uint64_t bytesLoaded = 0;
+	/// File size read for them.
+	uint64_t bytesRead = 0;
+};
+
+/**@brief Throttle of @ref ResourceManager::prefetchResourceSet().
+ * @details Prefetch runs each resource as one job (read, decode, upload).
+ */
+struct PrefetchParam {
+	/// Max resources being loaded at the same time. (CPU budget)
+	uint32_t maxInFlight = 1;
+	/// Bytes read per frame on average. (I/O budget, 0: unlimited)
+	uint64_t bytesPerFrame = 1024 * 1024;
+};
+
+/**@brief %Resource handle.
+ * @details
+ * Index of a resource in its type, returned by ResourceManager::add().
+ * Valid while the ResourceManager lives.
+ */
+using ResourceHandle = uint32_t;
+
+/**@brief Resources of a type.
+ * @details Used by ResourceManager.
+ */
+struct ResourceTable {
+	// int setId -> char[16] resId -> handle
+	std::vector<std::unordered_map<IdString, ResourceHandle>> idMapVec;
+	// frozen copy of idMapVec, built while sealed (empty if unsealed)
+	std::vector<util::FrozenIdMap> frozenVec;
+	// handle -> Resource<T> (T is the same in a table)
+	std::vector<std::unique_ptr<ResourceBase>> list;
+
+	explicit ResourceTable(size_t resSetCount) :
+		idMapVec(resSetCount), frozenVec(resSetCount)
+	{}
+};
+
+/**@brief Resource sets of all resource types.
+ * @details
+ * Each ResourceType holds resources of one C++ type T,
+ * which is given to add(), get() and getView().
+ * (e.g. Texture: graphics::DGraphics::TextureResource)
+ */
+class ResourceManager : private util::noncopyable {
+public:
+	explicit ResourceManager(size_t resSetCount = 1);
+	/**@brief Destructor.
+	 * @details Cancels all prefetches and waits for their jobs.
+	 */
+	~ResourceManager();
+
+	/**@brief Add a resource.
+	 * @details
+	 * Adding the same resId with the same content key again returns
+	 * the handle already added (e.g. manifest, then script).
+	 * @tparam		T		%Resource class of type.
+	 * @param[in]	type	%Resource type.
+	 * @param[in]	setId	%Resource set ID.
+	 * @param[in]	resId	%Resource ID.
+	 * @param[in]	loader	Load stage functions.
+	 * @return		%Resource handle.
+	 */
+	template <class T>
+	ResourceHandle add(ResourceType type, size_t setId, const char *resId,
+		typename Resource<T>::Loader loader)
+	{
+		return addResource(type, setId, resId,
+			std::make_unique<Resource<T>>(std::move(loader), &getCache(type)));
+	}
+	/**@brief Reserve space for resources to be added.
+	 * @param[in]	type	%Resource type.
+	 * @param[in]	count	%Resource count to be added.
+	 */
+	void reserve(ResourceType type, size_t count);
+
+	/**@brief Set the lock state of resources.
+	 * @details
+	 * Name to handle maps are immutable while sealed, so that
+	 * sealing builds a frozen perfect hash index of them.
+	 * @param[in]	sealed	new state.
+	 */
+	void setSealed(bool sealed);
+	bool isSealed();
+
+	/**@brief Set job system used by loadResourceSet().
+	 * @param[in]	jobs	Job system. (nullptr: load on the calling thread)
+	 */
+	void setJobSystem(jobs::JobSystem *jobs);
+	/**@brief Set reader used by the read stage of loadResourceSet().
+	 * @details
+	 * Loader::fileName in the real file system is read by it
+	 * without occupying a job thread. Needs job system.
+	 * @param[in]	reader	Async reader. (nullptr: read in jobs)
+	 */
+	void setAsyncReader(file::AsyncReader *reader);
+
+	/**@brief Load all resources in a resource set.
+	 * @details
+	 * Each resource goes through read, decode and upload stages as
+	 * separate jobs, so that I/O and CPU work of different resources
+	 * (of all types) overlap.
+	 * With setAsyncReader(), files are read by the reader instead of jobs.
+	 * Blocks until all of them finish. The calling thread also runs jobs.
+	 *
+	 * If the set is being prefetched, the prefetch is promoted:
+	 * resources in flight are waited for and the rest are loaded
+	 * here at full speed. Prefetched resources are not loaded again.
+	 * @param[in]	setId		%Resource set ID.
+	 * @param[in]	cancel		Stops scheduling remaining stages if true.
+	 * @param[out]	progress	Progress counters. (can be nullptr)
+	 */
+	void loadResourceSet(size_t setId, std::atomic_bool &cancel,
+		LoadProgress *progress = nullptr);
+	/**@brief Unload all resources in a resource set.
+	 * @details Prefetch of the set is cancelled and waited for.
+	 */
+	void unloadResourceSet(size_t setId);
+	/**@brief Replace a loaded resource set with another one.
+	 * @details
+	 * Same as unloadResourceSet(fromSet) then loadResourceSet(toSet),
+	 * except that resources with the same content key (Loader::key)
+	 * are moved from fromSet to toSet without reloading.
+	 * The rest of fromSet is unloaded before the delta is loaded,
+	 * so that peak memory does not exceed max(fromSet, toSet).
+	 * @param[in]	fromSet		%Resource set ID to be unloaded.
+	 * @param[in]	toSet		%Resource set ID to be loaded.
+	 * @param[in]	cancel		Stops scheduling remaining stages if true.
+	 * @param[out]	progress	Progress counters of the delta. (can be nullptr)
+	 * @return		Statistics.
+	 */
+	SetSwitchStats switchResourceSet(size_t fromSet, size_t toSet,
+		std::atomic_bool &cancel, LoadProgress *progress = nullptr);
+
+	/**@brief Start loading a resource set in background at low priority.
+	 * @details
+	 * The first resources are submitted to the job system immediately
+	 * (so that it can start before the first frame), and the rest from
+	 * @ref beginFrame() within the budget of param,
+	 * so that the current scene keeps its frame rate.
+	 * Resources already loaded (or being loaded) are skipped.
+	 * Does nothing if the set is already being prefetched.
+	 * Call loadResourceSet() to promote it when the set is actually needed.
+	 * A resource failed in prefetch is loaded again by loadResourceSet(),
+	 * which reports the error.
+	 * Does nothing without job system.
+	 * @param[in]	setId		%Resource set ID.
+	 * @param[in]	param		Throttle parameters.
+	 * @param[out]	progress	Progress counters. (can be nullptr, must outlive the prefetch)
+	 */
+	void prefetchResourceSet(size_t setId, const PrefetchParam &param = PrefetchParam(),
+		LoadProgress *progress = nullptr);
+	/**@brief Cancel prefetch of a resource set.
+	 * @details
+	 * Does not block. Resources in flight stop at the next stage and
+	 * resources already loaded are kept.
+	 * @param[in]	setId		%Resource set ID.
+	 */
+	void cancelPrefetch(size_t setId);
+	/**@brief Cancel all prefetches and wait for their jobs.
+	 * @details Call before the job system is destroyed.
+	 */
+	void cancelAllPrefetch();
+	/**@brief Returns true if a prefetch of the set has resources not loaded yet.
+	 * @param[in]	setId		%Resource set ID.
+	 */
+	bool isPrefetching(size_t setId) const;
+
+	/**@brief Set memory budget of a resource type. (cache mode)
+	 * @details
+	 * If budget is not 0, least recently used resources which are not
+	 * referenced from anywhere else are unloaded by @ref beginFrame()
+	 * while the total size exceeds the budget.
+	 * Unloaded resources are reloaded by the next get() call.
+	 * @param[in]	type	%Resource type.
+	 * @param[in]	bytes	Memory budget. (0: unlimited, cache mode off)
+	 */
+	void setCacheBudget(ResourceType type, size_t bytes);
+	/**@brief Get cache statistics of a resource type.
+	 * @param[in]	type	%Resource type.
+	 */
+	CacheStats getCacheStats(ResourceType type) const;
+	/**@brief Advance frame number and evict resources over budget.
+	 * @details
+	 * Call at the beginning of every frame.
+	 * Prefetch jobs are submitted here within their budget.
+	 * Resources released in the previous frame are freed here,
+	 * so views (getView()) must not be used across this call.
+	 */
+	void beginFrame();
+
+	/**@brief Get resource handle by name.
+	 * @details Resolve once and use handle in frame loop.
+	 */
+	ResourceHandle getHandle(ResourceType type, size_t setId, const char *resId) const;
+
+	/// Get by name.
+	template <class T>
+	const typename Resource<T>::PtrType get(ResourceType type,
+		size_t setId, const char *resId)
+	{
+		return get<T>(type, getHandle(type, setId, resId));
+	}
+	/// Get by handle. (array index)
+	template <class T>
+	const typename Resource<T>::PtrType get(ResourceType type, ResourceHandle handle)
+	{
+		return getResource<T>(type, handle)->acquire(m_frame);
+	}
+	/// Get view by handle. (lock-free, valid until the next beginFrame())
+	template <class T>
+	T *getView(ResourceType type, ResourceHandle handle)
+	{
+		return getResource<T>(type, handle)->getView(m_frame);
+	}
+
+private:
+	bool m_sealed = true;
+	jobs::JobSystem *m_jobs = nullptr;
+	file::AsyncReader *m_reader = nullptr;
+	// frame number for LRU
+	uint64_t m_frame = 0;
+	ResourceCache m_cache[static_cast<size_t>(ResourceType::Count)];
+
+	// background loading of a set (defined in cpp)
+	struct PrefetchState;
+	// active and cancelled prefetches
+	mutable std::mutex m_prefetchLock;
+	std::vector<std::unique_ptr<PrefetchState>> m_prefetch;
+
+	// ResourceType -> table
+	std::vector<ResourceTable> m_tables;
+
+	ResourceCache &getCache(ResourceType type);
+	ResourceTable &getTable(ResourceType type);
+	ResourceHandle addResource(ResourceType type, size_t setId, const char *resId,
+		std::unique_ptr<ResourceBase> &&res);
+	ResourceBase *getResourceBase(ResourceType type, ResourceHandle handle);
+	template <class T>
+	Resource<T> *getResource(ResourceType type, ResourceHandle handle)
+	{
+		ResourceBase *res = getResourceBase(type, handle);
+		ASSERT(dynamic_cast<Resource<T> *>(res) != nullptr);
+		return static_cast<Resource<T> *>(res);
+	}
+	void pumpPrefetch(bool newFrame);
+	std::vector<std::unique_ptr<PrefetchState>> takePrefetch(size_t setId);
+	void waitPrefetch(PrefetchState *state);
+};
+
+/// Result of @ref benchmarkResourceRead().
+struct ResourceReadBenchResult {
+	uint32_t threads = 0;
+	uint32_t iterations = 0;
+	/// Resource::getPtr(): mutex + shared_ptr copy. [ns/read]
+	double lockedNs = 0.0;
+	/// Resource::getView(): atomic load. [ns/read]
+	double viewNs = 0.0;
+	/// Worst time of a batch of reads with getPtr(). [us]
+	double lockedMaxUs = 0.0;
+	/// Worst time of a batch of reads with getView(). [us]
+	double viewMaxUs = 0.0;
+};
+
+/**@brief Multi-threaded benchmark of Resource read path.
+ * @details
+ * All threads read the same small set of resources at the same time,
+ * like draw jobs sharing textures. Compares locked and lock-free reads.
+ * @param[in]	threads		Reader thread count.
+ * @param[in]	iterations	Read count per thread.
+ * @return		Result.
+ */
+ResourceReadBenchResult benchmarkResourceRead(uint32_t threads, uint32_t iterations);
+
+}	// namespace framework
+}	// namespace yappy
@@ -0,0 +1,110 @@
+﻿/**@file
+ * @brief Lock-free single-producer single-consumer ring.
+ */
+
+#pragma once
+
+#include "util.h"
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace yappy {
+namespace util {
+
+/**@brief Fixed capacity lock-free ring of slots between two threads.
+ * @details
+ * One producer thread fills a slot in place and publishes it,
+ * one consumer thread uses the oldest slot and releases it.
+ * A slot is not overwritten until it is released, so the consumer can
+ * keep referring to it (e.g. an audio buffer being played) until pop().
+ * No lock and no allocation after construction.
+ * @tparam	T	Slot type. (default constructible)
+ */
+template <class T>
+class SpscRing : private noncopyable {
+public:
+	/**@brief Allocate slots.
+	 * @param[in]	capacity	Slot count. (at least 1)
+	 */
+	explicit SpscRing(size_t capacity) :
+		m_slots(capacity > 0 ? capacity : 1)
+	{}
+	~SpscRing() = default;
+
+	/// Slot count.
+	size_t capacity() const { return m_slots.size(); }
+	/// Published and not released slot count. (a snapshot if called by neither thread)
+	size_t size() const
+	{
+		return m_write.load(std::memory_order_acquire) -
+			m_read.load(std::memory_order_acquire);
+	}
+	/**@brief Access a slot directly. (e.g. to set up buffers)
+	 * @pre Neither thread is running.
+	 */
+	T &slot(size_t index) { return m_slots[index]; }
+
+	/// @name Producer
+	//@{
+	/**@brief Get the next slot to fill.
+	 * @return	Slot. (nullptr if full)
+	 */
+	T *beginWrite()
+	{
+		const size_t w = m_write.load(std::memory_order_relaxed);
+		if (w - m_read.load(std::memory_order_acquire) >= m_slots.size()) {
+			return nullptr;
+		}
+		return &m_slots[w % m_slots.size()];
+	}
+	/**@brief Publish the slot from beginWrite() to the consumer.
+	 */
+	void commitWrite()
+	{
+		m_write.store(m_write.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+	}
+	//@}
+
+	/// @name Consumer
+	//@{
+	/**@brief Get the oldest published slot.
+	 * @return	Slot. (nullptr if empty)
+	 */
+	T *front()
+	{
+		const size_t r = m_read.load(std::memory_order_relaxed);
+		if (m_write.load(std::memory_order_acquire) == r) {
+			return nullptr;
+		}
+		return &m_slots[r % m_slots.size()];
+	}
+	/**@brief Release the oldest slot to the producer.
+	 * @pre The ring is not empty.
+	 */
+	void pop()
+	{
+		m_read.store(m_read.load(std::memory_order_relaxed) + 1,
+			std::memory_order_release);
+	}
+	//@}
+
+	/**@brief Make empty.
+	 * @pre Neither thread is running.
+	 */
+	void clear()
+	{
+		m_write.store(0);
+		m_read.store(0);
+	}
+
+private:
+	std::vector<T> m_slots;
+	// separate cache lines (written by different threads)
+	alignas(64) std::atomic<size_t> m_write{ 0 };
+	alignas(64) std::atomic<size_t> m_read{ 0 };
+};
+
+}	// namespace util
+}	// namespace yappy
@@ -1,177 +1,297 @@
-﻿#pragma once
-
-#include "util.h"
-#include "file.h"
-#include <xaudio2.h>
-#include <vorbis/vorbisfile.h>
-#include <unordered_map>
-
-namespace yappy {
-/// Sound effect and BGM library.
-namespace sound {
-
-/// SE file size limit (wave data part): 3MiB
-const uint32_t SoundEffectSizeMax = 3 * 1024 * 1024;
-/// Playing SE at the same time limit.
-const uint32_t SoundEffectPlayMax = 64;
-
-/// BGM ov_read unit.
-const uint32_t BgmOvReadSize = 4096;
-/// BGM one buffer size. (Consumes @ref BgmBufferSize * @ref BgmBufferCount bytes)
-const uint32_t BgmBufferSize = 4096 * 16;
-/// BGM buffer count.
-const uint32_t BgmBufferCount = 2;
-
-#pragma region Deleters
-struct hmmioDeleter {
-	using pointer = HMMIO;
-	void operator()(HMMIO hMmio)
-	{
-		::mmioClose(hMmio, 0);
-	}
-};
-
-struct voiceDeleter {
-	void operator()(IXAudio2Voice *pv)
-	{
-		pv->DestroyVoice();
-	}
-};
-
-struct oggFileDeleter {
-	void operator()(OggVorbis_File *ovf)
-	{
-		ov_clear(ovf);
-	}
-};
-#pragma endregion
-
-/// Sound effect resource.
-struct SoundEffect : private util::noncopyable {
-	WAVEFORMATEX format;
-	file::Bytes samples;
-	SoundEffect() = default;
-	~SoundEffect() = default;
-};
-
-/// BGM resource.
-struct Bgm : private util::noncopyable {
-	using OggFilePtr = std::unique_ptr<OggVorbis_File, oggFileDeleter>;
-
-	Bgm(file::Bytes &&ovFileBin);
-	~Bgm() = default;
-
-	OggVorbis_File *ovFp() const { return m_ovFp.get(); }
-
-private:
-	file::Bytes m_ovFileBin;
-	uint32_t m_readPos;
-	OggVorbis_File m_ovFile;
-	// for public interface (auto close pointer to m_ovFile)
-	OggFilePtr m_ovFp;
-	// for OggVorbis_File callback (datasource == this)
-	static size_t read(void *ptr, size_t size, size_t nmemb, void *datasource);
-	static int seek(void *datasource, int64_t offset, int whence);
-	static long tell(void *datasource);
-	static int close(void *datasource);
-};
-
-/// XAudio2 manager.
-class XAudio2 : private util::noncopyable {
-public:
-	using SeResource = const SoundEffect;
-	using SeResourcePtr = std::shared_ptr<SeResource>;
-	using BgmResource = Bgm;
-	using BgmResourcePtr = std::shared_ptr<BgmResource>;
-
-	/// Initialize XAudio2.
-	XAudio2();
-	/// Finalize XAudio2.
-	~XAudio2();
-
-	/**@brief Application must call this function every frames.
-	 * @details
-	 * @li Free SE entry which has done.
-	 * @li Decode ogg partly and write to BGM buffer.
-	 */
-	void processFrame();
-
-	/// @name Sound Effect
-	//@{
-	/**@brief Load a sound effect resource.
-	 * @details This function may take time.
-	 * @param[in]	path	(abstract file layer) File path.
-	 * @return				shared_ptr to sound effect resource.
-	 * @sa @ref yappy::file
-	 */
-	SeResourcePtr loadSoundEffect(const wchar_t *path);
-
-	/**@brief Starts playing a sound effect.
-	 * @param[in]	se	Sound effect resource.
-	 */
-	void playSoundEffect(const SeResourcePtr &se);
-
-	/**@brief Returns whether any sound effects are playing.
-	 * @return true if one or more sound effects are playing.
-	 */
-	bool isPlayingAnySoundEffect() const;
-
-	/**@brief Stops all sound effects.
-	 */
-	void stopAllSoundEffect();
-	//@}
-
-	/// @name BGM
-	//@{
-	/**@brief Load a BGM resource.
-	 * @details This function may take time.
-	 * @param[in]	path	(abstract file layer) File path.
-	 * @return				shared_ptr to BGM resource.
-	 * @sa @ref yappy::file
-	 */
-	BgmResourcePtr loadBgm(const wchar_t *path);
-
-	/**@brief Starts playing a BGM.
-	 * @details
-	 * Only one BGM can be played at the same time.
-	 * This function will stop the current BGM and then start the new BGM.
-	 * @param[in]	se	Sound effect resource.
-	 */
-	void playBgm(const BgmResourcePtr &bgm);
-
-	/**@brief Stops playing a BGM.
-	 */
-	void stopBgm();
-	//@}
-
-private:
-	using IXAudio2Ptr = util::ComPtr<IXAudio2>;
-	using SourceVoicePtr = std::unique_ptr<IXAudio2SourceVoice, voiceDeleter>;
-	using MasterVoicePtr = std::unique_ptr<IXAudio2MasteringVoice, voiceDeleter>;
-
-	util::CoInitialize m_coInit;
-	IXAudio2Ptr m_pIXAudio;
-	MasterVoicePtr m_pMasterVoice;
-
-	// Sound Effect
-	// keep reference to playing buffer in resource
-	using PyaingSeElem = std::tuple<SeResourcePtr, SourceVoicePtr>;
-	std::array<PyaingSeElem, SoundEffectPlayMax> m_playingSeList;
-
-	PyaingSeElem *findFreeSeEntry();
-	void processFrameSe();
-
-	// BGM
-	// raw wave buffer, which must be deleted after m_pBgmVoice
-	std::unique_ptr<char[]> m_pBgmBuffer;
-	uint32_t m_writePos;
-	// play m_pBgmBuffer at another thread
-	SourceVoicePtr m_pBgmVoice;
-	// keep reference to resource struct
-	BgmResourcePtr m_playingBgm;
-
-	void processFrameBgm();
-};
-
-}	// namespace sound
-}	// namespace yappy
+﻿#pragma once
+
+#include "util.h"
+#include "file.h"
+#include "ring.h"
+#include <xaudio2.h>
+#include <vorbis/vorbisfile.h>
+#include <unordered_map>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace yappy {
+/// Sound effect and BGM library.
+namespace sound {
+
+/// SE file size limit (wave data part): 3MiB
+const uint32_t SoundEffectSizeMax = 3 * 1024 * 1024;
+/// Playing SE at the same time limit.
+const uint32_t SoundEffectPlayMax = 64;
+
+/// BGM ov_read unit.
+const uint32_t BgmOvReadSize = 4096;
+/// BGM PCM block size. (about 93 ms of 44.1 kHz 16-bit stereo)
+const uint32_t BgmBlockSize = 4096 * 4;
+/// Default BGM latency target: decoded PCM queued to the voice. [ms]
+const uint32_t BgmLatencyDefault = 300;
+
+#pragma region Deleters
+struct hmmioDeleter {
+	using pointer = HMMIO;
+	void operator()(HMMIO hMmio)
+	{
+		::mmioClose(hMmio, 0);
+	}
+};
+
+struct voiceDeleter {
+	void operator()(IXAudio2Voice *pv)
+	{
+		pv->DestroyVoice();
+	}
+};
+
+struct oggFileDeleter {
+	void operator()(OggVorbis_File *ovf)
+	{
+		ov_clear(ovf);
+	}
+};
+#pragma endregion
+
+/// Sound effect resource.
+struct SoundEffect : private util::noncopyable {
+	WAVEFORMATEX format;
+	/// Wave data in the file contents.
+	file::FileView samples;
+	SoundEffect() = default;
+	~SoundEffect() = default;
+
+	/// Memory size of samples.
+	size_t getMemorySize() const { return samples.size(); }
+};
+
+/**@brief BGM resource.
+ * @details
+ * The ogg file is streamed by @ref file::StreamReader,
+ * so memory usage does not depend on the length of the track.
+ */
+struct Bgm : private util::noncopyable {
+	using OggFilePtr = std::unique_ptr<OggVorbis_File, oggFileDeleter>;
+
+	explicit Bgm(const wchar_t *path);
+	~Bgm() = default;
+
+	OggVorbis_File *ovFp() const { return m_ovFp.get(); }
+	/// Memory size of stream buffers. (decoder state is not included)
+	size_t getMemorySize() const { return m_stream.getMemorySize(); }
+	/**@brief Rethrow an exception of the stream in a vorbisfile callback.
+	 * @details
+	 * Callbacks report errors to vorbisfile by return values,
+	 * so call this after each ov_xxx() call with ovFp().
+	 */
+	void checkStreamError();
+
+private:
+	file::StreamReader m_stream;
+	// thrown in a callback (cannot propagate through vorbisfile)
+	std::exception_ptr m_streamError;
+	OggVorbis_File m_ovFile;
+	// for public interface (auto close pointer to m_ovFile)
+	OggFilePtr m_ovFp;
+	// for OggVorbis_File callback (datasource == this)
+	static size_t read(void *ptr, size_t size, size_t nmemb, void *datasource);
+	static int seek(void *datasource, int64_t offset, int whence);
+	static long tell(void *datasource);
+	static int close(void *datasource);
+};
+
+/// BGM streaming statistics. (@ref XAudio2::getBgmStats())
+struct BgmStats {
+	/// PCM block count of the ring. (from the latency target, 0 if not playing)
+	uint32_t blockCount = 0;
+	/// Blocks queued to the voice now.
+	uint32_t queued = 0;
+	/// Total decoded blocks.
+	uint64_t decoded = 0;
+	/// Times the voice played out all blocks before the next one. (total)
+	uint64_t underruns = 0;
+	/// Play time of the full ring. [ms]
+	double latencyMs = 0.0;
+};
+
+/**@brief XAudio2 manager.
+ * @details
+ * BGM is decoded on a dedicated audio thread, not in the frame.
+ * Decoded PCM blocks are queued to the voice through a lock-free ring
+ * (@ref util::SpscRing) which is filled up to the latency target;
+ * XAudio2 releases a block by the voice callback when it has been played.
+ * Frame time spikes and frame skips do not starve the voice
+ * as long as the audio thread runs.
+ */
+class XAudio2 : private util::noncopyable {
+public:
+	using SeResource = const SoundEffect;
+	using SeResourcePtr = std::shared_ptr<SeResource>;
+	using BgmResource = Bgm;
+	using BgmResourcePtr = std::shared_ptr<BgmResource>;
+
+	/**@brief Initialize XAudio2 and start the audio thread.
+	 * @param[in]	bgmLatencyMs	BGM latency target. [ms]
+	 */
+	explicit XAudio2(uint32_t bgmLatencyMs = BgmLatencyDefault);
+	/// Stop the audio thread and finalize XAudio2.
+	~XAudio2();
+
+	/**@brief Application must call this function every frames.
+	 * @details
+	 * @li Free SE entry which has done.
+	 * @li Rethrow a BGM decode error on the audio thread.
+	 */
+	void processFrame();
+
+	/// @name Sound Effect
+	//@{
+	/**@brief Load a sound effect resource.
+	 * @details This function may take time.
+	 * @param[in]	path	(abstract file layer) File path.
+	 * @return				shared_ptr to sound effect resource.
+	 * @sa @ref yappy::file
+	 */
+	SeResourcePtr loadSoundEffect(const wchar_t *path);
+	/**@brief Create a sound effect resource from wave file contents.
+	 * @details Thread-safe. Decode stage of @ref loadSoundEffect().
+	 * @param[in]	bin	Wave file contents.
+	 * @return			shared_ptr to sound effect resource.
+	 */
+	static SeResourcePtr createSoundEffect(file::FileView &&bin);
+
+	/**@brief Starts playing a sound effect.
+	 * @param[in]	se	Sound effect resource.
+	 */
+	void playSoundEffect(const SeResourcePtr &se);
+
+	/**@brief Returns whether any sound effects are playing.
+	 * @return true if one or more sound effects are playing.
+	 */
+	bool isPlayingAnySoundEffect() const;
+
+	/**@brief Stops all sound effects.
+	 */
+	void stopAllSoundEffect();
+	//@}
+
+	/// @name BGM
+	//@{
+	/**@brief Load a BGM resource.
+	 * @details This function may take time.
+	 * @param[in]	path	(abstract file layer) File path.
+	 * @return				shared_ptr to BGM resource.
+	 * @sa @ref yappy::file
+	 */
+	BgmResourcePtr loadBgm(const wchar_t *path);
+	/**@brief Open a BGM stream.
+	 * @details
+	 * Thread-safe. Decode stage of @ref loadBgm().
+	 * Reads ogg headers; the rest is read while playing.
+	 * @param[in]	path	(abstract file layer) File path.
+	 * @return				shared_ptr to BGM resource.
+	 */
+	static BgmResourcePtr createBgm(const wchar_t *path);
+
+	/**@brief Starts playing a BGM.
+	 * @details
+	 * Only one BGM can be played at the same time.
+	 * This function will stop the current BGM and then start the new BGM.
+	 * @param[in]	se	Sound effect resource.
+	 */
+	void playBgm(const BgmResourcePtr &bgm);
+
+	/**@brief Stops playing a BGM.
+	 */
+	void stopBgm();
+
+	/**@brief Get BGM streaming statistics.
+	 * @details Underruns are also written to debug output by the audio thread.
+	 */
+	BgmStats getBgmStats() const;
+	//@}
+
+private:
+	using IXAudio2Ptr = util::ComPtr<IXAudio2>;
+	using SourceVoicePtr = std::unique_ptr<IXAudio2SourceVoice, voiceDeleter>;
+	using MasterVoicePtr = std::unique_ptr<IXAudio2MasteringVoice, voiceDeleter>;
+
+	util::CoInitialize m_coInit;
+	IXAudio2Ptr m_pIXAudio;
+	MasterVoicePtr m_pMasterVoice;
+
+	// Sound Effect
+	// keep reference to playing buffer in resource
+	using PyaingSeElem = std::tuple<SeResourcePtr, SourceVoicePtr>;
+	std::array<PyaingSeElem, SoundEffectPlayMax> m_playingSeList;
+
+	PyaingSeElem *findFreeSeEntry();
+	void processFrameSe();
+
+	// BGM
+	// PCM block in BgmQueue::buffer
+	struct BgmBlock {
+		char *data = nullptr;
+		uint32_t size = 0;
+	};
+	// PCM blocks of one playBgm()
+	// (the audio thread may keep decoding into it after stopBgm())
+	struct BgmQueue {
+		explicit BgmQueue(uint32_t blockCount);
+		// producer: audio thread, consumer: voice callback
+		util::SpscRing<BgmBlock> ring;
+		// raw wave buffer
+		std::unique_ptr<char[]> buffer;
+	};
+	// releases played blocks (called on the XAudio2 thread)
+	class BgmVoiceCallback : public IXAudio2VoiceCallback {
+	public:
+		explicit BgmVoiceCallback(XAudio2 *owner) : m_owner(owner) {}
+		virtual ~BgmVoiceCallback() = default;
+		virtual void STDMETHODCALLTYPE OnBufferEnd(void *pBufferContext) override;
+		virtual void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32) override {}
+		virtual void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() override {}
+		virtual void STDMETHODCALLTYPE OnStreamEnd() override {}
+		virtual void STDMETHODCALLTYPE OnBufferStart(void *) override {}
+		virtual void STDMETHODCALLTYPE OnLoopEnd(void *) override {}
+		virtual void STDMETHODCALLTYPE OnVoiceError(void *, HRESULT) override {}
+	private:
+		XAudio2 *m_owner;
+	};
+
+	uint32_t m_bgmLatencyMs;
+	// wakes the audio thread (auto reset)
+	util::HandlePtr m_hBgmEvent;
+	// play time of the full ring [ms]
+	double m_bgmRingMs = 0.0;
+	BgmVoiceCallback m_bgmCallback;
+	// m_bgmQueue, m_pBgmVoice, m_playingBgm, m_bgmGeneration and m_bgmError
+	// (between the main thread and the audio thread, not held while decoding)
+	std::mutex m_bgmLock;
+	// must be deleted after m_pBgmVoice
+	std::shared_ptr<BgmQueue> m_bgmQueue;
+	// play m_bgmQueue at another thread
+	SourceVoicePtr m_pBgmVoice;
+	// keep reference to resource struct
+	BgmResourcePtr m_playingBgm;
+	// changed by playBgm() and stopBgm();
+	// the audio thread drops blocks decoded for an old value
+	uint64_t m_bgmGeneration = 0;
+	// the voice callback counts underruns only while true
+	std::atomic<bool> m_bgmActive{ false };
+	std::atomic<uint64_t> m_bgmDecoded{ 0 };
+	std::atomic<uint64_t> m_bgmUnderruns{ 0 };
+	// decode error on the audio thread (rethrown by processFrame())
+	std::atomic<bool> m_bgmFailed{ false };
+	std::exception_ptr m_bgmError;
+	bool m_bgmExit = false;
+	std::thread m_bgmThread;
+
+	void processFrameBgm();
+	void bgmThreadMain();
+	// decode and submit blocks until the ring is full (audio thread)
+	void fillBgm(Bgm *bgm, BgmQueue *queue, uint64_t generation);
+	uint32_t decodeBgm(Bgm *bgm, char *dst);
+	void rewindBgm(Bgm *bgm);
+};
+
+}	// namespace sound
+}	// namespace yappy
@@ -0,0 +1,250 @@
+﻿/**@file
+ * @brief High-resolution clock and precise waiting.
+ */
+
+#pragma once
+
+#include "util.h"
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <atomic>
+
+namespace yappy {
+/// High-resolution clock and precise waiting.
+namespace timer {
+
+/**@brief Clock and sleep abstraction.
+ * @details
+ * Frame pacing logic uses only this interface,
+ * so that it can be driven by a fake clock in tests and benchmarks.
+ */
+class Clock : private util::noncopyable {
+public:
+	/// Constructor (default).
+	Clock() = default;
+	/// Virtual destructor (default).
+	virtual ~Clock() = default;
+
+	/**@brief Get counter frequency.
+	 * @return counter/sec
+	 */
+	virtual int64_t getFrequency() const = 0;
+	/**@brief Get current counter value.
+	 * @return Monotonic counter.
+	 */
+	virtual int64_t getCounter() const = 0;
+	/**@brief Coarse sleep.
+	 * @details
+	 * The current thread gives up CPU.
+	 * It may return later than requested by scheduler granularity.
+	 * @param[in]	counter	Sleep time in counter unit.
+	 */
+	virtual void sleepFor(int64_t counter) = 0;
+	/**@brief Called in each iteration of a spin-wait loop.
+	 * @details Default implementation does nothing.
+	 */
+	virtual void relax() {}
+};
+
+/**@brief Real clock of the running system.
+ * @details
+ * @li Windows: QueryPerformanceCounter() and high-resolution waitable timer.
+ * (Falls back to timeBeginPeriod(1) if high-resolution timer is not available.)
+ * @li POSIX: clock_gettime(CLOCK_MONOTONIC) and clock_nanosleep().
+ */
+class SystemClock : public Clock {
+public:
+	SystemClock();
+	virtual ~SystemClock() override;
+
+	virtual int64_t getFrequency() const override;
+	virtual int64_t getCounter() const override;
+	virtual void sleepFor(int64_t counter) override;
+	virtual void relax() override;
+
+private:
+	int64_t m_freq;
+#ifdef _WIN32
+	util::HandlePtr m_hTimer;
+	bool m_timePeriod = false;
+#endif
+};
+
+/// How to decide spin time before the deadline.
+enum class SlackPolicy {
+	/// Always spin for WaitParam::slackUs.
+	Fixed,
+	/// Learn sleep overshoot and spin as short as possible.
+	Adaptive,
+	/// Never sleep. (lowest jitter, burns a core)
+	SpinOnly,
+	/// Never spin. (lowest CPU usage, jitter by scheduler)
+	SleepOnly,
+};
+
+/**@brief PreciseWaiter parameters.
+ * @details Each field has a default value.
+ */
+struct WaitParam {
+	/// Slack policy.
+	SlackPolicy policy = SlackPolicy::Adaptive;
+	/// Spin time before the deadline. (Initial value if Adaptive) [us]
+	uint32_t slackUs = 2000;
+	/// Lower limit of spin time if Adaptive. [us]
+	uint32_t minSlackUs = 200;
+	/// Upper limit of spin time if Adaptive. [us]
+	uint32_t maxSlackUs = 4000;
+};
+
+/**@brief Hybrid waiter: coarse sleep, then short calibrated spin.
+ * @details
+ * waitUntil() sleeps until (target - slack) and spins for the rest.
+ * In Adaptive mode, slack follows mean + 3 sigma of the observed sleep
+ * overshoot, clamped in [minSlackUs, maxSlackUs].
+ */
+class PreciseWaiter : private util::noncopyable {
+public:
+	/**@brief Constructor.
+	 * @param[in]	clock	Clock to be used. (must outlive this object)
+	 * @param[in]	param	Wait parameters.
+	 */
+	PreciseWaiter(Clock &clock, const WaitParam &param);
+	~PreciseWaiter() = default;
+
+	/**@brief Wait until clock counter reaches target.
+	 * @param[in]	target	Target counter value.
+	 * @return		Counter value at return. (>= target)
+	 */
+	int64_t waitUntil(int64_t target);
+	/**@brief Get current slack.
+	 * @return Slack in counter unit.
+	 */
+	int64_t getSlack() const { return m_slack; }
+
+private:
+	Clock &m_clock;
+	WaitParam m_param;
+	int64_t m_slack;
+	int64_t m_minSlack;
+	int64_t m_maxSlack;
+	// EWMA of sleep overshoot (counter unit)
+	double m_overMean = 0.0;
+	double m_overVar = 0.0;
+
+	void updateSlack(int64_t overshoot);
+};
+
+/// Frame time jitter statistics. [ms]
+struct FrameJitter {
+	/// Average frame time.
+	double meanMs = 0.0;
+	/// Standard deviation of frame time.
+	double stddevMs = 0.0;
+	/// 99th percentile frame time.
+	double p99Ms = 0.0;
+	/// Max frame time.
+	double maxMs = 0.0;
+};
+
+/**@brief Calculate jitter statistics.
+ * @param[out]	out		Result.
+ * @param[in]	samples	Frame times in counter unit.
+ * @param[in]	freq	Counter frequency.
+ */
+void calcFrameJitter(FrameJitter *out,
+	const std::vector<int64_t> &samples, int64_t freq);
+
+/// Per-frame time breakdown. (counter unit)
+struct FrameTimeSample {
+	/// Update phase.
+	int64_t update = 0;
+	/// Render phase.
+	int64_t render = 0;
+	/// Present phase.
+	int64_t present = 0;
+	/// Idle tasks run in the frame slack.
+	int64_t idle = 0;
+	/// Wait for the next frame.
+	int64_t wait = 0;
+	/// Frame interval. (includes all of the above)
+	int64_t total = 0;
+};
+
+/// Percentile values. [ms]
+struct Percentiles {
+	double p50Ms = 0.0;
+	double p95Ms = 0.0;
+	double p99Ms = 0.0;
+	double maxMs = 0.0;
+};
+
+/// Frame time statistics over a sliding window.
+struct FrameTimeStats {
+	/// Actual sample count. (<= requested window)
+	uint32_t frames = 0;
+	Percentiles update;
+	Percentiles render;
+	Percentiles present;
+	Percentiles idle;
+	Percentiles wait;
+	Percentiles total;
+};
+
+/**@brief Lock-free ring buffer of per-frame times.
+ * @details
+ * Single writer (frame loop), multiple readers on any thread.
+ * Each slot is protected by a sequence counter (seqlock);
+ * readers never block the writer and drop slots overwritten while reading.
+ */
+class FrameTimeRing : private util::noncopyable {
+public:
+	/// Ring size. (frames)
+	static const uint32_t Capacity = 1024;
+
+	/**@brief Constructor.
+	 * @param[in]	freq	Counter frequency.
+	 */
+	explicit FrameTimeRing(int64_t freq);
+	~FrameTimeRing() = default;
+
+	/**@brief Push a sample. (writer thread only)
+	 * @param[in]	sample	Frame time sample.
+	 */
+	void push(const FrameTimeSample &sample);
+	/**@brief Get total number of pushed samples.
+	 */
+	uint64_t getCount() const;
+	/**@brief Copy the latest samples. (any thread)
+	 * @param[out]	out		Samples, older first.
+	 * @param[in]	count	Max sample count. (<= @ref Capacity)
+	 */
+	void copyLatest(std::vector<FrameTimeSample> *out, uint32_t count) const;
+	/**@brief Calculate percentiles of the latest samples. (any thread)
+	 * @param[out]	out		Result.
+	 * @param[in]	window	Window size. (frames, <= @ref Capacity)
+	 */
+	void getStats(FrameTimeStats *out, uint32_t window) const;
+	/**@brief Make a histogram of frame interval. (any thread)
+	 * @details The last bin counts all samples >= binMs * (binCount - 1).
+	 * @param[out]	out			Counts of each bin. (resized to binCount)
+	 * @param[in]	binMs		Bin width. [ms]
+	 * @param[in]	binCount	Bin count.
+	 * @param[in]	window		Window size. (frames, <= @ref Capacity)
+	 */
+	void getHistogram(std::vector<uint32_t> *out,
+		double binMs, uint32_t binCount, uint32_t window) const;
+
+private:
+	struct Slot {
+		std::atomic<uint32_t> seq;
+		std::atomic<int64_t> update, render, present, idle, wait, total;
+	};
+
+	int64_t m_freq;
+	std::atomic<uint64_t> m_count;
+	std::array<Slot, Capacity> m_slots;
+};
+
+}	// namespace timer
+}	// namespace yappy
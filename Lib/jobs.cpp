@@ -0,0 +1,333 @@
+﻿#include "stdafx.h"
+#include "include/jobs.h"
+#include "include/debug.h"
+#include <cwchar>
+
+namespace yappy {
+namespace jobs {
+
+namespace {
+
+// worker identity of the current thread
+thread_local const JobSystem *t_system = nullptr;
+thread_local int t_workerIndex = -1;
+
+inline uint32_t xorshift32(uint32_t *state)
+{
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+}	// namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// class JobCounter impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region JobCounter
+
+bool JobCounter::isDone() const
+{
+	// lock so that the counter can be destroyed right after this returns true
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_count == 0;
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// class JobSystem impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region JobSystem
+
+JobSystem::JobSystem(uint32_t workerCount) :
+	m_externalExecuted(0), m_queued(0), m_waiters(0), m_stop(false)
+{
+	if (workerCount == 0) {
+		// the main thread also works while waiting
+		uint32_t hw = std::thread::hardware_concurrency();
+		workerCount = (hw > 1) ? hw - 1 : 1;
+	}
+	for (uint32_t i = 0; i < workerCount; i++) {
+		auto worker = std::make_unique<Worker>();
+		worker->executed.store(0);
+		worker->stolen.store(0);
+		worker->injected.store(0);
+		worker->random = 2463534242u + i * 0x9e3779b9u;
+		m_workers.emplace_back(std::move(worker));
+	}
+	debug::writef(L"JobSystem: %u workers", workerCount);
+	for (uint32_t i = 0; i < workerCount; i++) {
+		m_threads.emplace_back(&JobSystem::workerMain, this, i);
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		m_stop.store(true);
+	}
+	m_wake.notify_all();
+	for (auto &th : m_threads) {
+		th.join();
+	}
+}
+
+uint32_t JobSystem::getWorkerCount() const
+{
+	return static_cast<uint32_t>(m_workers.size());
+}
+
+JobStats JobSystem::getStats() const
+{
+	JobStats stats;
+	stats.workers = getWorkerCount();
+	stats.executed = m_externalExecuted.load(std::memory_order_relaxed);
+	for (const auto &worker : m_workers) {
+		stats.executed += worker->executed.load(std::memory_order_relaxed);
+		stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+		stats.injected += worker->injected.load(std::memory_order_relaxed);
+	}
+	return stats;
+}
+
+void JobSystem::run(JobFunc func, JobCounter *counter)
+{
+	if (counter != nullptr) {
+		std::lock_guard<std::mutex> lock(counter->m_lock);
+		counter->m_count++;
+	}
+	push(Job{ std::move(func), counter });
+}
+
+void JobSystem::runAfter(JobCounter &dependency, JobFunc func, JobCounter *counter)
+{
+	if (counter != nullptr) {
+		std::lock_guard<std::mutex> lock(counter->m_lock);
+		counter->m_count++;
+	}
+	Job job{ std::move(func), counter };
+	{
+		std::lock_guard<std::mutex> lock(dependency.m_lock);
+		if (dependency.m_count != 0) {
+			// pushed by finish() of the last job
+			dependency.m_continuations.emplace_back(std::move(job));
+			return;
+		}
+	}
+	push(std::move(job));
+}
+
+void JobSystem::wait(JobCounter &counter)
+{
+	while (!counter.isDone()) {
+		Job job;
+		if (tryPop(&job)) {
+			execute(job);
+			continue;
+		}
+		// sleep until a job is queued or the last job finishes
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_waiters++;
+		m_waitWake.wait(lock, [this, &counter]() {
+			return m_queued.load() != 0 || counter.isDone();
+		});
+		m_waiters--;
+	}
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_lock);
+		std::swap(error, counter.m_error);
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+}
+
+int JobSystem::getCurrentWorker() const
+{
+	return (t_system == this) ? t_workerIndex : -1;
+}
+
+void JobSystem::push(Job &&job)
+{
+	int index = getCurrentWorker();
+	if (index >= 0) {
+		// own deque (back)
+		Worker &worker = *m_workers[index];
+		std::lock_guard<std::mutex> lock(worker.lock);
+		worker.deque.emplace_back(std::move(job));
+	}
+	else {
+		std::lock_guard<std::mutex> lock(m_globalLock);
+		m_global.emplace_back(std::move(job));
+	}
+	m_queued.fetch_add(1);
+	// avoid lost wake-up: a worker is either before the check or in wait()
+	bool waiters;
+	{
+		std::lock_guard<std::mutex> lock(m_sleepLock);
+		waiters = m_waiters != 0;
+	}
+	m_wake.notify_one();
+	if (waiters) {
+		// waiting threads help too
+		m_waitWake.notify_all();
+	}
+}
+
+bool JobSystem::tryPop(Job *job)
+{
+	if (m_queued.load() == 0) {
+		return false;
+	}
+	const int index = getCurrentWorker();
+	const size_t count = m_workers.size();
+
+	// 1. own deque (back, LIFO)
+	if (index >= 0) {
+		Worker &worker = *m_workers[index];
+		std::lock_guard<std::mutex> lock(worker.lock);
+		if (!worker.deque.empty()) {
+			*job = std::move(worker.deque.back());
+			worker.deque.pop_back();
+			m_queued.fetch_sub(1);
+			return true;
+		}
+	}
+	// 2. global queue (front, FIFO)
+	{
+		std::lock_guard<std::mutex> lock(m_globalLock);
+		if (!m_global.empty()) {
+			*job = std::move(m_global.front());
+			m_global.pop_front();
+			m_queued.fetch_sub(1);
+			if (index >= 0) {
+				m_workers[index]->injected.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+	}
+	// 3. steal from others (front, FIFO), starting at a random victim
+	uint32_t start = 0;
+	if (index >= 0) {
+		start = xorshift32(&m_workers[index]->random);
+	}
+	for (size_t i = 0; i < count; i++) {
+		size_t victim = (start + i) % count;
+		if (static_cast<int>(victim) == index) {
+			continue;
+		}
+		Worker &worker = *m_workers[victim];
+		std::lock_guard<std::mutex> lock(worker.lock);
+		if (!worker.deque.empty()) {
+			*job = std::move(worker.deque.front());
+			worker.deque.pop_front();
+			m_queued.fetch_sub(1);
+			if (index >= 0) {
+				m_workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Job &job)
+{
+	std::exception_ptr error;
+	try {
+		job.func();
+	}
+	catch (...) {
+		error = std::current_exception();
+	}
+	int index = getCurrentWorker();
+	if (index >= 0) {
+		m_workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+	}
+	else {
+		m_externalExecuted.fetch_add(1, std::memory_order_relaxed);
+	}
+	// release captures before the counter is signaled
+	job.func = nullptr;
+	finish(job.counter, error);
+}
+
+void JobSystem::finish(JobCounter *counter, std::exception_ptr error)
+{
+	if (counter == nullptr) {
+		if (error) {
+			try {
+				std::rethrow_exception(error);
+			}
+			catch (const std::exception &ex) {
+				debug::writeLine(L"Unhandled exception in job");
+				debug::writeLine(ex.what());
+			}
+			catch (...) {
+				debug::writeLine(L"Unhandled exception in job");
+			}
+		}
+		return;
+	}
+	std::vector<Job> continuations;
+	bool done;
+	{
+		std::lock_guard<std::mutex> lock(counter->m_lock);
+		if (error && !counter->m_error) {
+			counter->m_error = error;
+		}
+		ASSERT(counter->m_count > 0);
+		counter->m_count--;
+		done = counter->m_count == 0;
+		if (done) {
+			continuations.swap(counter->m_continuations);
+		}
+	}
+	// counter may be destroyed from here
+	for (auto &job : continuations) {
+		push(std::move(job));
+	}
+	if (done) {
+		// a waiter checks the counter under m_sleepLock
+		bool waiters;
+		{
+			std::lock_guard<std::mutex> lock(m_sleepLock);
+			waiters = m_waiters != 0;
+		}
+		if (waiters) {
+			m_waitWake.notify_all();
+		}
+	}
+}
+
+void JobSystem::workerMain(uint32_t index)
+{
+	t_system = this;
+	t_workerIndex = static_cast<int>(index);
+	wchar_t name[32];
+	std::swprintf(name, sizeof(name) / sizeof(name[0]), L"Job worker %u", index);
+	platform::setThreadName(name);
+
+	while (!m_stop.load()) {
+		Job job;
+		if (tryPop(&job)) {
+			execute(job);
+			continue;
+		}
+		std::unique_lock<std::mutex> lock(m_sleepLock);
+		m_wake.wait(lock, [this]() {
+			return m_stop.load() || m_queued.load() != 0;
+		});
+	}
+}
+
+#pragma endregion
+
+}	// namespace jobs
+}	// namespace yappy
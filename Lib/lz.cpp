@@ -0,0 +1,266 @@
+﻿#include "stdafx.h"
+#include "include/lz.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+namespace yappy {
+namespace lz {
+
+using error::throwTrace;
+using error::FrameworkError;
+
+namespace {
+
+const int HashBits = 12;
+// the last bytes are always literals
+const size_t LastLiterals = 5;
+// no match starts in the last bytes
+const size_t MatchSearchEnd = 12;
+
+inline uint32_t read32(const uint8_t *p)
+{
+	uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+inline uint32_t hash4(uint32_t value)
+{
+	return (value * 2654435761u) >> (32 - HashBits);
+}
+
+// len: length - 15
+inline bool writeLength(uint8_t **op, const uint8_t *oend, size_t len)
+{
+	for (; len >= 255; len -= 255) {
+		if (*op >= oend) {
+			return false;
+		}
+		*(*op)++ = 255;
+	}
+	if (*op >= oend) {
+		return false;
+	}
+	*(*op)++ = static_cast<uint8_t>(len);
+	return true;
+}
+
+// matchLen == 0: the last literals
+bool writeSequence(uint8_t **op, const uint8_t *oend,
+	const uint8_t *lit, size_t litLen, size_t offset, size_t matchLen)
+{
+	uint8_t *p = *op;
+	if (p >= oend) {
+		return false;
+	}
+	const size_t ml = (matchLen != 0) ? matchLen - MinMatch : 0;
+	*p++ = static_cast<uint8_t>(
+		(std::min<size_t>(litLen, 15) << 4) | std::min<size_t>(ml, 15));
+	if (litLen >= 15 && !writeLength(&p, oend, litLen - 15)) {
+		return false;
+	}
+	if (litLen > static_cast<size_t>(oend - p)) {
+		return false;
+	}
+	std::memcpy(p, lit, litLen);
+	p += litLen;
+	if (matchLen != 0) {
+		if (oend - p < 2) {
+			return false;
+		}
+		*p++ = static_cast<uint8_t>(offset & 0xff);
+		*p++ = static_cast<uint8_t>(offset >> 8);
+		if (ml >= 15 && !writeLength(&p, oend, ml - 15)) {
+			return false;
+		}
+	}
+	*op = p;
+	return true;
+}
+
+inline size_t readLength(const uint8_t **ip, const uint8_t *iend)
+{
+	size_t len = 0;
+	uint8_t b;
+	do {
+		if (*ip >= iend) {
+			throwTrace<FrameworkError>("Broken compressed data: length");
+		}
+		b = *(*ip)++;
+		len += b;
+	} while (b == 255);
+	return len;
+}
+
+}	// namespace
+
+size_t compress(const void *src, size_t srcSize, void *dst, size_t dstSize)
+{
+	if (srcSize == 0) {
+		return 0;
+	}
+	const uint8_t *in = static_cast<const uint8_t *>(src);
+	uint8_t *op = static_cast<uint8_t *>(dst);
+	const uint8_t *oend = op + dstSize;
+
+	size_t anchor = 0;
+	if (srcSize > MatchSearchEnd) {
+		// position of the last 4 bytes with the hash
+		// (16 KiB on stack, no heap allocation)
+		uint32_t table[1 << HashBits] = { 0 };
+		const size_t limit = srcSize - MatchSearchEnd;
+		const size_t matchEnd = srcSize - LastLiterals;
+		size_t ip = 0;
+		uint32_t misses = 0;
+		while (ip < limit) {
+			const uint32_t seq = read32(in + ip);
+			const uint32_t h = hash4(seq);
+			const size_t ref = table[h];
+			table[h] = static_cast<uint32_t>(ip);
+			if (ref < ip && ip - ref <= MaxOffset && read32(in + ref) == seq) {
+				size_t len = MinMatch;
+				while (ip + len < matchEnd && in[ref + len] == in[ip + len]) {
+					len++;
+				}
+				if (!writeSequence(&op, oend, in + anchor, ip - anchor, ip - ref, len)) {
+					return 0;
+				}
+				ip += len;
+				anchor = ip;
+				misses = 0;
+			}
+			else {
+				// skip faster in incompressible data
+				ip += 1 + (misses++ >> 6);
+			}
+		}
+	}
+	if (!writeSequence(&op, oend, in + anchor, srcSize - anchor, 0, 0)) {
+		return 0;
+	}
+	size_t size = op - static_cast<uint8_t *>(dst);
+	return (size < srcSize) ? size : 0;
+}
+
+void decompress(const void *src, size_t srcSize, void *dst, size_t dstSize)
+{
+	const uint8_t *ip = static_cast<const uint8_t *>(src);
+	const uint8_t *iend = ip + srcSize;
+	uint8_t *const obegin = static_cast<uint8_t *>(dst);
+	uint8_t *op = obegin;
+	uint8_t *const oend = op + dstSize;
+
+	while (true) {
+		if (ip >= iend) {
+			throwTrace<FrameworkError>("Broken compressed data: token");
+		}
+		const uint8_t token = *ip++;
+		size_t lit = token >> 4;
+		if (lit == 15) {
+			lit += readLength(&ip, iend);
+		}
+		if (lit > static_cast<size_t>(iend - ip) || lit > static_cast<size_t>(oend - op)) {
+			throwTrace<FrameworkError>("Broken compressed data: literals");
+		}
+		std::memcpy(op, ip, lit);
+		ip += lit;
+		op += lit;
+		if (ip == iend) {
+			break;
+		}
+
+		if (iend - ip < 2) {
+			throwTrace<FrameworkError>("Broken compressed data: offset");
+		}
+		const size_t offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > static_cast<size_t>(op - obegin)) {
+			throwTrace<FrameworkError>("Broken compressed data: offset");
+		}
+		size_t len = token & 15;
+		if (len == 15) {
+			len += readLength(&ip, iend);
+		}
+		len += MinMatch;
+		if (len > static_cast<size_t>(oend - op)) {
+			throwTrace<FrameworkError>("Broken compressed data: match");
+		}
+		const uint8_t *ref = op - offset;
+		if (offset >= len) {
+			std::memcpy(op, ref, len);
+		}
+		else {
+			// overlapped (repeat pattern)
+			for (size_t i = 0; i < len; i++) {
+				op[i] = ref[i];
+			}
+		}
+		op += len;
+	}
+	if (op != oend) {
+		throwTrace<FrameworkError>("Broken compressed data: size");
+	}
+}
+
+BenchResult benchmark(const void *data, size_t size, size_t blockSize, uint32_t rounds)
+{
+	using Clock = std::chrono::high_resolution_clock;
+	using std::chrono::duration;
+
+	const uint8_t *in = static_cast<const uint8_t *>(data);
+	blockSize = std::max<size_t>(blockSize, 1);
+	rounds = std::max(rounds, 1u);
+	const size_t blockCount = (size + blockSize - 1) / blockSize;
+	const size_t bound = compressBound(blockSize);
+
+	// compressed size of each block (0: stored)
+	std::vector<uint8_t> comp(bound * blockCount);
+	std::vector<size_t> compSize(blockCount);
+	std::vector<uint8_t> out(size);
+
+	BenchResult result;
+	result.rawBytes = size;
+	duration<double> compTime(0), decompTime(0);
+	for (uint32_t r = 0; r < rounds; r++) {
+		auto start = Clock::now();
+		for (size_t i = 0; i < blockCount; i++) {
+			size_t raw = std::min(blockSize, size - i * blockSize);
+			compSize[i] = compress(in + i * blockSize, raw, &comp[i * bound], bound);
+		}
+		auto mid = Clock::now();
+		for (size_t i = 0; i < blockCount; i++) {
+			size_t raw = std::min(blockSize, size - i * blockSize);
+			if (compSize[i] != 0) {
+				decompress(&comp[i * bound], compSize[i], &out[i * blockSize], raw);
+			}
+			else {
+				std::memcpy(&out[i * blockSize], in + i * blockSize, raw);
+			}
+		}
+		auto end = Clock::now();
+		compTime += mid - start;
+		decompTime += end - mid;
+	}
+	if (size != 0 && std::memcmp(out.data(), in, size) != 0) {
+		throwTrace<FrameworkError>("LZ round trip mismatch");
+	}
+	for (size_t i = 0; i < blockCount; i++) {
+		size_t raw = std::min(blockSize, size - i * blockSize);
+		result.compressedBytes += (compSize[i] != 0) ? compSize[i] : raw;
+	}
+	const double mb = static_cast<double>(size) * rounds / 1e6;
+	result.compressMBps = (compTime.count() > 0.0) ? mb / compTime.count() : 0.0;
+	result.decompressMBps = (decompTime.count() > 0.0) ? mb / decompTime.count() : 0.0;
+	debug::writef(L"LZ bench: %llu -> %llu bytes, compress %.1f MB/s, decompress %.1f MB/s",
+		static_cast<unsigned long long>(result.rawBytes),
+		static_cast<unsigned long long>(result.compressedBytes),
+		result.compressMBps, result.decompressMBps);
+	return result;
+}
+
+}	// namespace lz
+}	// namespace yappy
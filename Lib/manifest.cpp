@@ -0,0 +1,203 @@
+﻿#include "stdafx.h"
+#include "include/manifest.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <cstring>
+
+namespace yappy {
+namespace manifest {
+
+using error::throwTrace;
+using error::FrameworkError;
+
+namespace {
+
+const char Magic[4] = { 'Y', 'R', 'M', 'F' };
+const uint32_t Version = 1;
+
+struct Header {
+	char magic[4];
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t stringSize;
+};
+
+struct EntryData {
+	uint32_t type;
+	uint32_t setId;
+	uint32_t resId;
+	uint32_t path;
+	uint32_t startChar;
+	uint32_t endChar;
+	uint32_t w;
+	uint32_t h;
+};
+
+static_assert(sizeof(Header) == 16, "Header size");
+static_assert(sizeof(EntryData) == 32, "EntryData size");
+
+// returns offset in the string table
+uint32_t addString(std::vector<char> *table, const char *str)
+{
+	uint32_t offset = static_cast<uint32_t>(table->size());
+	table->insert(table->end(), str, str + std::strlen(str) + 1);
+	return offset;
+}
+
+const char *getString(const char *base, uint32_t size, uint32_t offset)
+{
+	if (offset >= size) {
+		throwTrace<FrameworkError>("Broken manifest: string offset");
+	}
+	// must be terminated in the table
+	if (std::memchr(base + offset, '\0', size - offset) == nullptr) {
+		throwTrace<FrameworkError>("Broken manifest: string");
+	}
+	return base + offset;
+}
+
+}	// namespace
+
+file::Bytes serialize(const std::vector<Entry> &entries)
+{
+	std::vector<EntryData> data;
+	std::vector<char> strings;
+	data.reserve(entries.size());
+	for (const auto &entry : entries) {
+		EntryData ed = {};
+		ed.type = static_cast<uint32_t>(entry.type);
+		ed.setId = entry.setId;
+		ed.resId = addString(&strings, entry.resId.c_str());
+		ed.path = addString(&strings, util::wc2utf8(entry.path.c_str()).get());
+		ed.startChar = entry.startChar;
+		ed.endChar = entry.endChar;
+		ed.w = entry.w;
+		ed.h = entry.h;
+		data.emplace_back(ed);
+	}
+
+	Header header;
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.entryCount = static_cast<uint32_t>(data.size());
+	header.stringSize = static_cast<uint32_t>(strings.size());
+
+	file::Bytes bin(sizeof(header) + sizeof(EntryData) * data.size() + strings.size());
+	uint8_t *p = bin.data();
+	std::memcpy(p, &header, sizeof(header));
+	p += sizeof(header);
+	if (!data.empty()) {
+		std::memcpy(p, data.data(), sizeof(EntryData) * data.size());
+		p += sizeof(EntryData) * data.size();
+	}
+	if (!strings.empty()) {
+		std::memcpy(p, strings.data(), strings.size());
+	}
+	return bin;
+}
+
+std::vector<Entry> parse(const file::Bytes &bin)
+{
+	Header header;
+	if (bin.size() < sizeof(header)) {
+		throwTrace<FrameworkError>("Broken manifest: header");
+	}
+	std::memcpy(&header, bin.data(), sizeof(header));
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0) {
+		throwTrace<FrameworkError>("Not a manifest file");
+	}
+	if (header.version != Version) {
+		throwTrace<FrameworkError>("Unsupported manifest version");
+	}
+	uint64_t expected = sizeof(header) +
+		static_cast<uint64_t>(sizeof(EntryData)) * header.entryCount + header.stringSize;
+	if (bin.size() != expected) {
+		throwTrace<FrameworkError>("Broken manifest: size");
+	}
+
+	const uint8_t *entryBase = bin.data() + sizeof(header);
+	const char *strBase = reinterpret_cast<const char *>(
+		entryBase + sizeof(EntryData) * header.entryCount);
+
+	std::vector<Entry> entries(header.entryCount);
+	for (uint32_t i = 0; i < header.entryCount; i++) {
+		EntryData ed;
+		std::memcpy(&ed, entryBase + sizeof(EntryData) * i, sizeof(ed));
+		if (ed.type >= static_cast<uint32_t>(EntryType::Count)) {
+			throwTrace<FrameworkError>("Broken manifest: type");
+		}
+		Entry &entry = entries[i];
+		entry.type = static_cast<EntryType>(ed.type);
+		entry.setId = ed.setId;
+		entry.resId = getString(strBase, header.stringSize, ed.resId);
+		entry.path = util::utf82wc(
+			getString(strBase, header.stringSize, ed.path)).get();
+		entry.startChar = ed.startChar;
+		entry.endChar = ed.endChar;
+		entry.w = ed.w;
+		entry.h = ed.h;
+	}
+	return entries;
+}
+
+std::vector<Entry> load(const wchar_t *fileName)
+{
+	return parse(file::loadFile(fileName));
+}
+
+void save(const wchar_t *path, const std::vector<Entry> &entries)
+{
+	debug::writef(L"Save manifest: %s (%zu entries)", path, entries.size());
+
+	file::Bytes bin = serialize(entries);
+	FILE *tmpfp = platform::openFile(path, "wb");
+	if (tmpfp == nullptr) {
+		throwTrace<FrameworkError>("Save manifest file failed");
+	}
+	util::FilePtr fp(tmpfp);
+	if (::fwrite(bin.data(), 1, bin.size(), fp.get()) != bin.size()) {
+		throwTrace<FrameworkError>("Write manifest file failed");
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class Recorder impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region Recorder
+
+void Recorder::setEnabled(bool enabled)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	m_enabled = enabled;
+}
+
+bool Recorder::isEnabled() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_enabled;
+}
+
+void Recorder::record(const Entry &entry)
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	if (!m_enabled) {
+		return;
+	}
+	for (const auto &e : m_entries) {
+		if (e.type == entry.type && e.setId == entry.setId && e.resId == entry.resId) {
+			return;
+		}
+	}
+	m_entries.emplace_back(entry);
+}
+
+std::vector<Entry> Recorder::getEntries() const
+{
+	std::lock_guard<std::mutex> lock(m_lock);
+	return m_entries;
+}
+
+#pragma endregion
+
+}	// namespace manifest
+}	// namespace yappy
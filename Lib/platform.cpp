@@ -0,0 +1,1045 @@
+﻿#include "stdafx.h"
+#include "include/platform.h"
+#include "include/exceptions.h"
+#include "include/util.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <csignal>
+#include <climits>
+#include <cstdlib>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace yappy {
+namespace platform {
+
+using error::throwTrace;
+using error::checkWin32Result;
+
+#ifdef _WIN32
+
+namespace {
+
+DWORD getFlags(AccessHint hint)
+{
+	switch (hint) {
+	case AccessHint::Sequential:
+		return FILE_FLAG_SEQUENTIAL_SCAN;
+	case AccessHint::Random:
+		return FILE_FLAG_RANDOM_ACCESS;
+	default:
+		return 0;
+	}
+}
+
+// ReadFile() and WriteFile() take DWORD size
+const size_t IoChunkMax = 0x40000000;
+
+// PrefetchVirtualMemory() is Windows 8 or later
+struct MemoryRangeEntry {
+	void *VirtualAddress;
+	SIZE_T NumberOfBytes;
+};
+using PrefetchVirtualMemoryFunc = BOOL (WINAPI *)(
+	HANDLE hProcess, ULONG_PTR NumberOfEntries,
+	MemoryRangeEntry *VirtualAddresses, ULONG Flags);
+// SetThreadDescription() is Windows 10 1607 or later
+using SetThreadDescriptionFunc = HRESULT (WINAPI *)(HANDLE hThread, PCWSTR lpThreadDescription);
+
+template <class F>
+F getKernel32Proc(const char *name)
+{
+	return reinterpret_cast<F>(::GetProcAddress(::GetModuleHandle(L"kernel32.dll"), name));
+}
+
+}	// namespace
+
+uint32_t getLastError()
+{
+	return ::GetLastError();
+}
+
+std::string getErrorMessage(uint32_t code)
+{
+	char *lpMsgBuf = NULL;
+	DWORD ret = ::FormatMessageA(
+		FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS | FORMAT_MESSAGE_MAX_WIDTH_MASK,
+		nullptr, code, MAKELANGID(LANG_ENGLISH, SUBLANG_ENGLISH_US),
+		reinterpret_cast<LPSTR>(&lpMsgBuf), 0, nullptr);
+	auto del = [](char *p) {
+		::LocalFree(p);
+	};
+	std::unique_ptr<char, decltype(del)> pMsgBuf(lpMsgBuf, del);
+	return (ret != 0) ? lpMsgBuf : "<FormatMessageA failed>";
+}
+
+void debugBreak()
+{
+	::DebugBreak();
+}
+
+int64_t getCounter()
+{
+	LARGE_INTEGER cur;
+	BOOL b = ::QueryPerformanceCounter(&cur);
+	checkWin32Result(b != 0, "QueryPerformanceCounter() failed");
+	return cur.QuadPart;
+}
+
+int64_t getCounterFrequency()
+{
+	static const int64_t freq = []() {
+		LARGE_INTEGER f;
+		BOOL b = ::QueryPerformanceFrequency(&f);
+		checkWin32Result(b != 0, "QueryPerformanceFrequency() failed");
+		return f.QuadPart;
+	}();
+	return freq;
+}
+
+size_t wcToUtf8(const wchar_t *in, char *out, size_t outCount)
+{
+	int len = ::WideCharToMultiByte(CP_UTF8, 0, in, -1, nullptr, 0, nullptr, nullptr);
+	if (out != nullptr) {
+		::WideCharToMultiByte(CP_UTF8, 0, in, -1, out, static_cast<int>(outCount), nullptr, nullptr);
+	}
+	return len;
+}
+
+size_t utf8ToWc(const char *in, wchar_t *out, size_t outCount)
+{
+	int len = ::MultiByteToWideChar(CP_UTF8, 0, in, -1, nullptr, 0);
+	if (out != nullptr) {
+		::MultiByteToWideChar(CP_UTF8, 0, in, -1, out, static_cast<int>(outCount));
+	}
+	return len;
+}
+
+void formatWide(wchar_t *buf, size_t count, const wchar_t *fmt, va_list args)
+{
+	_vsnwprintf_s(buf, count, _TRUNCATE, fmt, args);
+}
+
+void writeDebugOutput(const wchar_t *str)
+{
+	::OutputDebugString(str);
+}
+
+bool openConsole()
+{
+	BOOL ret = ::AllocConsole();
+	if (!ret) {
+		return false;
+	}
+	HANDLE hOut = ::GetStdHandle(STD_OUTPUT_HANDLE);
+	COORD maxSize = ::GetLargestConsoleWindowSize(hOut);
+	COORD bufSize = { 80, static_cast<SHORT>(maxSize.Y * 10) };
+	SMALL_RECT rect = { 0, 0, static_cast<SHORT>(bufSize.X - 1), static_cast<SHORT>(maxSize.Y * 3 / 4) };
+	::SetConsoleScreenBufferSize(hOut, bufSize);
+	::SetConsoleWindowInfo(hOut, TRUE, &rect);
+	return true;
+}
+
+void closeConsole()
+{
+	::FreeConsole();
+}
+
+void writeConsole(const wchar_t *str)
+{
+	HANDLE hOut = ::GetStdHandle(STD_OUTPUT_HANDLE);
+	DWORD written = 0;
+	::WriteConsole(hOut, str, static_cast<DWORD>(wcslen(str)), &written, nullptr);
+}
+
+bool readConsole(std::wstring *line)
+{
+	HANDLE hIn = ::GetStdHandle(STD_INPUT_HANDLE);
+	if (hIn == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	wchar_t buf[1024];
+	DWORD readSize = 0;
+	if (!::ReadConsole(hIn, buf, sizeof(buf) / sizeof(buf[0]), &readSize, nullptr)) {
+		return false;
+	}
+	line->assign(buf, readSize);
+	while (!line->empty() && (line->back() == L'\n' || line->back() == L'\r')) {
+		line->pop_back();
+	}
+	return true;
+}
+
+FileHandle FileHandle::openRead(const wchar_t *path, AccessHint hint)
+{
+	HANDLE h = ::CreateFile(
+		path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | getFlags(hint), nullptr);
+	checkWin32Result(h != INVALID_HANDLE_VALUE, "CreateFile() failed");
+	return FileHandle(reinterpret_cast<intptr_t>(h));
+}
+
+FileHandle FileHandle::createWrite(const wchar_t *path)
+{
+	HANDLE h = ::CreateFile(
+		path, GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	checkWin32Result(h != INVALID_HANDLE_VALUE, "CreateFile() failed");
+	return FileHandle(reinterpret_cast<intptr_t>(h));
+}
+
+void FileHandle::close() noexcept
+{
+	if (m_handle != InvalidHandle) {
+		::CloseHandle(reinterpret_cast<HANDLE>(m_handle));
+		m_handle = InvalidHandle;
+	}
+}
+
+uint64_t FileHandle::getSize() const
+{
+	LARGE_INTEGER size = { 0 };
+	BOOL b = ::GetFileSizeEx(reinterpret_cast<HANDLE>(m_handle), &size);
+	checkWin32Result(b != 0, "GetFileSizeEx() failed");
+	return static_cast<uint64_t>(size.QuadPart);
+}
+
+size_t FileHandle::read(void *buf, size_t size)
+{
+	uint8_t *p = static_cast<uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		DWORD chunk = static_cast<DWORD>(std::min(size - total, IoChunkMax));
+		DWORD readSize = 0;
+		BOOL b = ::ReadFile(reinterpret_cast<HANDLE>(m_handle), p + total, chunk, &readSize, nullptr);
+		checkWin32Result(b != 0, "ReadFile() failed");
+		if (readSize == 0) {
+			break;
+		}
+		total += readSize;
+	}
+	return total;
+}
+
+size_t FileHandle::readAt(void *buf, size_t size, uint64_t offset)
+{
+	uint8_t *p = static_cast<uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		// synchronous handle: reads at the offset and waits
+		OVERLAPPED ov = { 0 };
+		uint64_t pos = offset + total;
+		ov.Offset = static_cast<DWORD>(pos);
+		ov.OffsetHigh = static_cast<DWORD>(pos >> 32);
+		DWORD chunk = static_cast<DWORD>(std::min(size - total, IoChunkMax));
+		DWORD readSize = 0;
+		BOOL b = ::ReadFile(reinterpret_cast<HANDLE>(m_handle), p + total, chunk, &readSize, &ov);
+		if (!b && ::GetLastError() == ERROR_HANDLE_EOF) {
+			break;
+		}
+		checkWin32Result(b != 0, "ReadFile() failed");
+		if (readSize == 0) {
+			break;
+		}
+		total += readSize;
+	}
+	return total;
+}
+
+void FileHandle::write(const void *buf, size_t size)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		DWORD chunk = static_cast<DWORD>(std::min(size - total, IoChunkMax));
+		DWORD written = 0;
+		BOOL b = ::WriteFile(reinterpret_cast<HANDLE>(m_handle), p + total, chunk, &written, nullptr);
+		checkWin32Result(b != 0, "WriteFile() failed");
+		total += written;
+	}
+}
+
+FILE *openFile(const wchar_t *path, const char *mode)
+{
+	// mode is ASCII
+	wchar_t wmode[8] = { 0 };
+	for (size_t i = 0; i < 7 && mode[i] != '\0'; i++) {
+		wmode[i] = mode[i];
+	}
+	FILE *fp = nullptr;
+	if (::_wfopen_s(&fp, path, wmode) != 0) {
+		return nullptr;
+	}
+	return fp;
+}
+
+int seekFile(FILE *fp, int64_t offset, int origin)
+{
+	return ::_fseeki64(fp, offset, origin);
+}
+
+bool getFileInfo(const wchar_t *path, FileInfo *info)
+{
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (!::GetFileAttributesEx(path, GetFileExInfoStandard, &attr)) {
+		return false;
+	}
+	info->isDirectory = (attr.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+	info->size = (static_cast<uint64_t>(attr.nFileSizeHigh) << 32) | attr.nFileSizeLow;
+	return true;
+}
+
+void listDirectory(const wchar_t *dir,
+	const std::function<void(const wchar_t *name, bool isDirectory)> &callback)
+{
+	WIN32_FIND_DATA fd;
+	HANDLE tmphFind = ::FindFirstFile((std::wstring(dir) + L"/*").c_str(), &fd);
+	checkWin32Result(tmphFind != INVALID_HANDLE_VALUE, "FindFirstFile() failed");
+	auto del = [](HANDLE h) { ::FindClose(h); };
+	std::unique_ptr<void, decltype(del)> hFind(tmphFind, del);
+	do {
+		if (::wcscmp(fd.cFileName, L".") == 0 || ::wcscmp(fd.cFileName, L"..") == 0) {
+			continue;
+		}
+		callback(fd.cFileName, (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0);
+	} while (::FindNextFile(hFind.get(), &fd));
+	checkWin32Result(::GetLastError() == ERROR_NO_MORE_FILES, "FindNextFile() failed");
+}
+
+const std::wstring &getExecutableDir()
+{
+	static const std::wstring dir = []() {
+		wchar_t buf[MAX_PATH];
+		DWORD ret = ::GetModuleFileName(nullptr, buf, MAX_PATH);
+		checkWin32Result(ret != 0, "GetModuleFileName() failed");
+		*(::wcsrchr(buf, L'\\') + 1) = L'\0';
+		return std::wstring(buf);
+	}();
+	return dir;
+}
+
+std::wstring createTempFile(const wchar_t *prefix)
+{
+	wchar_t tempPath[MAX_PATH];
+	DWORD dret = ::GetTempPath(MAX_PATH, tempPath);
+	checkWin32Result(dret != 0, "GetTempPath() failed");
+	wchar_t filePath[MAX_PATH];
+	UINT uret = ::GetTempFileName(tempPath, prefix, 0, filePath);
+	checkWin32Result(uret != 0, "GetTempFileName() failed");
+	return filePath;
+}
+
+const uint8_t *mapFile(const wchar_t *path, AccessHint hint, uint64_t *size)
+{
+	FileHandle file = FileHandle::openRead(path, hint);
+	*size = file.getSize();
+	if (*size == 0) {
+		// cannot map an empty file
+		return nullptr;
+	}
+	if (*size > std::numeric_limits<size_t>::max()) {
+		throwTrace<error::FrameworkError>("File is too large for address space");
+	}
+	// CreateFileMapping() returns nullptr on error
+	HANDLE tmphMap = ::CreateFileMapping(
+		reinterpret_cast<HANDLE>(file.m_handle), nullptr, PAGE_READONLY, 0, 0, nullptr);
+	checkWin32Result(tmphMap != nullptr, "CreateFileMapping() failed");
+	util::HandlePtr hMap(tmphMap);
+	const void *base = ::MapViewOfFile(hMap.get(), FILE_MAP_READ, 0, 0, 0);
+	checkWin32Result(base != nullptr, "MapViewOfFile() failed");
+	// the view keeps the file open
+	return static_cast<const uint8_t *>(base);
+}
+
+void unmapFile(const uint8_t *base, uint64_t size) noexcept
+{
+	if (base != nullptr) {
+		::UnmapViewOfFile(base);
+	}
+}
+
+bool prefetchMemory(const void *p, size_t size)
+{
+	static const auto prefetch =
+		getKernel32Proc<PrefetchVirtualMemoryFunc>("PrefetchVirtualMemory");
+	if (prefetch == nullptr) {
+		return false;
+	}
+	MemoryRangeEntry range;
+	range.VirtualAddress = const_cast<void *>(p);
+	range.NumberOfBytes = size;
+	return prefetch(::GetCurrentProcess(), 1, &range, 0) != 0;
+}
+
+bool evictFileCache(const wchar_t *path)
+{
+	HANDLE h = ::CreateFile(
+		path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING, nullptr);
+	if (h == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	::CloseHandle(h);
+	return true;
+}
+
+size_t getPageSize()
+{
+	SYSTEM_INFO info;
+	::GetSystemInfo(&info);
+	return info.dwPageSize;
+}
+
+void *allocatePages(size_t size)
+{
+	void *p = ::VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	checkWin32Result(p != nullptr, "VirtualAlloc() failed");
+	return p;
+}
+
+void freePages(void *p, size_t size) noexcept
+{
+	if (p != nullptr) {
+		::VirtualFree(p, 0, MEM_RELEASE);
+	}
+}
+
+Heap::Heap(size_t initSize, size_t maxSize) :
+	m_maxSize(maxSize)
+{
+	m_heap = ::HeapCreate(HEAP_NO_SERIALIZE, initSize, maxSize);
+	checkWin32Result(m_heap != nullptr, "HeapCreate() failed");
+}
+
+Heap::~Heap()
+{
+	::HeapDestroy(m_heap);
+}
+
+void *Heap::allocate(size_t size)
+{
+	return ::HeapAlloc(m_heap, 0, size);
+}
+
+void *Heap::reallocate(void *p, size_t oldSize, size_t size)
+{
+	return ::HeapReAlloc(m_heap, 0, p, size);
+}
+
+void Heap::free(void *p, size_t size) noexcept
+{
+	if (p != nullptr) {
+		::HeapFree(m_heap, 0, p);
+	}
+}
+
+void setThreadName(const wchar_t *name)
+{
+	static const auto setDesc =
+		getKernel32Proc<SetThreadDescriptionFunc>("SetThreadDescription");
+	if (setDesc != nullptr) {
+		setDesc(::GetCurrentThread(), name);
+	}
+}
+
+uint32_t getCurrentThreadId()
+{
+	return ::GetCurrentThreadId();
+}
+
+void yieldProcessor()
+{
+	YieldProcessor();
+}
+
+#else
+
+namespace {
+
+std::string toNative(const wchar_t *path)
+{
+	std::string str(wcToUtf8(path, nullptr, 0), '\0');
+	wcToUtf8(path, &str[0], str.size());
+	str.pop_back();
+	return str;
+}
+
+std::wstring fromNative(const char *path)
+{
+	std::wstring str(utf8ToWc(path, nullptr, 0), L'\0');
+	utf8ToWc(path, &str[0], str.size());
+	str.pop_back();
+	return str;
+}
+
+// XSI strerror_r() returns int, GNU returns char *
+inline const char *strerrorResult(int ret, const char *buf)
+{
+	return (ret == 0) ? buf : "Unknown error";
+}
+inline const char *strerrorResult(const char *ret, const char *)
+{
+	return ret;
+}
+
+const uint32_t Replacement = 0xfffd;
+
+// returns byte count
+size_t encodeUtf8(uint32_t c, char *out)
+{
+	if (c < 0x80) {
+		out[0] = static_cast<char>(c);
+		return 1;
+	}
+	if (c < 0x800) {
+		out[0] = static_cast<char>(0xc0 | (c >> 6));
+		out[1] = static_cast<char>(0x80 | (c & 0x3f));
+		return 2;
+	}
+	if (c < 0x10000) {
+		out[0] = static_cast<char>(0xe0 | (c >> 12));
+		out[1] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+		out[2] = static_cast<char>(0x80 | (c & 0x3f));
+		return 3;
+	}
+	out[0] = static_cast<char>(0xf0 | (c >> 18));
+	out[1] = static_cast<char>(0x80 | ((c >> 12) & 0x3f));
+	out[2] = static_cast<char>(0x80 | ((c >> 6) & 0x3f));
+	out[3] = static_cast<char>(0x80 | (c & 0x3f));
+	return 4;
+}
+
+// advances *p, returns Replacement on broken sequence
+uint32_t decodeUtf8(const uint8_t **p)
+{
+	const uint8_t *s = *p;
+	uint32_t c = *s++;
+	size_t extra;
+	uint32_t min;
+	if (c < 0x80) {
+		*p = s;
+		return c;
+	}
+	else if ((c & 0xe0) == 0xc0) {
+		extra = 1;
+		min = 0x80;
+		c &= 0x1f;
+	}
+	else if ((c & 0xf0) == 0xe0) {
+		extra = 2;
+		min = 0x800;
+		c &= 0x0f;
+	}
+	else if ((c & 0xf8) == 0xf0) {
+		extra = 3;
+		min = 0x10000;
+		c &= 0x07;
+	}
+	else {
+		*p = s;
+		return Replacement;
+	}
+	for (size_t i = 0; i < extra; i++) {
+		// stops at '\0' too
+		if ((*s & 0xc0) != 0x80) {
+			*p = s;
+			return Replacement;
+		}
+		c = (c << 6) | (*s++ & 0x3f);
+	}
+	*p = s;
+	if (c < min || c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+		return Replacement;
+	}
+	return c;
+}
+
+void writeUtf8(FILE *fp, const wchar_t *str)
+{
+	std::string mb = toNative(str);
+	::fputs(mb.c_str(), fp);
+}
+
+}	// namespace
+
+uint32_t getLastError()
+{
+	return static_cast<uint32_t>(errno);
+}
+
+std::string getErrorMessage(uint32_t code)
+{
+	char buf[256] = { 0 };
+	return strerrorResult(::strerror_r(static_cast<int>(code), buf, sizeof(buf)), buf);
+}
+
+void debugBreak()
+{
+	std::raise(SIGTRAP);
+}
+
+int64_t getCounter()
+{
+	timespec ts;
+	if (::clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		throwTrace<std::runtime_error>("clock_gettime() failed");
+	}
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+int64_t getCounterFrequency()
+{
+	return 1000000000;
+}
+
+size_t wcToUtf8(const wchar_t *in, char *out, size_t outCount)
+{
+	size_t len = 0;
+	char tmp[4];
+	for (const wchar_t *p = in; ; p++) {
+		uint32_t c = static_cast<uint32_t>(*p);
+		if (c > 0x10ffff || (c >= 0xd800 && c <= 0xdfff)) {
+			c = Replacement;
+		}
+		size_t n = encodeUtf8(c, tmp);
+		for (size_t i = 0; i < n; i++, len++) {
+			if (out != nullptr && len < outCount) {
+				out[len] = tmp[i];
+			}
+		}
+		if (c == 0) {
+			break;
+		}
+	}
+	return len;
+}
+
+size_t utf8ToWc(const char *in, wchar_t *out, size_t outCount)
+{
+	size_t len = 0;
+	const uint8_t *p = reinterpret_cast<const uint8_t *>(in);
+	while (true) {
+		uint32_t c = decodeUtf8(&p);
+		if (out != nullptr && len < outCount) {
+			out[len] = static_cast<wchar_t>(c);
+		}
+		len++;
+		if (c == 0) {
+			break;
+		}
+	}
+	return len;
+}
+
+void formatWide(wchar_t *buf, size_t count, const wchar_t *fmt, va_list args)
+{
+	if (count == 0) {
+		return;
+	}
+	// %s and %c without length modifier -> %ls and %lc
+	std::wstring conv;
+	for (const wchar_t *p = fmt; *p != L'\0'; p++) {
+		conv += *p;
+		if (*p != L'%') {
+			continue;
+		}
+		p++;
+		if (*p == L'%') {
+			conv += *p;
+			continue;
+		}
+		bool length = false;
+		while (*p != L'\0' && ::wcschr(L"-+ #0123456789.*", *p) != nullptr) {
+			conv += *p++;
+		}
+		while (*p != L'\0' && ::wcschr(L"hlLqjzt", *p) != nullptr) {
+			length = true;
+			conv += *p++;
+		}
+		if (*p == L'\0') {
+			break;
+		}
+		if (!length && (*p == L's' || *p == L'c')) {
+			conv += L'l';
+		}
+		conv += *p;
+	}
+	if (::vswprintf(buf, count, conv.c_str(), args) < 0) {
+		// truncated (contents are unspecified)
+		buf[count - 1] = L'\0';
+	}
+}
+
+void writeDebugOutput(const wchar_t *str)
+{
+	writeUtf8(stderr, str);
+}
+
+bool openConsole()
+{
+	return true;
+}
+
+void closeConsole()
+{
+	::fflush(stdout);
+}
+
+void writeConsole(const wchar_t *str)
+{
+	writeUtf8(stdout, str);
+}
+
+bool readConsole(std::wstring *line)
+{
+	std::string buf;
+	int c;
+	while ((c = std::fgetc(stdin)) != EOF && c != '\n') {
+		buf.push_back(static_cast<char>(c));
+	}
+	if (c == EOF && buf.empty()) {
+		return false;
+	}
+	if (!buf.empty() && buf.back() == '\r') {
+		buf.pop_back();
+	}
+	*line = fromNative(buf.c_str());
+	return true;
+}
+
+FileHandle FileHandle::openRead(const wchar_t *path, AccessHint hint)
+{
+	int fd = ::open(toNative(path).c_str(), O_RDONLY | O_CLOEXEC);
+	checkWin32Result(fd >= 0, "open() failed");
+	FileHandle file(fd);
+	int advice = (hint == AccessHint::Sequential) ? POSIX_FADV_SEQUENTIAL :
+		(hint == AccessHint::Random) ? POSIX_FADV_RANDOM : POSIX_FADV_NORMAL;
+	::posix_fadvise(fd, 0, 0, advice);
+	return file;
+}
+
+FileHandle FileHandle::createWrite(const wchar_t *path)
+{
+	int fd = ::open(toNative(path).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	checkWin32Result(fd >= 0, "open() failed");
+	return FileHandle(fd);
+}
+
+void FileHandle::close() noexcept
+{
+	if (m_handle != InvalidHandle) {
+		::close(static_cast<int>(m_handle));
+		m_handle = InvalidHandle;
+	}
+}
+
+uint64_t FileHandle::getSize() const
+{
+	struct stat st;
+	checkWin32Result(::fstat(static_cast<int>(m_handle), &st) == 0, "fstat() failed");
+	return static_cast<uint64_t>(st.st_size);
+}
+
+size_t FileHandle::read(void *buf, size_t size)
+{
+	uint8_t *p = static_cast<uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		ssize_t ret = ::read(static_cast<int>(m_handle), p + total, size - total);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		checkWin32Result(ret >= 0, "read() failed");
+		if (ret == 0) {
+			break;
+		}
+		total += static_cast<size_t>(ret);
+	}
+	return total;
+}
+
+size_t FileHandle::readAt(void *buf, size_t size, uint64_t offset)
+{
+	uint8_t *p = static_cast<uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		ssize_t ret = ::pread(static_cast<int>(m_handle), p + total, size - total,
+			static_cast<off_t>(offset + total));
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		checkWin32Result(ret >= 0, "pread() failed");
+		if (ret == 0) {
+			break;
+		}
+		total += static_cast<size_t>(ret);
+	}
+	return total;
+}
+
+void FileHandle::write(const void *buf, size_t size)
+{
+	const uint8_t *p = static_cast<const uint8_t *>(buf);
+	size_t total = 0;
+	while (total < size) {
+		ssize_t ret = ::write(static_cast<int>(m_handle), p + total, size - total);
+		if (ret < 0 && errno == EINTR) {
+			continue;
+		}
+		checkWin32Result(ret >= 0, "write() failed");
+		total += static_cast<size_t>(ret);
+	}
+}
+
+FILE *openFile(const wchar_t *path, const char *mode)
+{
+	return ::fopen(toNative(path).c_str(), mode);
+}
+
+int seekFile(FILE *fp, int64_t offset, int origin)
+{
+	return ::fseeko(fp, static_cast<off_t>(offset), origin);
+}
+
+bool getFileInfo(const wchar_t *path, FileInfo *info)
+{
+	struct stat st;
+	if (::stat(toNative(path).c_str(), &st) != 0) {
+		return false;
+	}
+	info->isDirectory = S_ISDIR(st.st_mode);
+	info->size = static_cast<uint64_t>(st.st_size);
+	return true;
+}
+
+void listDirectory(const wchar_t *dir,
+	const std::function<void(const wchar_t *name, bool isDirectory)> &callback)
+{
+	const std::string native = toNative(dir);
+	DIR *tmpDir = ::opendir(native.c_str());
+	checkWin32Result(tmpDir != nullptr, "opendir() failed");
+	auto del = [](DIR *d) { ::closedir(d); };
+	std::unique_ptr<DIR, decltype(del)> d(tmpDir, del);
+	while (const dirent *ent = ::readdir(d.get())) {
+		if (std::strcmp(ent->d_name, ".") == 0 || std::strcmp(ent->d_name, "..") == 0) {
+			continue;
+		}
+		bool isDir = (ent->d_type == DT_DIR);
+		if (ent->d_type == DT_UNKNOWN || ent->d_type == DT_LNK) {
+			// some file systems do not fill d_type
+			struct stat st;
+			std::string path = native + '/' + ent->d_name;
+			isDir = (::stat(path.c_str(), &st) == 0) && S_ISDIR(st.st_mode);
+		}
+		callback(fromNative(ent->d_name).c_str(), isDir);
+	}
+}
+
+const std::wstring &getExecutableDir()
+{
+	static const std::wstring dir = []() {
+		char buf[PATH_MAX];
+		ssize_t len = ::readlink("/proc/self/exe", buf, sizeof(buf) - 1);
+		if (len <= 0) {
+			return std::wstring(L"./");
+		}
+		buf[len] = '\0';
+		*(std::strrchr(buf, '/') + 1) = '\0';
+		return fromNative(buf);
+	}();
+	return dir;
+}
+
+std::wstring createTempFile(const wchar_t *prefix)
+{
+	const char *tmpDir = ::getenv("TMPDIR");
+	std::string path = (tmpDir != nullptr) ? tmpDir : "/tmp";
+	path += '/';
+	path += toNative(prefix);
+	path += "XXXXXX";
+	int fd = ::mkstemp(&path[0]);
+	checkWin32Result(fd >= 0, "mkstemp() failed");
+	::close(fd);
+	return fromNative(path.c_str());
+}
+
+const uint8_t *mapFile(const wchar_t *path, AccessHint hint, uint64_t *size)
+{
+	FileHandle file = FileHandle::openRead(path, hint);
+	*size = file.getSize();
+	if (*size == 0) {
+		return nullptr;
+	}
+	if (*size > std::numeric_limits<size_t>::max()) {
+		throwTrace<error::FrameworkError>("File is too large for address space");
+	}
+	void *base = ::mmap(nullptr, static_cast<size_t>(*size), PROT_READ, MAP_PRIVATE,
+		static_cast<int>(file.m_handle), 0);
+	checkWin32Result(base != MAP_FAILED, "mmap() failed");
+	int advice = (hint == AccessHint::Sequential) ? MADV_SEQUENTIAL :
+		(hint == AccessHint::Random) ? MADV_RANDOM : MADV_NORMAL;
+	::madvise(base, static_cast<size_t>(*size), advice);
+	// the mapping keeps the file open
+	return static_cast<const uint8_t *>(base);
+}
+
+void unmapFile(const uint8_t *base, uint64_t size) noexcept
+{
+	if (base != nullptr) {
+		::munmap(const_cast<uint8_t *>(base), static_cast<size_t>(size));
+	}
+}
+
+bool prefetchMemory(const void *p, size_t size)
+{
+	// madvise() needs a page aligned address
+	const uintptr_t page = getPageSize();
+	const uintptr_t start = reinterpret_cast<uintptr_t>(p) & ~(page - 1);
+	const uintptr_t end = reinterpret_cast<uintptr_t>(p) + size;
+	return ::madvise(reinterpret_cast<void *>(start), end - start, MADV_WILLNEED) == 0;
+}
+
+bool evictFileCache(const wchar_t *path)
+{
+	int fd = ::open(toNative(path).c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		return false;
+	}
+	// dirty pages are not dropped
+	::fdatasync(fd);
+	bool ok = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return ok;
+}
+
+size_t getPageSize()
+{
+	static const size_t size = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+	return size;
+}
+
+void *allocatePages(size_t size)
+{
+	void *p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	checkWin32Result(p != MAP_FAILED, "mmap() failed");
+	return p;
+}
+
+void freePages(void *p, size_t size) noexcept
+{
+	if (p != nullptr) {
+		::munmap(p, size);
+	}
+}
+
+// malloc() commits on demand, so initSize is not used
+Heap::Heap(size_t /*initSize*/, size_t maxSize) :
+	m_maxSize(maxSize)
+{}
+
+Heap::~Heap()
+{}
+
+void *Heap::allocate(size_t size)
+{
+	if (m_maxSize != 0 && size > m_maxSize - m_used) {
+		return nullptr;
+	}
+	void *p = std::malloc(size);
+	if (p != nullptr) {
+		m_used += size;
+	}
+	return p;
+}
+
+void *Heap::reallocate(void *p, size_t oldSize, size_t size)
+{
+	if (m_maxSize != 0 && size > oldSize && size - oldSize > m_maxSize - m_used) {
+		return nullptr;
+	}
+	void *np = std::realloc(p, size);
+	if (np != nullptr) {
+		m_used = m_used - oldSize + size;
+	}
+	return np;
+}
+
+void Heap::free(void *p, size_t size) noexcept
+{
+	if (p != nullptr) {
+		std::free(p);
+		m_used -= size;
+	}
+}
+
+void setThreadName(const wchar_t *name)
+{
+	// 16 bytes including '\0'
+	std::string native = toNative(name).substr(0, 15);
+#ifdef __APPLE__
+	::pthread_setname_np(native.c_str());
+#else
+	::pthread_setname_np(::pthread_self(), native.c_str());
+#endif
+}
+
+uint32_t getCurrentThreadId()
+{
+#ifdef __linux__
+	return static_cast<uint32_t>(::syscall(SYS_gettid));
+#else
+	return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(::pthread_self()));
+#endif
+}
+
+void yieldProcessor()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	_mm_pause();
+#endif
+}
+
+#endif
+
+FileHandle::FileHandle(FileHandle &&other) noexcept :
+	m_handle(other.m_handle)
+{
+	other.m_handle = InvalidHandle;
+}
+
+FileHandle &FileHandle::operator=(FileHandle &&other) noexcept
+{
+	if (this != &other) {
+		close();
+		m_handle = other.m_handle;
+		other.m_handle = InvalidHandle;
+	}
+	return *this;
+}
+
+FileHandle::~FileHandle()
+{
+	close();
+}
+
+}	// namespace platform
+}	// namespace yappy
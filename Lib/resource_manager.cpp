@@ -0,0 +1,905 @@
+﻿#include "stdafx.h"
+#include "include/resource_manager.h"
+#include "include/arena.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace yappy {
+namespace framework {
+
+///////////////////////////////////////////////////////////////////////////////
+// class ResourceManager impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region ResourceManager
+
+ResourceManager::ResourceManager(size_t resSetCount)
+{
+	m_tables.reserve(static_cast<size_t>(ResourceType::Count));
+	for (size_t i = 0; i < static_cast<size_t>(ResourceType::Count); i++) {
+		m_tables.emplace_back(resSetCount);
+	}
+}
+
+ResourceManager::~ResourceManager()
+{
+	cancelAllPrefetch();
+}
+
+ResourceCache &ResourceManager::getCache(ResourceType type)
+{
+	if (static_cast<size_t>(type) >= static_cast<size_t>(ResourceType::Count)) {
+		throwTrace<std::invalid_argument>("Invalid resource type");
+	}
+	return m_cache[static_cast<size_t>(type)];
+}
+
+ResourceTable &ResourceManager::getTable(ResourceType type)
+{
+	if (static_cast<size_t>(type) >= m_tables.size()) {
+		throwTrace<std::invalid_argument>("Invalid resource type");
+	}
+	return m_tables[static_cast<size_t>(type)];
+}
+
+ResourceHandle ResourceManager::addResource(ResourceType type,
+	size_t setId, const char *resId, std::unique_ptr<ResourceBase> &&res)
+{
+	if (m_sealed) {
+		throwTrace<std::logic_error>("Resource is not allowed to be added now");
+	}
+
+	ResourceTable &table = getTable(type);
+	IdString fixedResId;
+	util::createFixedString(&fixedResId, resId);
+	std::unordered_map<IdString, ResourceHandle> &map =
+		table.idMapVec.at(setId);
+	auto it = map.find(fixedResId);
+	if (it != map.end()) {
+		// the same registration again (e.g. manifest, then script)
+		if (!res->getKey().empty() && table.list[it->second]->getKey() == res->getKey()) {
+			return it->second;
+		}
+		throwTrace<std::invalid_argument>(std::string("Resource ID already exists: ") + resId);
+	}
+	// key = IdString(fixedResId)
+	// value = handle of Resource<T>(loader)
+	ResourceHandle handle = static_cast<ResourceHandle>(table.list.size());
+	table.list.emplace_back(std::move(res));
+	map.emplace(fixedResId, handle);
+	return handle;
+}
+
+void ResourceManager::reserve(ResourceType type, size_t count)
+{
+	ResourceTable &table = getTable(type);
+	table.list.reserve(table.list.size() + count);
+}
+
+namespace {
+
+void freezeIdMaps(ResourceTable *table, bool freeze)
+{
+	for (size_t setId = 0; setId < table->idMapVec.size(); setId++) {
+		util::FrozenIdMap &frozen = table->frozenVec[setId];
+		if (freeze) {
+			const auto &map = table->idMapVec[setId];
+			frozen.build(std::vector<std::pair<IdString, ResourceHandle>>(
+				map.begin(), map.end()));
+		}
+		else {
+			frozen.clear();
+		}
+	}
+}
+
+}	// namespace
+
+void ResourceManager::setSealed(bool seal)
+{
+	if (seal != m_sealed) {
+		for (auto &table : m_tables) {
+			freezeIdMaps(&table, seal);
+		}
+	}
+	m_sealed = seal;
+}
+
+bool ResourceManager::isSealed()
+{
+	return m_sealed;
+}
+
+void ResourceManager::setJobSystem(jobs::JobSystem *jobs)
+{
+	m_jobs = jobs;
+}
+
+void ResourceManager::setAsyncReader(file::AsyncReader *reader)
+{
+	m_reader = reader;
+}
+
+namespace {
+
+// shared by all stage jobs of a loadResourceSet() call
+struct LoadContext {
+	jobs::JobSystem *jobs;
+	jobs::JobCounter counter;
+	std::atomic_bool &cancel;
+	LoadProgress *progress;
+	// read stage (nullptr: read in jobs)
+	file::AsyncReader *reader;
+	// reads in flight on reader (not counted by counter)
+	std::mutex readLock;
+	std::condition_variable readDone;
+	uint32_t reads = 0;
+
+	LoadContext(jobs::JobSystem *jobs_, std::atomic_bool &cancel_,
+		LoadProgress *progress_, file::AsyncReader *reader_ = nullptr) :
+		jobs(jobs_), cancel(cancel_), progress(progress_),
+		reader((jobs_ != nullptr) ? reader_ : nullptr)
+	{}
+
+	// run on the job system, or on the calling thread if not available
+	void submit(jobs::JobFunc func)
+	{
+		if (jobs != nullptr) {
+			jobs->run(std::move(func), &counter);
+		}
+		else {
+			func();
+		}
+	}
+	// wait for jobs and reads, rethrow the first error
+	void wait()
+	{
+		std::exception_ptr error;
+		auto waitJobs = [this, &error]() {
+			try {
+				jobs->wait(counter);
+			}
+			catch (...) {
+				if (!error) {
+					error = std::current_exception();
+				}
+			}
+		};
+		while (true) {
+			waitJobs();
+			// a completed read submits its decode job before reads--
+			std::unique_lock<std::mutex> lock(readLock);
+			readDone.wait(lock, [this]() { return reads == 0 || !counter.isDone(); });
+			if (reads == 0 && counter.isDone()) {
+				break;
+			}
+		}
+		// nothing can submit jobs any more: take the error of the last ones
+		waitJobs();
+		if (error) {
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+// returns false if cancelled
+// the resource is released from loading state on cancel or exception
+template <class F>
+bool runStage(LoadContext *ctx, ResourceBase *res, F func)
+{
+	if (ctx->cancel.load()) {
+		res->abortLoad();
+		return false;
+	}
+	try {
+		func();
+	}
+	catch (...) {
+		res->abortLoad();
+		throw;
+	}
+	return true;
+}
+
+void uploadStage(LoadContext *ctx, ResourceBase *res,
+	std::shared_ptr<ResourceBase::FinishFunc> finish)
+{
+	// upload and endLoad()
+	if (!runStage(ctx, res, [&finish]() { (*finish)(); })) {
+		return;
+	}
+	if (ctx->progress != nullptr) {
+		ctx->progress->itemsDone.fetch_add(1);
+	}
+}
+
+void decodeStage(LoadContext *ctx, ResourceBase *res,
+	std::shared_ptr<file::FileView> bin)
+{
+	auto finish = std::make_shared<ResourceBase::FinishFunc>();
+	if (!runStage(ctx, res, [res, &bin, &finish]() {
+		*finish = res->prepare(std::move(*bin));
+	})) {
+		return;
+	}
+	bin.reset();
+	ctx->submit([ctx, res, finish]() {
+		uploadStage(ctx, res, finish);
+	});
+}
+
+// read on ctx->reader, then decode in a job
+void readAsync(LoadContext *ctx, ResourceBase *res)
+{
+	{
+		std::lock_guard<std::mutex> lock(ctx->readLock);
+		ctx->reads++;
+	}
+	ctx->reader->read(res->getFileName().c_str(),
+		[ctx, res](file::Bytes &&bin, std::exception_ptr error) {
+		// on the reader thread: must not block
+		auto view = std::make_shared<file::FileView>(std::move(bin));
+		ctx->submit([ctx, res, view, error]() {
+			if (!runStage(ctx, res, [&error]() {
+				if (error) {
+					std::rethrow_exception(error);
+				}
+			})) {
+				return;
+			}
+			if (ctx->progress != nullptr) {
+				ctx->progress->bytesRead.fetch_add(view->size());
+			}
+			decodeStage(ctx, res, view);
+		});
+		{
+			std::lock_guard<std::mutex> lock(ctx->readLock);
+			ctx->reads--;
+		}
+		ctx->readDone.notify_all();
+	});
+}
+
+void readStage(LoadContext *ctx, ResourceBase *res)
+{
+	// archive entries are read in this job (zero-copy view)
+	bool async = false;
+	if (!runStage(ctx, res, [ctx, res, &async]() {
+		async = ctx->reader != nullptr && !res->getFileName().empty() &&
+			file::isRealFile(res->getFileName().c_str());
+	})) {
+		return;
+	}
+	if (async) {
+		readAsync(ctx, res);
+		return;
+	}
+	auto bin = std::make_shared<file::FileView>();
+	if (!runStage(ctx, res, [res, &bin]() { *bin = res->read(); })) {
+		return;
+	}
+	if (ctx->progress != nullptr) {
+		ctx->progress->bytesRead.fetch_add(bin->size());
+	}
+	ctx->submit([ctx, res, bin]() {
+		decodeStage(ctx, res, bin);
+	});
+}
+
+void loadAll(ResourceTable *table, size_t setId, LoadContext *ctx)
+{
+	for (const auto &elem : table->idMapVec.at(setId)) {
+		if (ctx->cancel.load()) {
+			break;
+		}
+		ResourceBase *res = table->list[elem.second].get();
+		if (!res->beginLoad()) {
+			continue;
+		}
+		// same content already loaded by another resource
+		if (res->shareLoaded()) {
+			continue;
+		}
+		if (ctx->progress != nullptr) {
+			ctx->progress->itemsTotal.fetch_add(1);
+		}
+		ctx->submit([ctx, res]() {
+			readStage(ctx, res);
+		});
+	}
+}
+
+void unloadAll(ResourceTable *table, size_t setId)
+{
+	for (const auto &elem : table->idMapVec.at(setId)) {
+		table->list[elem.second]->unload();
+	}
+}
+
+}	// namespace
+
+namespace {
+
+// move loaded resources of fromSet to toSet by content key
+void moveShared(ResourceTable *table, size_t fromSet, size_t toSet,
+	SetSwitchStats *stats)
+{
+	std::unordered_map<std::wstring, ResourceBase *> loaded;
+	for (const auto &elem : table->idMapVec.at(fromSet)) {
+		ResourceBase *res = table->list[elem.second].get();
+		if (!res->getKey().empty() && res->isLoaded()) {
+			loaded.emplace(res->getKey(), res);
+		}
+	}
+	for (const auto &elem : table->idMapVec.at(toSet)) {
+		ResourceBase *res = table->list[elem.second].get();
+		if (res->getKey().empty() || res->isLoaded()) {
+			continue;
+		}
+		auto it = loaded.find(res->getKey());
+		if (it == loaded.end()) {
+			continue;
+		}
+		size_t size = it->second->getMemorySize();
+		if (res->adoptFrom(*it->second)) {
+			stats->itemsReused++;
+			stats->bytesReused += size;
+			loaded.erase(it);
+		}
+	}
+}
+
+void unloadCounted(ResourceTable *table, size_t setId, SetSwitchStats *stats)
+{
+	for (const auto &elem : table->idMapVec.at(setId)) {
+		ResourceBase *res = table->list[elem.second].get();
+		if (res->isLoaded()) {
+			stats->itemsUnloaded++;
+			stats->bytesUnloaded += res->getMemorySize();
+		}
+		res->unload();
+	}
+}
+
+// (loaded count, memory size)
+void countLoaded(const ResourceTable &table, size_t setId,
+	uint32_t *count, uint64_t *bytes)
+{
+	for (const auto &elem : table.idMapVec.at(setId)) {
+		const ResourceBase *res = table.list[elem.second].get();
+		if (res->isLoaded()) {
+			(*count)++;
+			*bytes += res->getMemorySize();
+		}
+	}
+}
+
+}	// namespace
+
+struct ResourceManager::PrefetchState {
+	size_t setId;
+	PrefetchParam param;
+	std::atomic_bool cancel{ false };
+	LoadContext ctx;
+	// resources not submitted yet: items[next, size)
+	std::vector<std::pair<ResourceType, ResourceHandle>> items;
+	size_t next = 0;
+	std::atomic<uint32_t> inFlight{ 0 };
+	std::atomic<uint64_t> bytesRead{ 0 };
+	// I/O budget (main thread only)
+	uint64_t bytesCounted = 0;
+	uint64_t debt = 0;
+
+	PrefetchState(size_t setId_, const PrefetchParam &param_,
+		jobs::JobSystem *jobs, LoadProgress *progress) :
+		setId(setId_), param(param_), ctx(jobs, cancel, progress)
+	{}
+};
+
+void ResourceManager::loadResourceSet(size_t setId, std::atomic_bool &cancel,
+	LoadProgress *progress)
+{
+	// promote prefetch: wait for resources in flight and load the rest here
+	for (auto &state : takePrefetch(setId)) {
+		waitPrefetch(state.get());
+	}
+	LoadContext ctx(m_jobs, cancel, progress, m_reader);
+	try {
+		for (auto &table : m_tables) {
+			loadAll(&table, setId, &ctx);
+		}
+	}
+	catch (...) {
+		// jobs and reads already submitted refer to ctx
+		if (m_jobs != nullptr) {
+			try {
+				ctx.wait();
+			}
+			catch (...) {
+				// report the first one
+			}
+		}
+		throw;
+	}
+	if (m_jobs != nullptr) {
+		ctx.wait();
+	}
+}
+
+void ResourceManager::unloadResourceSet(size_t setId)
+{
+	// resources in flight can not be unloaded
+	for (auto &state : takePrefetch(setId)) {
+		state->cancel.store(true);
+		waitPrefetch(state.get());
+	}
+	for (auto &table : m_tables) {
+		unloadAll(&table, setId);
+	}
+}
+
+SetSwitchStats ResourceManager::switchResourceSet(size_t fromSet, size_t toSet,
+	std::atomic_bool &cancel, LoadProgress *progress)
+{
+	SetSwitchStats stats;
+	if (fromSet == toSet) {
+		loadResourceSet(toSet, cancel, progress);
+		return stats;
+	}
+	// the old set is not needed any more
+	for (auto &state : takePrefetch(fromSet)) {
+		state->cancel.store(true);
+		waitPrefetch(state.get());
+	}
+	// resources in flight can not be moved
+	for (auto &state : takePrefetch(toSet)) {
+		waitPrefetch(state.get());
+	}
+
+	// 1. move common resources
+	for (auto &table : m_tables) {
+		moveShared(&table, fromSet, toSet, &stats);
+	}
+	// 2. unload the rest before loading (old and new do not coexist)
+	for (auto &table : m_tables) {
+		unloadCounted(&table, fromSet, &stats);
+	}
+	// 3. load the delta
+	auto count = [this, toSet](uint32_t *items, uint64_t *bytes) {
+		for (const auto &table : m_tables) {
+			countLoaded(table, toSet, items, bytes);
+		}
+	};
+	uint32_t itemsBefore = 0, itemsAfter = 0;
+	uint64_t bytesBefore = 0, bytesAfter = 0;
+	count(&itemsBefore, &bytesBefore);
+	LoadProgress localProgress;
+	LoadProgress *prog = (progress != nullptr) ? progress : &localProgress;
+	uint64_t readBefore = prog->bytesRead.load();
+	loadResourceSet(toSet, cancel, prog);
+	count(&itemsAfter, &bytesAfter);
+	stats.itemsLoaded = itemsAfter - itemsBefore;
+	stats.bytesLoaded = bytesAfter - bytesBefore;
+	stats.bytesRead = prog->bytesRead.load() - readBefore;
+
+	debug::writef(L"Switch resource set %zu -> %zu: reused %u (%llu bytes), "
+		L"unloaded %u (%llu bytes), loaded %u (%llu bytes, read %llu bytes)",
+		fromSet, toSet,
+		stats.itemsReused, static_cast<unsigned long long>(stats.bytesReused),
+		stats.itemsUnloaded, static_cast<unsigned long long>(stats.bytesUnloaded),
+		stats.itemsLoaded, static_cast<unsigned long long>(stats.bytesLoaded),
+		static_cast<unsigned long long>(stats.bytesRead));
+	return stats;
+}
+
+namespace {
+
+using PrefetchItem = std::pair<ResourceType, ResourceHandle>;
+
+void collectPrefetch(const ResourceTable &table, size_t setId, ResourceType type,
+	std::vector<PrefetchItem> *items)
+{
+	for (const auto &elem : table.idMapVec.at(setId)) {
+		if (!table.list[elem.second]->isLoaded()) {
+			items->emplace_back(type, elem.second);
+		}
+	}
+}
+
+// all stages in one job (low priority: one resource occupies one worker at most)
+void prefetchStages(LoadContext *ctx, ResourceBase *res, std::atomic<uint64_t> *bytesRead)
+{
+	file::FileView bin;
+	if (!runStage(ctx, res, [res, &bin]() { bin = res->read(); })) {
+		return;
+	}
+	bytesRead->fetch_add(bin.size());
+	if (ctx->progress != nullptr) {
+		ctx->progress->bytesRead.fetch_add(bin.size());
+	}
+	ResourceBase::FinishFunc finish;
+	if (!runStage(ctx, res, [res, &bin, &finish]() {
+		finish = res->prepare(std::move(bin));
+	})) {
+		return;
+	}
+	// upload and endLoad()
+	if (!runStage(ctx, res, [&finish]() { finish(); })) {
+		return;
+	}
+	if (ctx->progress != nullptr) {
+		ctx->progress->itemsDone.fetch_add(1);
+	}
+}
+
+// returns false if already loaded or being loaded (dedup)
+bool submitPrefetch(ResourceTable *table, ResourceHandle handle, LoadContext *ctx,
+	std::atomic<uint32_t> *inFlight, std::atomic<uint64_t> *bytesRead)
+{
+	ResourceBase *res = table->list.at(handle).get();
+	if (!res->tryBeginLoad()) {
+		return false;
+	}
+	if (res->shareLoaded()) {
+		return true;
+	}
+	if (ctx->progress != nullptr) {
+		ctx->progress->itemsTotal.fetch_add(1);
+	}
+	inFlight->fetch_add(1);
+	ctx->submit([ctx, res, inFlight, bytesRead]() {
+		try {
+			prefetchStages(ctx, res, bytesRead);
+		}
+		catch (...) {
+			inFlight->fetch_sub(1);
+			throw;
+		}
+		inFlight->fetch_sub(1);
+	});
+	return true;
+}
+
+}	// namespace
+
+void ResourceManager::prefetchResourceSet(size_t setId, const PrefetchParam &param,
+	LoadProgress *progress)
+{
+	if (m_jobs == nullptr) {
+		// nothing runs in background
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_prefetchLock);
+		for (const auto &state : m_prefetch) {
+			if (state->setId == setId && !state->cancel.load()) {
+				return;
+			}
+		}
+		auto state = std::make_unique<PrefetchState>(setId, param, m_jobs, progress);
+		state->param.maxInFlight = std::max(state->param.maxInFlight, 1u);
+		for (size_t i = 0; i < m_tables.size(); i++) {
+			collectPrefetch(m_tables[i], setId, static_cast<ResourceType>(i), &state->items);
+		}
+		m_prefetch.emplace_back(std::move(state));
+	}
+	// start now (e.g. before the first frame), the budget is paid per frame
+	pumpPrefetch(false);
+}
+
+void ResourceManager::cancelPrefetch(size_t setId)
+{
+	// removed by pumpPrefetch() when jobs in flight finish
+	std::lock_guard<std::mutex> lock(m_prefetchLock);
+	for (auto &state : m_prefetch) {
+		if (state->setId == setId) {
+			state->cancel.store(true);
+		}
+	}
+}
+
+void ResourceManager::cancelAllPrefetch()
+{
+	std::vector<std::unique_ptr<PrefetchState>> list;
+	{
+		std::lock_guard<std::mutex> lock(m_prefetchLock);
+		list.swap(m_prefetch);
+	}
+	for (auto &state : list) {
+		state->cancel.store(true);
+		waitPrefetch(state.get());
+	}
+}
+
+bool ResourceManager::isPrefetching(size_t setId) const
+{
+	std::lock_guard<std::mutex> lock(m_prefetchLock);
+	for (const auto &state : m_prefetch) {
+		if (state->setId == setId && !state->cancel.load()) {
+			return state->next < state->items.size() || !state->ctx.counter.isDone();
+		}
+	}
+	return false;
+}
+
+std::vector<std::unique_ptr<ResourceManager::PrefetchState>>
+	ResourceManager::takePrefetch(size_t setId)
+{
+	std::vector<std::unique_ptr<PrefetchState>> result;
+	std::lock_guard<std::mutex> lock(m_prefetchLock);
+	for (auto it = m_prefetch.begin(); it != m_prefetch.end();) {
+		if ((*it)->setId == setId) {
+			result.emplace_back(std::move(*it));
+			it = m_prefetch.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	return result;
+}
+
+void ResourceManager::waitPrefetch(PrefetchState *state)
+{
+	try {
+		m_jobs->wait(state->ctx.counter);
+	}
+	catch (const std::exception &ex) {
+		// the resource is not loaded and loadResourceSet() will retry
+		debug::writeLine(L"Prefetch failed");
+		debug::writeLine(ex.what());
+	}
+}
+
+void ResourceManager::pumpPrefetch(bool newFrame)
+{
+	std::lock_guard<std::mutex> lock(m_prefetchLock);
+	for (auto it = m_prefetch.begin(); it != m_prefetch.end();) {
+		PrefetchState &state = **it;
+		// I/O budget: pay bytes read since the last frame, bytesPerFrame per frame
+		uint64_t total = state.bytesRead.load();
+		state.debt += total - state.bytesCounted;
+		state.bytesCounted = total;
+		if (state.param.bytesPerFrame == 0) {
+			state.debt = 0;
+		}
+		if (newFrame) {
+			state.debt -= std::min(state.debt, state.param.bytesPerFrame);
+		}
+		// CPU budget: jobs in flight
+		while (!state.cancel.load() && state.next < state.items.size() &&
+			state.debt == 0 && state.inFlight.load() < state.param.maxInFlight) {
+			const PrefetchItem &item = state.items[state.next++];
+			submitPrefetch(&getTable(item.first), item.second,
+				&state.ctx, &state.inFlight, &state.bytesRead);
+		}
+		bool submitted = state.cancel.load() || state.next == state.items.size();
+		if (submitted && state.ctx.counter.isDone()) {
+			waitPrefetch(&state);
+			it = m_prefetch.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+}
+
+void ResourceManager::setCacheBudget(ResourceType type, size_t bytes)
+{
+	getCache(type).budget.store(bytes);
+}
+
+CacheStats ResourceManager::getCacheStats(ResourceType type) const
+{
+	const ResourceCache &cache = m_cache[static_cast<size_t>(type)];
+	CacheStats stats;
+	stats.budget = cache.budget.load();
+	stats.used = cache.used.load();
+	stats.hit = cache.hit.load();
+	stats.miss = cache.miss.load();
+	stats.evict = cache.evict.load();
+	stats.shared = cache.shared.load();
+	stats.saved = cache.saved.load();
+	return stats;
+}
+
+namespace {
+
+void evictLru(ResourceTable *table, ResourceCache *cache, uint64_t frame)
+{
+	const size_t budget = cache->budget.load();
+	if (budget == 0 || cache->used.load() <= budget) {
+		return;
+	}
+	// (last use, resource) of all sets
+	// frame arena: no heap allocation
+	using Entry = std::pair<uint64_t, ResourceBase *>;
+	arena::ArenaVector<Entry> list;
+	for (const auto &res : table->list) {
+		// keep ones used in this frame
+		if (res->isLoaded() && res->getLastUse() < frame) {
+			list.emplace_back(res->getLastUse(), res.get());
+		}
+	}
+	// least recently used first
+	std::sort(list.begin(), list.end(), [](const Entry &a, const Entry &b) {
+		return a.first < b.first;
+	});
+	for (const auto &entry : list) {
+		if (cache->used.load() <= budget) {
+			break;
+		}
+		// skip if someone holds shared_ptr
+		if (entry.second->tryEvict()) {
+			cache->evict.fetch_add(1);
+		}
+	}
+}
+
+}	// namespace
+
+void ResourceManager::beginFrame()
+{
+	m_frame++;
+	pumpPrefetch(true);
+	// views of the previous frame are no longer used
+	for (auto &cache : m_cache) {
+		cache.collect();
+	}
+	for (size_t i = 0; i < m_tables.size(); i++) {
+		evictLru(&m_tables[i], &m_cache[i], m_frame);
+	}
+}
+
+ResourceHandle ResourceManager::getHandle(ResourceType type,
+	size_t setId, const char *resId) const
+{
+	if (static_cast<size_t>(type) >= m_tables.size()) {
+		throwTrace<std::invalid_argument>("Invalid resource type");
+	}
+	const ResourceTable &table = m_tables[static_cast<size_t>(type)];
+	IdString fixedResId;
+	util::createFixedString(&fixedResId, resId);
+	const util::FrozenIdMap &frozen = table.frozenVec.at(setId);
+	if (frozen.size() != 0) {
+		ResourceHandle handle = frozen.find(fixedResId);
+		if (handle == util::FrozenIdMap::NotFound) {
+			throwTrace<std::invalid_argument>(std::string("Resource ID not found: ") + resId);
+		}
+		return handle;
+	}
+	auto &map = table.idMapVec.at(setId);
+	auto it = map.find(fixedResId);
+	if (it == map.end()) {
+		throwTrace<std::invalid_argument>(std::string("Resource ID not found: ") + resId);
+	}
+	return it->second;
+}
+
+ResourceBase *ResourceManager::getResourceBase(ResourceType type, ResourceHandle handle)
+{
+	ResourceTable &table = getTable(type);
+	if (handle >= table.list.size()) {
+		throwTrace<std::invalid_argument>("Invalid resource handle");
+	}
+	return table.list[handle].get();
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// Resource read benchmark
+///////////////////////////////////////////////////////////////////////////////
+#pragma region ResourceReadBench
+
+namespace {
+
+struct BenchResource {
+	uint32_t value;
+
+	size_t getMemorySize() const { return sizeof(*this); }
+};
+
+const uint32_t BenchResourceCount = 16;
+const uint32_t BenchBatch = 1024;
+
+struct BenchTiming {
+	double totalNs;
+	double maxBatchNs;
+};
+
+// run read(i) on all threads at the same time
+template <class F>
+BenchTiming runReaders(uint32_t threads, uint32_t iterations, F read)
+{
+	using Clock = std::chrono::steady_clock;
+
+	std::vector<BenchTiming> timing(threads);
+	std::atomic<uint32_t> ready{ 0 };
+	std::vector<std::thread> workers;
+	for (uint32_t t = 0; t < threads; t++) {
+		workers.emplace_back([t, threads, iterations, &timing, &ready, &read]() {
+			ready.fetch_add(1);
+			while (ready.load() < threads) {
+				std::this_thread::yield();
+			}
+			uint64_t sum = 0;
+			double maxBatchNs = 0.0;
+			auto start = Clock::now();
+			auto batchStart = start;
+			for (uint32_t i = 0; i < iterations; i++) {
+				sum += read((i + t) % BenchResourceCount);
+				if (i % BenchBatch == BenchBatch - 1) {
+					auto now = Clock::now();
+					maxBatchNs = std::max(maxBatchNs, static_cast<double>(
+						std::chrono::duration_cast<std::chrono::nanoseconds>(now - batchStart).count()));
+					batchStart = now;
+				}
+			}
+			double totalNs = static_cast<double>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+			// keep the loop
+			ASSERT(sum != static_cast<uint64_t>(-1));
+			timing[t] = BenchTiming{ totalNs, maxBatchNs };
+		});
+	}
+	for (auto &th : workers) {
+		th.join();
+	}
+	BenchTiming result = { 0.0, 0.0 };
+	for (const auto &tm : timing) {
+		result.totalNs = std::max(result.totalNs, tm.totalNs);
+		result.maxBatchNs = std::max(result.maxBatchNs, tm.maxBatchNs);
+	}
+	return result;
+}
+
+}	// namespace
+
+ResourceReadBenchResult benchmarkResourceRead(uint32_t threads, uint32_t iterations)
+{
+	using Res = Resource<const BenchResource>;
+
+	ResourceCache cache;
+	std::vector<std::unique_ptr<Res>> list;
+	for (uint32_t i = 0; i < BenchResourceCount; i++) {
+		Res::Loader loader;
+		loader.decode = [i](file::FileView &&) {
+			return [i]() {
+				return std::make_shared<const BenchResource>(BenchResource{ i });
+			};
+		};
+		list.emplace_back(std::make_unique<Res>(std::move(loader), &cache));
+		list.back()->load();
+	}
+
+	ResourceReadBenchResult result;
+	result.threads = threads;
+	result.iterations = iterations;
+
+	BenchTiming locked = runReaders(threads, iterations, [&list](uint32_t i) {
+		return list[i]->getPtr()->value;
+	});
+	result.lockedNs = locked.totalNs / iterations;
+	result.lockedMaxUs = locked.maxBatchNs / 1e3;
+
+	const uint64_t frame = 1;
+	BenchTiming view = runReaders(threads, iterations, [&list, frame](uint32_t i) {
+		return list[i]->getView(frame)->value;
+	});
+	result.viewNs = view.totalNs / iterations;
+	result.viewMaxUs = view.maxBatchNs / 1e3;
+
+	debug::writef(L"Resource read bench: threads=%u iterations=%u "
+		L"locked=%.1fns (max batch %.1fus) view=%.1fns (max batch %.1fus)",
+		threads, iterations, result.lockedNs, result.lockedMaxUs,
+		result.viewNs, result.viewMaxUs);
+	return result;
+}
+
+#pragma endregion
+
+}	// namespace framework
+}	// namespace yappy
@@ -1,797 +1,1565 @@
-﻿#include "stdafx.h"
-#include "include/script.h"
-#include "include/debug.h"
-
-namespace yappy {
-namespace lua {
-namespace export {
-
-namespace {
-
-template <class T>
-inline T *getPtrFromUpvalue(lua_State *L, int uvInd)
-{
-	int idx = lua_upvalueindex(uvInd);
-	ASSERT(lua_type(L, idx) == LUA_TLIGHTUSERDATA);
-	void *p = lua_touserdata(L, idx);
-	return static_cast<T *>(p);
-}
-
-template <class F>
-inline int exceptToLuaError(lua_State *L, F proc)
-{
-	try {
-		return proc();
-	}
-	catch (const std::exception &ex) {
-		// push string ex.what() and throw
-		// noreturn
-		return luaL_error(L, "%s", ex.what());
-	}
-}
-
-template <class T>
-using lim = std::numeric_limits<T>;
-
-static_assert(lim<lua_Integer>::min() <= lim<int>::min(),	"Lua type check");
-static_assert(lim<lua_Integer>::max() >= lim<int>::max(),	"Lua type check");
-static_assert(lim<lua_Number>::max() >= lim<float>::max(),	"Lua type check");
-
-inline int luaintToInt(lua_State *L, int arg,
-	lua_Integer val, int min, int max)
-{
-	luaL_argcheck(L, val >= min, arg, "number too small");
-	luaL_argcheck(L, val <= max, arg, "number too large");
-	return static_cast<int>(val);
-}
-
-inline int getInt(lua_State *L, int arg,
-	int min = std::numeric_limits<int>::min(),
-	int max = std::numeric_limits<int>::max())
-{
-	lua_Integer val = luaL_checkinteger(L, arg);
-	return luaintToInt(L, arg, val, min, max);
-}
-
-inline int getOptInt(lua_State *L, int arg, int def,
-	int min = std::numeric_limits<int>::min(),
-	int max = std::numeric_limits<int>::max())
-{
-	lua_Integer val = luaL_optinteger(L, arg, def);
-	return luaintToInt(L, arg, val, min, max);
-}
-
-inline float luanumToFloat(lua_State *L, int arg,
-	lua_Number val, float min, float max)
-{
-	luaL_argcheck(L, val >= min, arg, "number too small or NaN");
-	luaL_argcheck(L, val <= max, arg, "number too large or NaN");
-	return static_cast<float>(val);
-}
-
-inline double luanumToDouble(lua_State *L, int arg,
-	lua_Number val, double min, double max)
-{
-	luaL_argcheck(L, val >= min, arg, "number too small or NaN");
-	luaL_argcheck(L, val <= max, arg, "number too large or NaN");
-	return static_cast<double>(val);
-}
-
-inline float getFloat(lua_State *L, int arg,
-	float min = std::numeric_limits<float>::lowest(),
-	float max = std::numeric_limits<float>::max())
-{
-	lua_Number val = luaL_checknumber(L, arg);
-	return luanumToFloat(L, arg, val, min, max);
-}
-
-inline float getOptFloat(lua_State *L, int arg, float def,
-	float min = std::numeric_limits<float>::lowest(),
-	float max = std::numeric_limits<float>::max())
-{
-	lua_Number val = luaL_optnumber(L, arg, def);
-	return luanumToFloat(L, arg, val, min, max);
-}
-
-inline double getDouble(lua_State *L, int arg,
-	double min = std::numeric_limits<double>::lowest(),
-	double max = std::numeric_limits<double>::max())
-{
-	lua_Number val = luaL_checknumber(L, arg);
-	return luanumToDouble(L, arg, val, min, max);
-}
-
-inline double getOptDouble(lua_State *L, int arg, double def,
-	double min = std::numeric_limits<double>::lowest(),
-	double max = std::numeric_limits<double>::max())
-{
-	lua_Number val = luaL_optnumber(L, arg, def);
-	return luanumToDouble(L, arg, val, min, max);
-}
-
-}	// namespace
-
-///////////////////////////////////////////////////////////////////////////////
-// "trace" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief デバッグ出力する。
- * @details
- * 標準 print 関数は削除され、この関数で置き換えられます。
- * @code
- * function trace.write(...)
- * end
- * function print(...)
- * end
- * @endcode
- *
- * @param[in]	...	任意の型および数の出力する値
- * @return			なし
- *
- * @sa @ref yappy::debug
- */
-int trace::write(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		int argc = lua_gettop(L);
-		for (int i = 1; i <= argc; i++) {
-			const char *str = lua_tostring(L, i);
-			if (str != nullptr) {
-				debug::writeLine(str);
-			}
-			else if (lua_type(L, i) == LUA_TBOOLEAN) {
-				int b = lua_toboolean(L, i);
-				debug::writeLine(b ? "true" : "false");
-			}
-			else {
-				debug::writef("<%s>", luaL_typename(L, i));
-			}
-		}
-		return 0;
-	});
-}
-
-/**@brief メモリ上のバッファに高速なログ出力を行う。
- * @details
- * @code
- * function trace.perf(...)
- * end
- * @endcode
- *
- * @param[in]	...	任意の型および数の出力する値
- * @return			なし
- *
- * @sa @ref yappy::trace
- */
-int trace::perf(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		int argc = lua_gettop(L);
-		for (int i = 1; i <= argc; i++) {
-			const char *str = ::lua_tostring(L, i);
-			if (str != nullptr) {
-				yappy::trace::write(str);
-			}
-			else {
-				debug::writef("<%s>", luaL_typename(L, i));
-			}
-		}
-		return 0;
-	});
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// "sys" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief 別の Lua ソースファイルを実行する。
- * @details
- * @code
- * function sys.include(...)
- * end
- * @endcode
- * Lua 標準関数 dofile() とおおよそ同じです。
- * (ロード系の標準関数は全て削除されています。)
- * ファイルのロードはライブラリのローダを呼び出して行うようになっています。
- * デバッグ情報のロードも行うようになっています。
- *
- * @param[in]	...	ファイル名
- * @return			なし
- *
- * @sa @ref yappy::file
- */
-int sys::include(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *lua = getPtrFromUpvalue<Lua>(L, 1);
-
-		int argc = lua_gettop(L);
-		for (int i = 1; i <= argc; i++) {
-			const char *fileName = ::lua_tostring(L, i);
-			luaL_argcheck(L, fileName != nullptr, i, "string needed");
-
-			lua->loadFile(util::utf82wc(fileName).get(), false, false);
-		}
-		return 0;
-	});
-}
-
-/**@brief ファイルを読む。
- * @details
- * @code
- * function sys.readFile(str fileName)
- * 	return ...;
- * end
- * @endcode
- * テキストファイルを読みます。
- * ファイルが存在しない場合、何も返しません(0個の値を返します)。
- * ファイル内に1行も存在しなかった場合も同様です。
- * ファイルが存在しない以外の理由で失敗した場合、エラーを発生させます。
- * 1行あたり読み取るのは1023文字までです。超過した分は捨てられます。
- * @code
- * -- 最初の3行をそれぞれ a, b, c に代入する
- * -- 足りない部分には nil が代入される
- * -- 3行あったかどうかは c が nil かを見ればよい
- * local a, b, c = sys.readFile("savedata.txt");
- * -- リストに変換する (x[1]から始まる)
- * local x = { sys.readFile("savedata.txt") };
- * -- 長さ(行数)を得る
- * local len = #x;
- * -- 全て出力する
- * for i = 1, #x do
- *	trace.write(x[i]);
- * end
- * @endcode
- *
- * @param[in]	fileName	ファイル名
- * @return				各行の内容
- */
-int sys::readFile(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		const char *fileName = luaL_checkstring(L, 1);
-
-		FILE *tmpfp = nullptr;
-		errno_t err = ::fopen_s(&tmpfp, fileName, "r");
-		if (err == ENOENT) {
-			// return;
-			return 0;
-		}
-		else if (err != 0) {
-			luaL_error(L, "File open error: %s, %d", fileName, err);
-		}
-
-		// return ...;
-		int retcnt = 0;
-
-		util::FilePtr fp(tmpfp);
-		char buf[1024];
-		while (std::fgets(buf, sizeof(buf), fp.get()) != nullptr) {
-			// find new line
-			char *pnl = std::strchr(buf, '\n');
-			if (pnl != nullptr) {
-				// OK, delete '\n'
-				*pnl = '\0';
-			}
-			else {
-				// line buffer over or EOF without new line
-				// discard until NL is found or reach EOF
-				char disc[1024];
-				do {
-					if (std::fgets(disc, sizeof(disc), fp.get()) == nullptr) {
-						break;
-					}
-				} while (std::strchr(disc, '\n') == nullptr);
-			}
-			lua_pushstring(L, buf);
-			retcnt++;
-		}
-		return retcnt;
-	});
-}
-
-/**@brief ファイルを書く。
- * @details
- * @code
- * function sys.writeFile(str fileName, ...)
- * end
- * @endcode
- * テキストファイルを書き込みます。
- * ファイルのオープンや書き込みに失敗した場合、エラーを発生させます。
- * @code
- * -- 数値は文字列に自動で変換される
- * sys.writeFile("savedata.txt", "NoName", 1, 255);
- * local name, stage, hp = sys.readFile("savedata.txt");
- * -- リストを可変個の値に変換するには table.unpack() を使う
- * local list = { "NoName", 1, 255 };
- * sys.writeFile("savedata.txt", table.unpack(list));
- * @endcode
- *
- * @warning 文字列に含まれる改行をチェックしません。
- * @ref readFile() との整合性が崩れるので注意してください。
- *
- * @param[in]	fileName	ファイル名
- * @param[in]	...			各行の内容
- * @return					なし
- */
-int sys::writeFile(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		const char *fileName = luaL_checkstring(L, 1);
-
-		FILE *tmpfp = nullptr;
-		errno_t err = ::fopen_s(&tmpfp, fileName, "w");
-		if (err != 0) {
-			luaL_error(L, "File open error: %s, %d", fileName, err);
-		}
-
-		util::FilePtr fp(tmpfp);
-		int argc = lua_gettop(L);
-		for (int i = 2; i <= argc; i++) {
-			// if lua error, destruct fp and throw
-			const char *line = luaL_checkstring(L, i);
-			std::fputs(line, fp.get());
-			std::fputc('\n', fp.get());
-		}
-		return 0;
-	});
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// "rand" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief 乱数シード用の値を生成する。
- * @details
- * @code
- * function rand.generateSeed()
- * end
- * @endcode
- *
- * @return	シード用の整数乱数
- *
- * @sa @ref framework::random::generateRandomSeed()
- */
-int rand::generateSeed(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		unsigned int seed = framework::random::generateRandomSeed();
-		lua_pushinteger(L, seed);
-		return 1;
-	});
-}
-
-/**@brief 乱数のシード値を設定する。
- * @details
- * @code
- * function rand.setSeed(int seed)
- * end
- * @endcode
- * シード値を設定しないと毎回同じ乱数が出てきてしまいます。
- * 初めに @ref generateSeed() で生成した乱数値をシードに設定してください。
- * 逆に同じシードを設定すると同じ乱数列を再現できます。
- *
- * @param[in]	seed	設定するシード値
- * @return				なし
- *
- * @sa @ref framework::random::setSeed()
- */
-int rand::setSeed(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto seed = static_cast<unsigned int>(luaL_checkinteger(L, 1));
-		framework::random::setSeed(seed);
-		return 0;
-	});
-}
-
-/**@brief 次の整数乱数を生成する。
- * @details
- * @code
- * function rand.nextInt(int a = 0, int b = 0x7fffffff)
- * end
- * @endcode
- *
- * @param[in]	a	最小値(含む)
- * @param[in]	b	最大値(含む)
- * @return		[a, b] のランダムな値
- *
- * @sa @ref framework::random::nextInt()
- */
-int rand::nextInt(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		int a = getOptInt(L, 1, 0);
-		int b = getOptInt(L, 2, std::numeric_limits<int>::max());
-		luaL_argcheck(L, a <= b, 1, "Must be a <= b");
-
-		int rnum = framework::random::nextInt(a, b);
-
-		lua_pushinteger(L, rnum);
-		return 1;
-	});
-}
-
-/**@brief 次の浮動小数点乱数を生成する。
- * @details
- * @code
- * function rand.nextDouble(double a = 0.0, double b = 1.0)
- * end
- * @endcode
- *
- * @param[in]	a	最小値(含む)
- * @param[in]	b	最大値(含まない)
- * @return		[a, b) のランダムな値
- *
- * @sa @ref framework::random::nextInt()
- */
-int rand::nextDouble(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		double a = getOptDouble(L, 1, 0.0);
-		double b = getOptDouble(L, 2, 1.0);
-		luaL_argcheck(L, a <= b, 1, "Must be a <= b");
-
-		double rnum = framework::random::nextDouble(a, b);
-
-		lua_pushnumber(L, rnum);
-		return 1;
-	});
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// "resource" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief テクスチャリソースを登録する。
- * @details
- * @code
- * function resource.addTexture(int setId, str resId, str path)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	path	ファイルパス
- * @return				なし
- */
-int resource::addTexture(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		const char *path = luaL_checkstring(L, 3);
-
-		app->addTextureResource(setId, resId, util::utf82wc(path).get());
-		return 0;
-	});
-}
-
-/**@brief フォントリソースを登録する。
- * @details
- * @code
- * function resource.addFont(int setId, str resId, str path)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	path	ファイルパス
- * @return				なし
- */
-int resource::addFont(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		const char *fontName = luaL_checkstring(L, 3);
-		const char *startCharStr = luaL_checkstring(L, 4);
-		luaL_argcheck(L, *startCharStr != '\0', 4, "empty string is NG");
-		const char *endCharStr = luaL_checkstring(L, 4);
-		luaL_argcheck(L, *endCharStr != '\0', 5, "empty string is NG");
-		int w = getInt(L, 7, 0);
-		int h = getInt(L, 8, 0);
-
-		wchar_t startChar = util::utf82wc(startCharStr)[0];
-		wchar_t endChar = util::utf82wc(endCharStr)[0];
-
-		app->addFontResource(setId, resId, util::utf82wc(fontName).get(),
-			startChar, endChar, w, h);
-		return 0;
-	});
-}
-
-/**@brief 効果音リソースを登録する。
- * @details
- * @code
- * function resource.addSe(int setId, str resId, str path)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	path	ファイルパス
- * @return				なし
- */
-int resource::addSe(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		const char *path = luaL_checkstring(L, 3);
-
-		app->addSeResource(setId, resId, util::utf82wc(path).get());
-		return 0;
-	});
-}
-
-/**@brief BGMリソースを登録する。
- * @details
- * @code
- * function resource.addBgm(int setId, str resId, str path)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	path	ファイルパス
- * @return				なし
- */
-int resource::addBgm(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		const char *path = luaL_checkstring(L, 3);
-
-		app->addBgmResource(setId, resId, util::utf82wc(path).get());
-		return 0;
-	});
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// "graph" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief テクスチャのサイズを得る。
- * @details
- * @code
- * function graph.getParam()
- * 	return int w, int h, int refreshRate, bool vsync;
- * end
- * @endcode
- *
- * @retval	1	ディスプレイサイズ横
- * @retval	2	ディスプレイサイズ縦
- * @retval	3	リフレッシュレート(Hz)
- * @retval	4	vsync 待ちが有効なら true
- */
-int graph::getParam(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-
-		graphics::GraphicsParam param;
-		app->getGraphicsParam(&param);
-
-		lua_pushinteger(L, param.w);
-		lua_pushinteger(L, param.h);
-		lua_pushinteger(L, param.refreshRate);
-		lua_pushboolean(L, param.vsync);
-		return 4;
-	});
-}
-
-/**@brief テクスチャのサイズを得る。
- * @details
- * @code
- * function graph.getTextureSize(int setId, str resId)
- * 	return w, h;
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @retval		1		横の長さ
- * @retval		2		縦の長さ
- */
-int graph::getTextureSize(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-
-		const auto &pTex = app->getTexture(setId, resId);
-
-		lua_pushinteger(L, pTex->w);
-		lua_pushinteger(L, pTex->h);
-		return 2;
-	});
-}
-
-/**@brief テクスチャを描画する。
- * @details
- * @code
- * function graph.drawTexture(int setId, str resId,
- * 	int dx, int dy, bool lrInv = false, bool udInv = false,
- * 	int sx = 0, int sy = 0, int sw = -1, int sh = -1,
- * 	int cx = 0, int cy = 0, float angle = 0.0f,
- * 	float scaleX = 1.0f, float scaleY = 1.0f, float alpha = 1.0f)
- * end
- * @endcode
- * スクリーン座標 (dx, dy) に (cx, cy) が一致するように描画されます。
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	dx		描画先中心座標X
- * @param[in]	dy		描画先中心座標Y
- * @param[in]	lrInv	左右反転フラグ
- * @param[in]	udInv	上下反転フラグ
- * @param[in]	sx		テクスチャから切り出す際の左上座標X
- * @param[in]	sy		テクスチャから切り出す際の左上座標Y
- * @param[in]	sw		切り出しサイズX(-1でテクスチャサイズ)
- * @param[in]	sh		切り出しサイズY(-1でテクスチャサイズ)
- * @param[in]	cx		(sx, sy)基準の描画元中心座標X
- * @param[in]	cy		(sx, sy)基準の描画元中心座標Y
- * @param[in]	angle	回転角(rad)
- * @param[in]	scaleX	拡大率X
- * @param[in]	scaleY	拡大率Y
- * @param[in]	alpha	透明度(0.0 - 1.0)
- * @return				なし
- *
- * @sa @ref yappy::graphics::DGraphics::drawTexture()
- */
-int graph::drawTexture(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		int dx = getInt(L, 3);
-		int dy = getInt(L, 4);
-
-		bool lrInv = lua_toboolean(L, 5) != 0;
-		bool udInv = lua_toboolean(L, 6) != 0;
-		int sx = getOptInt(L, 7, 0);
-		int sy = getOptInt(L, 8, 0);
-		int sw = getOptInt(L, 9, -1);
-		int sh = getOptInt(L, 10, -1);
-		int cx = getOptInt(L, 11, 0);
-		int cy = getOptInt(L, 12, 0);
-		float angle = getOptFloat(L, 13, 0.0f);
-		float scaleX = getOptFloat(L, 14, 1.0f);
-		float scaleY = getOptFloat(L, 15, 1.0f);
-		float alpha = getOptFloat(L, 16, 1.0f);
-
-		const auto &pTex = app->getTexture(setId, resId);
-		app->graph().drawTexture(pTex, dx, dy, lrInv, udInv, sx, sy, sw, sh, cx, cy,
-			angle, scaleX, scaleY, alpha);
-		return 0;
-	});
-}
-
-/**@brief 文字列を描画する。
- * @details
- * @code
- * function graph.drawString(int setId, str resId, str str, int dx, int dy,
- * 	int color = 0x000000, int ajustX = 0, 
- * 	float scaleX = 1.0f, float scaleY = 1.0f, float alpha = 1.0f)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @param[in]	str		描画する文字列
- * @param[in]	dx		描画先座標X
- * @param[in]	dy		描画先座標Y
- * @param[in]	color	文字色 (0xRRGGBB)
- * @param[in]	ajustX	文字間隔調整用X移動量
- * @param[in]	scaleX	拡大率X
- * @param[in]	scaleY	拡大率Y
- * @param[in]	alpha	透明度(0.0 - 1.0)
- * @return				なし
- *
- * @sa @ref yappy::graphics::DGraphics::drawString()
- */
-int graph::drawString(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-		const char *str = luaL_checkstring(L, 3);
-		int dx = getInt(L, 4);
-		int dy = getInt(L, 5);
-
-		int color = getOptInt(L, 6, 0x000000);
-		int ajustX = getOptInt(L, 7, 0);
-		float scaleX = getOptFloat(L, 8, 1.0f);
-		float scaleY = getOptFloat(L, 9, 1.0f);
-		float alpha = getOptFloat(L, 10, 1.0f);
-
-		const auto &pFont = app->getFont(setId, resId);
-		app->graph().drawString(pFont, util::utf82wc(str).get(), dx, dy,
-			color, ajustX, scaleX, scaleY, alpha);
-		return 0;
-	});
-}
-
-///////////////////////////////////////////////////////////////////////////////
-// "sound" table
-///////////////////////////////////////////////////////////////////////////////
-
-/**@brief 効果音再生を開始する。
- * @details
- * @code
- * function sound.playSe(int setId, str resId)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @return				なし
- */
-int sound::playSe(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-
-		const auto &pSoundEffect = app->getSoundEffect(setId, resId);
-		app->sound().playSoundEffect(pSoundEffect);
-		return 0;
-	});
-}
-
-/**@brief BGM 再生を開始する。
- * @details
- * @code
- * function sound.playBgm(int setId, str resId)
- * end
- * @endcode
- *
- * @param[in]	setId	リソースセットID(整数値)
- * @param[in]	resId	リソースID(文字列)
- * @return				なし
- */
-int sound::playBgm(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-		int setId = getInt(L, 1, 0);
-		const char *resId = luaL_checkstring(L, 2);
-
-		auto &pBgm = app->getBgm(setId, resId);
-		app->sound().playBgm(pBgm);
-		return 0;
-	});
-}
-
-/**@brief BGM 再生を停止する。
- * @details
- * @code
- * function sound.stopBgm()
- * end
- * @endcode
- *
- * @return				なし
- */
-int sound::stopBgm(lua_State *L)
-{
-	return exceptToLuaError(L, [L]() {
-		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
-
-		app->sound().stopBgm();
-		return 0;
-	});
-}
-
-}	// namespace export
-}	// namespace lua
-}	// namespace yappy
+﻿#include "stdafx.h"
+#include "include/script.h"
+#include "include/script_export.h"
+#include "include/framework.h"
+#include "include/debug.h"
+#include "include/arena.h"
+#include "include/lz.h"
+#include "include/crc.h"
+
+namespace yappy {
+namespace lua {
+namespace export {
+
+namespace {
+
+template <class T>
+inline T *getPtrFromUpvalue(lua_State *L, int uvInd)
+{
+	int idx = lua_upvalueindex(uvInd);
+	ASSERT(lua_type(L, idx) == LUA_TLIGHTUSERDATA);
+	void *p = lua_touserdata(L, idx);
+	return static_cast<T *>(p);
+}
+
+template <class F>
+inline int exceptToLuaError(lua_State *L, F proc)
+{
+	try {
+		return proc();
+	}
+	catch (const std::exception &ex) {
+		// push string ex.what() and throw
+		// noreturn
+		return luaL_error(L, "%s", ex.what());
+	}
+}
+
+template <class T>
+using lim = std::numeric_limits<T>;
+
+static_assert(lim<lua_Integer>::min() <= lim<int>::min(),	"Lua type check");
+static_assert(lim<lua_Integer>::max() >= lim<int>::max(),	"Lua type check");
+static_assert(lim<lua_Number>::max() >= lim<float>::max(),	"Lua type check");
+
+inline int luaintToInt(lua_State *L, int arg,
+	lua_Integer val, int min, int max)
+{
+	luaL_argcheck(L, val >= min, arg, "number too small");
+	luaL_argcheck(L, val <= max, arg, "number too large");
+	return static_cast<int>(val);
+}
+
+inline int getInt(lua_State *L, int arg,
+	int min = std::numeric_limits<int>::min(),
+	int max = std::numeric_limits<int>::max())
+{
+	lua_Integer val = luaL_checkinteger(L, arg);
+	return luaintToInt(L, arg, val, min, max);
+}
+
+inline int getOptInt(lua_State *L, int arg, int def,
+	int min = std::numeric_limits<int>::min(),
+	int max = std::numeric_limits<int>::max())
+{
+	lua_Integer val = luaL_optinteger(L, arg, def);
+	return luaintToInt(L, arg, val, min, max);
+}
+
+inline float luanumToFloat(lua_State *L, int arg,
+	lua_Number val, float min, float max)
+{
+	luaL_argcheck(L, val >= min, arg, "number too small or NaN");
+	luaL_argcheck(L, val <= max, arg, "number too large or NaN");
+	return static_cast<float>(val);
+}
+
+inline double luanumToDouble(lua_State *L, int arg,
+	lua_Number val, double min, double max)
+{
+	luaL_argcheck(L, val >= min, arg, "number too small or NaN");
+	luaL_argcheck(L, val <= max, arg, "number too large or NaN");
+	return static_cast<double>(val);
+}
+
+inline float getFloat(lua_State *L, int arg,
+	float min = std::numeric_limits<float>::lowest(),
+	float max = std::numeric_limits<float>::max())
+{
+	lua_Number val = luaL_checknumber(L, arg);
+	return luanumToFloat(L, arg, val, min, max);
+}
+
+inline float getOptFloat(lua_State *L, int arg, float def,
+	float min = std::numeric_limits<float>::lowest(),
+	float max = std::numeric_limits<float>::max())
+{
+	lua_Number val = luaL_optnumber(L, arg, def);
+	return luanumToFloat(L, arg, val, min, max);
+}
+
+inline double getDouble(lua_State *L, int arg,
+	double min = std::numeric_limits<double>::lowest(),
+	double max = std::numeric_limits<double>::max())
+{
+	lua_Number val = luaL_checknumber(L, arg);
+	return luanumToDouble(L, arg, val, min, max);
+}
+
+inline double getOptDouble(lua_State *L, int arg, double def,
+	double min = std::numeric_limits<double>::lowest(),
+	double max = std::numeric_limits<double>::max())
+{
+	lua_Number val = luaL_optnumber(L, arg, def);
+	return luanumToDouble(L, arg, val, min, max);
+}
+
+// framework::ResourceType order
+const char *const ResourceTypeNames[] = {
+	"texture", "font", "se", "bgm", nullptr
+};
+
+// file::AsyncReader::Backend order
+const char *const AsyncBackendNames[] = {
+	"auto", "iocp", "pool", nullptr
+};
+
+// resource argument: (int handle) or (int setId, str resId)
+// name form if arg + 1 + strArgs is a string
+// (strArgs: count of string arguments just after the resource argument)
+// returns the index of the next argument
+int getResourceArg(lua_State *L, int arg, framework::Application *app,
+	framework::ResourceType type, framework::ResourceHandle *handle,
+	int strArgs = 0)
+{
+	if (lua_type(L, arg + 1 + strArgs) == LUA_TSTRING) {
+		int setId = getInt(L, arg, 0);
+		const char *resId = luaL_checkstring(L, arg + 1);
+		*handle = app->getResourceHandle(type, setId, resId);
+		return arg + 2;
+	}
+	*handle = getInt(L, arg, 0);
+	return arg + 1;
+}
+
+}	// namespace
+
+///////////////////////////////////////////////////////////////////////////////
+// "trace" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief デバッグ出力する。
+ * @details
+ * 標準 print 関数は削除され、この関数で置き換えられます。
+ * @code
+ * function trace.write(...)
+ * end
+ * function print(...)
+ * end
+ * @endcode
+ *
+ * @param[in]	...	任意の型および数の出力する値
+ * @return			なし
+ *
+ * @sa @ref yappy::debug
+ */
+int trace::write(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int argc = lua_gettop(L);
+		for (int i = 1; i <= argc; i++) {
+			const char *str = lua_tostring(L, i);
+			if (str != nullptr) {
+				debug::writeLine(str);
+			}
+			else if (lua_type(L, i) == LUA_TBOOLEAN) {
+				int b = lua_toboolean(L, i);
+				debug::writeLine(b ? "true" : "false");
+			}
+			else {
+				debug::writef("<%s>", luaL_typename(L, i));
+			}
+		}
+		return 0;
+	});
+}
+
+/**@brief メモリ上のバッファに高速なログ出力を行う。
+ * @details
+ * @code
+ * function trace.perf(...)
+ * end
+ * @endcode
+ *
+ * @param[in]	...	任意の型および数の出力する値
+ * @return			なし
+ *
+ * @sa @ref yappy::trace
+ */
+int trace::perf(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int argc = lua_gettop(L);
+		for (int i = 1; i <= argc; i++) {
+			const char *str = ::lua_tostring(L, i);
+			if (str != nullptr) {
+				yappy::trace::write(str);
+			}
+			else {
+				debug::writef("<%s>", luaL_typename(L, i));
+			}
+		}
+		return 0;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "sys" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief 別の Lua ソースファイルを実行する。
+ * @details
+ * @code
+ * function sys.include(...)
+ * end
+ * @endcode
+ * Lua 標準関数 dofile() とおおよそ同じです。
+ * (ロード系の標準関数は全て削除されています。)
+ * ファイルのロードはライブラリのローダを呼び出して行うようになっています。
+ * デバッグ情報のロードも行うようになっています。
+ *
+ * @param[in]	...	ファイル名
+ * @return			なし
+ *
+ * @sa @ref yappy::file
+ */
+int sys::include(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *lua = getPtrFromUpvalue<Lua>(L, 1);
+
+		int argc = lua_gettop(L);
+		for (int i = 1; i <= argc; i++) {
+			const char *fileName = ::lua_tostring(L, i);
+			luaL_argcheck(L, fileName != nullptr, i, "string needed");
+
+			lua->loadFile(arena::utf82wc(fileName), false, false);
+		}
+		return 0;
+	});
+}
+
+/**@brief ファイルを読む。
+ * @details
+ * @code
+ * function sys.readFile(str fileName)
+ * 	return ...;
+ * end
+ * @endcode
+ * テキストファイルを読みます。
+ * ファイルが存在しない場合、何も返しません(0個の値を返します)。
+ * ファイル内に1行も存在しなかった場合も同様です。
+ * ファイルが存在しない以外の理由で失敗した場合、エラーを発生させます。
+ * 1行あたり読み取るのは1023文字までです。超過した分は捨てられます。
+ * @code
+ * -- 最初の3行をそれぞれ a, b, c に代入する
+ * -- 足りない部分には nil が代入される
+ * -- 3行あったかどうかは c が nil かを見ればよい
+ * local a, b, c = sys.readFile("savedata.txt");
+ * -- リストに変換する (x[1]から始まる)
+ * local x = { sys.readFile("savedata.txt") };
+ * -- 長さ(行数)を得る
+ * local len = #x;
+ * -- 全て出力する
+ * for i = 1, #x do
+ *	trace.write(x[i]);
+ * end
+ * @endcode
+ *
+ * @param[in]	fileName	ファイル名
+ * @return				各行の内容
+ */
+int sys::readFile(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *fileName = luaL_checkstring(L, 1);
+
+		FILE *tmpfp = nullptr;
+		errno_t err = ::fopen_s(&tmpfp, fileName, "r");
+		if (err == ENOENT) {
+			// return;
+			return 0;
+		}
+		else if (err != 0) {
+			luaL_error(L, "File open error: %s, %d", fileName, err);
+		}
+
+		// return ...;
+		int retcnt = 0;
+
+		util::FilePtr fp(tmpfp);
+		char buf[1024];
+		while (std::fgets(buf, sizeof(buf), fp.get()) != nullptr) {
+			// find new line
+			char *pnl = std::strchr(buf, '\n');
+			if (pnl != nullptr) {
+				// OK, delete '\n'
+				*pnl = '\0';
+			}
+			else {
+				// line buffer over or EOF without new line
+				// discard until NL is found or reach EOF
+				char disc[1024];
+				do {
+					if (std::fgets(disc, sizeof(disc), fp.get()) == nullptr) {
+						break;
+					}
+				} while (std::strchr(disc, '\n') == nullptr);
+			}
+			lua_pushstring(L, buf);
+			retcnt++;
+		}
+		return retcnt;
+	});
+}
+
+/**@brief ファイルを書く。
+ * @details
+ * @code
+ * function sys.writeFile(str fileName, ...)
+ * end
+ * @endcode
+ * テキストファイルを書き込みます。
+ * ファイルのオープンや書き込みに失敗した場合、エラーを発生させます。
+ * @code
+ * -- 数値は文字列に自動で変換される
+ * sys.writeFile("savedata.txt", "NoName", 1, 255);
+ * local name, stage, hp = sys.readFile("savedata.txt");
+ * -- リストを可変個の値に変換するには table.unpack() を使う
+ * local list = { "NoName", 1, 255 };
+ * sys.writeFile("savedata.txt", table.unpack(list));
+ * @endcode
+ *
+ * @warning 文字列に含まれる改行をチェックしません。
+ * @ref readFile() との整合性が崩れるので注意してください。
+ *
+ * @param[in]	fileName	ファイル名
+ * @param[in]	...			各行の内容
+ * @return					なし
+ */
+int sys::writeFile(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *fileName = luaL_checkstring(L, 1);
+
+		FILE *tmpfp = nullptr;
+		errno_t err = ::fopen_s(&tmpfp, fileName, "w");
+		if (err != 0) {
+			luaL_error(L, "File open error: %s, %d", fileName, err);
+		}
+
+		util::FilePtr fp(tmpfp);
+		int argc = lua_gettop(L);
+		for (int i = 2; i <= argc; i++) {
+			// if lua error, destruct fp and throw
+			const char *line = luaL_checkstring(L, i);
+			std::fputs(line, fp.get());
+			std::fputc('\n', fp.get());
+		}
+		return 0;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "rand" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief 乱数シード用の値を生成する。
+ * @details
+ * @code
+ * function rand.generateSeed()
+ * end
+ * @endcode
+ *
+ * @return	シード用の整数乱数
+ *
+ * @sa @ref framework::random::generateRandomSeed()
+ */
+int rand::generateSeed(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		unsigned int seed = framework::random::generateRandomSeed();
+		lua_pushinteger(L, seed);
+		return 1;
+	});
+}
+
+/**@brief 乱数のシード値を設定する。
+ * @details
+ * @code
+ * function rand.setSeed(int seed)
+ * end
+ * @endcode
+ * シード値を設定しないと毎回同じ乱数が出てきてしまいます。
+ * 初めに @ref generateSeed() で生成した乱数値をシードに設定してください。
+ * 逆に同じシードを設定すると同じ乱数列を再現できます。
+ *
+ * @param[in]	seed	設定するシード値
+ * @return				なし
+ *
+ * @sa @ref framework::random::setSeed()
+ */
+int rand::setSeed(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto seed = static_cast<unsigned int>(luaL_checkinteger(L, 1));
+		framework::random::setSeed(seed);
+		return 0;
+	});
+}
+
+/**@brief 次の整数乱数を生成する。
+ * @details
+ * @code
+ * function rand.nextInt(int a = 0, int b = 0x7fffffff)
+ * end
+ * @endcode
+ *
+ * @param[in]	a	最小値(含む)
+ * @param[in]	b	最大値(含む)
+ * @return		[a, b] のランダムな値
+ *
+ * @sa @ref framework::random::nextInt()
+ */
+int rand::nextInt(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int a = getOptInt(L, 1, 0);
+		int b = getOptInt(L, 2, std::numeric_limits<int>::max());
+		luaL_argcheck(L, a <= b, 1, "Must be a <= b");
+
+		int rnum = framework::random::nextInt(a, b);
+
+		lua_pushinteger(L, rnum);
+		return 1;
+	});
+}
+
+/**@brief 次の浮動小数点乱数を生成する。
+ * @details
+ * @code
+ * function rand.nextDouble(double a = 0.0, double b = 1.0)
+ * end
+ * @endcode
+ *
+ * @param[in]	a	最小値(含む)
+ * @param[in]	b	最大値(含まない)
+ * @return		[a, b) のランダムな値
+ *
+ * @sa @ref framework::random::nextInt()
+ */
+int rand::nextDouble(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		double a = getOptDouble(L, 1, 0.0);
+		double b = getOptDouble(L, 2, 1.0);
+		luaL_argcheck(L, a <= b, 1, "Must be a <= b");
+
+		double rnum = framework::random::nextDouble(a, b);
+
+		lua_pushnumber(L, rnum);
+		return 1;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "resource" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief テクスチャリソースを登録する。
+ * @details
+ * @code
+ * function resource.addTexture(int setId, str resId, str path)
+ * 	return handle;
+ * end
+ * @endcode
+ * 返されるハンドルはリソースセットIDとリソースIDの組の代わりに使えます。
+ * 名前の検索が不要になるので、毎フレーム使う場合はこちらが高速です。
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	path	ファイルパス
+ * @return				リソースハンドル(整数値)
+ */
+int resource::addTexture(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int setId = getInt(L, 1, 0);
+		const char *resId = luaL_checkstring(L, 2);
+		const char *path = luaL_checkstring(L, 3);
+
+		framework::ResourceHandle handle =
+			app->addTextureResource(setId, resId, arena::utf82wc(path));
+		lua_pushinteger(L, handle);
+		return 1;
+	});
+}
+
+/**@brief フォントリソースを登録する。
+ * @details
+ * @code
+ * function resource.addFont(int setId, str resId, str path)
+ * 	return handle;
+ * end
+ * @endcode
+ * 返されるハンドルはリソースセットIDとリソースIDの組の代わりに使えます。
+ * 名前の検索が不要になるので、毎フレーム使う場合はこちらが高速です。
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	path	ファイルパス
+ * @return				リソースハンドル(整数値)
+ */
+int resource::addFont(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int setId = getInt(L, 1, 0);
+		const char *resId = luaL_checkstring(L, 2);
+		const char *fontName = luaL_checkstring(L, 3);
+		const char *startCharStr = luaL_checkstring(L, 4);
+		luaL_argcheck(L, *startCharStr != '\0', 4, "empty string is NG");
+		const char *endCharStr = luaL_checkstring(L, 4);
+		luaL_argcheck(L, *endCharStr != '\0', 5, "empty string is NG");
+		int w = getInt(L, 7, 0);
+		int h = getInt(L, 8, 0);
+
+		wchar_t startChar = arena::utf82wc(startCharStr)[0];
+		wchar_t endChar = arena::utf82wc(endCharStr)[0];
+
+		framework::ResourceHandle handle =
+			app->addFontResource(setId, resId, arena::utf82wc(fontName),
+				startChar, endChar, w, h);
+		lua_pushinteger(L, handle);
+		return 1;
+	});
+}
+
+/**@brief 効果音リソースを登録する。
+ * @details
+ * @code
+ * function resource.addSe(int setId, str resId, str path)
+ * 	return handle;
+ * end
+ * @endcode
+ * 返されるハンドルはリソースセットIDとリソースIDの組の代わりに使えます。
+ * 名前の検索が不要になるので、毎フレーム使う場合はこちらが高速です。
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	path	ファイルパス
+ * @return				リソースハンドル(整数値)
+ */
+int resource::addSe(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int setId = getInt(L, 1, 0);
+		const char *resId = luaL_checkstring(L, 2);
+		const char *path = luaL_checkstring(L, 3);
+
+		framework::ResourceHandle handle =
+			app->addSeResource(setId, resId, arena::utf82wc(path));
+		lua_pushinteger(L, handle);
+		return 1;
+	});
+}
+
+/**@brief BGMリソースを登録する。
+ * @details
+ * @code
+ * function resource.addBgm(int setId, str resId, str path)
+ * 	return handle;
+ * end
+ * @endcode
+ * 返されるハンドルはリソースセットIDとリソースIDの組の代わりに使えます。
+ * 名前の検索が不要になるので、毎フレーム使う場合はこちらが高速です。
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	path	ファイルパス
+ * @return				リソースハンドル(整数値)
+ */
+int resource::addBgm(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int setId = getInt(L, 1, 0);
+		const char *resId = luaL_checkstring(L, 2);
+		const char *path = luaL_checkstring(L, 3);
+
+		framework::ResourceHandle handle =
+			app->addBgmResource(setId, resId, arena::utf82wc(path));
+		lua_pushinteger(L, handle);
+		return 1;
+	});
+}
+
+/**@brief 登録済みリソースのハンドルを得る。
+ * @details
+ * @code
+ * function resource.getHandle(str type, int setId, str resId)
+ * 	return handle;
+ * end
+ * @endcode
+ * type は "texture", "font", "se", "bgm" のいずれかです。
+ * 初期化時に一度だけ呼び、毎フレームの描画ではハンドルを使ってください。
+ *
+ * @param[in]	type	リソースの種類
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @return				リソースハンドル(整数値)
+ */
+int resource::getHandle(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int type = luaL_checkoption(L, 1, nullptr, ResourceTypeNames);
+		int setId = getInt(L, 2, 0);
+		const char *resId = luaL_checkstring(L, 3);
+
+		framework::ResourceHandle handle = app->getResourceHandle(
+			static_cast<framework::ResourceType>(type), setId, resId);
+		lua_pushinteger(L, handle);
+		return 1;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "graph" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief テクスチャのサイズを得る。
+ * @details
+ * @code
+ * function graph.getParam()
+ * 	return int w, int h, int refreshRate, bool vsync;
+ * end
+ * @endcode
+ *
+ * @retval	1	ディスプレイサイズ横
+ * @retval	2	ディスプレイサイズ縦
+ * @retval	3	リフレッシュレート(Hz)
+ * @retval	4	vsync 待ちが有効なら true
+ */
+int graph::getParam(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		graphics::GraphicsParam param;
+		app->getGraphicsParam(&param);
+
+		lua_pushinteger(L, param.w);
+		lua_pushinteger(L, param.h);
+		lua_pushinteger(L, param.refreshRate);
+		lua_pushboolean(L, param.vsync);
+		return 4;
+	});
+}
+
+/**@brief テクスチャのサイズを得る。
+ * @details
+ * @code
+ * function graph.getTextureSize(int setId, str resId)
+ * 	return w, h;
+ * end
+ * function graph.getTextureSize(int handle)
+ * 	return w, h;
+ * end
+ * @endcode
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	handle	リソースハンドル(setId, resId の代わり)
+ * @retval		1		横の長さ
+ * @retval		2		縦の長さ
+ */
+int graph::getTextureSize(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		framework::ResourceHandle handle;
+		getResourceArg(L, 1, app, framework::ResourceType::Texture, &handle);
+
+		const auto *pTex = app->getTextureView(handle);
+
+		lua_pushinteger(L, pTex->w);
+		lua_pushinteger(L, pTex->h);
+		return 2;
+	});
+}
+
+/**@brief テクスチャを描画する。
+ * @details
+ * @code
+ * function graph.drawTexture(int setId, str resId,
+ * 	int dx, int dy, bool lrInv = false, bool udInv = false,
+ * 	int sx = 0, int sy = 0, int sw = -1, int sh = -1,
+ * 	int cx = 0, int cy = 0, float angle = 0.0f,
+ * 	float scaleX = 1.0f, float scaleY = 1.0f, float alpha = 1.0f)
+ * end
+ * @endcode
+ * スクリーン座標 (dx, dy) に (cx, cy) が一致するように描画されます。
+ * setId, resId の代わりにリソースハンドル 1 つを渡すこともできます。
+ * (以降の引数は 1 つずつ前にずれます)
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	dx		描画先中心座標X
+ * @param[in]	dy		描画先中心座標Y
+ * @param[in]	lrInv	左右反転フラグ
+ * @param[in]	udInv	上下反転フラグ
+ * @param[in]	sx		テクスチャから切り出す際の左上座標X
+ * @param[in]	sy		テクスチャから切り出す際の左上座標Y
+ * @param[in]	sw		切り出しサイズX(-1でテクスチャサイズ)
+ * @param[in]	sh		切り出しサイズY(-1でテクスチャサイズ)
+ * @param[in]	cx		(sx, sy)基準の描画元中心座標X
+ * @param[in]	cy		(sx, sy)基準の描画元中心座標Y
+ * @param[in]	angle	回転角(rad)
+ * @param[in]	scaleX	拡大率X
+ * @param[in]	scaleY	拡大率Y
+ * @param[in]	alpha	透明度(0.0 - 1.0)
+ * @return				なし
+ *
+ * @sa @ref yappy::graphics::DGraphics::drawTexture()
+ */
+int graph::drawTexture(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		framework::ResourceHandle handle;
+		int arg = getResourceArg(L, 1, app, framework::ResourceType::Texture, &handle);
+		int dx = getInt(L, arg + 0);
+		int dy = getInt(L, arg + 1);
+
+		bool lrInv = lua_toboolean(L, arg + 2) != 0;
+		bool udInv = lua_toboolean(L, arg + 3) != 0;
+		int sx = getOptInt(L, arg + 4, 0);
+		int sy = getOptInt(L, arg + 5, 0);
+		int sw = getOptInt(L, arg + 6, -1);
+		int sh = getOptInt(L, arg + 7, -1);
+		int cx = getOptInt(L, arg + 8, 0);
+		int cy = getOptInt(L, arg + 9, 0);
+		float angle = getOptFloat(L, arg + 10, 0.0f);
+		float scaleX = getOptFloat(L, arg + 11, 1.0f);
+		float scaleY = getOptFloat(L, arg + 12, 1.0f);
+		float alpha = getOptFloat(L, arg + 13, 1.0f);
+
+		// valid until the end of frame (drawn at frame end)
+		const auto *pTex = app->getTextureView(handle);
+		app->graph().drawTexture(*pTex, dx, dy, lrInv, udInv, sx, sy, sw, sh, cx, cy,
+			angle, scaleX, scaleY, alpha);
+		return 0;
+	});
+}
+
+/**@brief 文字列を描画する。
+ * @details
+ * @code
+ * function graph.drawString(int setId, str resId, str str, int dx, int dy,
+ * 	int color = 0x000000, int ajustX = 0, 
+ * 	float scaleX = 1.0f, float scaleY = 1.0f, float alpha = 1.0f)
+ * end
+ * @endcode
+ * setId, resId の代わりにリソースハンドル 1 つを渡すこともできます。
+ * (以降の引数は 1 つずつ前にずれます)
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	str		描画する文字列
+ * @param[in]	dx		描画先座標X
+ * @param[in]	dy		描画先座標Y
+ * @param[in]	color	文字色 (0xRRGGBB)
+ * @param[in]	ajustX	文字間隔調整用X移動量
+ * @param[in]	scaleX	拡大率X
+ * @param[in]	scaleY	拡大率Y
+ * @param[in]	alpha	透明度(0.0 - 1.0)
+ * @return				なし
+ *
+ * @sa @ref yappy::graphics::DGraphics::drawString()
+ */
+int graph::drawString(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		framework::ResourceHandle handle;
+		// str follows the resource
+		int arg = getResourceArg(L, 1, app, framework::ResourceType::Font, &handle, 1);
+		const char *str = luaL_checkstring(L, arg + 0);
+		int dx = getInt(L, arg + 1);
+		int dy = getInt(L, arg + 2);
+
+		int color = getOptInt(L, arg + 3, 0x000000);
+		int ajustX = getOptInt(L, arg + 4, 0);
+		float scaleX = getOptFloat(L, arg + 5, 1.0f);
+		float scaleY = getOptFloat(L, arg + 6, 1.0f);
+		float alpha = getOptFloat(L, arg + 7, 1.0f);
+
+		const auto *pFont = app->getFontView(handle);
+		app->graph().drawString(*pFont, arena::utf82wc(str), dx, dy,
+			color, ajustX, scaleX, scaleY, alpha);
+		return 0;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "sound" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief 効果音再生を開始する。
+ * @details
+ * @code
+ * function sound.playSe(int setId, str resId)
+ * end
+ * function sound.playSe(int handle)
+ * end
+ * @endcode
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	handle	リソースハンドル(setId, resId の代わり)
+ * @return				なし
+ */
+int sound::playSe(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		framework::ResourceHandle handle;
+		getResourceArg(L, 1, app, framework::ResourceType::SoundEffect, &handle);
+
+		const auto &pSoundEffect = app->getSoundEffect(handle);
+		app->sound().playSoundEffect(pSoundEffect);
+		return 0;
+	});
+}
+
+/**@brief BGM 再生を開始する。
+ * @details
+ * @code
+ * function sound.playBgm(int setId, str resId)
+ * end
+ * function sound.playBgm(int handle)
+ * end
+ * @endcode
+ *
+ * @param[in]	setId	リソースセットID(整数値)
+ * @param[in]	resId	リソースID(文字列)
+ * @param[in]	handle	リソースハンドル(setId, resId の代わり)
+ * @return				なし
+ */
+int sound::playBgm(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		framework::ResourceHandle handle;
+		getResourceArg(L, 1, app, framework::ResourceType::Bgm, &handle);
+
+		auto &pBgm = app->getBgm(handle);
+		app->sound().playBgm(pBgm);
+		return 0;
+	});
+}
+
+/**@brief BGM 再生を停止する。
+ * @details
+ * @code
+ * function sound.stopBgm()
+ * end
+ * @endcode
+ *
+ * @return				なし
+ */
+int sound::stopBgm(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		app->sound().stopBgm();
+		return 0;
+	});
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// "perf" table
+///////////////////////////////////////////////////////////////////////////////
+
+/**@brief 現在の FPS を得る。
+ * @details
+ * @code
+ * function perf.getFps()
+ * 	return fps;
+ * end
+ * @endcode
+ *
+ * @retval	1	実際に描画された回数/秒(約1秒ごとに更新)
+ */
+int perf::getFps(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		lua_pushnumber(L, app->frameControl().getFramePerSec());
+		return 1;
+	});
+}
+
+/**@brief 直近のフレーム時間のパーセンタイル値を得る。
+ * @details
+ * @code
+ * function perf.getFrameStats(int window = 60)
+ * 	return {
+ * 		frames = int,
+ * 		update = { p50 = number, p95 = number, p99 = number, max = number },
+ * 		render = {...}, present = {...}, idle = {...}, wait = {...},
+ * 		total = {...},
+ * 	};
+ * end
+ * @endcode
+ * update: 更新処理、render: 描画処理、present: フリップ(vsync 待ち含む)、
+ * idle: 余り時間に実行したアイドルタスク、wait: 次フレームまでの待ち、
+ * total: フレーム間隔 です。
+ *
+ * @param[in]	window	集計するフレーム数(1 - 1024)
+ * @retval		1		統計情報テーブル
+ */
+int perf::getFrameStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int window = getOptInt(L, 1, 60, 1, timer::FrameTimeRing::Capacity);
+
+		timer::FrameTimeStats stats;
+		app->frameControl().getFrameTimeStats(&stats, window);
+
+		auto pushPercentiles = [L](const timer::Percentiles &p) {
+			lua_createtable(L, 0, 4);
+			lua_pushnumber(L, p.p50Ms);
+			lua_setfield(L, -2, "p50");
+			lua_pushnumber(L, p.p95Ms);
+			lua_setfield(L, -2, "p95");
+			lua_pushnumber(L, p.p99Ms);
+			lua_setfield(L, -2, "p99");
+			lua_pushnumber(L, p.maxMs);
+			lua_setfield(L, -2, "max");
+		};
+		lua_createtable(L, 0, 7);
+		lua_pushinteger(L, stats.frames);
+		lua_setfield(L, -2, "frames");
+		pushPercentiles(stats.update);
+		lua_setfield(L, -2, "update");
+		pushPercentiles(stats.render);
+		lua_setfield(L, -2, "render");
+		pushPercentiles(stats.present);
+		lua_setfield(L, -2, "present");
+		pushPercentiles(stats.idle);
+		lua_setfield(L, -2, "idle");
+		pushPercentiles(stats.wait);
+		lua_setfield(L, -2, "wait");
+		pushPercentiles(stats.total);
+		lua_setfield(L, -2, "total");
+		return 1;
+	});
+}
+
+/**@brief フレームスキップの統計情報を得る。
+ * @details
+ * @code
+ * function perf.getSkipStats()
+ * 	return skipRatio, updateCost, renderCost;
+ * end
+ * @endcode
+ *
+ * @retval	1	スキップしたフレームの割合(0.0 - 1.0)
+ * @retval	2	更新処理時間の移動平均
+ * @retval	3	描画処理時間の移動平均
+ */
+int perf::getSkipStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		const auto &stats = app->frameControl().getSkipStats();
+		lua_pushnumber(L, stats.skipRatio);
+		lua_pushnumber(L, stats.updateCostMs);
+		lua_pushnumber(L, stats.renderCostMs);
+		return 3;
+	});
+}
+
+/**@brief フレーム時間のパーセンタイル値とヒストグラムをデバッグ出力する。
+ * @details
+ * @code
+ * function perf.dumpFrameTime(int window = 1024, number binMs = 1.0,
+ * 	int binCount = 50)
+ * end
+ * @endcode
+ *
+ * @param[in]	window		集計するフレーム数(1 - 1024)
+ * @param[in]	binMs		ヒストグラムの幅
+ * @param[in]	binCount	ヒストグラムの区間数
+ * @return					なし
+ */
+int perf::dumpFrameTime(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int window = getOptInt(L, 1, timer::FrameTimeRing::Capacity,
+			1, timer::FrameTimeRing::Capacity);
+		double binMs = getOptDouble(L, 2, 1.0, 0.01, 1000.0);
+		int binCount = getOptInt(L, 3, 50, 1, 1000);
+
+		app->frameControl().dumpFrameTime(window, binMs, binCount);
+		return 0;
+	});
+}
+
+/**@brief メモリ使用状況を得る。
+ * @details
+ * @code
+ * function perf.getMemoryStats()
+ * 	return heapAllocPerFrame, arenaUsed, arenaPeak;
+ * end
+ * @endcode
+ * ヒープ確保回数はデバッグビルドでのみ有効です。(リリースビルドでは常に 0)
+ *
+ * @retval	1	前フレームの CRT ヒープ確保回数
+ * @retval	2	フレームアリーナの現在の使用量(バイト)
+ * @retval	3	フレームアリーナの最大使用量(バイト)
+ */
+int perf::getMemoryStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		const auto &frameArena = arena::threadArena();
+		lua_pushinteger(L, static_cast<lua_Integer>(app->getHeapAllocPerFrame()));
+		lua_pushinteger(L, static_cast<lua_Integer>(frameArena.getUsed()));
+		lua_pushinteger(L, static_cast<lua_Integer>(frameArena.getPeak()));
+		return 3;
+	});
+}
+
+/**@brief アイドルタスクの実行状況を得る。
+ * @details
+ * @code
+ * function perf.getIdleStats()
+ * 	return slack, spent, executed, deferred, overrunTotal;
+ * end
+ * @endcode
+ * 値は前フレームのものです。(overrunTotal は累計)
+ *
+ * @retval	1	アイドルタスクに与えられた余り時間
+ * @retval	2	アイドルタスクの実行に使った時間
+ * @retval	3	実行したステップ数
+ * @retval	4	時間が足りず次フレーム以降に回したステップ数
+ * @retval	5	期限を超過したステップ数の累計
+ *
+ * @sa @ref yappy::framework::IdleScheduler
+ */
+int perf::getIdleStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		const auto &stats = app->idle().getStats();
+		lua_pushnumber(L, stats.slackMs);
+		lua_pushnumber(L, stats.spentMs);
+		lua_pushinteger(L, stats.executed);
+		lua_pushinteger(L, stats.deferred);
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.overrunTotal));
+		return 5;
+	});
+}
+
+/**@brief リソースキャッシュの統計情報を得る。
+ * @details
+ * @code
+ * function perf.getCacheStats(str type)
+ * 	return hit, miss, evict, used, budget, shared, saved;
+ * end
+ * @endcode
+ * type は "texture", "font", "se", "bgm" のいずれかです。
+ * 同じファイルを複数のIDで登録した場合、実体は共有されます。
+ *
+ * @param[in]	type	リソースの種類
+ * @retval	1	ロード済みだった取得回数
+ * @retval	2	ロードが必要だった取得回数
+ * @retval	3	予算超過で解放したリソース数
+ * @retval	4	ロード済みリソースのメモリサイズ(バイト)
+ * @retval	5	メモリ予算(バイト、0 は無制限)
+ * @retval	6	ロード済みの実体を共有したロード回数
+ * @retval	7	共有により節約したメモリサイズ(バイト)
+ *
+ * @sa @ref yappy::framework::Application::setResourceCacheBudget()
+ */
+int perf::getCacheStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+		int type = luaL_checkoption(L, 1, nullptr, ResourceTypeNames);
+
+		const auto stats = app->getResourceCacheStats(
+			static_cast<framework::ResourceType>(type));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.hit));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.miss));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.evict));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.used));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.budget));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.shared));
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.saved));
+		return 7;
+	});
+}
+
+/**@brief BGM ストリーミングの状況を得る。
+ * @details
+ * @code
+ * function perf.getBgmStats()
+ * 	return underruns, queued, blockCount, latencyMs, decoded;
+ * end
+ * @endcode
+ * BGM はオーディオスレッドでデコードされ、
+ * 遅延目標 (config の sound.bgmlatency) 分のブロックがボイスに積まれます。
+ * underruns が増える場合はデコードが間に合っていません。
+ * underruns と decoded は累計です。
+ *
+ * @retval	1	ボイスのブロックが空になった回数
+ * @retval	2	現在ボイスに積まれているブロック数
+ * @retval	3	ブロック数 (再生中でなければ 0)
+ * @retval	4	全ブロックの再生時間(ms)
+ * @retval	5	デコードしたブロック数
+ *
+ * @sa @ref yappy::sound::XAudio2::getBgmStats()
+ */
+int perf::getBgmStats(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		auto *app = getPtrFromUpvalue<framework::Application>(L, 1);
+
+		const auto stats = app->sound().getBgmStats();
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.underruns));
+		lua_pushinteger(L, stats.queued);
+		lua_pushinteger(L, stats.blockCount);
+		lua_pushnumber(L, stats.latencyMs);
+		lua_pushinteger(L, static_cast<lua_Integer>(stats.decoded));
+		return 5;
+	});
+}
+
+/**@brief リソースID検索のマイクロベンチマークを実行する。
+ * @details
+ * @code
+ * function perf.benchIdMap(int count = 10000, int lookups = 1000000)
+ * 	return unorderedNs, frozenNs, buildMs;
+ * end
+ * @endcode
+ * シール時に作られる完全ハッシュ表と std::unordered_map の検索時間を比較します。
+ *
+ * @param[in]	count	登録するID数
+ * @param[in]	lookups	検索回数
+ * @retval	1	std::unordered_map の 1 検索あたりの時間(ns)
+ * @retval	2	完全ハッシュ表の 1 検索あたりの時間(ns)
+ * @retval	3	完全ハッシュ表の構築時間(ms)
+ *
+ * @sa @ref yappy::util::FrozenIdMap
+ */
+int perf::benchIdMap(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int count = getOptInt(L, 1, 10000, 1, 1000000);
+		int lookups = getOptInt(L, 2, 1000000, 1, 100000000);
+
+		const auto result = util::benchmarkIdMap(count, lookups);
+		lua_pushnumber(L, result.unorderedNs);
+		lua_pushnumber(L, result.frozenNs);
+		lua_pushnumber(L, result.buildMs);
+		return 3;
+	});
+}
+
+/**@brief リソース読み出しのマルチスレッドベンチマークを実行する。
+ * @details
+ * @code
+ * function perf.benchResourceRead(int threads = 4, int iterations = 1000000)
+ * 	return lockedNs, viewNs, lockedMaxUs, viewMaxUs;
+ * end
+ * @endcode
+ * 全スレッドが同じリソースを同時に読み出し、
+ * ロック付きの取得(shared_ptr)とロックフリーのビュー取得を比較します。
+ *
+ * @param[in]	threads		読み出しスレッド数
+ * @param[in]	iterations	スレッドあたりの読み出し回数
+ * @retval	1	ロック付き取得の 1 回あたりの時間(ns)
+ * @retval	2	ビュー取得の 1 回あたりの時間(ns)
+ * @retval	3	ロック付き取得の 1024 回あたりの最悪時間(us)
+ * @retval	4	ビュー取得の 1024 回あたりの最悪時間(us)
+ *
+ * @sa @ref yappy::framework::Resource
+ */
+int perf::benchResourceRead(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int threads = getOptInt(L, 1, 4, 1, 64);
+		int iterations = getOptInt(L, 2, 1000000, 1024, 100000000);
+
+		const auto result = framework::benchmarkResourceRead(threads, iterations);
+		lua_pushnumber(L, result.lockedNs);
+		lua_pushnumber(L, result.viewNs);
+		lua_pushnumber(L, result.lockedMaxUs);
+		lua_pushnumber(L, result.viewMaxUs);
+		return 4;
+	});
+}
+
+/**@brief アーカイブからのファイル読み込みのベンチマークを実行する。
+ * @details
+ * @code
+ * function perf.benchArchive(string archive, string rootDir, int rounds = 10)
+ * 	return fsMs, archiveMs, files, bytes, archiveBytes;
+ * end
+ * @endcode
+ * アーカイブ内の全ファイルを、アーカイブと元のディレクトリの両方から読み込み、
+ * 時間を比較します。
+ *
+ * @param[in]	archive	アーカイブファイルのパス
+ * @param[in]	rootDir	アーカイブ作成元のディレクトリ
+ * @param[in]	rounds	繰り返し回数
+ * @retval	1	ディレクトリから全ファイルを読む時間(ms)
+ * @retval	2	アーカイブから全ファイルを読む時間(ms)
+ * @retval	3	ファイル数
+ * @retval	4	合計バイト数
+ * @retval	5	アーカイブファイルのバイト数
+ *
+ * @sa @ref yappy::file::createArchive()
+ */
+int perf::benchArchive(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *archive = luaL_checkstring(L, 1);
+		const char *rootDir = luaL_checkstring(L, 2);
+		int rounds = getOptInt(L, 3, 10, 1, 10000);
+
+		const auto result = file::benchmarkArchive(
+			util::utf82wc(archive).get(), util::utf82wc(rootDir).get(), rounds);
+		lua_pushnumber(L, result.fsMs);
+		lua_pushnumber(L, result.archiveMs);
+		lua_pushinteger(L, result.files);
+		lua_pushinteger(L, static_cast<lua_Integer>(result.bytes));
+		lua_pushinteger(L, static_cast<lua_Integer>(result.archiveBytes));
+		return 5;
+	});
+}
+
+/**@brief アーカイブ用圧縮の圧縮率と速度を計測する。
+ * @details
+ * @code
+ * function perf.benchLz(string fileName, int rounds = 10)
+ * 	return ratio, compressMBps, decompressMBps;
+ * end
+ * @endcode
+ * ファイルをアーカイブと同じブロック単位で圧縮・展開します。
+ * 展開速度は 1 スレッドでの値です。
+ *
+ * @param[in]	fileName	ファイル名
+ * @param[in]	rounds		繰り返し回数
+ * @retval	1	圧縮後サイズ / 元のサイズ
+ * @retval	2	圧縮速度(MB/s)
+ * @retval	3	展開速度(MB/s)
+ *
+ * @sa @ref yappy::lz
+ */
+int perf::benchLz(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *fileName = luaL_checkstring(L, 1);
+		int rounds = getOptInt(L, 2, 10, 1, 10000);
+
+		file::Bytes bin = file::loadFile(util::utf82wc(fileName).get());
+		const auto result = lz::benchmark(bin.data(), bin.size(),
+			file::ArchiveBlockSize, rounds);
+		double ratio = (result.rawBytes != 0) ?
+			static_cast<double>(result.compressedBytes) / result.rawBytes : 1.0;
+		lua_pushnumber(L, ratio);
+		lua_pushnumber(L, result.compressMBps);
+		lua_pushnumber(L, result.decompressMBps);
+		return 3;
+	});
+}
+
+/**@brief 非同期ファイル読み込みのスループットを計測する。
+ * @details
+ * @code
+ * function perf.benchAsyncRead(table fileNames, int depth = 8, string backend = "auto")
+ * 	return mbps, ms, bytes, maxInFlight;
+ * end
+ * @endcode
+ * fileNames の全ファイルを、最大 depth 個同時に発行して読み込みます。
+ * backend には以下を指定できます。
+ * @li "auto"	環境ごとの既定値 (Windows では "iocp"、その他では "pool")
+ * @li "iocp"	I/O 完了ポートによるオーバーラップ I/O (Windows のみ)
+ * @li "pool"	depth 個のスレッドによる同期読み込み
+ *
+ * OS のファイルキャッシュに乗っている場合は大きな値が出るため、
+ * コールドキャッシュの値が必要な場合は注意してください。
+ *
+ * @param[in]	fileNames	ファイル名の配列
+ * @param[in]	depth		同時に発行する読み込みの最大数
+ * @param[in]	backend		実装の種類
+ * @retval	1	スループット(MB/s)
+ * @retval	2	全ファイルの読み込み時間(ms)
+ * @retval	3	合計バイト数
+ * @retval	4	実際に同時に発行された読み込みの最大数
+ *
+ * @sa @ref yappy::file::AsyncReader
+ */
+int perf::benchAsyncRead(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		luaL_checktype(L, 1, LUA_TTABLE);
+		int depth = getOptInt(L, 2, 8, 1, 256);
+		int backend = luaL_checkoption(L, 3, "auto", AsyncBackendNames);
+
+		std::vector<std::wstring> fileNames;
+		lua_Integer len = luaL_len(L, 1);
+		for (lua_Integer i = 1; i <= len; i++) {
+			lua_geti(L, 1, i);
+			fileNames.emplace_back(util::utf82wc(luaL_checkstring(L, -1)).get());
+			lua_pop(L, 1);
+		}
+		const auto result = file::benchmarkAsyncRead(fileNames, depth,
+			static_cast<file::AsyncReader::Backend>(backend));
+		lua_pushnumber(L, result.mbps);
+		lua_pushnumber(L, result.ms);
+		lua_pushinteger(L, static_cast<lua_Integer>(result.bytes));
+		lua_pushinteger(L, result.maxInFlight);
+		return 4;
+	});
+}
+
+/**@brief アクセストレース順にアーカイブからの読み込み時間を計測する。
+ * @details
+ * @code
+ * function perf.benchTraceReplay(string nameArchive, string traceArchive, string trace)
+ * 	return nameMs, traceMs, files, bytes, cold;
+ * end
+ * @endcode
+ * 実行時に記録したファイルのアクセス順 (config の file.trace) を再現し、
+ * アーカイブを開いてから全ファイルを読み終わるまでの時間を
+ * 名前順のアーカイブとトレース順のアーカイブ (--pack --trace) のそれぞれで計測します。
+ * 各計測の直前にそのアーカイブを OS のファイルキャッシュから追い出します。
+ * 追い出せなかった場合 (cold が false) は再起動直後でのみ意味があります。
+ *
+ * @param[in]	nameArchive		名前順のアーカイブファイルのパス
+ * @param[in]	traceArchive	トレース順のアーカイブファイルのパス
+ * @param[in]	trace			アクセストレースファイルのパス
+ * @retval	1	名前順アーカイブの読み込み時間(ms)
+ * @retval	2	トレース順アーカイブの読み込み時間(ms)
+ * @retval	3	読み込んだファイル数
+ * @retval	4	合計バイト数
+ * @retval	5	両方をファイルキャッシュから追い出せたか
+ *
+ * @sa @ref yappy::file::benchmarkTraceReplay()
+ */
+int perf::benchTraceReplay(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *nameArchive = luaL_checkstring(L, 1);
+		const char *traceArchive = luaL_checkstring(L, 2);
+		const char *trace = luaL_checkstring(L, 3);
+
+		const auto result = file::benchmarkTraceReplay(
+			util::utf82wc(nameArchive).get(), util::utf82wc(traceArchive).get(),
+			util::utf82wc(trace).get());
+		lua_pushnumber(L, result.nameOrderMs);
+		lua_pushnumber(L, result.traceOrderMs);
+		lua_pushinteger(L, result.files);
+		lua_pushinteger(L, static_cast<lua_Integer>(result.bytes));
+		lua_pushboolean(L, result.cold);
+		return 5;
+	});
+}
+
+/**@brief マウントテーブルのファイル名検索速度を計測する。
+ * @details
+ * @code
+ * function perf.benchMountLookup(int entries = 100000, int lookups = 1000000)
+ * 	return lookupsPerSec, lookupMs, buildMs;
+ * end
+ * @endcode
+ * 生成したファイル名 entries 個でインデックスを作り、
+ * ランダムな順序で lookups 回検索します。
+ * ファイルの読み込みは行いません。
+ *
+ * @param[in]	entries	エントリ数
+ * @param[in]	lookups	検索回数
+ * @retval	1	1 秒あたりの検索回数
+ * @retval	2	全検索の時間(ms)
+ * @retval	3	インデックス作成時間(ms)
+ *
+ * @sa @ref yappy::file::mount()
+ */
+int perf::benchMountLookup(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int entries = getOptInt(L, 1, 100000, 1, 10000000);
+		int lookups = getOptInt(L, 2, 1000000, 1, 100000000);
+
+		const auto result = file::benchmarkMountLookup(entries, lookups);
+		lua_pushnumber(L, result.lookupsPerSec);
+		lua_pushnumber(L, result.lookupMs);
+		lua_pushnumber(L, result.buildMs);
+		return 3;
+	});
+}
+
+/**@brief アーカイブの整合性チェックに使う CRC-32C の速度を計測する。
+ * @details
+ * @code
+ * function perf.benchCrc(int sizeKB = 1024, int rounds = 100)
+ * 	return crcGBps, tableGBps, hardware;
+ * end
+ * @endcode
+ * 乱数データの CRC を 1 スレッドで計算し、
+ * CPU 命令 (SSE4.2 / ARMv8 CRC) 版とテーブル版を比較します。
+ * sizeKB が CPU キャッシュより小さい場合はキャッシュ内の速度になります。
+ *
+ * @param[in]	sizeKB	データサイズ(KiB)
+ * @param[in]	rounds	繰り返し回数
+ * @retval	1	実際に使われる実装の速度(GB/s)
+ * @retval	2	テーブル版の速度(GB/s)
+ * @retval	3	CPU 命令が使われるなら true
+ *
+ * @sa @ref yappy::crc
+ */
+int perf::benchCrc(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		int sizeKB = getOptInt(L, 1, 1024, 1, 1024 * 1024);
+		int rounds = getOptInt(L, 2, 100, 1, 100000);
+
+		const auto result = crc::benchmark(static_cast<size_t>(sizeKB) * 1024, rounds);
+		lua_pushnumber(L, result.crcGBps);
+		lua_pushnumber(L, result.tableGBps);
+		lua_pushboolean(L, result.hardware);
+		return 3;
+	});
+}
+
+/**@brief アーカイブ内の全ブロックの CRC をチェックする。
+ * @details
+ * @code
+ * function perf.verifyArchive(string archive)
+ * 	return brokenCount, gbps, ms;
+ * end
+ * @endcode
+ * 全ブロックを並列にチェックします (インストールの検証)。
+ * 壊れたファイル名もデバッグ出力に書き出されます。
+ *
+ * @param[in]	archive	アーカイブファイルのパス
+ * @retval	1	壊れたファイルの数
+ * @retval	2	チェック速度(GB/s)
+ * @retval	3	チェック時間(ms)
+ *
+ * @sa @ref yappy::file::verifyArchive()
+ */
+int perf::verifyArchive(lua_State *L)
+{
+	return exceptToLuaError(L, [L]() {
+		const char *archive = luaL_checkstring(L, 1);
+
+		const auto result = file::verifyArchive(util::utf82wc(archive).get());
+		lua_pushinteger(L, static_cast<lua_Integer>(result.badFiles.size()));
+		lua_pushnumber(L, result.gbps);
+		lua_pushnumber(L, result.ms);
+		return 3;
+	});
+}
+
+}	// namespace export
+
+///////////////////////////////////////////////////////////////////////////////
+// Lua::loadXxxLib
+///////////////////////////////////////////////////////////////////////////////
+
+void Lua::loadTraceLib()
+{
+	lua_State *L = m_lua.get();
+	luaL_newlib(L, export::trace_RegList);
+	lua_setglobal(L, "trace");
+
+	// print <- trace.write
+	lua_pushcfunction(L, export::trace::write);
+	lua_setglobal(L, "print");
+}
+
+void Lua::loadSysLib()
+{
+	lua_State *L = m_lua.get();
+	luaL_newlibtable(L, export::trace_RegList);
+	// upvalue[1]: Lua *
+	lua_pushlightuserdata(L, this);
+	luaL_setfuncs(L, export::sys_RegList, 1);
+	lua_setglobal(L, "sys");
+}
+
+void Lua::loadRandLib()
+{
+	lua_State *L = m_lua.get();
+	luaL_newlib(L, export::rand_RegList);
+	lua_setglobal(L, "rand");
+}
+
+void Lua::loadResourceLib(framework::Application *app)
+{
+	lua_State *L = m_lua.get();
+	luaL_newlibtable(L, export::resource_RegList);
+	// upvalue[1]: Application *
+	lua_pushlightuserdata(L, app);
+	luaL_setfuncs(L, export::resource_RegList, 1);
+	lua_setglobal(L, "resource");
+}
+
+void Lua::loadGraphLib(framework::Application *app)
+{
+	lua_State *L = m_lua.get();
+	luaL_newlibtable(L, export::graph_RegList);
+	// upvalue[1]: Application *
+	lua_pushlightuserdata(L, app);
+	luaL_setfuncs(L, export::graph_RegList, 1);
+	lua_setglobal(L, "graph");
+}
+
+void Lua::loadSoundLib(framework::Application *app)
+{
+	lua_State *L = m_lua.get();
+	luaL_newlibtable(L, export::sound_RegList);
+	// upvalue[1]: Application *
+	lua_pushlightuserdata(L, app);
+	luaL_setfuncs(L, export::sound_RegList, 1);
+	lua_setglobal(L, "sound");
+}
+
+void Lua::loadPerfLib(framework::Application *app)
+{
+	lua_State *L = m_lua.get();
+	luaL_newlibtable(L, export::perf_RegList);
+	// upvalue[1]: Application *
+	lua_pushlightuserdata(L, app);
+	luaL_setfuncs(L, export::perf_RegList, 1);
+	lua_setglobal(L, "perf");
+}
+
+}	// namespace lua
+}	// namespace yappy
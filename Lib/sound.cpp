@@ -1,413 +1,598 @@
-﻿#include "stdafx.h"
-#include "include/sound.h"
-#include "include/debug.h"
-#include "include/exceptions.h"
-#include <algorithm>
-
-#include <mmsystem.h>
-#pragma comment(lib, "winmm.lib")
-
-namespace yappy {
-namespace sound {
-
-using error::throwTrace;
-using error::MmioError;
-using error::OggVorbisError;
-using error::checkDXResult;
-using error::XAudioError;
-
-namespace {
-
-void loadWaveFile(SoundEffect *out, const wchar_t *path)
-{
-	file::Bytes bin = file::loadFile(path);
-
-	MMIOINFO mmioInfo = { 0 };
-	mmioInfo.pchBuffer = reinterpret_cast<HPSTR>(bin.data());
-	mmioInfo.fccIOProc = FOURCC_MEM;
-	mmioInfo.cchBuffer = static_cast<LONG>(bin.size());
-
-	HMMIO tmpHMmio = mmioOpen(0, &mmioInfo, MMIO_READ);
-	if (tmpHMmio == nullptr) {
-		throwTrace<MmioError>("mmioOpen() failed", mmioInfo.wErrorRet);
-	}
-	std::unique_ptr<HMMIO, hmmioDeleter> hMmio(tmpHMmio);
-
-	// enter "WAVE"
-	MMRESULT mmRes = MMSYSERR_NOERROR;
-	MMCKINFO riffChunk = { 0 };
-	riffChunk.fccType = mmioFOURCC('W', 'A', 'V', 'E');
-	mmRes = mmioDescend(hMmio.get(), &riffChunk, nullptr, MMIO_FINDRIFF);
-	if (mmRes != MMSYSERR_NOERROR) {
-		throwTrace<MmioError>("mmioDescend() failed", mmRes);
-	}
-	// enter "fmt "
-	MMCKINFO formatChunk = { 0 };
-	formatChunk.ckid = mmioFOURCC('f', 'm', 't', ' ');
-	mmRes = mmioDescend(hMmio.get(), &formatChunk, &riffChunk, MMIO_FINDCHUNK);
-	if (mmRes != MMSYSERR_NOERROR) {
-		throwTrace<MmioError>("mmioDescend() failed", mmRes);
-	}
-	// read "fmt "
-	::ZeroMemory(&out->format, sizeof(out->format));
-	DWORD fmtSize = std::min(formatChunk.cksize, static_cast<DWORD>(sizeof(out->format)));
-	DWORD size = mmioRead(hMmio.get(), reinterpret_cast<HPSTR>(&out->format), fmtSize);
-	if (size != fmtSize) {
-		throwTrace<MmioError>("mmioRead() failed", size);
-	}
-	// leave "fmt "
-	mmRes = mmioAscend(hMmio.get(), &formatChunk, 0);
-	if (mmRes != MMSYSERR_NOERROR) {
-		throwTrace<MmioError>("mmioAscend() failed", mmRes);
-	}
-	// enter "data"
-	MMCKINFO dataChunk = { 0 };
-	dataChunk.ckid = mmioFOURCC('d', 'a', 't', 'a');
-	mmRes = mmioDescend(hMmio.get(), &dataChunk, &riffChunk, MMIO_FINDCHUNK);
-	if (mmRes != MMSYSERR_NOERROR) {
-		throwTrace<MmioError>("mmioDescend() failed", mmRes);
-	}
-	// read "data"
-	if (dataChunk.cksize > SoundEffectSizeMax) {
-		throwTrace<MmioError>("data size too large", 0);
-	}
-	out->samples.resize(dataChunk.cksize);
-	size = mmioRead(hMmio.get(), reinterpret_cast<HPSTR>(out->samples.data()), dataChunk.cksize);
-	if (size != dataChunk.cksize) {
-		throwTrace<MmioError>("mmioRead() failed", size);
-	}
-}
-
-}	// namespace
-
-XAudio2::XAudio2() :
-	m_pBgmBuffer(new char[BgmBufferSize * BgmBufferCount]),
-	m_writePos(0)
-{
-	debug::writeLine(L"Initializing XAudio2...");
-
-	HRESULT hr = S_OK;
-
-	IXAudio2 *ptmpIXAudio2 = nullptr;
-	UINT32 flags = 0;
-#ifdef _DEBUG
-	flags = XAUDIO2_DEBUG_ENGINE;
-#endif
-	hr = ::XAudio2Create(&ptmpIXAudio2, flags);
-	checkDXResult<XAudioError>(hr, "XAudio2Create() failed");
-	m_pIXAudio.reset(ptmpIXAudio2);
-
-	IXAudio2MasteringVoice *ptmpMasterVoice = nullptr;
-	hr = m_pIXAudio->CreateMasteringVoice(&ptmpMasterVoice);
-	checkDXResult<XAudioError>(hr, "IXAudio2::CreateMasteringVoice() failed");
-	m_pMasterVoice.reset(ptmpMasterVoice);
-
-	debug::writeLine(L"Initializing XAudio2 OK");
-}
-
-XAudio2::~XAudio2() {
-	debug::writeLine(L"Finalize XAudio2");
-}
-
-void XAudio2::processFrame()
-{
-	processFrameSe();
-	processFrameBgm();
-}
-
-XAudio2::SeResourcePtr XAudio2::loadSoundEffect(const wchar_t *path)
-{
-	auto res = std::make_shared<SoundEffect>();
-	loadWaveFile(res.get(), path);
-	return res;
-}
-
-void XAudio2::playSoundEffect(const SeResourcePtr &se)
-{
-	// find playing src voice list entry
-	PyaingSeElem *ppEntry = findFreeSeEntry();
-	if (ppEntry == nullptr) {
-		debug::writeLine("Warning: SE playing list is full!");
-		return;
-	}
-	SeResourcePtr &entryBuf = std::get<0>(*ppEntry);
-	SourceVoicePtr &entryVoice = std::get<1>(*ppEntry);
-	ASSERT(entryBuf == nullptr);
-	ASSERT(entryVoice == nullptr);
-
-	XAUDIO2_BUFFER buffer = { 0 };
-	ASSERT(se->samples.size() <= file::FileSizeMax);
-	buffer.AudioBytes = static_cast<UINT32>(se->samples.size());
-	buffer.pAudioData = se->samples.data();
-	buffer.Flags = XAUDIO2_END_OF_STREAM;
-
-	// create source voice
-	HRESULT hr = S_OK;
-	IXAudio2SourceVoice *ptmpSrcVoice = nullptr;
-	hr = m_pIXAudio->CreateSourceVoice(&ptmpSrcVoice, &se->format);
-	checkDXResult<XAudioError>(hr, "IXAudio2::CreateSourceVoice() failed");
-	SourceVoicePtr pSrcVoice(ptmpSrcVoice);
-
-	// submit source buffer
-	hr = pSrcVoice->SubmitSourceBuffer(&buffer);
-	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::SubmitSourceBuffer() failed");
-	hr = pSrcVoice->Start();
-	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::Start() failed");
-
-	// keep shared_ptr reference in *this 
-	entryBuf = se;
-	// set the source voice element
-	entryVoice = std::move(pSrcVoice);
-}
-
-bool XAudio2::isPlayingAnySoundEffect() const
-{
-	for (const auto &entry : m_playingSeList) {
-		const SeResourcePtr &entryBuf = std::get<0>(entry);
-		const SourceVoicePtr &entryVoice = std::get<1>(entry);
-		if (entryBuf == nullptr) {
-			ASSERT(entryVoice == nullptr);
-			continue;
-		}
-		// check if playing is end
-		XAUDIO2_VOICE_STATE state = { 0 };
-		entryVoice->GetState(&state);
-		if (state.BuffersQueued != 0) {
-			return false;
-		}
-	}
-	return true;
-}
-
-void XAudio2::stopAllSoundEffect()
-{
-	// release SrcVoice, then decrement refcnt of wave buf
-	for (auto &entry : m_playingSeList) {
-		SeResourcePtr &entryBuf = std::get<0>(entry);
-		SourceVoicePtr &entryVoice = std::get<1>(entry);
-		entryVoice.reset();
-		entryBuf.reset();
-	}
-}
-
-XAudio2::PyaingSeElem *XAudio2::findFreeSeEntry()
-{
-	for (auto &entry : m_playingSeList) {
-		SeResourcePtr &entryBuf = std::get<0>(entry);
-		SourceVoicePtr &entryVoice = std::get<1>(entry);
-		if (entryBuf == nullptr) {
-			ASSERT(entryVoice == nullptr);
-			return &entry;
-		}
-	}
-	return nullptr;
-}
-
-void XAudio2::processFrameSe()
-{
-	// poll playing state and release if playing completed
-	for (auto &entry : m_playingSeList) {
-		SeResourcePtr &entryBuf = std::get<0>(entry);
-		SourceVoicePtr &entryVoice = std::get<1>(entry);
-
-		if (entryBuf == nullptr) {
-			ASSERT(entryVoice == nullptr);
-			continue;
-		}
-		// get playing state
-		XAUDIO2_VOICE_STATE state = { 0 };
-		entryVoice->GetState(&state);
-		if (state.BuffersQueued == 0) {
-			// DestroyVoice(), stop playing raw buf, set nullptr
-			entryVoice.reset();
-			// Release reference to raw wave buffer
-			entryBuf.reset();
-		}
-	}
-}
-
-
-XAudio2::BgmResourcePtr XAudio2::loadBgm(const wchar_t *path)
-{
-	auto res = std::make_shared<Bgm>(file::loadFile(path));
-	return res;
-}
-
-void XAudio2::playBgm(const BgmResourcePtr &bgm)
-{
-	int ret = 0;
-	HRESULT hr = S_OK;
-
-	stopBgm();
-
-	// ovinfo
-	vorbis_info *info = ov_info(bgm->ovFp(), -1);
-	if (info == nullptr) {
-		throwTrace<OggVorbisError>("ov_info() failed", 0);
-	}
-	debug::writef(L"ov_info: channels=%d, rate=%ld", info->channels, info->rate);
-	// WAVEFORMAT from ovinfo
-	WAVEFORMATEX format = { 0 };
-	format.wFormatTag = WAVE_FORMAT_PCM;
-	format.nChannels = info->channels;
-	format.nSamplesPerSec = info->rate;
-	format.wBitsPerSample = 16;
-	format.nBlockAlign = info->channels * format.wBitsPerSample / 8;
-	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
-	format.cbSize = 0;
-
-	// create source voice using WAVEFORMAT
-	IXAudio2SourceVoice *ptmpSrcVoice = nullptr;
-	hr = m_pIXAudio->CreateSourceVoice(&ptmpSrcVoice, &format);
-	checkDXResult<XAudioError>(hr, "IXAudio2::CreateSourceVoice() failed");
-	m_pBgmVoice.reset(ptmpSrcVoice);
-
-	// keep reference to ogg bin
-	m_playingBgm = bgm;
-
-	hr = m_pBgmVoice->Start();
-	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::Start() failed");
-
-	debug::writeLine(L"playBgm OK");
-}
-
-void XAudio2::stopBgm()
-{
-	// DestroyVoice(), stop playing, set nullptr
-	m_pBgmVoice.reset();
-	// release reference to ogg bin
-	if (m_playingBgm != nullptr) {
-		OggVorbis_File *fp = m_playingBgm->ovFp();
-		int ret = ::ov_raw_seek(fp, 0);
-		if (ret < 0) {
-			throwTrace<OggVorbisError>("ov_raw_seek() failed", ret);
-		}
-	}
-	m_playingBgm.reset();
-
-	debug::writeLine(L"stopBgm OK");
-}
-
-void XAudio2::processFrameBgm()
-{
-	HRESULT hr = S_OK;
-
-	if (m_pBgmVoice == nullptr) {
-		// not playing
-		return;
-	}
-	ASSERT(m_playingBgm != nullptr);
-
-	XAUDIO2_VOICE_STATE state = { 0 };
-	m_pBgmVoice->GetState(&state);
-	if (state.BuffersQueued >= BgmBufferCount) {
-		// queue is full, do nothing
-		return;
-	}
-
-	// fill m_pBgmBuffer[base:base+BgmBufferSize-1]
-	OggVorbis_File *fp = m_playingBgm->ovFp();
-	uint32_t readSum = 0;
-	uint32_t base = m_writePos * BgmBufferSize;
-	while (BgmBufferSize - readSum >= BgmOvReadSize) {
-		long size = ::ov_read(fp,
-			&m_pBgmBuffer[base + readSum],
-			BgmOvReadSize, 0, 2, 1, nullptr);
-		if (size < 0) {
-			throwTrace<OggVorbisError>("ov_read() failed", size);
-		}
-		readSum += size;
-		if (size == 0) {
-			// stream end; seek to loop point
-			// TODO: loop point
-			int ret = ::ov_raw_seek(fp, 0);
-			if (ret < 0) {
-				throwTrace<OggVorbisError>("ov_raw_seek() failed", ret);
-			}
-		}
-	}
-
-	// submit source buffer (add to queue)
-	XAUDIO2_BUFFER buffer = { 0 };
-	buffer.AudioBytes = static_cast<UINT32>(readSum);
-	buffer.pAudioData = reinterpret_cast<BYTE *>(&m_pBgmBuffer[base]);
-	hr = m_pBgmVoice->SubmitSourceBuffer(&buffer);
-	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::SubmitSourceBuffer() failed");
-	//debug::writeLine(L"push back!");
-
-	m_writePos = (m_writePos + 1) % BgmBufferCount;
-}
-
-
-Bgm::Bgm(file::Bytes &&ovFileBin) :
-	m_ovFileBin(ovFileBin),
-	m_readPos(0)
-{
-	// ovfile open (set m_ovFile)
-	ov_callbacks callbacks = { read, seek, close, tell };
-	int ret = ::ov_open_callbacks(this, &m_ovFile, nullptr, 0, callbacks);
-	if (ret != 0) {
-		throwTrace<OggVorbisError>("ov_open_callbacks() failed", ret);
-	}
-	// auto close at destructor
-	m_ovFp.reset(&m_ovFile);
-}
-
-size_t Bgm::read(void *ptr, size_t size, size_t nmemb, void *datasource)
-{
-	auto *obj = static_cast<Bgm *>(datasource);
-	ASSERT(obj->m_ovFileBin.size() <= file::FileSizeMax);
-	uint32_t totalSize = static_cast<uint32_t>(obj->m_ovFileBin.size());
-	ASSERT(totalSize >= obj->m_readPos);
-	uint32_t remainSize = totalSize - obj->m_readPos;
-	size_t count = std::min(remainSize / size, nmemb);
-	::memcpy(ptr, &obj->m_ovFileBin.data()[obj->m_readPos], size * count);
-	obj->m_readPos += static_cast<uint32_t>(size * count);
-	return count;
-}
-
-int Bgm::seek(void *datasource, int64_t offset, int whence)
-{
-	auto *obj = static_cast<Bgm *>(datasource);
-	ASSERT(offset < file::FileSizeMax);
-	ASSERT(obj->m_ovFileBin.size() <= file::FileSizeMax);
-	uint32_t totalSize = static_cast<uint32_t>(obj->m_ovFileBin.size());
-	switch (whence) {
-	case SEEK_SET:
-		obj->m_readPos = static_cast<uint32_t>(offset);
-		break;
-	case SEEK_CUR:
-		obj->m_readPos += static_cast<uint32_t>(offset);
-		break;
-	case SEEK_END:
-		ASSERT(offset <= 0);
-		obj->m_readPos = static_cast<uint32_t>(totalSize + offset);
-		break;
-	default:
-		return -1;
-	}
-	if (obj->m_readPos > totalSize) {
-		obj->m_readPos = totalSize;
-		return -1;
-	}
-	else if (obj->m_readPos < 0) {
-		obj->m_readPos = 0;
-		return -1;
-	}
-	return 0;
-}
-
-long Bgm::tell(void *datasource)
-{
-	auto *obj = static_cast<Bgm *>(datasource);
-	return obj->m_readPos;
-}
-
-int Bgm::close(void *datasource)
-{
-	auto *obj = static_cast<Bgm *>(datasource);
-	return 0;
-}
-
-}	// namespace sound
-}	// namespace yappy
+﻿#include "stdafx.h"
+#include "include/sound.h"
+#include "include/debug.h"
+#include "include/exceptions.h"
+#include "include/platform.h"
+#include <algorithm>
+#include <cerrno>
+
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+
+namespace yappy {
+namespace sound {
+
+using error::throwTrace;
+using error::checkWin32Result;
+using error::MmioError;
+using error::OggVorbisError;
+using error::checkDXResult;
+using error::XAudioError;
+
+namespace {
+
+void loadWaveFile(SoundEffect *out, const file::FileView &bin)
+{
+	MMIOINFO mmioInfo = { 0 };
+	// read only (MMIO_READ)
+	mmioInfo.pchBuffer = reinterpret_cast<HPSTR>(const_cast<uint8_t *>(bin.data()));
+	mmioInfo.fccIOProc = FOURCC_MEM;
+	mmioInfo.cchBuffer = static_cast<LONG>(bin.size());
+
+	HMMIO tmpHMmio = mmioOpen(0, &mmioInfo, MMIO_READ);
+	if (tmpHMmio == nullptr) {
+		throwTrace<MmioError>("mmioOpen() failed", mmioInfo.wErrorRet);
+	}
+	std::unique_ptr<HMMIO, hmmioDeleter> hMmio(tmpHMmio);
+
+	// enter "WAVE"
+	MMRESULT mmRes = MMSYSERR_NOERROR;
+	MMCKINFO riffChunk = { 0 };
+	riffChunk.fccType = mmioFOURCC('W', 'A', 'V', 'E');
+	mmRes = mmioDescend(hMmio.get(), &riffChunk, nullptr, MMIO_FINDRIFF);
+	if (mmRes != MMSYSERR_NOERROR) {
+		throwTrace<MmioError>("mmioDescend() failed", mmRes);
+	}
+	// enter "fmt "
+	MMCKINFO formatChunk = { 0 };
+	formatChunk.ckid = mmioFOURCC('f', 'm', 't', ' ');
+	mmRes = mmioDescend(hMmio.get(), &formatChunk, &riffChunk, MMIO_FINDCHUNK);
+	if (mmRes != MMSYSERR_NOERROR) {
+		throwTrace<MmioError>("mmioDescend() failed", mmRes);
+	}
+	// read "fmt "
+	::ZeroMemory(&out->format, sizeof(out->format));
+	DWORD fmtSize = std::min(formatChunk.cksize, static_cast<DWORD>(sizeof(out->format)));
+	DWORD size = mmioRead(hMmio.get(), reinterpret_cast<HPSTR>(&out->format), fmtSize);
+	if (size != fmtSize) {
+		throwTrace<MmioError>("mmioRead() failed", size);
+	}
+	// leave "fmt "
+	mmRes = mmioAscend(hMmio.get(), &formatChunk, 0);
+	if (mmRes != MMSYSERR_NOERROR) {
+		throwTrace<MmioError>("mmioAscend() failed", mmRes);
+	}
+	// enter "data"
+	MMCKINFO dataChunk = { 0 };
+	dataChunk.ckid = mmioFOURCC('d', 'a', 't', 'a');
+	mmRes = mmioDescend(hMmio.get(), &dataChunk, &riffChunk, MMIO_FINDCHUNK);
+	if (mmRes != MMSYSERR_NOERROR) {
+		throwTrace<MmioError>("mmioDescend() failed", mmRes);
+	}
+	// read "data"
+	if (dataChunk.cksize > SoundEffectSizeMax) {
+		throwTrace<MmioError>("data size too large", 0);
+	}
+	// refer to the file contents (no copy)
+	if (dataChunk.dwDataOffset > bin.size() ||
+		dataChunk.cksize > bin.size() - dataChunk.dwDataOffset) {
+		throwTrace<MmioError>("data chunk is out of file", 0);
+	}
+	out->samples = bin.subView(dataChunk.dwDataOffset, dataChunk.cksize);
+}
+
+}	// namespace
+
+XAudio2::XAudio2(uint32_t bgmLatencyMs) :
+	m_bgmLatencyMs(bgmLatencyMs),
+	m_bgmCallback(this)
+{
+	debug::writeLine(L"Initializing XAudio2...");
+
+	HRESULT hr = S_OK;
+
+	IXAudio2 *ptmpIXAudio2 = nullptr;
+	UINT32 flags = 0;
+#ifdef _DEBUG
+	flags = XAUDIO2_DEBUG_ENGINE;
+#endif
+	hr = ::XAudio2Create(&ptmpIXAudio2, flags);
+	checkDXResult<XAudioError>(hr, "XAudio2Create() failed");
+	m_pIXAudio.reset(ptmpIXAudio2);
+
+	IXAudio2MasteringVoice *ptmpMasterVoice = nullptr;
+	hr = m_pIXAudio->CreateMasteringVoice(&ptmpMasterVoice);
+	checkDXResult<XAudioError>(hr, "IXAudio2::CreateMasteringVoice() failed");
+	m_pMasterVoice.reset(ptmpMasterVoice);
+
+	// audio thread
+	HANDLE tmphEvent = ::CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	checkWin32Result(tmphEvent != nullptr, "CreateEvent() failed");
+	m_hBgmEvent.reset(tmphEvent);
+	m_bgmThread = std::thread([this]() { bgmThreadMain(); });
+
+	debug::writeLine(L"Initializing XAudio2 OK");
+}
+
+XAudio2::~XAudio2() {
+	{
+		std::lock_guard<std::mutex> lock(m_bgmLock);
+		m_bgmExit = true;
+	}
+	::SetEvent(m_hBgmEvent.get());
+	m_bgmThread.join();
+	// before the queue
+	m_bgmActive.store(false);
+	m_pBgmVoice.reset();
+	debug::writeLine(L"Finalize XAudio2");
+}
+
+void XAudio2::processFrame()
+{
+	processFrameSe();
+	processFrameBgm();
+}
+
+XAudio2::SeResourcePtr XAudio2::loadSoundEffect(const wchar_t *path)
+{
+	return createSoundEffect(file::loadFileView(path));
+}
+
+XAudio2::SeResourcePtr XAudio2::createSoundEffect(file::FileView &&bin)
+{
+	auto res = std::make_shared<SoundEffect>();
+	loadWaveFile(res.get(), bin);
+	return res;
+}
+
+void XAudio2::playSoundEffect(const SeResourcePtr &se)
+{
+	// find playing src voice list entry
+	PyaingSeElem *ppEntry = findFreeSeEntry();
+	if (ppEntry == nullptr) {
+		debug::writeLine("Warning: SE playing list is full!");
+		return;
+	}
+	SeResourcePtr &entryBuf = std::get<0>(*ppEntry);
+	SourceVoicePtr &entryVoice = std::get<1>(*ppEntry);
+	ASSERT(entryBuf == nullptr);
+	ASSERT(entryVoice == nullptr);
+
+	XAUDIO2_BUFFER buffer = { 0 };
+	ASSERT(se->samples.size() <= file::FileSizeMax);
+	buffer.AudioBytes = static_cast<UINT32>(se->samples.size());
+	buffer.pAudioData = se->samples.data();
+	buffer.Flags = XAUDIO2_END_OF_STREAM;
+
+	// create source voice
+	HRESULT hr = S_OK;
+	IXAudio2SourceVoice *ptmpSrcVoice = nullptr;
+	hr = m_pIXAudio->CreateSourceVoice(&ptmpSrcVoice, &se->format);
+	checkDXResult<XAudioError>(hr, "IXAudio2::CreateSourceVoice() failed");
+	SourceVoicePtr pSrcVoice(ptmpSrcVoice);
+
+	// submit source buffer
+	hr = pSrcVoice->SubmitSourceBuffer(&buffer);
+	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::SubmitSourceBuffer() failed");
+	hr = pSrcVoice->Start();
+	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::Start() failed");
+
+	// keep shared_ptr reference in *this 
+	entryBuf = se;
+	// set the source voice element
+	entryVoice = std::move(pSrcVoice);
+}
+
+bool XAudio2::isPlayingAnySoundEffect() const
+{
+	for (const auto &entry : m_playingSeList) {
+		const SeResourcePtr &entryBuf = std::get<0>(entry);
+		const SourceVoicePtr &entryVoice = std::get<1>(entry);
+		if (entryBuf == nullptr) {
+			ASSERT(entryVoice == nullptr);
+			continue;
+		}
+		// check if playing is end
+		XAUDIO2_VOICE_STATE state = { 0 };
+		entryVoice->GetState(&state);
+		if (state.BuffersQueued != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void XAudio2::stopAllSoundEffect()
+{
+	// release SrcVoice, then decrement refcnt of wave buf
+	for (auto &entry : m_playingSeList) {
+		SeResourcePtr &entryBuf = std::get<0>(entry);
+		SourceVoicePtr &entryVoice = std::get<1>(entry);
+		entryVoice.reset();
+		entryBuf.reset();
+	}
+}
+
+XAudio2::PyaingSeElem *XAudio2::findFreeSeEntry()
+{
+	for (auto &entry : m_playingSeList) {
+		SeResourcePtr &entryBuf = std::get<0>(entry);
+		SourceVoicePtr &entryVoice = std::get<1>(entry);
+		if (entryBuf == nullptr) {
+			ASSERT(entryVoice == nullptr);
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+void XAudio2::processFrameSe()
+{
+	// poll playing state and release if playing completed
+	for (auto &entry : m_playingSeList) {
+		SeResourcePtr &entryBuf = std::get<0>(entry);
+		SourceVoicePtr &entryVoice = std::get<1>(entry);
+
+		if (entryBuf == nullptr) {
+			ASSERT(entryVoice == nullptr);
+			continue;
+		}
+		// get playing state
+		XAUDIO2_VOICE_STATE state = { 0 };
+		entryVoice->GetState(&state);
+		if (state.BuffersQueued == 0) {
+			// DestroyVoice(), stop playing raw buf, set nullptr
+			entryVoice.reset();
+			// Release reference to raw wave buffer
+			entryBuf.reset();
+		}
+	}
+}
+
+
+XAudio2::BgmResourcePtr XAudio2::loadBgm(const wchar_t *path)
+{
+	return createBgm(path);
+}
+
+XAudio2::BgmResourcePtr XAudio2::createBgm(const wchar_t *path)
+{
+	auto res = std::make_shared<Bgm>(path);
+	return res;
+}
+
+void XAudio2::playBgm(const BgmResourcePtr &bgm)
+{
+	HRESULT hr = S_OK;
+
+	stopBgm();
+
+	// ovinfo
+	vorbis_info *info = ov_info(bgm->ovFp(), -1);
+	if (info == nullptr) {
+		throwTrace<OggVorbisError>("ov_info() failed", 0);
+	}
+	debug::writef(L"ov_info: channels=%d, rate=%ld", info->channels, info->rate);
+	// WAVEFORMAT from ovinfo
+	WAVEFORMATEX format = { 0 };
+	format.wFormatTag = WAVE_FORMAT_PCM;
+	format.nChannels = info->channels;
+	format.nSamplesPerSec = info->rate;
+	format.wBitsPerSample = 16;
+	format.nBlockAlign = info->channels * format.wBitsPerSample / 8;
+	format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+	format.cbSize = 0;
+
+	// PCM blocks for the latency target
+	uint64_t latencyBytes = static_cast<uint64_t>(format.nAvgBytesPerSec) * m_bgmLatencyMs / 1000;
+	uint32_t blockCount = static_cast<uint32_t>((latencyBytes + BgmBlockSize - 1) / BgmBlockSize);
+	blockCount = std::min(std::max(blockCount, 2u),
+		static_cast<uint32_t>(XAUDIO2_MAX_QUEUED_BUFFERS));
+
+	// new ring (the audio thread may still refer to the old one)
+	auto queue = std::make_shared<BgmQueue>(blockCount);
+
+	std::lock_guard<std::mutex> lock(m_bgmLock);
+	m_bgmQueue = queue;
+	m_bgmRingMs = 1000.0 * BgmBlockSize * blockCount / format.nAvgBytesPerSec;
+
+	// create source voice using WAVEFORMAT
+	IXAudio2SourceVoice *ptmpSrcVoice = nullptr;
+	hr = m_pIXAudio->CreateSourceVoice(&ptmpSrcVoice, &format,
+		0, XAUDIO2_DEFAULT_FREQ_RATIO, &m_bgmCallback);
+	checkDXResult<XAudioError>(hr, "IXAudio2::CreateSourceVoice() failed");
+	m_pBgmVoice.reset(ptmpSrcVoice);
+
+	// keep reference to ogg stream
+	// (rewound by the audio thread when it sees the new generation)
+	m_playingBgm = bgm;
+	m_bgmGeneration++;
+	m_bgmActive.store(true);
+
+	hr = m_pBgmVoice->Start();
+	checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::Start() failed");
+	// first blocks are decoded on the audio thread
+	::SetEvent(m_hBgmEvent.get());
+
+	debug::writef(L"playBgm OK (%u blocks, %.0f ms)", blockCount, m_bgmRingMs);
+}
+
+void XAudio2::stopBgm()
+{
+	std::lock_guard<std::mutex> lock(m_bgmLock);
+	// not an underrun
+	m_bgmActive.store(false);
+	// DestroyVoice(), stop playing, set nullptr
+	// (no voice callback after this)
+	m_pBgmVoice.reset();
+	// the audio thread drops blocks being decoded for the old stream
+	m_bgmGeneration++;
+	m_bgmQueue.reset();
+	// release reference to ogg stream
+	// (the audio thread may release the last one)
+	m_playingBgm.reset();
+	// error of the old stream
+	m_bgmError = nullptr;
+	m_bgmFailed.store(false);
+
+	debug::writeLine(L"stopBgm OK");
+}
+
+BgmStats XAudio2::getBgmStats() const
+{
+	BgmStats stats;
+	stats.decoded = m_bgmDecoded.load();
+	stats.underruns = m_bgmUnderruns.load();
+	// m_pBgmVoice and m_bgmQueue are changed only by the main thread
+	if (m_pBgmVoice != nullptr) {
+		stats.blockCount = static_cast<uint32_t>(m_bgmQueue->ring.capacity());
+		stats.queued = static_cast<uint32_t>(m_bgmQueue->ring.size());
+		stats.latencyMs = m_bgmRingMs;
+	}
+	return stats;
+}
+
+void XAudio2::processFrameBgm()
+{
+	if (!m_bgmFailed.load()) {
+		return;
+	}
+	// decode error on the audio thread
+	std::exception_ptr error;
+	{
+		std::lock_guard<std::mutex> lock(m_bgmLock);
+		error = m_bgmError;
+	}
+	// clears the error
+	stopBgm();
+	if (!error) {
+		// stopped by another stopBgm() or playBgm() already
+		return;
+	}
+	std::rethrow_exception(error);
+}
+
+void XAudio2::bgmThreadMain()
+{
+	platform::setThreadName(L"Audio");
+	// decoding must keep up with the voice, not with the frame
+	::SetThreadPriority(::GetCurrentThread(), THREAD_PRIORITY_ABOVE_NORMAL);
+
+	uint64_t underruns = 0;
+	// generation of the last decoded stream
+	uint64_t decoding = 0;
+	while (true) {
+		// block played, playBgm() or exit
+		::WaitForSingleObject(m_hBgmEvent.get(), INFINITE);
+		// take a snapshot and decode without the lock
+		// (playBgm(), stopBgm() and processFrame() do not wait for file I/O)
+		BgmResourcePtr bgm;
+		std::shared_ptr<BgmQueue> queue;
+		uint64_t generation;
+		{
+			std::lock_guard<std::mutex> lock(m_bgmLock);
+			if (m_bgmExit) {
+				return;
+			}
+			bgm = m_playingBgm;
+			queue = m_bgmQueue;
+			generation = m_bgmGeneration;
+		}
+		if (bgm != nullptr && !m_bgmFailed.load()) {
+			try {
+				if (generation != decoding) {
+					// playBgm() plays from the beginning
+					decoding = generation;
+					rewindBgm(bgm.get());
+				}
+				fillBgm(bgm.get(), queue.get(), generation);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_bgmLock);
+				// ignore errors of a stopped stream
+				if (generation == m_bgmGeneration) {
+					m_bgmError = std::current_exception();
+					m_bgmFailed.store(true);
+				}
+			}
+		}
+		uint64_t count = m_bgmUnderruns.load();
+		if (count != underruns) {
+			debug::writef(L"Warning: BGM underrun (total %llu)",
+				static_cast<unsigned long long>(count));
+			underruns = count;
+		}
+	}
+}
+
+void XAudio2::fillBgm(Bgm *bgm, BgmQueue *queue, uint64_t generation)
+{
+	while (BgmBlock *block = queue->ring.beginWrite()) {
+		// file I/O and decoding
+		block->size = decodeBgm(bgm, block->data);
+
+		std::lock_guard<std::mutex> lock(m_bgmLock);
+		if (generation != m_bgmGeneration) {
+			// stopped or replaced while decoding
+			return;
+		}
+		XAUDIO2_BUFFER buffer = { 0 };
+		buffer.AudioBytes = block->size;
+		buffer.pAudioData = reinterpret_cast<BYTE *>(block->data);
+		// for OnBufferEnd()
+		buffer.pContext = queue;
+		// publish before the voice can release it
+		queue->ring.commitWrite();
+		// submit source buffer (add to queue)
+		HRESULT hr = m_pBgmVoice->SubmitSourceBuffer(&buffer);
+		checkDXResult<XAudioError>(hr, "IXAudio2SourceVoice::SubmitSourceBuffer() failed");
+		m_bgmDecoded.fetch_add(1);
+	}
+}
+
+XAudio2::BgmQueue::BgmQueue(uint32_t blockCount) :
+	ring(blockCount), buffer(new char[BgmBlockSize * blockCount])
+{
+	for (uint32_t i = 0; i < blockCount; i++) {
+		ring.slot(i).data = &buffer[i * BgmBlockSize];
+	}
+}
+
+void XAudio2::BgmVoiceCallback::OnBufferEnd(void *pBufferContext)
+{
+	// blocks are played in submission order
+	auto *queue = static_cast<BgmQueue *>(pBufferContext);
+	queue->ring.pop();
+	if (m_owner->m_bgmActive.load() && queue->ring.size() == 0) {
+		// nothing queued, the voice plays silence
+		m_owner->m_bgmUnderruns.fetch_add(1);
+	}
+	::SetEvent(m_owner->m_hBgmEvent.get());
+}
+
+uint32_t XAudio2::decodeBgm(Bgm *bgm, char *dst)
+{
+	OggVorbis_File *fp = bgm->ovFp();
+	uint32_t readSum = 0;
+	while (BgmBlockSize - readSum >= BgmOvReadSize) {
+		long size = ::ov_read(fp,
+			&dst[readSum],
+			BgmOvReadSize, 0, 2, 1, nullptr);
+		bgm->checkStreamError();
+		if (size < 0) {
+			throwTrace<OggVorbisError>("ov_read() failed", size);
+		}
+		readSum += size;
+		if (size == 0) {
+			// stream end; seek to loop point
+			// TODO: loop point
+			rewindBgm(bgm);
+		}
+	}
+	return readSum;
+}
+
+void XAudio2::rewindBgm(Bgm *bgm)
+{
+	int ret = ::ov_raw_seek(bgm->ovFp(), 0);
+	bgm->checkStreamError();
+	if (ret < 0) {
+		throwTrace<OggVorbisError>("ov_raw_seek() failed", ret);
+	}
+}
+
+
+Bgm::Bgm(const wchar_t *path) :
+	m_stream(path)
+{
+	// ovfile open (set m_ovFile)
+	ov_callbacks callbacks = { read, seek, close, tell };
+	int ret = ::ov_open_callbacks(this, &m_ovFile, nullptr, 0, callbacks);
+	if (ret != 0) {
+		// I/O error is more specific
+		checkStreamError();
+		throwTrace<OggVorbisError>("ov_open_callbacks() failed", ret);
+	}
+	// auto close at destructor
+	m_ovFp.reset(&m_ovFile);
+	checkStreamError();
+}
+
+void Bgm::checkStreamError()
+{
+	if (m_streamError) {
+		std::exception_ptr error;
+		std::swap(error, m_streamError);
+		std::rethrow_exception(error);
+	}
+}
+
+size_t Bgm::read(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+	auto *obj = static_cast<Bgm *>(datasource);
+	if (size == 0) {
+		return 0;
+	}
+	try {
+		// vorbisfile reads by size == 1
+		return obj->m_stream.read(ptr, size * nmemb) / size;
+	}
+	catch (...) {
+		// vorbisfile: 0 and errno != 0 is a read error
+		obj->m_streamError = std::current_exception();
+		errno = EIO;
+		return 0;
+	}
+}
+
+int Bgm::seek(void *datasource, int64_t offset, int whence)
+{
+	auto *obj = static_cast<Bgm *>(datasource);
+	const int64_t totalSize = static_cast<int64_t>(obj->m_stream.size());
+	int64_t pos = 0;
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = static_cast<int64_t>(obj->m_stream.tell()) + offset;
+		break;
+	case SEEK_END:
+		pos = totalSize + offset;
+		break;
+	default:
+		return -1;
+	}
+	if (pos < 0 || pos > totalSize) {
+		return -1;
+	}
+	try {
+		obj->m_stream.seek(static_cast<uint64_t>(pos));
+	}
+	catch (...) {
+		obj->m_streamError = std::current_exception();
+		return -1;
+	}
+	return 0;
+}
+
+long Bgm::tell(void *datasource)
+{
+	auto *obj = static_cast<Bgm *>(datasource);
+	try {
+		return static_cast<long>(obj->m_stream.tell());
+	}
+	catch (...) {
+		obj->m_streamError = std::current_exception();
+		return -1;
+	}
+}
+
+int Bgm::close(void *datasource)
+{
+	auto *obj = static_cast<Bgm *>(datasource);
+	return 0;
+}
+
+}	// namespace sound
+}	// namespace yappy
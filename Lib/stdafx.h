@@ -1,24 +1,26 @@
-﻿// stdafx.h : include file for standard system include files,
-// or project specific include files that are used frequently, but
-// are changed infrequently
-//
-
-#pragma once
-
-#include "targetver.h"
-
-#define NOMINMAX
-#include <WinSock2.h>
-#include <mmsystem.h>
-#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
-#include <windows.h>
-#include <xaudio2.h>
-
-#include <stdexcept>
-#include <memory>
-#include <regex>
-#include <string>
-#include <vector>
-#include <map>
-#include <unordered_map>
-#include <algorithm>
+﻿// stdafx.h : include file for standard system include files,
+// or project specific include files that are used frequently, but
+// are changed infrequently
+//
+
+#pragma once
+
+#ifdef _WIN32
+#include "targetver.h"
+
+#define NOMINMAX
+#include <WinSock2.h>
+#include <mmsystem.h>
+#define WIN32_LEAN_AND_MEAN             // Exclude rarely-used stuff from Windows headers
+#include <windows.h>
+#include <xaudio2.h>
+#endif
+
+#include <stdexcept>
+#include <memory>
+#include <regex>
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <algorithm>
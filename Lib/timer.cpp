@@ -0,0 +1,388 @@
+﻿#include "stdafx.h"
+#include "include/timer.h"
+#include "include/exceptions.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+#include <mmsystem.h>
+#pragma comment(lib, "winmm.lib")
+#else
+#include <time.h>
+#include <errno.h>
+#if defined(__i386__) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+#endif
+
+namespace yappy {
+namespace timer {
+
+using error::throwTrace;
+
+///////////////////////////////////////////////////////////////////////////////
+// class SystemClock impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region SystemClock
+
+#ifdef _WIN32
+
+using error::checkWin32Result;
+
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+SystemClock::SystemClock()
+{
+	// counter/sec
+	LARGE_INTEGER freq;
+	BOOL b = ::QueryPerformanceFrequency(&freq);
+	checkWin32Result(b != 0, "QueryPerformanceFrequency() failed");
+	m_freq = freq.QuadPart;
+
+	// Windows 10 1803 or later
+	HANDLE hTimer = ::CreateWaitableTimerExW(nullptr, nullptr,
+		CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+	if (hTimer == nullptr) {
+		// older OS: normal timer + 1ms system timer resolution
+		hTimer = ::CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+		checkWin32Result(hTimer != nullptr, "CreateWaitableTimerEx() failed");
+		m_timePeriod = (::timeBeginPeriod(1) == TIMERR_NOERROR);
+	}
+	m_hTimer.reset(hTimer);
+}
+
+SystemClock::~SystemClock()
+{
+	if (m_timePeriod) {
+		::timeEndPeriod(1);
+	}
+}
+
+int64_t SystemClock::getCounter() const
+{
+	LARGE_INTEGER cur;
+	BOOL b = ::QueryPerformanceCounter(&cur);
+	checkWin32Result(b != 0, "QueryPerformanceCounter() failed");
+	return cur.QuadPart;
+}
+
+void SystemClock::sleepFor(int64_t counter)
+{
+	// 100ns unit, negative value means relative time
+	LARGE_INTEGER due;
+	due.QuadPart = -static_cast<LONGLONG>(
+		static_cast<double>(counter) * 10000000 / m_freq);
+	if (due.QuadPart >= 0) {
+		return;
+	}
+	BOOL b = ::SetWaitableTimer(m_hTimer.get(), &due, 0, nullptr, nullptr, FALSE);
+	checkWin32Result(b != 0, "SetWaitableTimer() failed");
+	DWORD ret = ::WaitForSingleObject(m_hTimer.get(), INFINITE);
+	checkWin32Result(ret == WAIT_OBJECT_0, "WaitForSingleObject() failed");
+}
+
+void SystemClock::relax()
+{
+	YieldProcessor();
+}
+
+#else
+
+SystemClock::SystemClock() :
+	m_freq(1000 * 1000 * 1000)
+{}
+
+SystemClock::~SystemClock()
+{}
+
+int64_t SystemClock::getCounter() const
+{
+	timespec ts;
+	if (::clock_gettime(CLOCK_MONOTONIC, &ts) != 0) {
+		throwTrace<std::runtime_error>("clock_gettime() failed");
+	}
+	return static_cast<int64_t>(ts.tv_sec) * m_freq + ts.tv_nsec;
+}
+
+void SystemClock::sleepFor(int64_t counter)
+{
+	if (counter <= 0) {
+		return;
+	}
+	timespec req;
+	req.tv_sec = static_cast<time_t>(counter / m_freq);
+	req.tv_nsec = static_cast<long>(counter % m_freq);
+	// restart with the remaining time if interrupted by a signal
+	int ret;
+	while ((ret = ::clock_nanosleep(CLOCK_MONOTONIC, 0, &req, &req)) == EINTR);
+	if (ret != 0) {
+		throwTrace<std::runtime_error>("clock_nanosleep() failed");
+	}
+}
+
+void SystemClock::relax()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	_mm_pause();
+#endif
+}
+
+#endif
+
+int64_t SystemClock::getFrequency() const
+{
+	return m_freq;
+}
+
+#pragma endregion
+
+///////////////////////////////////////////////////////////////////////////////
+// class PreciseWaiter impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region PreciseWaiter
+
+PreciseWaiter::PreciseWaiter(Clock &clock, const WaitParam &param) :
+	m_clock(clock), m_param(param)
+{
+	int64_t freq = m_clock.getFrequency();
+	auto usToCounter = [freq](uint32_t us) {
+		return freq * us / (1000 * 1000);
+	};
+	m_slack = usToCounter(param.slackUs);
+	m_minSlack = usToCounter(param.minSlackUs);
+	m_maxSlack = usToCounter(param.maxSlackUs);
+	// start from the configured value
+	m_overMean = static_cast<double>(m_slack);
+}
+
+int64_t PreciseWaiter::waitUntil(int64_t target)
+{
+	int64_t cur = m_clock.getCounter();
+
+	// coarse sleep until (target - slack)
+	if (m_param.policy != SlackPolicy::SpinOnly) {
+		int64_t slack = (m_param.policy == SlackPolicy::SleepOnly) ? 0 : m_slack;
+		int64_t sleepTime = target - slack - cur;
+		if (sleepTime > 0) {
+			m_clock.sleepFor(sleepTime);
+			int64_t after = m_clock.getCounter();
+			if (m_param.policy == SlackPolicy::Adaptive) {
+				updateSlack(after - (cur + sleepTime));
+			}
+			cur = after;
+		}
+	}
+	// spin for the rest
+	// (SleepOnly: only if the timer woke up a little bit early)
+	while (cur < target) {
+		m_clock.relax();
+		cur = m_clock.getCounter();
+	}
+	return cur;
+}
+
+void PreciseWaiter::updateSlack(int64_t overshoot)
+{
+	// exponentially weighted mean and variance
+	const double Alpha = 1.0 / 16.0;
+	double x = static_cast<double>(std::max<int64_t>(overshoot, 0));
+	double diff = x - m_overMean;
+	m_overMean += Alpha * diff;
+	m_overVar = (1.0 - Alpha) * (m_overVar + Alpha * diff * diff);
+
+	// mean + 3 sigma
+	auto slack = static_cast<int64_t>(m_overMean + 3.0 * std::sqrt(m_overVar));
+	m_slack = std::min(std::max(slack, m_minSlack), m_maxSlack);
+}
+
+#pragma endregion
+
+namespace {
+
+// nearest-rank method
+inline size_t percentileIndex(size_t n, double p)
+{
+	size_t rank = static_cast<size_t>(std::ceil(p * n));
+	return std::max<size_t>(rank, 1) - 1;
+}
+
+}	// namespace
+
+void calcFrameJitter(FrameJitter *out,
+	const std::vector<int64_t> &samples, int64_t freq)
+{
+	*out = FrameJitter();
+	if (samples.empty()) {
+		return;
+	}
+	const double toMs = 1000.0 / freq;
+	const size_t n = samples.size();
+
+	double sum = 0.0;
+	for (int64_t t : samples) {
+		sum += static_cast<double>(t);
+	}
+	double mean = sum / n;
+	double sqSum = 0.0;
+	for (int64_t t : samples) {
+		double d = static_cast<double>(t) - mean;
+		sqSum += d * d;
+	}
+
+	std::vector<int64_t> sorted(samples);
+	size_t p99 = percentileIndex(n, 0.99);
+	std::nth_element(sorted.begin(), sorted.begin() + p99, sorted.end());
+
+	out->meanMs = mean * toMs;
+	out->stddevMs = std::sqrt(sqSum / n) * toMs;
+	out->p99Ms = sorted[p99] * toMs;
+	out->maxMs = *std::max_element(samples.begin(), samples.end()) * toMs;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// class FrameTimeRing impl
+///////////////////////////////////////////////////////////////////////////////
+#pragma region FrameTimeRing
+
+namespace {
+
+void calcPercentiles(Percentiles *out, std::vector<int64_t> *values, int64_t freq)
+{
+	*out = Percentiles();
+	if (values->empty()) {
+		return;
+	}
+	const double toMs = 1000.0 / freq;
+	const size_t n = values->size();
+	std::sort(values->begin(), values->end());
+	out->p50Ms = (*values)[percentileIndex(n, 0.50)] * toMs;
+	out->p95Ms = (*values)[percentileIndex(n, 0.95)] * toMs;
+	out->p99Ms = (*values)[percentileIndex(n, 0.99)] * toMs;
+	out->maxMs = values->back() * toMs;
+}
+
+// Slot::seq value after frame[index] has been written
+inline uint32_t stableSeq(uint64_t index)
+{
+	return static_cast<uint32_t>(index * 2 + 2);
+}
+
+}	// namespace
+
+FrameTimeRing::FrameTimeRing(int64_t freq) :
+	m_freq(freq), m_count(0)
+{
+	for (auto &slot : m_slots) {
+		slot.seq.store(0);
+		slot.update.store(0);
+		slot.render.store(0);
+		slot.present.store(0);
+		slot.idle.store(0);
+		slot.wait.store(0);
+		slot.total.store(0);
+	}
+}
+
+void FrameTimeRing::push(const FrameTimeSample &sample)
+{
+	uint64_t index = m_count.load(std::memory_order_relaxed);
+	Slot &slot = m_slots[index % Capacity];
+
+	// odd: being written
+	slot.seq.store(stableSeq(index) - 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.update.store(sample.update, std::memory_order_relaxed);
+	slot.render.store(sample.render, std::memory_order_relaxed);
+	slot.present.store(sample.present, std::memory_order_relaxed);
+	slot.idle.store(sample.idle, std::memory_order_relaxed);
+	slot.wait.store(sample.wait, std::memory_order_relaxed);
+	slot.total.store(sample.total, std::memory_order_relaxed);
+	// even: stable
+	slot.seq.store(stableSeq(index), std::memory_order_release);
+
+	m_count.store(index + 1, std::memory_order_release);
+}
+
+uint64_t FrameTimeRing::getCount() const
+{
+	return m_count.load(std::memory_order_acquire);
+}
+
+void FrameTimeRing::copyLatest(std::vector<FrameTimeSample> *out, uint32_t count) const
+{
+	out->clear();
+	uint64_t end = m_count.load(std::memory_order_acquire);
+	if (count > Capacity) {
+		count = Capacity;
+	}
+	uint64_t begin = (end > count) ? end - count : 0;
+	out->reserve(static_cast<size_t>(end - begin));
+
+	for (uint64_t i = begin; i < end; i++) {
+		const Slot &slot = m_slots[i % Capacity];
+		uint32_t seq1 = slot.seq.load(std::memory_order_acquire);
+		FrameTimeSample sample;
+		sample.update = slot.update.load(std::memory_order_relaxed);
+		sample.render = slot.render.load(std::memory_order_relaxed);
+		sample.present = slot.present.load(std::memory_order_relaxed);
+		sample.idle = slot.idle.load(std::memory_order_relaxed);
+		sample.wait = slot.wait.load(std::memory_order_relaxed);
+		sample.total = slot.total.load(std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint32_t seq2 = slot.seq.load(std::memory_order_relaxed);
+		// overwritten by a newer frame while reading
+		if (seq1 != stableSeq(i) || seq2 != stableSeq(i)) {
+			continue;
+		}
+		out->push_back(sample);
+	}
+}
+
+void FrameTimeRing::getStats(FrameTimeStats *out, uint32_t window) const
+{
+	std::vector<FrameTimeSample> samples;
+	copyLatest(&samples, window);
+
+	*out = FrameTimeStats();
+	out->frames = static_cast<uint32_t>(samples.size());
+
+	std::vector<int64_t> values(samples.size());
+	auto calc = [this, &samples, &values](Percentiles *res,
+		int64_t FrameTimeSample::*field) {
+		for (size_t i = 0; i < samples.size(); i++) {
+			values[i] = samples[i].*field;
+		}
+		calcPercentiles(res, &values, m_freq);
+	};
+	calc(&out->update, &FrameTimeSample::update);
+	calc(&out->render, &FrameTimeSample::render);
+	calc(&out->present, &FrameTimeSample::present);
+	calc(&out->idle, &FrameTimeSample::idle);
+	calc(&out->wait, &FrameTimeSample::wait);
+	calc(&out->total, &FrameTimeSample::total);
+}
+
+void FrameTimeRing::getHistogram(std::vector<uint32_t> *out,
+	double binMs, uint32_t binCount, uint32_t window) const
+{
+	out->assign(binCount, 0);
+	if (binCount == 0) {
+		return;
+	}
+	std::vector<FrameTimeSample> samples;
+	copyLatest(&samples, window);
+
+	const double toMs = 1000.0 / m_freq;
+	for (const auto &sample : samples) {
+		double ms = sample.total * toMs;
+		size_t bin = static_cast<size_t>(ms / binMs);
+		(*out)[std::min<size_t>(bin, binCount - 1)]++;
+	}
+}
+
+#pragma endregion
+
+}	// namespace timer
+}	// namespace yappy
@@ -0,0 +1,212 @@
+﻿// Tests.cpp : Unit tests of the platform independent core.
+//
+// Tests [<suite>]
+// Runs all test cases, or the cases of one suite.
+// Exit code is 1 if any case fails.
+
+#include "test.h"
+#include <platform.h>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace test {
+
+namespace {
+
+int s_failCount = 0;
+
+std::string toUtf8(const std::wstring &str)
+{
+	std::string result(str.size() * 4 + 1, '\0');
+	size_t len = yappy::platform::wcToUtf8(str.c_str(), &result[0], result.size());
+	result.resize(len);
+	return result;
+}
+
+bool makeDir(const std::wstring &path)
+{
+#ifdef _WIN32
+	return _wmkdir(path.c_str()) == 0;
+#else
+	return ::mkdir(toUtf8(path).c_str(), 0755) == 0;
+#endif
+}
+
+bool removeDir(const std::wstring &path)
+{
+#ifdef _WIN32
+	return _wrmdir(path.c_str()) == 0;
+#else
+	return ::rmdir(toUtf8(path).c_str()) == 0;
+#endif
+}
+
+bool removeFile(const std::wstring &path)
+{
+#ifdef _WIN32
+	return _wremove(path.c_str()) == 0;
+#else
+	return std::remove(toUtf8(path).c_str()) == 0;
+#endif
+}
+
+void removeTree(const std::wstring &dir)
+{
+	std::vector<std::pair<std::wstring, bool>> children;
+	yappy::platform::listDirectory(dir.c_str(),
+		[&children](const wchar_t *name, bool isDirectory) {
+			children.emplace_back(name, isDirectory);
+		});
+	for (const auto &child : children) {
+		std::wstring path = dir + L'/' + child.first;
+		if (child.second) {
+			removeTree(path);
+		}
+		else {
+			removeFile(path);
+		}
+	}
+	removeDir(dir);
+}
+
+}	// namespace
+
+std::vector<Case> &getCases()
+{
+	static std::vector<Case> cases;
+	return cases;
+}
+
+void fail(const char *file, int line, const std::string &msg)
+{
+	std::printf("  %s(%d): %s\n", file, line, msg.c_str());
+	s_failCount++;
+}
+
+std::vector<uint8_t> randomBytes(size_t size, uint32_t seed)
+{
+	std::vector<uint8_t> data(size);
+	uint32_t x = seed != 0 ? seed : 2463534242u;
+	for (auto &b : data) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		b = static_cast<uint8_t>(x >> 24);
+	}
+	return data;
+}
+
+std::vector<uint8_t> textBytes(size_t size, uint32_t seed)
+{
+	static const char *const Words[] = {
+		"sprite", "texture", "font", "sound", "script", "frame", "scene", "load",
+		"draw", "update", "=", "(", ")", "{", "}", ";", "\n", "\t", "0", "1",
+	};
+	const size_t wordCount = sizeof(Words) / sizeof(Words[0]);
+	std::vector<uint8_t> data;
+	data.reserve(size + 16);
+	uint32_t x = seed != 0 ? seed : 2463534242u;
+	while (data.size() < size) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		const char *word = Words[x % wordCount];
+		data.insert(data.end(), word, word + std::strlen(word));
+		data.push_back(' ');
+	}
+	data.resize(size);
+	return data;
+}
+
+std::vector<uint8_t> readFile(const std::wstring &path)
+{
+	auto file = yappy::platform::FileHandle::openRead(path.c_str());
+	std::vector<uint8_t> data(static_cast<size_t>(file.getSize()));
+	if (!data.empty()) {
+		file.read(data.data(), data.size());
+	}
+	return data;
+}
+
+void writeFile(const std::wstring &path, const std::vector<uint8_t> &data)
+{
+	auto file = yappy::platform::FileHandle::createWrite(path.c_str());
+	if (!data.empty()) {
+		file.write(data.data(), data.size());
+	}
+}
+
+TempDir::TempDir()
+{
+	// unique name from a temporary file, replaced by a directory
+	m_path = yappy::platform::createTempFile(L"yts");
+	removeFile(m_path);
+	if (!makeDir(m_path)) {
+		throw std::runtime_error("Cannot create temporary directory");
+	}
+}
+
+TempDir::~TempDir()
+{
+	removeTree(m_path);
+}
+
+void TempDir::createDir(const std::wstring &name)
+{
+	size_t pos = 0;
+	while (pos != std::wstring::npos) {
+		pos = name.find(L'/', pos + 1);
+		makeDir(m_path + L'/' + name.substr(0, pos));
+	}
+}
+
+void TempDir::writeFile(const std::wstring &name, const std::vector<uint8_t> &data)
+{
+	size_t sep = name.rfind(L'/');
+	if (sep != std::wstring::npos) {
+		createDir(name.substr(0, sep));
+	}
+	test::writeFile(m_path + L'/' + name, data);
+}
+
+}	// namespace test
+
+int main(int argc, char *argv[])
+{
+	const char *suite = argc >= 2 ? argv[1] : nullptr;
+	int run = 0;
+	int failed = 0;
+	for (const auto &c : test::getCases()) {
+		if (suite != nullptr && std::strcmp(suite, c.suite) != 0) {
+			continue;
+		}
+		std::printf("[ RUN  ] %s.%s\n", c.suite, c.name);
+		std::fflush(stdout);
+		int before = test::s_failCount;
+		try {
+			c.func();
+		}
+		catch (const std::exception &e) {
+			test::fail(__FILE__, __LINE__, std::string("exception: ") + e.what());
+		}
+		catch (...) {
+			test::fail(__FILE__, __LINE__, "unknown exception");
+		}
+		bool ok = test::s_failCount == before;
+		std::printf("[%s] %s.%s\n", ok ? "  OK  " : " FAIL ", c.suite, c.name);
+		run++;
+		failed += ok ? 0 : 1;
+	}
+	std::printf("%d cases, %d failed\n", run, failed);
+	return (run == 0 || failed != 0) ? 1 : 0;
+}
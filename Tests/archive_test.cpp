@@ -0,0 +1,403 @@
+﻿// archive_test.cpp : createArchive() and the archive index parser.
+
+#include "test.h"
+#include <exceptions.h>
+#include <file.h>
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+using namespace yappy;
+
+namespace {
+
+// archive file layout (file.cpp)
+const size_t HeaderSize = 48;
+const size_t HeaderVersion = 4;
+const size_t HeaderEntryCount = 12;
+const size_t HeaderIndexOffset = 16;
+const size_t HeaderNameOffset = 24;
+const size_t HeaderCrcOffset = 32;
+const size_t EntrySize = 40;
+const size_t EntryOffset = 8;
+const size_t EntryRawSize = 16;
+const size_t EntryStoredSize = 20;
+const size_t EntryNameOffset = 24;
+const size_t EntryNameSize = 28;
+const size_t EntryFlags = 30;
+const size_t EntryCrcIndex = 32;
+
+template <class T>
+T get(const std::vector<uint8_t> &data, size_t pos)
+{
+	T value;
+	std::memcpy(&value, &data.at(pos), sizeof(T));
+	return value;
+}
+
+template <class T>
+void put(std::vector<uint8_t> &data, size_t pos, T value)
+{
+	std::memcpy(&data.at(pos), &value, sizeof(T));
+}
+
+// file offset of the index entry of name
+size_t findEntry(const std::vector<uint8_t> &data, const std::string &name)
+{
+	uint32_t count = get<uint32_t>(data, HeaderEntryCount);
+	uint64_t index = get<uint64_t>(data, HeaderIndexOffset);
+	uint64_t names = get<uint64_t>(data, HeaderNameOffset);
+	for (uint32_t i = 0; i < count; i++) {
+		size_t entry = static_cast<size_t>(index + EntrySize * i);
+		size_t nameOffset = static_cast<size_t>(names + get<uint32_t>(data, entry + EntryNameOffset));
+		size_t nameSize = get<uint16_t>(data, entry + EntryNameSize);
+		if (name.compare(0, std::string::npos,
+				reinterpret_cast<const char *>(&data.at(nameOffset)), nameSize) == 0) {
+			return entry;
+		}
+	}
+	return 0;
+}
+
+// exception message of opening the archive ("" if succeeded)
+std::string openError(const std::wstring &archive)
+{
+	std::string msg;
+	try {
+		file::initWithArchiveFile(archive.c_str());
+	}
+	catch (const error::FrameworkError &e) {
+		msg = e.what();
+	}
+	// release the mapping
+	file::initWithFileSystem(L".");
+	return msg;
+}
+
+bool contains(const std::string &str, const char *part)
+{
+	return str.find(part) != std::string::npos;
+}
+
+// source tree with small, block boundary, large, empty and random files
+class Sample {
+public:
+	Sample()
+	{
+		m_small = test::textBytes(1000, 1);
+		m_large = test::textBytes(3 * file::ArchiveBlockSize + 123, 2);
+		m_exact = test::textBytes(file::ArchiveBlockSize, 3);
+		m_random = test::randomBytes(file::ArchiveBlockSize + 7, 4);
+		m_dir.writeFile(L"small.txt", m_small);
+		m_dir.writeFile(L"Sub/Large.txt", m_large);
+		m_dir.writeFile(L"sub/deep/exact.bin", m_exact);
+		m_dir.writeFile(L"random.bin", m_random);
+		m_dir.writeFile(L"empty.bin", {});
+	}
+
+	test::TempDir m_dir;
+	std::vector<uint8_t> m_small, m_large, m_exact, m_random;
+};
+
+// archive of Sample (out of the source tree)
+class SampleArchive {
+public:
+	explicit SampleArchive(bool compress) :
+		m_path(m_out.path() + L"/test.pak")
+	{
+		m_files = file::createArchive(m_path.c_str(), m_src.m_dir.path().c_str(), compress);
+		m_data = test::readFile(m_path);
+	}
+	~SampleArchive()
+	{
+		file::initWithFileSystem(L".");
+	}
+
+	// write modified archive to another file
+	std::wstring write(const std::vector<uint8_t> &data)
+	{
+		std::wstring path = m_out.path() + L"/broken.pak";
+		test::writeFile(path, data);
+		return path;
+	}
+
+	Sample m_src;
+	test::TempDir m_out;
+	std::wstring m_path;
+	uint32_t m_files = 0;
+	std::vector<uint8_t> m_data;
+};
+
+void checkRoundTrip(bool compress)
+{
+	SampleArchive ar(compress);
+	CHECK(ar.m_files == 5);
+	file::initWithArchiveFile(ar.m_path.c_str());
+
+	CHECK(file::loadFile(L"small.txt") == ar.m_src.m_small);
+	CHECK(file::loadFile(L"sub/large.txt") == ar.m_src.m_large);
+	CHECK(file::loadFile(L"sub/deep/exact.bin") == ar.m_src.m_exact);
+	CHECK(file::loadFile(L"random.bin") == ar.m_src.m_random);
+	CHECK(file::loadFile(L"empty.bin").empty());
+	// case and separator insensitive
+	CHECK(file::loadFile(L"SUB\\Large.TXT") == ar.m_src.m_large);
+	CHECK(file::getFileSize(L"sub/large.txt") == ar.m_src.m_large.size());
+
+	file::FileView view = file::loadFileView(L"sub/large.txt");
+	CHECK(view.size() == ar.m_src.m_large.size() &&
+		std::memcmp(view.data(), ar.m_src.m_large.data(), view.size()) == 0);
+
+	// across a block boundary
+	const auto &large = ar.m_src.m_large;
+	const size_t offset = file::ArchiveBlockSize - 100;
+	file::Bytes range = file::loadFileRange(L"sub/large.txt", offset, 300);
+	CHECK(range == file::Bytes(large.begin() + offset, large.begin() + offset + 300));
+	// clipped at the end
+	range = file::loadFileRange(L"sub/large.txt", large.size() - 10, 100);
+	CHECK(range == file::Bytes(large.end() - 10, large.end()));
+	CHECK(file::loadFileRange(L"sub/large.txt", large.size() + 10, 100).empty());
+
+	CHECK_THROWS(file::loadFile(L"missing.txt"), error::FrameworkError);
+	CHECK_THROWS(file::loadFile(L"sub/large.tx"), error::FrameworkError);
+}
+
+}	// namespace
+
+TEST_CASE(archive, roundTripCompressed)
+{
+	checkRoundTrip(true);
+}
+
+TEST_CASE(archive, roundTripStored)
+{
+	checkRoundTrip(false);
+}
+
+TEST_CASE(archive, sortedHashLookup)
+{
+	test::TempDir src;
+	const int FileCount = 500;
+	for (int i = 0; i < FileCount; i++) {
+		std::wstring name = L"d" + std::to_wstring(i % 7) + L"/f" + std::to_wstring(i) + L".dat";
+		src.writeFile(name, test::textBytes(16 + i, i + 1));
+	}
+	test::TempDir out;
+	std::wstring path = out.path() + L"/lookup.pak";
+	CHECK(file::createArchive(path.c_str(), src.path().c_str()) == FileCount);
+
+	// index is sorted by hash
+	std::vector<uint8_t> data = test::readFile(path);
+	CHECK(get<uint32_t>(data, HeaderEntryCount) == FileCount);
+	uint64_t index = get<uint64_t>(data, HeaderIndexOffset);
+	for (int i = 1; i < FileCount; i++) {
+		CHECK(get<uint64_t>(data, static_cast<size_t>(index + EntrySize * (i - 1))) <=
+			get<uint64_t>(data, static_cast<size_t>(index + EntrySize * i)));
+	}
+
+	file::initWithArchiveFile(path.c_str());
+	for (int i = 0; i < FileCount; i++) {
+		std::wstring name = L"d" + std::to_wstring(i % 7) + L"/f" + std::to_wstring(i) + L".dat";
+		CHECK(file::loadFile(name.c_str()) == test::textBytes(16 + i, i + 1));
+		// same hash bucket neighbours are not matched
+		std::wstring other = L"d" + std::to_wstring((i + 1) % 7) + L"/f" + std::to_wstring(i) + L".dat";
+		CHECK_THROWS(file::getFileSize(other.c_str()), error::FrameworkError);
+	}
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(archive, verify)
+{
+	SampleArchive ar(true);
+	file::VerifyResult result = file::verifyArchive(ar.m_path.c_str());
+	CHECK(result.files == 5);
+	CHECK(result.blocks > 0);
+	CHECK(result.badFiles.empty());
+}
+
+TEST_CASE(archive, traceReplay)
+{
+	test::TempDir src;
+	uint64_t bytes = 0;
+	for (int i = 0; i < 20; i++) {
+		std::wstring name = L"d" + std::to_wstring(i % 3) + L"/f" + std::to_wstring(i) + L".dat";
+		src.writeFile(name, test::textBytes(1000 + i, i + 1));
+		bytes += (i % 2 == 0) ? 1000 + i : 0;
+	}
+	// even files in reverse, and a deleted file
+	std::string trace = "d0/none.dat\n";
+	for (int i = 18; i >= 0; i -= 2) {
+		trace += "d" + std::to_string(i % 3) + "/f" + std::to_string(i) + ".dat\n";
+	}
+	test::TempDir out;
+	const std::wstring tracePath = out.path() + L"/trace.txt";
+	test::writeFile(tracePath, std::vector<uint8_t>(trace.begin(), trace.end()));
+	const std::wstring namePath = out.path() + L"/name.pak";
+	const std::wstring tracedPath = out.path() + L"/traced.pak";
+	CHECK(file::createArchive(namePath.c_str(), src.path().c_str()) == 20);
+	CHECK(file::createArchive(tracedPath.c_str(), src.path().c_str(), true, tracePath.c_str()) == 20);
+
+	file::TraceReplayResult result = file::benchmarkTraceReplay(
+		namePath.c_str(), tracedPath.c_str(), tracePath.c_str());
+	CHECK(result.files == 10);
+	CHECK(result.bytes == bytes);
+	CHECK(result.nameOrderMs > 0.0 && result.traceOrderMs > 0.0);
+	CHECK(result.cold);
+
+	// not the same files
+	test::TempDir other;
+	other.writeFile(L"d0/f0.dat", test::textBytes(1000, 1));
+	const std::wstring otherPath = out.path() + L"/other.pak";
+	file::createArchive(otherPath.c_str(), other.path().c_str());
+	CHECK_THROWS(file::benchmarkTraceReplay(
+		namePath.c_str(), otherPath.c_str(), tracePath.c_str()), error::FrameworkError);
+}
+
+TEST_CASE(archive, rejectHeader)
+{
+	SampleArchive ar(true);
+	CHECK(openError(ar.m_path).empty());
+
+	std::vector<uint8_t> data(ar.m_data.begin(), ar.m_data.begin() + HeaderSize - 1);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: header"));
+	CHECK(contains(openError(ar.write({})), "Broken archive: header"));
+
+	data = ar.m_data;
+	data[0] = 'X';
+	CHECK(contains(openError(ar.write(data)), "Not an archive file"));
+
+	data = ar.m_data;
+	put<uint32_t>(data, HeaderVersion, 2);
+	CHECK(contains(openError(ar.write(data)), "Unsupported archive version"));
+
+	data = ar.m_data;
+	put<uint32_t>(data, HeaderEntryCount, 0x10000000);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: index"));
+
+	data = ar.m_data;
+	put<uint64_t>(data, HeaderIndexOffset, get<uint64_t>(data, HeaderIndexOffset) + 4);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: index"));
+
+	data = ar.m_data;
+	put<uint64_t>(data, HeaderIndexOffset, ~0ull - 7);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: index"));
+
+	data = ar.m_data;
+	put<uint64_t>(data, HeaderNameOffset, data.size() + 1);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: index"));
+
+	data = ar.m_data;
+	put<uint64_t>(data, HeaderCrcOffset, data.size());
+	CHECK(contains(openError(ar.write(data)), "Broken archive: CRC table"));
+
+	data = ar.m_data;
+	put<uint64_t>(data, HeaderCrcOffset, get<uint64_t>(data, HeaderCrcOffset) + 2);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: CRC table"));
+
+	// index and CRC table are at the end
+	data.assign(ar.m_data.begin(), ar.m_data.end() - 8);
+	CHECK(!openError(ar.write(data)).empty());
+}
+
+TEST_CASE(archive, rejectIndex)
+{
+	SampleArchive ar(true);
+	const size_t large = findEntry(ar.m_data, "sub/large.txt");
+	const size_t small = findEntry(ar.m_data, "small.txt");
+	CHECK(large != 0 && small != 0);
+	if (large == 0 || small == 0) {
+		return;
+	}
+
+	std::vector<uint8_t> data = ar.m_data;
+	put<uint64_t>(data, large + EntryOffset, data.size() - 4);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: data range"));
+
+	data = ar.m_data;
+	put<uint32_t>(data, large + EntryStoredSize, 0xffffffffu);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: data range"));
+
+	data = ar.m_data;
+	put<uint32_t>(data, large + EntryNameOffset, 0x7fffffffu);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: name range"));
+
+	// name runs over the end of file
+	data = ar.m_data;
+	put<uint32_t>(data, large + EntryNameOffset,
+		static_cast<uint32_t>(data.size() - get<uint64_t>(data, HeaderNameOffset) - 1));
+	put<uint16_t>(data, large + EntryNameSize, 2);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: name range"));
+
+	// swap the first two entries
+	data = ar.m_data;
+	const size_t index = static_cast<size_t>(get<uint64_t>(data, HeaderIndexOffset));
+	std::swap_ranges(data.begin() + index, data.begin() + index + EntrySize,
+		data.begin() + index + EntrySize);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: index order"));
+
+	data = ar.m_data;
+	put<uint32_t>(data, large + EntryCrcIndex, 0x7fffffffu);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: CRC range"));
+
+	// more blocks than CRCs
+	data = ar.m_data;
+	put<uint32_t>(data, small + EntryRawSize, 0x7fffffffu);
+	CHECK(contains(openError(ar.write(data)), "Broken archive"));
+
+	// compressed: zero block size
+	data = ar.m_data;
+	CHECK((get<uint16_t>(data, large + EntryFlags) & 1) != 0);
+	put<uint32_t>(data, static_cast<size_t>(get<uint64_t>(data, large + EntryOffset)), 0);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: block size"));
+
+	// compressed: block larger than raw block
+	data = ar.m_data;
+	put<uint32_t>(data, static_cast<size_t>(get<uint64_t>(data, large + EntryOffset)),
+		file::ArchiveBlockSize + 1);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: block size"));
+
+	// compressed: block sizes do not add up
+	data = ar.m_data;
+	put<uint32_t>(data, large + EntryStoredSize, get<uint32_t>(data, large + EntryStoredSize) - 1);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: block table"));
+}
+
+TEST_CASE(archive, rejectStoredSize)
+{
+	SampleArchive ar(false);
+	const size_t small = findEntry(ar.m_data, "small.txt");
+	CHECK(small != 0);
+	if (small == 0) {
+		return;
+	}
+	std::vector<uint8_t> data = ar.m_data;
+	CHECK((get<uint16_t>(data, small + EntryFlags) & 1) == 0);
+	put<uint32_t>(data, small + EntryStoredSize, get<uint32_t>(data, small + EntryRawSize) - 1);
+	CHECK(contains(openError(ar.write(data)), "Broken archive: stored size"));
+}
+
+TEST_CASE(archive, corruptData)
+{
+	SampleArchive ar(false);
+	const size_t large = findEntry(ar.m_data, "sub/large.txt");
+	CHECK(large != 0);
+	if (large == 0) {
+		return;
+	}
+	std::vector<uint8_t> data = ar.m_data;
+	const size_t offset = static_cast<size_t>(get<uint64_t>(data, large + EntryOffset));
+	data[offset + file::ArchiveBlockSize + 5] ^= 0x20;
+	std::wstring broken = ar.write(data);
+
+	file::initWithArchiveFile(broken.c_str());
+	CHECK(file::loadFile(L"small.txt") == ar.m_src.m_small);
+	// the first block is still good
+	CHECK(file::loadFileRange(L"sub/large.txt", 0, 100) ==
+		file::Bytes(ar.m_src.m_large.begin(), ar.m_src.m_large.begin() + 100));
+	CHECK_THROWS(file::loadFile(L"sub/large.txt"), error::FrameworkError);
+	file::initWithFileSystem(L".");
+
+	file::VerifyResult result = file::verifyArchive(broken.c_str());
+	CHECK(result.files == 5);
+	CHECK(result.badFiles.size() == 1 &&
+		result.badFiles[0] == "sub/large.txt");
+}
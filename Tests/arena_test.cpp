@@ -0,0 +1,152 @@
+﻿// arena_test.cpp : LinearArena, ArenaScope, marker rewind and heap counter.
+
+#include "test.h"
+#include <arena.h>
+#include <cstring>
+#include <memory>
+
+using namespace yappy;
+
+namespace {
+
+// keeps allocations from being optimized out
+void *volatile s_sink = nullptr;
+
+bool isAligned(const void *p, size_t align)
+{
+	return reinterpret_cast<uintptr_t>(p) % align == 0;
+}
+
+}	// namespace
+
+TEST_CASE(arena, linearAllocate)
+{
+	arena::LinearArena arena(1024);
+	CHECK(arena.getReserved() == 0);
+	CHECK(arena.getUsed() == 0);
+
+	char *a = static_cast<char *>(arena.allocate(10, 1));
+	char *b = static_cast<char *>(arena.allocate(10, 1));
+	// bump in the same chunk
+	CHECK(b == a + 10);
+	CHECK(arena.getUsed() == 20);
+	CHECK(arena.getChunkAllocCount() == 1);
+	for (size_t align : { 2u, 8u, 16u, 64u }) {
+		CHECK(isAligned(arena.allocate(3, align), align));
+	}
+	std::memset(a, 'x', 20);
+
+	// the next chunk, and a dedicated chunk for a large request
+	arena.allocate(1000, 1);
+	CHECK(arena.getChunkAllocCount() == 2);
+	const char *str = arena.copyString("hello");
+	CHECK(std::strcmp(str, "hello") == 0);
+	void *large = arena.allocate(5000, 16);
+	CHECK(isAligned(large, 16));
+	CHECK(arena.getChunkAllocCount() == 3);
+	CHECK(arena.getReserved() >= 1024 * 2 + 5000);
+	CHECK(arena.getPeak() == arena.getUsed());
+
+	// chunks are kept and reused
+	size_t reserved = arena.getReserved();
+	size_t peak = arena.getPeak();
+	arena.reset();
+	CHECK(arena.getUsed() == 0);
+	CHECK(arena.getReserved() == reserved);
+	CHECK(arena.allocate(100, 1) == a);
+	arena.allocate(1000, 1);
+	arena.copyString("hello");
+	arena.allocate(5000, 16);
+	CHECK(arena.getChunkAllocCount() == 3);
+	CHECK(arena.getPeak() == peak);
+}
+
+TEST_CASE(arena, markerRewind)
+{
+	arena::LinearArena arena(1024);
+	arena.allocate(100, 1);
+	auto marker = arena.getMarker();
+	size_t used = arena.getUsed();
+	void *p = arena.allocate(200, 1);
+
+	// in the same chunk
+	arena.rewind(marker);
+	CHECK(arena.getUsed() == used);
+	CHECK(arena.allocate(200, 1) == p);
+
+	// across chunks
+	arena.allocate(2000, 1);
+	arena.allocate(900, 1);
+	CHECK(arena.getChunkAllocCount() == 3);
+	arena.rewind(marker);
+	CHECK(arena.getUsed() == used);
+	CHECK(arena.allocate(200, 1) == p);
+	arena.allocate(2000, 1);
+	arena.allocate(900, 1);
+	CHECK(arena.getChunkAllocCount() == 3);
+
+	// a marker older than reset() is ignored
+	auto late = arena.getMarker();
+	arena.reset();
+	arena.allocate(10, 1);
+	arena.rewind(late);
+	CHECK(arena.getUsed() == 10);
+}
+
+TEST_CASE(arena, scope)
+{
+	arena::LinearArena arena(1024);
+	arena.allocate(16, 1);
+	{
+		arena::ArenaScope outer(arena);
+		arena.allocate(100, 1);
+		{
+			arena::ArenaScope inner(arena);
+			arena.allocate(3000, 1);
+			CHECK(arena.getUsed() > 3000);
+		}
+		CHECK(arena.getUsed() == 116);
+		arena::ArenaVector<int> vec{ arena::ArenaAllocator<int>(arena) };
+		for (int i = 0; i < 100; i++) {
+			vec.push_back(i);
+		}
+		CHECK(vec[99] == 99);
+	}
+	CHECK(arena.getUsed() == 16);
+
+	// thread arena by default
+	size_t used = arena::threadArena().getUsed();
+	{
+		arena::ArenaScope scope;
+		const char *utf8 = arena::wc2utf8(L"abc");
+		CHECK(std::strcmp(utf8, "abc") == 0);
+		CHECK(arena::threadArena().getUsed() > used);
+	}
+	CHECK(arena::threadArena().getUsed() == used);
+}
+
+TEST_CASE(arena, heapCounter)
+{
+	CHECK(arena::isHeapCounterAvailable());
+	arena::enableHeapCounter();
+	uint64_t base = arena::getHeapAllocCount();
+	{
+		std::unique_ptr<int> p(new int(1));
+		std::unique_ptr<int[]> a(new int[10]);
+		s_sink = p.get();
+		s_sink = a.get();
+		CHECK(arena::getHeapAllocCount() - base == 2);
+	}
+
+	// no heap allocation in steady state
+	arena::LinearArena arena(1024);
+	arena.allocate(500, 1);
+	arena.reset();
+	base = arena::getHeapAllocCount();
+	for (int i = 0; i < 10; i++) {
+		arena::ArenaScope scope(arena);
+		arena.allocate(500, 1);
+		arena.copyString("text");
+	}
+	CHECK(arena::getHeapAllocCount() == base);
+}
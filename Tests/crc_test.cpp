@@ -0,0 +1,60 @@
+﻿// crc_test.cpp : CRC-32C known answers and hardware/table agreement.
+
+#include "test.h"
+#include <crc.h>
+#include <cstring>
+
+using namespace yappy;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+// both implementations
+void checkAnswer(const Bytes &data, uint32_t expected)
+{
+	CHECK(crc::crc32c(data.data(), data.size()) == expected);
+	CHECK(crc::crc32cTable(data.data(), data.size()) == expected);
+}
+
+}	// namespace
+
+TEST_CASE(crc, knownAnswers)
+{
+	// RFC 3720 B.4 and the common check value
+	const char *check = "123456789";
+	checkAnswer(Bytes(check, check + std::strlen(check)), 0xe3069283u);
+	checkAnswer(Bytes(32, 0x00), 0x8a9136aau);
+	checkAnswer(Bytes(32, 0xff), 0x62a8ab43u);
+	Bytes inc(32);
+	for (size_t i = 0; i < inc.size(); i++) {
+		inc[i] = static_cast<uint8_t>(i);
+	}
+	checkAnswer(inc, 0x46dd794eu);
+	checkAnswer(Bytes(), 0);
+}
+
+TEST_CASE(crc, chaining)
+{
+	Bytes data = test::randomBytes(10000, 1);
+	const uint32_t whole = crc::crc32c(data.data(), data.size());
+	for (size_t split : { size_t(0), size_t(1), size_t(7), size_t(4096), size_t(9999) }) {
+		uint32_t crc = crc::crc32c(data.data(), split);
+		CHECK(crc::crc32c(data.data() + split, data.size() - split, crc) == whole);
+		crc = crc::crc32cTable(data.data(), split);
+		CHECK(crc::crc32cTable(data.data() + split, data.size() - split, crc) == whole);
+	}
+}
+
+TEST_CASE(crc, hardwareMatchesTable)
+{
+	// unaligned starts, short tails and sizes over the 3 lane threshold
+	Bytes data = test::randomBytes(64 * 1024 + 64, 2);
+	const size_t sizes[] = { 1, 3, 8, 15, 63, 255, 256, 1023, 3071, 3072, 3073, 8192, 24577, 65536 };
+	for (size_t size : sizes) {
+		for (size_t align = 0; align < 8; align++) {
+			const uint8_t *p = data.data() + align;
+			CHECK(crc::crc32c(p, size) == crc::crc32cTable(p, size));
+		}
+	}
+}
@@ -0,0 +1,188 @@
+﻿// file_test.cpp : Abstract file system, mount table, AsyncReader and StreamReader.
+
+#include "test.h"
+#include <exceptions.h>
+#include <file.h>
+#include <jobs.h>
+#include <cstdio>
+#include <string>
+
+using namespace yappy;
+
+namespace {
+
+void checkAsyncReader(file::AsyncReader::Backend backend)
+{
+	test::TempDir dir;
+	std::vector<std::wstring> names;
+	for (int i = 0; i < 20; i++) {
+		names.push_back(L"f" + std::to_wstring(i) + L".bin");
+		dir.writeFile(names.back(), test::randomBytes(1000 + i * 100, i + 1));
+	}
+	dir.writeFile(L"empty.bin", std::vector<uint8_t>());
+	file::initWithFileSystem(dir.path().c_str());
+	{
+		file::AsyncReader reader(4, backend);
+		auto futures = reader.readBatch(names);
+		for (size_t i = 0; i < futures.size(); i++) {
+			CHECK(futures[i].get() == test::randomBytes(1000 + i * 100, static_cast<uint32_t>(i + 1)));
+		}
+		auto missing = reader.read(L"missing.bin");
+		CHECK_THROWS(missing.get(), std::exception);
+		CHECK(reader.read(L"empty.bin").get().empty());
+		CHECK(reader.getStats().completed == names.size() + 2);
+		CHECK(reader.getStats().maxInFlight <= 4);
+	}
+	file::initWithFileSystem(L".");
+}
+
+}	// namespace
+
+TEST_CASE(file, asyncReader)
+{
+	checkAsyncReader(file::AsyncReader::Backend::ThreadPool);
+	checkAsyncReader(file::AsyncReader::Backend::Auto);
+#ifdef __linux__
+	checkAsyncReader(file::AsyncReader::Backend::IoUring);
+#endif
+}
+
+TEST_CASE(file, asyncReaderBackend)
+{
+	file::AsyncReader pool(2, file::AsyncReader::Backend::ThreadPool);
+	CHECK(pool.getBackend() == file::AsyncReader::Backend::ThreadPool);
+	file::AsyncReader defaultBackend(2);
+	CHECK(defaultBackend.getBackend() != file::AsyncReader::Backend::Auto);
+#ifdef __linux__
+	// ThreadPool without liburing
+	file::AsyncReader uring(2, file::AsyncReader::Backend::IoUring);
+	CHECK(uring.getBackend() == file::AsyncReader::Backend::IoUring ||
+		uring.getBackend() == file::AsyncReader::Backend::ThreadPool);
+#endif
+#ifndef _WIN32
+	// explicit backend which the platform does not have
+	CHECK_THROWS(file::AsyncReader(2, file::AsyncReader::Backend::Iocp), error::FrameworkError);
+#endif
+}
+
+TEST_CASE(file, mountLookupName)
+{
+	// ASCII (stack buffer), non-ASCII and long names (fallback)
+	test::TempDir dir;
+	std::wstring longName;
+	for (int i = 0; i < 10; i++) {
+		longName += std::wstring(40, static_cast<wchar_t>(L'a' + i)) + L'/';
+	}
+	longName += L"long.txt";
+	dir.writeFile(L"data/a.txt", test::textBytes(100, 1));
+	dir.writeFile(L"data/あ.txt", test::textBytes(100, 2));
+	dir.writeFile(longName, test::textBytes(100, 3));
+	file::initWithMountTable();
+	file::mount(dir.path().c_str());
+	CHECK(file::loadFile(L"data/a.txt") == test::textBytes(100, 1));
+	CHECK(file::loadFile(L"DATA\\A.TXT") == test::textBytes(100, 1));
+	CHECK(file::loadFile(L"Data/あ.TXT") == test::textBytes(100, 2));
+	CHECK(file::loadFile(longName.c_str()) == test::textBytes(100, 3));
+	CHECK_THROWS(file::getFileSize(L"data/b.txt"), error::FrameworkError);
+	CHECK_THROWS(file::getFileSize((longName + L"x").c_str()), error::FrameworkError);
+	file::initWithFileSystem(L".");
+}
+
+namespace {
+
+// StreamReader with and without job system (read-ahead jobs or calling thread)
+template <class F>
+void withStreamJobs(F func)
+{
+	func();
+	jobs::JobSystem jobs(2);
+	file::setJobSystem(&jobs);
+	try {
+		func();
+	}
+	catch (...) {
+		file::setJobSystem(nullptr);
+		throw;
+	}
+	file::setJobSystem(nullptr);
+}
+
+}	// namespace
+
+TEST_CASE(file, streamReaderSequential)
+{
+	test::TempDir dir;
+	// not a multiple of chunkSize
+	const std::vector<uint8_t> data = test::randomBytes(10 * 1000 + 123, 7);
+	dir.writeFile(L"stream.bin", data);
+	file::initWithFileSystem(dir.path().c_str());
+	withStreamJobs([&data]() {
+		file::StreamReader reader(L"stream.bin", 1000, 3);
+		CHECK(reader.size() == data.size());
+		CHECK(reader.getMemorySize() == 3000);
+		std::vector<uint8_t> out;
+		uint8_t buf[777];
+		size_t size;
+		while ((size = reader.read(buf, sizeof(buf))) > 0) {
+			out.insert(out.end(), buf, buf + size);
+		}
+		CHECK(out == data);
+		CHECK(reader.tell() == data.size());
+		// at the end of file
+		CHECK(reader.read(buf, sizeof(buf)) == 0);
+		// each chunk once (11 chunks, the last one is 123 bytes)
+		CHECK(reader.getStats().chunks == 11);
+	});
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(file, streamReaderSeek)
+{
+	test::TempDir dir;
+	const std::vector<uint8_t> data = test::randomBytes(20 * 1000 + 1, 8);
+	dir.writeFile(L"stream.bin", data);
+	file::initWithFileSystem(dir.path().c_str());
+	withStreamJobs([&data]() {
+		file::StreamReader reader(L"stream.bin", 1000, 4);
+		auto readAt = [&reader, &data](uint64_t pos, size_t size) {
+			reader.seek(pos);
+			std::vector<uint8_t> buf(size);
+			buf.resize(reader.read(buf.data(), size));
+			size_t end = static_cast<size_t>(std::min<uint64_t>(pos + size, data.size()));
+			return buf == std::vector<uint8_t>(data.begin() + pos, data.begin() + end);
+		};
+		// across a chunk border in the window
+		CHECK(readAt(500, 1000));
+		// forward out of the window
+		CHECK(readAt(15 * 1000 - 10, 2500));
+		// backward out of the window
+		CHECK(readAt(1, 3000));
+		// backward in the window
+		CHECK(readAt(0, 100));
+		// the last byte, and past the end (clipped)
+		CHECK(readAt(data.size() - 1, 100));
+		reader.seek(data.size() + 100);
+		CHECK(reader.tell() == data.size());
+		uint8_t b;
+		CHECK(reader.read(&b, 1) == 0);
+	});
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(file, streamReaderError)
+{
+	test::TempDir dir;
+	file::initWithFileSystem(dir.path().c_str());
+	CHECK_THROWS(file::StreamReader(L"missing.bin"), std::exception);
+	withStreamJobs([&dir]() {
+		dir.writeFile(L"stream.bin", test::randomBytes(5000, 9));
+		file::StreamReader reader(L"stream.bin", 1000, 2);
+		// removed after open: the error surfaces from read()
+		std::remove(util::wc2utf8((dir.path() + L"/stream.bin").c_str()).get());
+		uint8_t buf[100];
+		CHECK_THROWS(reader.read(buf, sizeof(buf)), std::exception);
+		// and again
+		CHECK_THROWS(reader.read(buf, sizeof(buf)), std::exception);
+	});
+	file::initWithFileSystem(L".");
+}
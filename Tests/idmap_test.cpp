@@ -0,0 +1,100 @@
+﻿// idmap_test.cpp : FrozenIdMap hits, misses and build errors.
+
+#include "test.h"
+#include <exceptions.h>
+#include <idmap.h>
+#include <cstdio>
+
+using namespace yappy;
+using util::IdString;
+
+namespace {
+
+IdString makeId(const char *name)
+{
+	IdString id;
+	util::createFixedString(&id, name);
+	return id;
+}
+
+std::vector<std::pair<IdString, uint32_t>> makeEntries(uint32_t count)
+{
+	std::vector<std::pair<IdString, uint32_t>> entries;
+	for (uint32_t i = 0; i < count; i++) {
+		char name[16];
+		std::snprintf(name, sizeof(name), "key%u", i);
+		entries.emplace_back(makeId(name), i * 3 + 1);
+	}
+	return entries;
+}
+
+}	// namespace
+
+TEST_CASE(idmap, hitAndMiss)
+{
+	for (uint32_t count : { 1u, 2u, 7u, 100u, 5000u }) {
+		auto entries = makeEntries(count);
+		util::FrozenIdMap map;
+		map.build(entries);
+		CHECK(map.size() == count);
+		bool hit = true;
+		for (const auto &entry : entries) {
+			hit = hit && map.find(entry.first) == entry.second;
+		}
+		CHECK(hit);
+		bool miss = true;
+		for (uint32_t i = 0; i < 1000; i++) {
+			char name[16];
+			std::snprintf(name, sizeof(name), "other%u", i);
+			miss = miss && map.find(makeId(name)) == util::FrozenIdMap::NotFound;
+		}
+		CHECK(miss);
+		// empty slots hold the empty key
+		CHECK(map.find(makeId("")) == util::FrozenIdMap::NotFound);
+	}
+}
+
+TEST_CASE(idmap, emptyKey)
+{
+	auto entries = makeEntries(10);
+	entries.emplace_back(makeId(""), 12345);
+	util::FrozenIdMap map;
+	map.build(entries);
+	CHECK(map.find(makeId("")) == 12345);
+	CHECK(map.find(makeId("key3")) == 10);
+	CHECK(map.find(makeId("key10")) == util::FrozenIdMap::NotFound);
+}
+
+TEST_CASE(idmap, emptyMap)
+{
+	util::FrozenIdMap map;
+	CHECK(map.size() == 0);
+	CHECK(map.find(makeId("")) == util::FrozenIdMap::NotFound);
+	CHECK(map.find(makeId("key0")) == util::FrozenIdMap::NotFound);
+
+	map.build(makeEntries(10));
+	CHECK(map.find(makeId("key0")) == 1);
+	map.build({});
+	CHECK(map.size() == 0);
+	CHECK(map.find(makeId("key0")) == util::FrozenIdMap::NotFound);
+
+	map.build(makeEntries(10));
+	map.clear();
+	CHECK(map.size() == 0);
+	CHECK(map.find(makeId("key0")) == util::FrozenIdMap::NotFound);
+}
+
+TEST_CASE(idmap, duplicateKey)
+{
+	auto entries = makeEntries(10);
+	entries.emplace_back(makeId("key4"), 999);
+	util::FrozenIdMap map;
+	CHECK_THROWS(map.build(entries), error::FrameworkError);
+	// left empty
+	CHECK(map.size() == 0);
+	CHECK(map.find(makeId("key4")) == util::FrozenIdMap::NotFound);
+	// the empty key twice
+	std::vector<std::pair<IdString, uint32_t>> empties = {
+		{ makeId(""), 1 }, { makeId(""), 2 } };
+	CHECK_THROWS(map.build(empties), error::FrameworkError);
+}
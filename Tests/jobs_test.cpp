@@ -0,0 +1,101 @@
+﻿// jobs_test.cpp : JobSystem wait, dependencies and exceptions.
+
+#include "test.h"
+#include <jobs.h>
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+
+using namespace yappy;
+
+TEST_CASE(jobs, parallelFor)
+{
+	jobs::JobSystem jobs(2);
+	std::vector<int> out(10000, 0);
+	jobs.parallelFor(0, out.size(), 7, [&out](size_t i) {
+		out[i] = static_cast<int>(i) * 2;
+	});
+	bool ok = true;
+	for (size_t i = 0; i < out.size(); i++) {
+		ok = ok && out[i] == static_cast<int>(i) * 2;
+	}
+	CHECK(ok);
+	CHECK(jobs.getStats().executed == (out.size() + 6) / 7);
+}
+
+TEST_CASE(jobs, waitSleepsForRunningJob)
+{
+	// the waiter has nothing to take while the worker runs the job
+	jobs::JobSystem jobs(1);
+	std::atomic<bool> started(false);
+	std::atomic<bool> finished(false);
+	jobs::JobCounter counter;
+	jobs.run([&]() {
+		started = true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		finished = true;
+	}, &counter);
+	while (!started) {
+		std::this_thread::yield();
+	}
+	jobs.wait(counter);
+	CHECK(finished);
+	CHECK(counter.isDone());
+}
+
+TEST_CASE(jobs, nestedWait)
+{
+	// jobs wait for their children on a single worker
+	jobs::JobSystem jobs(1);
+	std::atomic<int> leaves(0);
+	jobs::JobCounter counter;
+	for (int i = 0; i < 8; i++) {
+		jobs.run([&jobs, &leaves]() {
+			jobs::JobCounter children;
+			for (int k = 0; k < 8; k++) {
+				jobs.run([&leaves]() { leaves++; }, &children);
+			}
+			jobs.wait(children);
+		}, &counter);
+	}
+	jobs.wait(counter);
+	CHECK(leaves == 64);
+}
+
+TEST_CASE(jobs, runAfter)
+{
+	jobs::JobSystem jobs(2);
+	std::atomic<int> first(0);
+	int seen = -1;
+	jobs::JobCounter dependency;
+	jobs::JobCounter counter;
+	for (int i = 0; i < 16; i++) {
+		jobs.run([&first]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			first++;
+		}, &dependency);
+	}
+	jobs.runAfter(dependency, [&]() { seen = first.load(); }, &counter);
+	jobs.wait(counter);
+	CHECK(seen == 16);
+}
+
+TEST_CASE(jobs, exception)
+{
+	jobs::JobSystem jobs(2);
+	jobs::JobCounter counter;
+	std::atomic<int> done(0);
+	for (int i = 0; i < 10; i++) {
+		jobs.run([i, &done]() {
+			if (i == 3) {
+				throw std::runtime_error("job error");
+			}
+			done++;
+		}, &counter);
+	}
+	CHECK_THROWS(jobs.wait(counter), std::runtime_error);
+	CHECK(done == 9);
+	// rethrown only once
+	jobs.wait(counter);
+}
@@ -0,0 +1,127 @@
+﻿// lz_test.cpp : LZ block compression and decompression bounds.
+
+#include "test.h"
+#include <exceptions.h>
+#include <lz.h>
+#include <string>
+
+using namespace yappy;
+
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+// decompress error message ("" if succeeded)
+std::string decompressError(const Bytes &src, size_t dstSize, Bytes *out = nullptr)
+{
+	// exact size buffer (overrun is caught by sanitizers)
+	Bytes dst(dstSize);
+	try {
+		lz::decompress(src.data(), src.size(), dst.data(), dst.size());
+	}
+	catch (const error::FrameworkError &e) {
+		return e.what();
+	}
+	if (out != nullptr) {
+		*out = dst;
+	}
+	return "";
+}
+
+bool contains(const std::string &str, const char *part)
+{
+	return str.find(part) != std::string::npos;
+}
+
+void checkRoundTrip(const Bytes &src)
+{
+	Bytes packed(lz::compressBound(src.size()));
+	size_t size = lz::compress(src.data(), src.size(), packed.data(), packed.size());
+	CHECK(size > 0 && size < src.size());
+	packed.resize(size);
+	Bytes out;
+	CHECK(decompressError(packed, src.size(), &out).empty());
+	CHECK(out == src);
+}
+
+}	// namespace
+
+TEST_CASE(lz, roundTrip)
+{
+	checkRoundTrip(test::textBytes(64 * 1024, 1));
+	checkRoundTrip(test::textBytes(1000, 2));
+	// long matches and repeat patterns
+	checkRoundTrip(Bytes(100000, 'x'));
+	Bytes pattern;
+	for (int i = 0; i < 20000; i++) {
+		pattern.push_back(static_cast<uint8_t>(i % 3));
+	}
+	checkRoundTrip(pattern);
+}
+
+TEST_CASE(lz, incompressible)
+{
+	Bytes src = test::randomBytes(4096, 3);
+	Bytes packed(lz::compressBound(src.size()));
+	CHECK(lz::compress(src.data(), src.size(), packed.data(), packed.size()) == 0);
+	CHECK(lz::compress(src.data(), 0, packed.data(), packed.size()) == 0);
+	// does not fit in dst
+	Bytes text = test::textBytes(4096, 4);
+	CHECK(lz::compress(text.data(), text.size(), packed.data(), 16) == 0);
+}
+
+TEST_CASE(lz, handMadeStream)
+{
+	// 1 literal, match (offset 1, length 8), last literal
+	Bytes out;
+	CHECK(decompressError({ 0x14, 'a', 0x01, 0x00, 0x10, 'b' }, 10, &out).empty());
+	CHECK(out == Bytes({ 'a', 'a', 'a', 'a', 'a', 'a', 'a', 'a', 'a', 'b' }));
+
+	// extra match length: 15 + 255 + 16 + MinMatch, then empty last literals
+	CHECK(decompressError({ 0x1f, 'a', 0x01, 0x00, 0xff, 0x10, 0x00 }, 291, &out).empty());
+	CHECK(out == Bytes(291, 'a'));
+
+	// extra literal length: 15 + 1
+	Bytes src = { 0xf0, 0x01 };
+	Bytes lit = test::textBytes(16, 5);
+	src.insert(src.end(), lit.begin(), lit.end());
+	CHECK(decompressError(src, 16, &out).empty());
+	CHECK(out == lit);
+}
+
+TEST_CASE(lz, rejectOverlongMatch)
+{
+	CHECK(contains(decompressError({ 0x14, 'a', 0x01, 0x00 }, 5), "match"));
+	CHECK(contains(decompressError({ 0x1f, 'a', 0x01, 0x00, 0xff, 0x10, 0x00 }, 290), "match"));
+	// huge extra length
+	Bytes src = { 0x1f, 'a', 0x01, 0x00 };
+	src.insert(src.end(), 1000, 0xff);
+	src.push_back(0x00);
+	CHECK(contains(decompressError(src, 1000), "match"));
+}
+
+TEST_CASE(lz, rejectOverlongLiteral)
+{
+	// longer than input
+	CHECK(contains(decompressError({ 0xf0, 0x10, 'a' }, 31), "literals"));
+	CHECK(contains(decompressError({ 0x30, 'a', 'b' }, 3), "literals"));
+	// longer than output
+	CHECK(contains(decompressError({ 0x30, 'a', 'b', 'c' }, 2), "literals"));
+	// length bytes run out
+	CHECK(contains(decompressError({ 0xf0 }, 100), "length"));
+	CHECK(contains(decompressError({ 0xf0, 0xff, 0xff }, 1000), "length"));
+}
+
+TEST_CASE(lz, rejectBrokenStream)
+{
+	CHECK(contains(decompressError({}, 1), "token"));
+	// match offset beyond output
+	CHECK(contains(decompressError({ 0x14, 'a', 0x05, 0x00, 0x10, 'b' }, 10), "offset"));
+	CHECK(contains(decompressError({ 0x14, 'a', 0x00, 0x00, 0x10, 'b' }, 10), "offset"));
+	// truncated offset
+	CHECK(contains(decompressError({ 0x14, 'a', 0x01 }, 10), "offset"));
+	// truncated after match
+	CHECK(contains(decompressError({ 0x14, 'a', 0x01, 0x00 }, 9), "token"));
+	// short output
+	CHECK(contains(decompressError({ 0x10, 'a' }, 2), "size"));
+}
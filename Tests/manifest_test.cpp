@@ -0,0 +1,144 @@
+﻿// manifest_test.cpp : Manifest serialize, parse, save and broken input.
+
+#include "test.h"
+#include <exceptions.h>
+#include <manifest.h>
+#include <cstring>
+
+using namespace yappy;
+
+namespace {
+
+// Header: uint32 x 4, Entry: uint32 x 8
+const size_t HeaderSize = 16;
+const size_t EntrySize = 32;
+const size_t StringSizeOffset = 12;
+const size_t TypeOffset = 0;
+const size_t ResIdOffset = 8;
+
+std::vector<manifest::Entry> sampleEntries()
+{
+	std::vector<manifest::Entry> entries(3);
+	entries[0].type = manifest::EntryType::Texture;
+	entries[0].setId = 1;
+	entries[0].resId = "tex";
+	entries[0].path = L"img/a.png";
+	entries[1].type = manifest::EntryType::Font;
+	entries[1].setId = 2;
+	entries[1].resId = "font";
+	entries[1].path = L"メイリオ";
+	entries[1].startChar = 0x20;
+	entries[1].endChar = 0x7e;
+	entries[1].w = 16;
+	entries[1].h = 32;
+	entries[2].type = manifest::EntryType::Bgm;
+	entries[2].resId = "";
+	entries[2].path = L"";
+	return entries;
+}
+
+bool equals(const manifest::Entry &a, const manifest::Entry &b)
+{
+	return a.type == b.type && a.setId == b.setId &&
+		a.resId == b.resId && a.path == b.path &&
+		a.startChar == b.startChar && a.endChar == b.endChar &&
+		a.w == b.w && a.h == b.h;
+}
+
+uint32_t getU32(const file::Bytes &bin, size_t offset)
+{
+	uint32_t value = 0;
+	std::memcpy(&value, bin.data() + offset, sizeof(value));
+	return value;
+}
+
+void setU32(file::Bytes *bin, size_t offset, uint32_t value)
+{
+	std::memcpy(bin->data() + offset, &value, sizeof(value));
+}
+
+}	// namespace
+
+TEST_CASE(manifest, roundTrip)
+{
+	auto entries = sampleEntries();
+	file::Bytes bin = manifest::serialize(entries);
+	auto parsed = manifest::parse(bin);
+	CHECK(parsed.size() == entries.size());
+	bool ok = parsed.size() == entries.size();
+	for (size_t i = 0; ok && i < entries.size(); i++) {
+		ok = equals(parsed[i], entries[i]);
+	}
+	CHECK(ok);
+
+	// empty
+	CHECK(manifest::parse(manifest::serialize({})).empty());
+	CHECK(manifest::serialize({}).size() == HeaderSize);
+}
+
+TEST_CASE(manifest, saveAndLoad)
+{
+	test::TempDir dir;
+	auto entries = sampleEntries();
+	manifest::save((dir.path() + L"/res.manifest").c_str(), entries);
+	file::initWithFileSystem(dir.path().c_str());
+	auto loaded = manifest::load(L"res.manifest");
+	file::initWithFileSystem(L".");
+	CHECK(loaded.size() == entries.size() && equals(loaded[1], entries[1]));
+}
+
+TEST_CASE(manifest, truncated)
+{
+	file::Bytes bin = manifest::serialize(sampleEntries());
+	// inside the header
+	file::Bytes header(bin.begin(), bin.begin() + HeaderSize - 1);
+	CHECK_THROWS(manifest::parse(header), error::FrameworkError);
+	// inside entries and inside strings
+	for (size_t size : { HeaderSize + EntrySize, bin.size() - 1 }) {
+		file::Bytes part(bin.begin(), bin.begin() + size);
+		CHECK_THROWS(manifest::parse(part), error::FrameworkError);
+	}
+	// trailing garbage
+	file::Bytes longer = bin;
+	longer.push_back(0);
+	CHECK_THROWS(manifest::parse(longer), error::FrameworkError);
+	// not a manifest
+	file::Bytes magic = bin;
+	magic[0] = 'X';
+	CHECK_THROWS(manifest::parse(magic), error::FrameworkError);
+}
+
+TEST_CASE(manifest, stringOffsetOutOfRange)
+{
+	file::Bytes bin = manifest::serialize(sampleEntries());
+	const uint32_t stringSize = getU32(bin, StringSizeOffset);
+	for (uint32_t offset : { stringSize, stringSize + 1, 0xffffffffu }) {
+		file::Bytes broken = bin;
+		setU32(&broken, HeaderSize + EntrySize + ResIdOffset, offset);
+		CHECK_THROWS(manifest::parse(broken), error::FrameworkError);
+	}
+	// the last valid offset (the last terminator, empty string)
+	file::Bytes last = bin;
+	setU32(&last, HeaderSize + ResIdOffset, stringSize - 1);
+	auto parsed = manifest::parse(last);
+	CHECK(parsed[0].resId.empty());
+}
+
+TEST_CASE(manifest, unterminatedString)
+{
+	file::Bytes bin = manifest::serialize(sampleEntries());
+	// the last string (path of the last entry, empty) is its terminator
+	CHECK(bin.back() == 0);
+	bin.back() = 'x';
+	CHECK_THROWS(manifest::parse(bin), error::FrameworkError);
+}
+
+TEST_CASE(manifest, typeOutOfRange)
+{
+	file::Bytes bin = manifest::serialize(sampleEntries());
+	for (uint32_t type : { static_cast<uint32_t>(manifest::EntryType::Count), 0xffffffffu }) {
+		file::Bytes broken = bin;
+		setU32(&broken, HeaderSize + EntrySize * 2 + TypeOffset, type);
+		CHECK_THROWS(manifest::parse(broken), error::FrameworkError);
+	}
+}
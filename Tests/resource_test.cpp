@@ -0,0 +1,295 @@
+﻿// resource_test.cpp : ResourceManager load, share, switch, cache and prefetch.
+
+#include "test.h"
+#include <resource_manager.h>
+#include <jobs.h>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+
+using namespace yappy;
+using framework::ResourceManager;
+using framework::ResourceType;
+
+namespace {
+
+// payload whose memory size is the file size
+struct Blob {
+	size_t size;
+	size_t getMemorySize() const { return size; }
+};
+
+using BlobResource = framework::Resource<Blob>;
+
+// reads size bytes, counting the reads
+BlobResource::Loader blobLoader(size_t size, const wchar_t *key,
+	std::shared_ptr<std::atomic<int>> reads = nullptr)
+{
+	BlobResource::Loader loader;
+	loader.read = [size, reads]() {
+		if (reads != nullptr) {
+			reads->fetch_add(1);
+		}
+		return file::FileView(file::Bytes(size, 0x5a));
+	};
+	loader.decode = [](file::FileView &&view) {
+		size_t n = view.size();
+		return BlobResource::UploadFunc([n]() {
+			return std::make_shared<Blob>(Blob{ n });
+		});
+	};
+	loader.key = key;
+	return loader;
+}
+
+}	// namespace
+
+TEST_CASE(resource, addAndGetHandle)
+{
+	ResourceManager mgr(2);
+	CHECK_THROWS(mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(10, L"a")),
+		std::logic_error);
+	mgr.setSealed(false);
+	auto a = mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(10, L"a"));
+	auto b = mgr.add<Blob>(ResourceType::Texture, 0, "b", blobLoader(20, L"b"));
+	// the same content key again returns the same handle
+	CHECK(mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(10, L"a")) == a);
+	CHECK_THROWS(mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(10, L"x")),
+		std::invalid_argument);
+	// unsealed: looked up in the unordered_map
+	CHECK(mgr.getHandle(ResourceType::Texture, 0, "b") == b);
+	mgr.setSealed(true);
+	// sealed: looked up in the frozen map
+	CHECK(mgr.getHandle(ResourceType::Texture, 0, "a") == a);
+	CHECK(mgr.getHandle(ResourceType::Texture, 0, "b") == b);
+	CHECK_THROWS(mgr.getHandle(ResourceType::Texture, 0, "c"), std::invalid_argument);
+	CHECK_THROWS(mgr.getHandle(ResourceType::Texture, 1, "a"), std::invalid_argument);
+	CHECK_THROWS(mgr.getHandle(ResourceType::Font, 0, "a"), std::invalid_argument);
+	// not loaded and not in cache mode
+	CHECK_THROWS(mgr.get<Blob>(ResourceType::Texture, a), error::FrameworkError);
+}
+
+TEST_CASE(resource, loadResourceSet)
+{
+	ResourceManager mgr(1);
+	mgr.setSealed(false);
+	auto tex = mgr.add<Blob>(ResourceType::Texture, 0, "tex", blobLoader(100, L"tex"));
+	auto se = mgr.add<Blob>(ResourceType::SoundEffect, 0, "se", blobLoader(30, L"se"));
+	mgr.setSealed(true);
+
+	std::atomic_bool cancel(false);
+	framework::LoadProgress progress;
+	mgr.loadResourceSet(0, cancel, &progress);
+	CHECK(progress.itemsTotal.load() == 2);
+	CHECK(progress.itemsDone.load() == 2);
+	CHECK(progress.bytesRead.load() == 130);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, tex)->size == 100);
+	CHECK(mgr.getView<Blob>(ResourceType::SoundEffect, se)->size == 30);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).used == 100);
+
+	mgr.unloadResourceSet(0);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).used == 0);
+	CHECK_THROWS(mgr.get<Blob>(ResourceType::Texture, tex), error::FrameworkError);
+}
+
+TEST_CASE(resource, loadResourceSetWithJobs)
+{
+	jobs::JobSystem jobs(2);
+	ResourceManager mgr(1);
+	mgr.setJobSystem(&jobs);
+	mgr.setSealed(false);
+	const int count = 50;
+	for (int i = 0; i < count; i++) {
+		std::string id = "r" + std::to_string(i);
+		std::wstring key = L"r" + std::to_wstring(i);
+		mgr.add<Blob>(ResourceType::Texture, 0, id.c_str(), blobLoader(i + 1, key.c_str()));
+	}
+	mgr.setSealed(true);
+
+	std::atomic_bool cancel(false);
+	framework::LoadProgress progress;
+	mgr.loadResourceSet(0, cancel, &progress);
+	CHECK(progress.itemsDone.load() == count);
+	bool ok = true;
+	for (int i = 0; i < count; i++) {
+		std::string id = "r" + std::to_string(i);
+		ok = ok && mgr.get<Blob>(ResourceType::Texture, 0, id.c_str())->size ==
+			static_cast<size_t>(i + 1);
+	}
+	CHECK(ok);
+	mgr.cancelAllPrefetch();
+}
+
+TEST_CASE(resource, asyncReadStage)
+{
+	test::TempDir dir;
+	const int count = 20;
+	for (int i = 0; i < count; i++) {
+		dir.writeFile(L"f" + std::to_wstring(i) + L".bin",
+			test::randomBytes(100 + i * 10, i + 1));
+	}
+	file::initWithFileSystem(dir.path().c_str());
+	{
+		jobs::JobSystem jobs(2);
+		file::AsyncReader reader(4);
+		ResourceManager mgr(2);
+		mgr.setJobSystem(&jobs);
+		mgr.setAsyncReader(&reader);
+		mgr.setSealed(false);
+		for (int i = 0; i < count; i++) {
+			std::string id = "f" + std::to_string(i);
+			std::wstring name = L"f" + std::to_wstring(i) + L".bin";
+			// read by the reader instead of read()
+			BlobResource::Loader loader = blobLoader(0, name.c_str());
+			loader.read = nullptr;
+			loader.fileName = name;
+			mgr.add<Blob>(ResourceType::Texture, 0, id.c_str(), std::move(loader));
+		}
+		BlobResource::Loader missing = blobLoader(0, L"missing.bin");
+		missing.fileName = L"missing.bin";
+		mgr.add<Blob>(ResourceType::Texture, 1, "missing", std::move(missing));
+		mgr.setSealed(true);
+
+		std::atomic_bool cancel(false);
+		framework::LoadProgress progress;
+		mgr.loadResourceSet(0, cancel, &progress);
+		CHECK(progress.itemsDone.load() == count);
+		CHECK(reader.getStats().completed == count);
+		bool ok = true;
+		uint64_t total = 0;
+		for (int i = 0; i < count; i++) {
+			std::string id = "f" + std::to_string(i);
+			ok = ok && mgr.get<Blob>(ResourceType::Texture, 0, id.c_str())->size ==
+				static_cast<size_t>(100 + i * 10);
+			total += 100 + i * 10;
+		}
+		CHECK(ok);
+		CHECK(progress.bytesRead.load() == total);
+
+		// read error is reported by loadResourceSet() and the resource is not loaded
+		CHECK_THROWS(mgr.loadResourceSet(1, cancel), std::exception);
+		CHECK_THROWS(mgr.get<Blob>(ResourceType::Texture, 1, "missing"), error::FrameworkError);
+		CHECK_THROWS(mgr.loadResourceSet(1, cancel), std::exception);
+	}
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(resource, shareByContentKey)
+{
+	auto reads = std::make_shared<std::atomic<int>>(0);
+	ResourceManager mgr(2);
+	mgr.setSealed(false);
+	auto a = mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(64, L"same", reads));
+	auto b = mgr.add<Blob>(ResourceType::Texture, 1, "b", blobLoader(64, L"same", reads));
+	mgr.setSealed(true);
+
+	std::atomic_bool cancel(false);
+	mgr.loadResourceSet(0, cancel);
+	mgr.loadResourceSet(1, cancel);
+	// the second set is served by the first load
+	CHECK(reads->load() == 1);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, a) == mgr.get<Blob>(ResourceType::Texture, b));
+	auto stats = mgr.getCacheStats(ResourceType::Texture);
+	CHECK(stats.used == 64);
+	CHECK(stats.shared == 1);
+	CHECK(stats.saved == 64);
+}
+
+TEST_CASE(resource, switchResourceSet)
+{
+	auto reads = std::make_shared<std::atomic<int>>(0);
+	ResourceManager mgr(2);
+	mgr.setSealed(false);
+	mgr.add<Blob>(ResourceType::Texture, 0, "common", blobLoader(100, L"common", reads));
+	mgr.add<Blob>(ResourceType::Texture, 0, "old", blobLoader(10, L"old", reads));
+	auto common = mgr.add<Blob>(ResourceType::Texture, 1, "common",
+		blobLoader(100, L"common", reads));
+	auto added = mgr.add<Blob>(ResourceType::Texture, 1, "new", blobLoader(20, L"new", reads));
+	mgr.setSealed(true);
+
+	std::atomic_bool cancel(false);
+	mgr.loadResourceSet(0, cancel);
+	CHECK(reads->load() == 2);
+	auto stats = mgr.switchResourceSet(0, 1, cancel);
+	CHECK(stats.itemsReused == 1);
+	CHECK(stats.bytesReused == 100);
+	CHECK(stats.itemsUnloaded == 1);
+	CHECK(stats.bytesUnloaded == 10);
+	CHECK(stats.itemsLoaded == 1);
+	CHECK(stats.bytesLoaded == 20);
+	CHECK(reads->load() == 3);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, common)->size == 100);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, added)->size == 20);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).used == 120);
+}
+
+TEST_CASE(resource, cacheBudget)
+{
+	ResourceManager mgr(1);
+	mgr.setSealed(false);
+	auto a = mgr.add<Blob>(ResourceType::Texture, 0, "a", blobLoader(100, L"a"));
+	auto b = mgr.add<Blob>(ResourceType::Texture, 0, "b", blobLoader(100, L"b"));
+	mgr.setSealed(true);
+	mgr.setCacheBudget(ResourceType::Texture, 150);
+
+	// cache mode: get() loads on demand
+	mgr.beginFrame();
+	CHECK(mgr.get<Blob>(ResourceType::Texture, a)->size == 100);
+	mgr.beginFrame();
+	CHECK(mgr.get<Blob>(ResourceType::Texture, b)->size == 100);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).used == 200);
+	// a is the least recently used
+	mgr.beginFrame();
+	auto stats = mgr.getCacheStats(ResourceType::Texture);
+	CHECK(stats.used == 100);
+	CHECK(stats.evict == 1);
+	CHECK(stats.miss == 2);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, b)->size == 100);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).hit == 1);
+
+	// a held shared_ptr is not evicted
+	auto held = mgr.get<Blob>(ResourceType::Texture, a);
+	CHECK(mgr.getCacheStats(ResourceType::Texture).miss == 3);
+	mgr.beginFrame();
+	mgr.beginFrame();
+	stats = mgr.getCacheStats(ResourceType::Texture);
+	CHECK(stats.used == 100);
+	CHECK(held->size == 100);
+	CHECK(mgr.get<Blob>(ResourceType::Texture, a) == held);
+}
+
+TEST_CASE(resource, prefetch)
+{
+	jobs::JobSystem jobs(1);
+	ResourceManager mgr(2);
+	mgr.setJobSystem(&jobs);
+	mgr.setSealed(false);
+	const int count = 10;
+	for (int i = 0; i < count; i++) {
+		std::string id = "p" + std::to_string(i);
+		std::wstring key = L"p" + std::to_wstring(i);
+		mgr.add<Blob>(ResourceType::Texture, 1, id.c_str(), blobLoader(1000, key.c_str()));
+	}
+	mgr.setSealed(true);
+
+	framework::PrefetchParam param;
+	param.maxInFlight = 2;
+	param.bytesPerFrame = 2000;
+	framework::LoadProgress progress;
+	mgr.prefetchResourceSet(1, param, &progress);
+	for (int frame = 0; frame < 3; frame++) {
+		mgr.beginFrame();
+	}
+	// promote: the rest is loaded here
+	std::atomic_bool cancel(false);
+	mgr.loadResourceSet(1, cancel);
+	CHECK(!mgr.isPrefetching(1));
+	CHECK(mgr.getCacheStats(ResourceType::Texture).used == count * 1000);
+	bool ok = true;
+	for (int i = 0; i < count; i++) {
+		std::string id = "p" + std::to_string(i);
+		ok = ok && mgr.get<Blob>(ResourceType::Texture, 1, id.c_str())->size == 1000;
+	}
+	CHECK(ok);
+	mgr.cancelAllPrefetch();
+}
@@ -0,0 +1,117 @@
+﻿// script_test.cpp : Lua state, script loading, calls and errors.
+
+#include "test.h"
+#include <script.h>
+#include <file.h>
+#include <string>
+
+using namespace yappy;
+
+namespace {
+
+const size_t HeapSize = 16 * 1024 * 1024;
+
+std::vector<uint8_t> toBytes(const char *src)
+{
+	return std::vector<uint8_t>(src, src + std::char_traits<char>::length(src));
+}
+
+}	// namespace
+
+TEST_CASE(script, loadFileAndCall)
+{
+	test::TempDir dir;
+	dir.writeFile(L"main.lua", toBytes(
+		"count = 0\n"
+		"function add(a, b)\n"
+		"  count = count + 1\n"
+		"  return a + b, tostring(a) .. b\n"
+		"end\n"));
+	file::initWithFileSystem(dir.path().c_str());
+	{
+		lua::Lua lua(false, HeapSize);
+		lua.loadFile(L"main.lua", false);
+		lua_Integer sum = 0;
+		std::string str;
+		lua.callGlobal("add", false, [](lua_State *L) {
+			lua_pushinteger(L, 3);
+			lua_pushinteger(L, 4);
+		}, 2, [&sum, &str](lua_State *L) {
+			sum = lua_tointeger(L, -2);
+			str = lua_tostring(L, -1);
+			lua_pop(L, 2);
+		}, 2);
+		CHECK(sum == 7);
+		CHECK(str == "34");
+		lua_State *L = lua.getLuaState();
+		lua_getglobal(L, "count");
+		CHECK(lua_tointeger(L, -1) == 1);
+		lua_pop(L, 1);
+		CHECK(lua_gettop(L) == 0);
+		// removed by the constructor
+		lua_getglobal(L, "load");
+		CHECK(lua_isnil(L, -1));
+		lua_pop(L, 1);
+	}
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(script, errors)
+{
+	test::TempDir dir;
+	dir.writeFile(L"syntax.lua", toBytes("function f(\n"));
+	dir.writeFile(L"runtime.lua", toBytes(
+		"function fail() error(\"boom\") end\n"
+		"function loop() while true do end end\n"));
+	file::initWithFileSystem(dir.path().c_str());
+	{
+		lua::Lua lua(false, HeapSize, 1024 * 1024, 10000);
+		CHECK_THROWS(lua.loadFile(L"syntax.lua", false), lua::LuaError);
+		CHECK_THROWS(lua.loadFile(L"none.lua", false), error::Win32Error);
+		lua.loadFile(L"runtime.lua", false);
+		bool caught = false;
+		try {
+			lua.callGlobal("fail", false);
+		}
+		catch (const lua::LuaError &e) {
+			caught = std::string(e.what()).find("boom") != std::string::npos;
+		}
+		CHECK(caught);
+		// instruction limit stops an infinite loop
+		CHECK_THROWS(lua.callGlobal("loop", false), lua::LuaError);
+		// the state is still usable
+		CHECK_THROWS(lua.callGlobal("undefined", false), lua::LuaError);
+		CHECK(lua_gettop(lua.getLuaState()) == 0);
+	}
+	file::initWithFileSystem(L".");
+}
+
+TEST_CASE(script, valueToStrList)
+{
+	lua::Lua lua(false, HeapSize);
+	lua_State *L = lua.getLuaState();
+	lua_newtable(L);
+	lua_pushinteger(L, 42);
+	lua_setfield(L, -2, "x");
+
+	auto shallow = lua::luaValueToStrList(L, -1, 0);
+	CHECK(shallow.size() == 1);
+	CHECK(shallow[0].find("(table)") == 0);
+
+	auto list = lua::luaValueToStrList(L, -1, 3);
+	bool hasValue = false;
+	for (const auto &line : list) {
+		hasValue = hasValue || line.find("(number) 42") != std::string::npos;
+	}
+	CHECK(hasValue);
+	// table, key and value
+	CHECK(list.size() == 3);
+	CHECK(list[1] == "K   (string) x");
+	lua_pop(L, 1);
+
+	lua_pushboolean(L, 1);
+	auto boolList = lua::luaValueToStrList(L, -1, 0);
+	CHECK(boolList.size() == 1 && boolList[0] == "(boolean) true");
+	lua_pop(L, 1);
+	CHECK_THROWS(lua::luaValueToStrList(L, 1, 0), std::logic_error);
+}
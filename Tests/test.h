@@ -0,0 +1,91 @@
+﻿// test.h : Minimal test harness of the portable core.
+//
+// TEST_CASE(suite, name) { CHECK(...); }
+// A failed CHECK is reported and the case continues.
+// An exception escaping from a case fails the case.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace test {
+
+/// Test function registered by TEST_CASE.
+struct Case {
+	const char *suite;
+	const char *name;
+	void (*func)();
+};
+
+/// All registered cases. (in link order)
+std::vector<Case> &getCases();
+
+/// Registers a case at static initialization.
+struct Register {
+	Register(const char *suite, const char *name, void (*func)())
+	{
+		getCases().push_back(Case{ suite, name, func });
+	}
+};
+
+/// Report a failure of the current case.
+void fail(const char *file, int line, const std::string &msg);
+
+/// Deterministic pseudo random bytes. (xorshift32)
+std::vector<uint8_t> randomBytes(size_t size, uint32_t seed);
+/// Compressible text-like bytes.
+std::vector<uint8_t> textBytes(size_t size, uint32_t seed);
+
+/// Read a whole file in the real file system.
+std::vector<uint8_t> readFile(const std::wstring &path);
+/// Create or overwrite a file in the real file system.
+void writeFile(const std::wstring &path, const std::vector<uint8_t> &data);
+
+/// Temporary directory, removed recursively at destruction.
+class TempDir {
+public:
+	TempDir();
+	~TempDir();
+	TempDir(const TempDir &) = delete;
+	TempDir &operator=(const TempDir &) = delete;
+
+	/// Directory path. (without the last separator)
+	const std::wstring &path() const { return m_path; }
+	/// Create a directory under this directory. ('/' separated, parents included)
+	void createDir(const std::wstring &name);
+	/// Write a file under this directory. (parent directories are created)
+	void writeFile(const std::wstring &name, const std::vector<uint8_t> &data);
+
+private:
+	std::wstring m_path;
+};
+
+}	// namespace test
+
+#define TEST_CASE(suite, name) \
+	static void suite##_##name(); \
+	static test::Register s_register_##suite##_##name(#suite, #name, suite##_##name); \
+	static void suite##_##name()
+
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			test::fail(__FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+#define CHECK_THROWS(expr, type) \
+	do { \
+		bool thrown_ = false; \
+		try { \
+			expr; \
+		} \
+		catch (const type &) { \
+			thrown_ = true; \
+		} \
+		if (!thrown_) { \
+			test::fail(__FILE__, __LINE__, "no " #type ": " #expr); \
+		} \
+	} while (0)
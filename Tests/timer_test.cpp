@@ -0,0 +1,286 @@
+﻿// timer_test.cpp : PreciseWaiter and frame statistics on a fake clock.
+
+#include "test.h"
+#include <timer.h>
+#include <cmath>
+#include <functional>
+
+using namespace yappy;
+
+namespace {
+
+// 1 counter = 1 us
+const int64_t Freq = 1000 * 1000;
+
+/**@brief Deterministic clock.
+ * @details
+ * sleepFor() advances the time by the request plus an overshoot chosen
+ * by a callback, relax() advances it by 1 us (spin step).
+ */
+class FakeClock : public timer::Clock {
+public:
+	FakeClock() = default;
+	virtual ~FakeClock() override = default;
+
+	virtual int64_t getFrequency() const override { return Freq; }
+	virtual int64_t getCounter() const override { return now; }
+	virtual void sleepFor(int64_t counter) override
+	{
+		sleeps++;
+		lastSleep = counter;
+		now += counter + (overshoot ? overshoot(sleeps) : 0);
+	}
+	virtual void relax() override
+	{
+		spins++;
+		now++;
+	}
+
+	int64_t now = 1000000;
+	// overshoot of the n-th sleep (1 origin)
+	std::function<int64_t(int)> overshoot;
+	int sleeps = 0;
+	int64_t lastSleep = 0;
+	int64_t spins = 0;
+};
+
+timer::WaitParam makeParam(timer::SlackPolicy policy)
+{
+	timer::WaitParam param;
+	param.policy = policy;
+	return param;
+}
+
+bool near(double a, double b, double eps)
+{
+	return std::fabs(a - b) <= eps;
+}
+
+}	// namespace
+
+TEST_CASE(timer, fixedSlack)
+{
+	FakeClock clock;
+	clock.overshoot = [](int) { return 300; };
+	timer::PreciseWaiter waiter(clock, makeParam(timer::SlackPolicy::Fixed));
+	CHECK(waiter.getSlack() == 2000);
+
+	int64_t target = clock.now + 16667;
+	CHECK(waiter.waitUntil(target) == target);
+	// sleep until target - slack, spin for the rest
+	CHECK(clock.lastSleep == 16667 - 2000);
+	CHECK(clock.spins == 2000 - 300);
+	// never adapted
+	CHECK(waiter.getSlack() == 2000);
+
+	// already passed: no sleep, no spin
+	int sleeps = clock.sleeps;
+	int64_t spins = clock.spins;
+	CHECK(waiter.waitUntil(clock.now - 10) == clock.now);
+	CHECK(clock.sleeps == sleeps && clock.spins == spins);
+	// shorter than slack: spin only
+	target = clock.now + 1500;
+	CHECK(waiter.waitUntil(target) == target);
+	CHECK(clock.sleeps == sleeps);
+}
+
+TEST_CASE(timer, adaptiveConvergesToMean)
+{
+	// constant overshoot: sigma goes to 0, slack goes to the overshoot
+	FakeClock clock;
+	clock.overshoot = [](int) { return 500; };
+	timer::PreciseWaiter waiter(clock, makeParam(timer::SlackPolicy::Adaptive));
+	CHECK(waiter.getSlack() == 2000);
+
+	for (int i = 0; i < 300; i++) {
+		int64_t target = clock.now + 16667;
+		CHECK(waiter.waitUntil(target) == target);
+		// (sigma grows at first by the distance from the initial value)
+		CHECK(waiter.getSlack() >= 500 && waiter.getSlack() <= 4000);
+	}
+	CHECK(waiter.getSlack() >= 500 && waiter.getSlack() <= 510);
+	// spin time per frame = slack - overshoot
+	int64_t spins = clock.spins;
+	int64_t target = clock.now + 16667;
+	waiter.waitUntil(target);
+	CHECK(clock.spins - spins <= 10);
+}
+
+TEST_CASE(timer, adaptiveMeanPlus3Sigma)
+{
+	// overshoot 300 and 700 alternately: mean 500, sigma 200
+	FakeClock clock;
+	clock.overshoot = [](int n) { return (n % 2 == 0) ? 300 : 700; };
+	timer::PreciseWaiter waiter(clock, makeParam(timer::SlackPolicy::Adaptive));
+	for (int i = 0; i < 1000; i++) {
+		int64_t target = clock.now + 16667;
+		// slack covers every overshoot
+		CHECK(waiter.waitUntil(target) == target);
+	}
+	// EWMA variance is slightly biased by the moving mean
+	int64_t slack = waiter.getSlack();
+	CHECK(slack >= 500 + 3 * 180 && slack <= 500 + 3 * 210);
+}
+
+TEST_CASE(timer, adaptiveClamp)
+{
+	timer::WaitParam param = makeParam(timer::SlackPolicy::Adaptive);
+	FakeClock clock;
+	clock.overshoot = [](int) { return 0; };
+	timer::PreciseWaiter low(clock, param);
+	for (int i = 0; i < 300; i++) {
+		low.waitUntil(clock.now + 10000);
+	}
+	CHECK(low.getSlack() == param.minSlackUs);
+
+	// late wake-up beyond max slack is a missed deadline
+	clock.overshoot = [](int) { return 6000; };
+	timer::PreciseWaiter high(clock, param);
+	int64_t late = 0;
+	for (int i = 0; i < 300; i++) {
+		int64_t target = clock.now + 16667;
+		late = high.waitUntil(target) - target;
+	}
+	CHECK(high.getSlack() == param.maxSlackUs);
+	CHECK(late == 6000 - param.maxSlackUs);
+}
+
+TEST_CASE(timer, spinOnlyAndSleepOnly)
+{
+	FakeClock clock;
+	clock.overshoot = [](int) { return 100; };
+	timer::PreciseWaiter spin(clock, makeParam(timer::SlackPolicy::SpinOnly));
+	int64_t target = clock.now + 5000;
+	CHECK(spin.waitUntil(target) == target);
+	CHECK(clock.sleeps == 0 && clock.spins == 5000);
+
+	timer::PreciseWaiter sleep(clock, makeParam(timer::SlackPolicy::SleepOnly));
+	target = clock.now + 5000;
+	CHECK(sleep.waitUntil(target) == target + 100);
+	CHECK(clock.sleeps == 1 && clock.lastSleep == 5000 && clock.spins == 5000);
+
+	// woke up early: spin for the rest
+	clock.overshoot = [](int) { return -50; };
+	target = clock.now + 5000;
+	CHECK(sleep.waitUntil(target) == target);
+	CHECK(clock.spins == 5050);
+}
+
+TEST_CASE(timer, frameJitter)
+{
+	timer::FrameJitter jitter;
+	timer::calcFrameJitter(&jitter, {}, Freq);
+	CHECK(jitter.meanMs == 0.0 && jitter.maxMs == 0.0);
+
+	// 99 frames of 16 ms and a 26 ms spike
+	std::vector<int64_t> samples(99, 16000);
+	samples.push_back(26000);
+	timer::calcFrameJitter(&jitter, samples, Freq);
+	CHECK(near(jitter.meanMs, 16.1, 1e-9));
+	CHECK(near(jitter.stddevMs, std::sqrt(0.99 * 0.01) * 10.0, 1e-9));
+	CHECK(near(jitter.p99Ms, 16.0, 1e-9));
+	CHECK(near(jitter.maxMs, 26.0, 1e-9));
+
+	// 1..100 ms (nearest-rank percentile)
+	samples.clear();
+	for (int i = 100; i >= 1; i--) {
+		samples.push_back(i * 1000);
+	}
+	timer::calcFrameJitter(&jitter, samples, Freq);
+	CHECK(near(jitter.meanMs, 50.5, 1e-9));
+	CHECK(near(jitter.stddevMs, std::sqrt((100.0 * 100.0 - 1.0) / 12.0), 1e-9));
+	CHECK(near(jitter.p99Ms, 99.0, 1e-9));
+	CHECK(near(jitter.maxMs, 100.0, 1e-9));
+}
+
+TEST_CASE(timer, framePacing)
+{
+	// 60 fps loop with scheduler noise 0..1000 us
+	const int64_t Period = 16667;
+	uint32_t x = 12345;
+	auto noise = [&x](int) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		return static_cast<int64_t>(x % 1001);
+	};
+
+	auto run = [&](timer::SlackPolicy policy, timer::FrameJitter *jitter) {
+		FakeClock clock;
+		clock.overshoot = noise;
+		timer::PreciseWaiter waiter(clock, makeParam(policy));
+		std::vector<int64_t> intervals;
+		int64_t target = clock.now;
+		int64_t prev = clock.now;
+		for (int i = 0; i < 600; i++) {
+			// update and render
+			clock.now += 3000 + (i % 5) * 500;
+			target += Period;
+			int64_t cur = waiter.waitUntil(target);
+			intervals.push_back(cur - prev);
+			prev = cur;
+		}
+		timer::calcFrameJitter(jitter, intervals, Freq);
+		return clock.spins;
+	};
+
+	// adaptive slack absorbs the noise: exact frame interval
+	timer::FrameJitter adaptive;
+	int64_t adaptiveSpins = run(timer::SlackPolicy::Adaptive, &adaptive);
+	CHECK(near(adaptive.meanMs, Period / 1000.0, 1e-9));
+	CHECK(adaptive.stddevMs == 0.0);
+	CHECK(near(adaptive.maxMs, Period / 1000.0, 1e-9));
+
+	// fixed 2 ms slack is also exact, but spins longer
+	timer::FrameJitter fixed;
+	int64_t fixedSpins = run(timer::SlackPolicy::Fixed, &fixed);
+	CHECK(fixed.stddevMs == 0.0);
+	CHECK(adaptiveSpins < fixedSpins);
+
+	// sleep only: the noise goes to frame time
+	timer::FrameJitter sleep;
+	int64_t sleepSpins = run(timer::SlackPolicy::SleepOnly, &sleep);
+	CHECK(sleepSpins == 0);
+	CHECK(sleep.stddevMs > 0.1);
+	CHECK(sleep.maxMs > Period / 1000.0 + 0.5);
+}
+
+TEST_CASE(timer, frameTimeRing)
+{
+	timer::FrameTimeRing ring(Freq);
+	timer::FrameTimeStats stats;
+	ring.getStats(&stats, 100);
+	CHECK(stats.frames == 0);
+
+	// wrap around: total = 1..(Capacity + 100) ms
+	const uint32_t Count = timer::FrameTimeRing::Capacity + 100;
+	for (uint32_t i = 1; i <= Count; i++) {
+		timer::FrameTimeSample sample;
+		sample.update = 1000;
+		sample.total = i * 1000;
+		ring.push(sample);
+	}
+	CHECK(ring.getCount() == Count);
+
+	std::vector<timer::FrameTimeSample> latest;
+	ring.copyLatest(&latest, 10);
+	CHECK(latest.size() == 10 && latest.front().total == (Count - 9) * 1000);
+	ring.copyLatest(&latest, Count);
+	CHECK(latest.size() == timer::FrameTimeRing::Capacity);
+	CHECK(latest.front().total == 101 * 1000 && latest.back().total == Count * 1000);
+
+	// last 100 frames: (Count - 99)..Count ms
+	ring.getStats(&stats, 100);
+	CHECK(stats.frames == 100);
+	CHECK(near(stats.total.p50Ms, Count - 50.0, 1e-9));
+	CHECK(near(stats.total.p99Ms, Count - 1.0, 1e-9));
+	CHECK(near(stats.total.maxMs, Count, 1e-9));
+	CHECK(near(stats.update.maxMs, 1.0, 1e-9));
+
+	// 10 frames in 1000 ms bins
+	std::vector<uint32_t> hist;
+	ring.getHistogram(&hist, 1000.0, 3, 10);
+	CHECK(hist.size() == 3 && hist[0] == 0 && hist[1] == 10 && hist[2] == 0);
+	ring.getHistogram(&hist, 100.0, 4, 10);
+	CHECK(hist[3] == 10);
+}
@@ -1,2 +1,2 @@
-rmdir /S /Q html
-del log.txt
+rmdir /S /Q html
+del log.txt